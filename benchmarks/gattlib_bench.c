@@ -0,0 +1,621 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// End-to-end benchmarks of gattlib. The results are written as JSON.
+//
+// The devices are expected to be described by the file generated by 'gen-bench-conf.sh' and served either by
+// the fake Bluez service (DBus backend, see 'dbus/fake-bluez/run-with-fake-bluez.sh') or by the loopback
+// ATT peer (legacy backend, option '-l'). Any real device exposing the same kind of characteristics can be used too.
+//
+
+#include <getopt.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib.h"
+
+#define BENCH_DEFAULT_ITERATIONS          1000
+#define BENCH_DEFAULT_CONNECT_ITERATIONS  20
+#define BENCH_DEFAULT_DURATION_S          5
+#define BENCH_MAX_DISCOVERY_DEVICES       16
+
+// Default ATT MTU minus the header of the ATT Write Command
+#define BENCH_PAYLOAD_SIZE                20
+
+/**
+ * Latency samples in microseconds
+ */
+struct bench_samples {
+	double *values;
+	size_t count;
+	size_t capacity;
+};
+
+struct bench_notification_state {
+	gint64 start_time;
+	gint64 last_time;
+	unsigned long received;
+	unsigned long lost;
+	uint32_t last_sequence;
+	struct bench_samples intervals;
+};
+
+struct bench_scan_state {
+	unsigned long callbacks;
+	GHashTable *advertisers;
+	GMutex mutex;
+};
+
+static const char *m_description_file;
+static unsigned int m_iterations = BENCH_DEFAULT_ITERATIONS;
+static unsigned int m_connect_iterations = BENCH_DEFAULT_CONNECT_ITERATIONS;
+static unsigned int m_duration_s = BENCH_DEFAULT_DURATION_S;
+
+static void samples_add(struct bench_samples *samples, double value) {
+	if (samples->count == samples->capacity) {
+		size_t capacity = (samples->capacity == 0) ? 256 : samples->capacity * 2;
+		double *values = realloc(samples->values, capacity * sizeof(double));
+		if (values == NULL) {
+			return;
+		}
+		samples->values = values;
+		samples->capacity = capacity;
+	}
+	samples->values[samples->count++] = value;
+}
+
+static void samples_free(struct bench_samples *samples) {
+	free(samples->values);
+	memset(samples, 0, sizeof(struct bench_samples));
+}
+
+static int double_cmp(const void *a, const void *b) {
+	double value_a = *(const double *)a, value_b = *(const double *)b;
+	return (value_a > value_b) - (value_a < value_b);
+}
+
+// Nearest-rank percentile of the sorted samples
+static double samples_percentile(const struct bench_samples *samples, unsigned int per_thousand) {
+	size_t rank = (samples->count * per_thousand + 999) / 1000;
+	return samples->values[(rank > 0) ? rank - 1 : 0];
+}
+
+/*
+ * Write the statistics of the samples and their histogram. The bucket 'le_us' counts the samples
+ * lower or equal to 'le_us' and greater than the previous bucket (power of 2 microseconds).
+ */
+static void json_latency(FILE *out, struct bench_samples *samples) {
+	double sum = 0;
+	size_t i = 0;
+
+	if (samples->count == 0) {
+		fprintf(out, "{ \"count\": 0 }");
+		return;
+	}
+
+	qsort(samples->values, samples->count, sizeof(double), double_cmp);
+	for (i = 0; i < samples->count; i++) {
+		sum += samples->values[i];
+	}
+
+	fprintf(out, "{ \"count\": %zu, \"min_us\": %.1f, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+			"\"p999_us\": %.1f, \"max_us\": %.1f, \"histogram\": [",
+			samples->count, samples->values[0], sum / samples->count,
+			samples_percentile(samples, 500), samples_percentile(samples, 990), samples_percentile(samples, 999),
+			samples->values[samples->count - 1]);
+
+	i = 0;
+	for (unsigned long bucket = 1; i < samples->count; bucket *= 2) {
+		size_t count = 0;
+
+		while ((i < samples->count) && (samples->values[i] <= bucket)) {
+			count++;
+			i++;
+		}
+		if (count > 0) {
+			fprintf(out, "%s{ \"le_us\": %lu, \"count\": %zu }", (i == count) ? " " : ", ", bucket, count);
+		}
+	}
+	fprintf(out, " ] }");
+}
+
+static void json_skipped(FILE *out, const char *reason) {
+	fprintf(out, "{ \"skipped\": \"%s\" }", reason);
+}
+
+static gatt_connection_t *bench_connect(const char *address) {
+	if (m_description_file != NULL) {
+		return gattlib_connect_loopback(m_description_file, address);
+	} else {
+		return gattlib_connect(NULL, address, GATTLIB_CONNECTION_OPTIONS_LEGACY_DEFAULT);
+	}
+}
+
+/*
+ * Return the first characteristic with the given property
+ */
+static const gattlib_characteristic_t *bench_find_characteristic(const gattlib_gatt_db_t *db, uint8_t property) {
+	const gattlib_gatt_tree_t *tree = gattlib_gatt_db_get_tree(db);
+
+	for (size_t s = 0; s < tree->services_count; s++) {
+		for (size_t c = 0; c < tree->services[s].characteristics_count; c++) {
+			const gattlib_characteristic_t *characteristic = &tree->services[s].characteristics[c].characteristic;
+			if (characteristic->properties & property) {
+				return characteristic;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void bench_connect_resolve(FILE *out, const char *address) {
+	struct bench_samples connect = { 0 }, connect_resolve = { 0 };
+
+	for (unsigned int i = 0; i < m_connect_iterations; i++) {
+		const gattlib_gatt_db_t *db;
+		gatt_connection_t *connection;
+		gint64 start = g_get_monotonic_time();
+
+		connection = bench_connect(address);
+		if (connection == NULL) {
+			fprintf(stderr, "Fail to connect to '%s'.\n", address);
+			break;
+		}
+		samples_add(&connect, g_get_monotonic_time() - start);
+
+		if (gattlib_gatt_db_get(connection, &db) == GATTLIB_SUCCESS) {
+			samples_add(&connect_resolve, g_get_monotonic_time() - start);
+			gattlib_gatt_db_release(connection, db);
+		}
+
+		gattlib_disconnect(connection);
+	}
+
+	fprintf(out, "\t\t\"connect\": ");
+	json_latency(out, &connect);
+	fprintf(out, ",\n\t\t\"connect_resolve\": ");
+	json_latency(out, &connect_resolve);
+	fprintf(out, ",\n");
+
+	samples_free(&connect);
+	samples_free(&connect_resolve);
+}
+
+static void bench_read(FILE *out, gatt_connection_t *connection, const gattlib_gatt_db_t *db) {
+	const gattlib_characteristic_t *characteristic = bench_find_characteristic(db, GATTLIB_CHARACTERISTIC_READ);
+	struct bench_samples samples = { 0 };
+	uuid_t uuid;
+
+	if (characteristic == NULL) {
+		json_skipped(out, "no readable characteristic");
+		return;
+	}
+	uuid = characteristic->uuid;
+
+	for (unsigned int i = 0; i < m_iterations; i++) {
+		gint64 start = g_get_monotonic_time();
+		size_t buffer_len;
+		void *buffer;
+
+		if (gattlib_read_char_by_uuid(connection, &uuid, &buffer, &buffer_len) != GATTLIB_SUCCESS) {
+			fprintf(stderr, "Fail to read the characteristic.\n");
+			break;
+		}
+		samples_add(&samples, g_get_monotonic_time() - start);
+		free(buffer);
+	}
+
+	json_latency(out, &samples);
+	samples_free(&samples);
+}
+
+static void bench_write(FILE *out, gatt_connection_t *connection, const gattlib_gatt_db_t *db) {
+	const gattlib_characteristic_t *characteristic = bench_find_characteristic(db, GATTLIB_CHARACTERISTIC_WRITE);
+	struct bench_samples samples = { 0 };
+	uint8_t payload[BENCH_PAYLOAD_SIZE] = { 0 };
+
+	if (characteristic == NULL) {
+		json_skipped(out, "no writable characteristic");
+		return;
+	}
+
+	for (unsigned int i = 0; i < m_iterations; i++) {
+		gint64 start = g_get_monotonic_time();
+
+		payload[0] = i;
+		if (gattlib_write_char_by_handle(connection, characteristic->value_handle, payload, sizeof(payload)) != GATTLIB_SUCCESS) {
+			fprintf(stderr, "Fail to write the characteristic.\n");
+			break;
+		}
+		samples_add(&samples, g_get_monotonic_time() - start);
+	}
+
+	json_latency(out, &samples);
+	samples_free(&samples);
+}
+
+static void json_throughput(FILE *out, unsigned long operations, gint64 duration_us, size_t payload_size) {
+	double duration_s = duration_us / 1000000.0;
+
+	fprintf(out, "{ \"duration_s\": %.3f, \"operations\": %lu, \"bytes\": %lu, \"operations_per_s\": %.1f, \"bytes_per_s\": %.1f }",
+			duration_s, operations, operations * payload_size,
+			operations / duration_s, operations * payload_size / duration_s);
+}
+
+static void bench_write_without_response(FILE *out, gatt_connection_t *connection, const gattlib_gatt_db_t *db) {
+	const gattlib_characteristic_t *characteristic = bench_find_characteristic(db, GATTLIB_CHARACTERISTIC_WRITE_WITHOUT_RESP);
+	uint8_t payload[BENCH_PAYLOAD_SIZE] = { 0 };
+	gint64 start, end;
+	unsigned long operations = 0;
+	int ret;
+
+	if (characteristic == NULL) {
+		json_skipped(out, "no characteristic writable without response");
+		return;
+	}
+
+	start = g_get_monotonic_time();
+	end = start + m_duration_s * G_USEC_PER_SEC;
+	do {
+		payload[0] = operations;
+		ret = gattlib_write_without_response_char_by_handle(connection, characteristic->value_handle, payload, sizeof(payload));
+		if (ret != GATTLIB_SUCCESS) {
+			break;
+		}
+		operations++;
+	} while (g_get_monotonic_time() < end);
+
+	if (ret == GATTLIB_NOT_SUPPORTED) {
+		json_skipped(out, "not supported by the backend");
+	} else {
+		json_throughput(out, operations, g_get_monotonic_time() - start, sizeof(payload));
+	}
+}
+
+static void bench_stream(FILE *out, gatt_connection_t *connection, const gattlib_gatt_db_t *db) {
+	const gattlib_characteristic_t *characteristic = bench_find_characteristic(db, GATTLIB_CHARACTERISTIC_WRITE_WITHOUT_RESP);
+	uint8_t payload[BENCH_PAYLOAD_SIZE] = { 0 };
+	unsigned long operations = 0;
+	gatt_stream_t *stream;
+	gint64 start, end;
+	uuid_t uuid;
+	uint16_t mtu;
+	int ret;
+
+	if (characteristic == NULL) {
+		json_skipped(out, "no characteristic writable without response");
+		return;
+	}
+	uuid = characteristic->uuid;
+
+	ret = gattlib_write_char_by_uuid_stream_open(connection, &uuid, &stream, &mtu);
+	if (ret == GATTLIB_NOT_SUPPORTED) {
+		json_skipped(out, "not supported by the backend");
+		return;
+	} else if (ret != GATTLIB_SUCCESS) {
+		json_skipped(out, "fail to open the stream");
+		return;
+	}
+
+	start = g_get_monotonic_time();
+	end = start + m_duration_s * G_USEC_PER_SEC;
+	do {
+		payload[0] = operations;
+		if (gattlib_write_char_stream_write(stream, payload, sizeof(payload)) != GATTLIB_SUCCESS) {
+			break;
+		}
+		operations++;
+	} while (g_get_monotonic_time() < end);
+
+	json_throughput(out, operations, g_get_monotonic_time() - start, sizeof(payload));
+	gattlib_write_char_stream_close(stream);
+}
+
+static void notification_handler(const uuid_t* uuid, const uint8_t* data, size_t data_length, void* user_data) {
+	struct bench_notification_state *state = user_data;
+	gint64 now = g_get_monotonic_time();
+
+	if (state->received > 0) {
+		samples_add(&state->intervals, now - state->last_time);
+	}
+
+	// The devices of the benchmark send a little-endian sequence number in the first 4 bytes
+	if (data_length >= 4) {
+		uint32_t sequence = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+		if ((state->received > 0) && (sequence > state->last_sequence + 1)) {
+			state->lost += sequence - state->last_sequence - 1;
+		}
+		state->last_sequence = sequence;
+	}
+
+	state->last_time = now;
+	state->received++;
+}
+
+static gboolean on_duration_elapsed(gpointer user_data) {
+	g_main_loop_quit(user_data);
+	return FALSE;
+}
+
+/*
+ * Run the default main context for the duration of the benchmark. The DBus backend dispatches its events there.
+ */
+static void bench_run_main_loop(void) {
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+	g_timeout_add_seconds(m_duration_s, on_duration_elapsed, loop);
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+}
+
+static void bench_notification(FILE *out, gatt_connection_t *connection, const gattlib_gatt_db_t *db) {
+	const gattlib_characteristic_t *characteristic = bench_find_characteristic(db, GATTLIB_CHARACTERISTIC_NOTIFY);
+	struct bench_notification_state state = { 0 };
+	double duration_s;
+	uuid_t uuid;
+
+	if (characteristic == NULL) {
+		json_skipped(out, "no characteristic with notification");
+		return;
+	}
+	uuid = characteristic->uuid;
+
+	gattlib_register_notification(connection, notification_handler, &state);
+
+	state.start_time = g_get_monotonic_time();
+	if (gattlib_notification_start(connection, &uuid) != GATTLIB_SUCCESS) {
+		json_skipped(out, "fail to start the notifications");
+		return;
+	}
+
+	bench_run_main_loop();
+
+	gattlib_notification_stop(connection, &uuid);
+	gattlib_register_notification(connection, NULL, NULL);
+
+	duration_s = (state.last_time - state.start_time) / 1000000.0;
+	fprintf(out, "{ \"received\": %lu, \"lost\": %lu, \"rate_per_s\": %.1f, \"interval\": ",
+			state.received, state.lost, (duration_s > 0) ? state.received / duration_s : 0);
+	json_latency(out, &state.intervals);
+	fprintf(out, " }");
+
+	samples_free(&state.intervals);
+}
+
+static size_t gatt_tree_attributes_count(const gattlib_gatt_tree_t *tree) {
+	size_t count = tree->services_count;
+
+	for (size_t s = 0; s < tree->services_count; s++) {
+		// Declaration and value of the characteristics
+		count += 2 * tree->services[s].characteristics_count;
+		for (size_t c = 0; c < tree->services[s].characteristics_count; c++) {
+			count += tree->services[s].characteristics[c].descriptors_count;
+		}
+	}
+	return count;
+}
+
+static void bench_discovery(FILE *out, const char *address, bool first) {
+	struct bench_samples samples = { 0 };
+	gatt_connection_t *connection;
+	size_t attributes_count = 0;
+	unsigned int iterations = MAX(m_iterations / 10, 1);
+
+	fprintf(out, "%s\t\t\t{ \"device\": \"%s\", ", first ? "" : ",\n", address);
+
+	connection = bench_connect(address);
+	if (connection == NULL) {
+		fprintf(stderr, "Fail to connect to '%s'.\n", address);
+		fprintf(out, "\"skipped\": \"fail to connect\" }");
+		return;
+	}
+
+	for (unsigned int i = 0; i < iterations; i++) {
+		gint64 start = g_get_monotonic_time();
+		gattlib_gatt_tree_t *tree;
+
+		if (gattlib_discover_all(connection, &tree) != GATTLIB_SUCCESS) {
+			fprintf(stderr, "Fail to discover '%s'.\n", address);
+			break;
+		}
+		samples_add(&samples, g_get_monotonic_time() - start);
+
+		attributes_count = gatt_tree_attributes_count(tree);
+		free(tree);
+	}
+
+	fprintf(out, "\"attributes\": %zu, \"latency\": ", attributes_count);
+	json_latency(out, &samples);
+	fprintf(out, " }");
+
+	samples_free(&samples);
+	gattlib_disconnect(connection);
+}
+
+static void on_device_discovered(void *adapter, const char* addr, const char* name, void *user_data) {
+	struct bench_scan_state *state = user_data;
+
+	// The legacy backend calls it from the gattlib thread
+	g_mutex_lock(&state->mutex);
+	state->callbacks++;
+	g_hash_table_add(state->advertisers, g_strdup(addr));
+	g_mutex_unlock(&state->mutex);
+}
+
+static void bench_scan(FILE *out) {
+	struct bench_scan_state state = { 0 };
+	void *adapter;
+	gint64 start;
+	double duration_s;
+	int ret;
+
+	if (m_description_file != NULL) {
+		json_skipped(out, "no adapter with the loopback connections");
+		return;
+	}
+
+	ret = gattlib_adapter_open(NULL, &adapter);
+	if (ret != GATTLIB_SUCCESS) {
+		json_skipped(out, "fail to open the adapter");
+		return;
+	}
+
+	g_mutex_init(&state.mutex);
+	state.advertisers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	start = g_get_monotonic_time();
+	ret = gattlib_adapter_scan_start(adapter, NULL, 0, 0, on_device_discovered, &state);
+	if (ret != GATTLIB_SUCCESS) {
+		json_skipped(out, "fail to start the scan");
+	} else {
+		bench_run_main_loop();
+		gattlib_adapter_scan_stop(adapter);
+
+		g_mutex_lock(&state.mutex);
+		duration_s = (g_get_monotonic_time() - start) / 1000000.0;
+		fprintf(out, "{ \"duration_s\": %.3f, \"advertisers\": %u, \"callbacks\": %lu, \"callbacks_per_s\": %.1f }",
+				duration_s, g_hash_table_size(state.advertisers), state.callbacks, state.callbacks / duration_s);
+		g_mutex_unlock(&state.mutex);
+	}
+
+	g_hash_table_destroy(state.advertisers);
+	g_mutex_clear(&state.mutex);
+	gattlib_adapter_close(adapter);
+}
+
+static void usage(char *argv[]) {
+	printf("%s [-l <description_file>] [-n <iterations>] [-c <connect_iterations>] [-t <duration_s>] [-o <output.json>]\n"
+	       "\t[-D <discovery_device>]... [-S] <device_address>\n", argv[0]);
+	printf("\t-l: connect to the loopback ATT peer (legacy backend) instead of Bluez\n");
+	printf("\t-D: measure the discovery of the device (can be repeated)\n");
+	printf("\t-S: measure the scan callbacks\n");
+}
+
+int main(int argc, char *argv[]) {
+	const char *discovery_devices[BENCH_MAX_DISCOVERY_DEVICES];
+	size_t discovery_devices_count = 0;
+	const gattlib_gatt_db_t *db;
+	gatt_connection_t *connection;
+	const char *output = NULL;
+	bool scan = false;
+	FILE *out = stdout;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:n:c:t:o:D:S")) != -1) {
+		switch (opt) {
+		case 'l':
+			m_description_file = optarg;
+			break;
+		case 'n':
+			m_iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			m_connect_iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			m_duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'D':
+			if (discovery_devices_count < BENCH_MAX_DISCOVERY_DEVICES) {
+				discovery_devices[discovery_devices_count++] = optarg;
+			}
+			break;
+		case 'S':
+			scan = true;
+			break;
+		default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		usage(argv);
+		return 1;
+	}
+
+	connection = bench_connect(argv[optind]);
+	if (connection == NULL) {
+		fprintf(stderr, "Fail to connect to the bluetooth device.\n");
+		return 1;
+	}
+
+	if (gattlib_gatt_db_get(connection, &db) != GATTLIB_SUCCESS) {
+		fprintf(stderr, "Fail to discover the bluetooth device.\n");
+		gattlib_disconnect(connection);
+		return 1;
+	}
+
+	if (output != NULL) {
+		out = fopen(output, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Fail to open '%s'.\n", output);
+			gattlib_disconnect(connection);
+			return 1;
+		}
+	}
+
+	fprintf(out, "{\n\t\"transport\": \"%s\",\n\t\"device\": \"%s\",\n", m_description_file ? "loopback" : "bluez", argv[optind]);
+	fprintf(out, "\t\"iterations\": %u,\n\t\"duration_s\": %u,\n\t\"benchmarks\": {\n", m_iterations, m_duration_s);
+
+	fprintf(out, "\t\t\"read\": ");
+	bench_read(out, connection, db);
+	fprintf(out, ",\n\t\t\"write\": ");
+	bench_write(out, connection, db);
+	fprintf(out, ",\n\t\t\"write_without_response\": ");
+	bench_write_without_response(out, connection, db);
+	fprintf(out, ",\n\t\t\"stream\": ");
+	bench_stream(out, connection, db);
+	fprintf(out, ",\n\t\t\"notification\": ");
+	bench_notification(out, connection, db);
+	fprintf(out, ",\n");
+
+	gattlib_gatt_db_release(connection, db);
+	gattlib_disconnect(connection);
+
+	// The connection benchmark needs the device disconnected
+	bench_connect_resolve(out, argv[optind]);
+
+	fprintf(out, "\t\t\"discovery\": [\n");
+	for (size_t i = 0; i < discovery_devices_count; i++) {
+		bench_discovery(out, discovery_devices[i], i == 0);
+	}
+	fprintf(out, "\n\t\t],\n\t\t\"scan\": ");
+	if (scan) {
+		bench_scan(out);
+	} else {
+		json_skipped(out, "not requested");
+	}
+	fprintf(out, "\n\t}\n}\n");
+
+	if (out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
@@ -0,0 +1,401 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// CPU microbenchmarks of the UUID, advertising data and ATT PDU codecs on the per-packet paths.
+//
+// The codecs are built into the benchmark from their sources so it runs without any Bluetooth stack.
+// Each function is called on a fixed corpus until the minimum measurement time is reached. The results
+// (ns/op and allocations/op) are written as JSON.
+//
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gattlib_internal.h"
+
+#include "att.h"
+
+#define MICROBENCH_DEFAULT_MIN_TIME_MS  200
+#define MICROBENCH_MAX_ITERATIONS       (1UL << 30)
+
+#define ARRAY_SIZE(array)  (sizeof(array) / sizeof(array[0]))
+
+typedef void (*microbench_func_t)(size_t iterations);
+
+struct microbench {
+	const char *name;
+	microbench_func_t run;
+};
+
+// Number of allocations done through the allocator of the C library
+static unsigned long m_allocations;
+
+// Results are accumulated here so the compiler cannot drop the benchmarked calls
+static volatile uintptr_t m_sink;
+
+//
+// Count the allocations by interposing the allocator of the C library (glibc). The other libraries
+// (eg: GLib) and the C library itself allocate through these symbols too.
+//
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+	m_allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	m_allocations++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	m_allocations++;
+	return __libc_realloc(ptr, size);
+}
+
+//
+// Corpora
+//
+
+static const char *m_uuid_strings[] = {
+	"0x2a19",
+	"2a37",
+	"0000fff1",
+	"0000180d-0000-1000-8000-00805f9b34fb",
+	"6e400001-b5a3-f393-e0a9-e50e24dcca9e",
+	"6E400003-B5A3-F393-E0A9-E50E24DCCA9E",
+};
+
+static uuid_t m_uuids[ARRAY_SIZE(m_uuid_strings)];
+
+static const uint8_t m_ad_with_complete_name[] = {
+	0x02, 0x01, 0x06,                                     // Flags
+	0x03, 0x03, 0x0d, 0x18,                               // Complete list of 16-bit UUIDs
+	0x0b, 0x09, 'H', 'e', 'a', 'r', 't', ' ', 'R', 'a', 't', 'e', // Complete local name
+};
+
+static const uint8_t m_ad_with_short_name_last[] = {
+	0x02, 0x01, 0x06,                                     // Flags
+	0x07, 0xff, 0x59, 0x00, 0x01, 0x02, 0x03, 0x04,       // Manufacturer data
+	0x11, 0x07, 0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0,
+	      0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e, // Complete list of 128-bit UUIDs
+	0x05, 0x08, 'U', 'A', 'R', 'T',                       // Shortened local name
+};
+
+static const uint8_t m_ad_without_name[] = {
+	0x02, 0x01, 0x06,                                     // Flags
+	0x03, 0x19, 0x41, 0x03,                               // Appearance
+	0x02, 0x0a, 0x04,                                     // TX power
+};
+
+static const struct {
+	const uint8_t *data;
+	size_t size;
+} m_ads[] = {
+	{ m_ad_with_complete_name, sizeof(m_ad_with_complete_name) },
+	{ m_ad_with_short_name_last, sizeof(m_ad_with_short_name_last) },
+	{ m_ad_without_name, sizeof(m_ad_without_name) },
+};
+
+// Characteristic discovery: 4 x (declaration handle, properties, value handle, UUID16)
+static const uint8_t m_read_by_type_resp[] = {
+	ATT_OP_READ_BY_TYPE_RESP, 7,
+	0x02, 0x00, 0x02, 0x03, 0x00, 0x00, 0x2a,
+	0x04, 0x00, 0x02, 0x05, 0x00, 0x01, 0x2a,
+	0x06, 0x00, 0x10, 0x07, 0x00, 0x37, 0x2a,
+	0x09, 0x00, 0x0a, 0x0a, 0x00, 0x38, 0x2a,
+};
+
+// Primary service discovery: 3 x (start handle, end handle, UUID16)
+static const uint8_t m_read_by_grp_resp[] = {
+	ATT_OP_READ_BY_GROUP_RESP, 6,
+	0x01, 0x00, 0x07, 0x00, 0x00, 0x18,
+	0x08, 0x00, 0x0b, 0x00, 0x01, 0x18,
+	0x0c, 0x00, 0xff, 0xff, 0x0d, 0x18,
+};
+
+// Descriptor discovery: 4 x (handle, UUID16)
+static const uint8_t m_find_info_resp[] = {
+	ATT_OP_FIND_INFO_RESP, ATT_FIND_INFO_RESP_FMT_16BIT,
+	0x0d, 0x00, 0x03, 0x28,
+	0x0e, 0x00, 0x37, 0x2a,
+	0x0f, 0x00, 0x02, 0x29,
+	0x10, 0x00, 0x01, 0x29,
+};
+
+static const uint8_t m_read_resp[] = {
+	ATT_OP_READ_RESP, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+	0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+};
+
+static const uint8_t m_indication[] = {
+	ATT_OP_HANDLE_IND, 0x03, 0x00, 0x01, 0x00, 0xff, 0xff,
+};
+
+static void corpora_init(void) {
+	for (size_t i = 0; i < ARRAY_SIZE(m_uuid_strings); i++) {
+		gattlib_string_to_uuid(m_uuid_strings[i], strlen(m_uuid_strings[i]) + 1, &m_uuids[i]);
+	}
+}
+
+//
+// Benchmarks
+//
+
+static void bench_gattlib_string_to_uuid(size_t iterations) {
+	uuid_t uuid;
+
+	for (size_t i = 0; i < iterations; i++) {
+		const char *str = m_uuid_strings[i % ARRAY_SIZE(m_uuid_strings)];
+		m_sink += gattlib_string_to_uuid(str, strlen(str) + 1, &uuid);
+		m_sink += uuid.type;
+	}
+}
+
+static void bench_bt_string_to_uuid(size_t iterations) {
+	bt_uuid_t uuid;
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += bt_string_to_uuid(&uuid, m_uuid_strings[i % ARRAY_SIZE(m_uuid_strings)]);
+		m_sink += uuid.type;
+	}
+}
+
+static void bench_gattlib_uuid_to_string(size_t iterations) {
+	char str[MAX_LEN_UUID_STR + 1];
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += gattlib_uuid_to_string(&m_uuids[i % ARRAY_SIZE(m_uuids)], str, sizeof(str));
+		m_sink += str[0];
+	}
+}
+
+static void bench_gattlib_uuid_cmp(size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		// Compare each UUID with itself and with its neighbour (same or different type)
+		const uuid_t *uuid = &m_uuids[i % ARRAY_SIZE(m_uuids)];
+		m_sink += gattlib_uuid_cmp(uuid, uuid);
+		m_sink += gattlib_uuid_cmp(uuid, &m_uuids[(i + 1) % ARRAY_SIZE(m_uuids)]);
+	}
+}
+
+static void bench_gattlib_eir_parse_name(size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		char *name = gattlib_eir_parse_name(m_ads[i % ARRAY_SIZE(m_ads)].data, m_ads[i % ARRAY_SIZE(m_ads)].size);
+		m_sink += (uintptr_t)name;
+		free(name);
+	}
+}
+
+static void bench_dec_read_by_type_resp(size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		struct att_data_list *list = dec_read_by_type_resp(m_read_by_type_resp, sizeof(m_read_by_type_resp));
+		m_sink += list->num;
+		att_data_list_free(list);
+	}
+}
+
+static void bench_dec_read_by_grp_resp(size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		struct att_data_list *list = dec_read_by_grp_resp(m_read_by_grp_resp, sizeof(m_read_by_grp_resp));
+		m_sink += list->num;
+		att_data_list_free(list);
+	}
+}
+
+static void bench_dec_find_info_resp(size_t iterations) {
+	uint8_t format;
+
+	for (size_t i = 0; i < iterations; i++) {
+		struct att_data_list *list = dec_find_info_resp(m_find_info_resp, sizeof(m_find_info_resp), &format);
+		m_sink += list->num + format;
+		att_data_list_free(list);
+	}
+}
+
+static void bench_enc_read_by_type_req(size_t iterations) {
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+	bt_uuid_t uuid;
+
+	bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += enc_read_by_type_req(0x0001, 0xffff, &uuid, pdu, sizeof(pdu));
+	}
+}
+
+static void bench_enc_read_req(size_t iterations) {
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += enc_read_req(i & 0xffff, pdu, sizeof(pdu));
+	}
+}
+
+static void bench_dec_read_resp(size_t iterations) {
+	uint8_t value[ATT_DEFAULT_LE_MTU];
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += dec_read_resp(m_read_resp, sizeof(m_read_resp), value, sizeof(value));
+	}
+}
+
+static void bench_enc_write_req(size_t iterations) {
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+	const uint8_t value[] = { 0x01, 0x00 };
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += enc_write_req(i & 0xffff, value, sizeof(value), pdu, sizeof(pdu));
+	}
+}
+
+static void bench_dec_indication(size_t iterations) {
+	uint8_t value[ATT_DEFAULT_LE_MTU];
+	uint16_t handle;
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += dec_indication(m_indication, sizeof(m_indication), &handle, value, sizeof(value));
+		m_sink += handle;
+	}
+}
+
+static void bench_enc_confirmation(size_t iterations) {
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+
+	for (size_t i = 0; i < iterations; i++) {
+		m_sink += enc_confirmation(pdu, sizeof(pdu));
+	}
+}
+
+static const struct microbench m_microbenchs[] = {
+	{ "gattlib_string_to_uuid",  bench_gattlib_string_to_uuid },
+	{ "bt_string_to_uuid",       bench_bt_string_to_uuid },
+	{ "gattlib_uuid_to_string",  bench_gattlib_uuid_to_string },
+	{ "gattlib_uuid_cmp",        bench_gattlib_uuid_cmp },
+	{ "gattlib_eir_parse_name",  bench_gattlib_eir_parse_name },
+	{ "dec_read_by_type_resp",   bench_dec_read_by_type_resp },
+	{ "dec_read_by_grp_resp",    bench_dec_read_by_grp_resp },
+	{ "dec_find_info_resp",      bench_dec_find_info_resp },
+	{ "enc_read_by_type_req",    bench_enc_read_by_type_req },
+	{ "enc_read_req",            bench_enc_read_req },
+	{ "dec_read_resp",           bench_dec_read_resp },
+	{ "enc_write_req",           bench_enc_write_req },
+	{ "dec_indication",          bench_dec_indication },
+	{ "enc_confirmation",        bench_enc_confirmation },
+};
+
+static uint64_t monotonic_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Double the number of iterations until a run lasts the minimum time. The last run is reported.
+ */
+static void microbench_run(FILE *out, const struct microbench *microbench, uint64_t min_time_ns, bool first) {
+	unsigned long allocations;
+	size_t iterations = 1;
+	uint64_t elapsed_ns;
+
+	while (true) {
+		uint64_t start = monotonic_ns();
+		m_allocations = 0;
+
+		microbench->run(iterations);
+
+		allocations = m_allocations;
+		elapsed_ns = monotonic_ns() - start;
+		if ((elapsed_ns >= min_time_ns) || (iterations >= MICROBENCH_MAX_ITERATIONS)) {
+			break;
+		}
+		iterations *= 2;
+	}
+
+	fprintf(out, "%s\t\t{ \"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.2f, \"allocs_per_op\": %.2f }",
+			first ? "" : ",\n", microbench->name, iterations,
+			(double)elapsed_ns / iterations, (double)allocations / iterations);
+}
+
+static void usage(char *argv[]) {
+	printf("%s [-t <min_time_ms>] [-o <output.json>] [<name_filter>]\n", argv[0]);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long min_time_ms = MICROBENCH_DEFAULT_MIN_TIME_MS;
+	const char *output = NULL, *filter = NULL;
+	FILE *out = stdout;
+	bool first = true;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:o:")) != -1) {
+		switch (opt) {
+		case 't':
+			min_time_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv);
+			return 1;
+		}
+	}
+
+	if (optind < argc) {
+		filter = argv[optind];
+	}
+
+	if (output != NULL) {
+		out = fopen(output, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Fail to open '%s'.\n", output);
+			return 1;
+		}
+	}
+
+	corpora_init();
+
+	fprintf(out, "{\n\t\"min_time_ms\": %lu,\n\t\"benchmarks\": [\n", min_time_ms);
+	for (size_t i = 0; i < ARRAY_SIZE(m_microbenchs); i++) {
+		if ((filter != NULL) && (strstr(m_microbenchs[i].name, filter) == NULL)) {
+			continue;
+		}
+
+		microbench_run(out, &m_microbenchs[i], min_time_ms * 1000000ULL, first);
+		first = false;
+	}
+	fprintf(out, "\n\t]\n}\n");
+
+	if (out != stdout) {
+		fclose(out);
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+#
+# Generate the device description file used by 'gattlib-bench'.
+#
+# Usage: gen-bench-conf.sh [<advertisers>] > gattlib-bench.conf
+#
+# The file can be served by the fake Bluez service (DBus backend) or by the loopback peer (legacy backend):
+#   00:00:00:00:BE:01     Benchmarked device: read, write, write-without-response and notify (every 1ms)
+#   00:00:00:00:D0:<nn>   Devices with 1, 8, 32 and 128 characteristics for the discovery benchmark
+#   00:00:00:00:AD:<nn>   Advertisers for the scan benchmark (default: 16)
+#
+
+ADVERTISERS=${1:-16}
+
+SERVICE=0000fff0-0000-1000-8000-00805f9b34fb
+CCC=00002902-0000-1000-8000-00805f9b34fb
+PAYLOAD="00 01 02 03 04 05 06 07 08 09 0a 0b 0c 0d 0e 0f 10 11 12 13"
+
+cat <<EOF
+[Adapter]
+Name=hci0
+Address=00:00:00:00:00:01
+
+[Device 00:00:00:00:BE:01]
+Name=Bench
+LatencyMs=0
+AdvertisingIntervalMs=0
+
+[Service 00:00:00:00:BE:01 $SERVICE]
+
+[Characteristic 00:00:00:00:BE:01 0000fff1-0000-1000-8000-00805f9b34fb]
+Service=$SERVICE
+Flags=read
+Value=$PAYLOAD
+
+[Characteristic 00:00:00:00:BE:01 0000fff2-0000-1000-8000-00805f9b34fb]
+Service=$SERVICE
+Flags=write;write-without-response
+
+[Characteristic 00:00:00:00:BE:01 0000fff3-0000-1000-8000-00805f9b34fb]
+Service=$SERVICE
+Flags=notify
+Value=$PAYLOAD
+NotifyIntervalMs=1
+NotifySequence=true
+Descriptors=$CCC
+EOF
+
+device=0
+for characteristics in 1 8 32 128; do
+	device=$((device + 1))
+	address=$(printf "00:00:00:00:D0:%02X" $device)
+
+	printf "\n[Device %s]\nName=Discovery %d\nAdvertisingIntervalMs=0\n" "$address" "$characteristics"
+	printf "\n[Service %s %s]\n" "$address" "$SERVICE"
+	for i in $(seq $characteristics); do
+		printf "\n[Characteristic %s %08x-0000-1000-8000-00805f9b34fb]\n" "$address" $((0x10000 + i))
+		printf "Service=%s\nFlags=read;notify\nValue=00\nDescriptors=%s\n" "$SERVICE" "$CCC"
+	done
+done
+
+for i in $(seq $ADVERTISERS); do
+	printf "\n[Device 00:00:00:00:AD:%02X]\nName=Advertiser %d\nRSSI=-%d\nAdvertisingIntervalMs=100\n" $i $i $((40 + i % 50))
+done
@@ -38,6 +38,7 @@
 #include "lib/uuid.h"
 #include "src/shared/att.h"
 #include "src/shared/crypto.h"
+#include "gattlib_capture.h"
 
 #define ATT_MIN_PDU_LEN			1  /* At least 1 byte for the opcode. */
 #define ATT_OP_CMD_MASK			0x40
@@ -468,6 +469,9 @@ static bool can_write_data(struct io *io, void *user_data)
 
 	util_hexdump('<', op->pdu, ret, att->debug_callback, att->debug_data);
 
+	if (GATTLIB_CAPTURE_ENABLED())
+		gattlib_capture_att(att->fd, false, op->pdu, ret);
+
 	/* Based on the operation type, set either the pending request or the
 	 * pending indication. If it came from the write queue, then there is
 	 * no need to keep it around.
@@ -861,6 +865,9 @@ static bool can_read_data(struct io *io, void *user_data)
 	util_hexdump('>', att->buf, bytes_read,
 					att->debug_callback, att->debug_data);
 
+	if (GATTLIB_CAPTURE_ENABLED())
+		gattlib_capture_att(att->fd, true, att->buf, bytes_read);
+
 	if (bytes_read < ATT_MIN_PDU_LEN)
 		return true;
 
@@ -1,35 +1,150 @@
 #include "gattlib_internal.h"
 
+#include <errno.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
 #include <bluetooth/hci_lib.h>
 
-#define LE_SCAN_PASSIVE                 0x00
-#define LE_SCAN_ACTIVE                  0x01
-
 /* These LE scan and inquiry parameters were chosen according to LE General
  * Discovery Procedure specification.
  */
 #define DISCOV_LE_SCAN_WIN              0x12
 #define DISCOV_LE_SCAN_INT              0x12
 
-#define BLE_EVENT_TYPE     0x05
-#define BLE_SCAN_RESPONSE  0x04
+// Limits of the LE scan interval and window (in 0.625 ms units)
+#define LE_SCAN_INTERVAL_MIN            0x0004
+#define LE_SCAN_INTERVAL_MAX            0x4000
+
+// Maximum number of HCI events read with a single system call
+#define BLE_SCAN_EVENT_BATCH            16
+
+// LE extended scanning commands and event (Bluetooth Core 5.0)
+#define OCF_LE_SET_EXT_SCAN_PARAMETERS  0x0041
+#define OCF_LE_SET_EXT_SCAN_ENABLE      0x0042
+#define EVT_LE_EXT_ADVERTISING_REPORT   0x0D
+
+// Fixed part of a report of the LE Extended Advertising Report event
+#define LE_EXT_ADV_REPORT_HDR_SIZE      24
+#define LE_EXT_ADV_EVT_TYPE_SCAN_RSP    (1 << 3)
+#define LE_EXT_ADV_DATA_STATUS(evt_type)  (((evt_type) >> 5) & 0x3)
+#define LE_EXT_ADV_DATA_COMPLETE        0x0
+#define LE_EXT_ADV_DATA_INCOMPLETE      0x1
+#define LE_EXT_ADV_ANONYMOUS_ADDR_TYPE  0xFF
+
+// Maximum length of the extended advertising data
+#define BLE_EXT_ADV_DATA_MAX_LEN        1650
+// Number of fragmented advertisements reassembled in parallel
+#define BLE_EXT_ADV_REASSEMBLY_SLOTS    8
+
+static int ble_read_le_features(int device_desc, uint8_t features[8]) {
+	le_read_local_supported_features_rp rp;
+	struct hci_request rq;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf = OGF_LE_CTL;
+	rq.ocf = OCF_LE_READ_LOCAL_SUPPORTED_FEATURES;
+	rq.rparam = &rp;
+	rq.rlen = LE_READ_LOCAL_SUPPORTED_FEATURES_RP_SIZE;
+
+	if ((hci_send_req(device_desc, &rq, 1000) < 0) || (rp.status != 0)) {
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	memcpy(features, rp.features, 8);
+	return GATTLIB_SUCCESS;
+}
+
+bool gattlib_adapter_has_le_feature(const struct gattlib_adapter *gattlib_adapter, unsigned int feature) {
+	return (gattlib_adapter->le_features[feature / 8] & (1 << (feature % 8))) != 0;
+}
+
+#if BLUEZ_VERSION_MAJOR == 5
+// Protect the auto-connect lists against the connection events of the gattlib thread
+static GMutex g_auto_connect_mutex;
 
-#define EIR_NAME_SHORT     0x08  /* shortened local name */
-#define EIR_NAME_COMPLETE  0x09  /* complete local name */
+/*
+ * Device connected by the kernel as soon as it advertises
+ */
+struct gattlib_auto_connect_device {
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	unsigned long options;
+	gatt_connect_cb_t connect_cb;
+	void *user_data;
+	// Set once the link has been established for the first time
+	bool connected;
+};
+
+static struct gattlib_auto_connect_device *auto_connect_find_locked(struct gattlib_adapter *gattlib_adapter,
+		const bdaddr_t *bdaddr, uint8_t bdaddr_type)
+{
+	for (GSList *l = gattlib_adapter->auto_connect_devices; l != NULL; l = l->next) {
+		struct gattlib_auto_connect_device *device = l->data;
+
+		if ((bacmp(&device->bdaddr, bdaddr) == 0) && (device->bdaddr_type == bdaddr_type)) {
+			return device;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Link established by the kernel (called from the gattlib thread)
+ */
+static void auto_connect_on_device_connected(const bdaddr_t *bdaddr, uint8_t bdaddr_type, void *user_data) {
+	struct gattlib_adapter *gattlib_adapter = user_data;
+	struct gattlib_auto_connect_device *device;
+	struct gattlib_auto_connect_device device_copy;
+
+	g_mutex_lock(&g_auto_connect_mutex);
+	device = auto_connect_find_locked(gattlib_adapter, bdaddr, bdaddr_type);
+	if (device != NULL) {
+		if (device->connected) {
+			GATTLIB_STATS_INC(gattlib_adapter->stats.reconnects);
+		}
+		device->connected = true;
+		device_copy = *device;
+	}
+	g_mutex_unlock(&g_auto_connect_mutex);
+
+	if (device == NULL) {
+		return;
+	}
+
+	// The ATT channel is opened on the link established by the controller
+	if (gattlib_connect_le_async(gattlib_adapter->dev_id, &device_copy.bdaddr, device_copy.bdaddr_type,
+			device_copy.options, device_copy.connect_cb, device_copy.user_data) == NULL) {
+		device_copy.connect_cb(NULL, device_copy.user_data);
+	}
+}
+#endif
+
+static int ble_scan_scheduler_set_scan_enable(void *adapter, bool enable);
 
 int gattlib_adapter_open(const char* adapter_name, void** adapter) {
+	return gattlib_adapter_open_with_options(adapter_name, GATTLIB_ADAPTER_OPTIONS_DEFAULT, adapter);
+}
+
+int gattlib_adapter_open_with_options(const char* adapter_name, uint32_t options, void** adapter) {
 	int dev_id;
 
 	if (adapter == NULL) {
 		return GATTLIB_INVALID_PARAMETER;
 	}
 
+#if BLUEZ_VERSION_MAJOR == 4
+	// The kernel management interface is not available with Bluez 4
+	if (options & GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+#endif
+
 	if (adapter_name) {
 		dev_id = hci_devid(adapter_name);
 	} else {
@@ -41,66 +156,462 @@ int gattlib_adapter_open(const char* adapter_name, void** adapter) {
 		return GATTLIB_NOT_FOUND;
 	}
 
-	int* device_desc = malloc(sizeof(int));
-	if (device_desc == NULL) {
+	struct gattlib_adapter* gattlib_adapter = calloc(1, sizeof(struct gattlib_adapter));
+	if (gattlib_adapter == NULL) {
 		return GATTLIB_OUT_OF_MEMORY;
-	} else {
-		*adapter = device_desc;
 	}
 
-	*device_desc = hci_open_dev(dev_id);
-	if (device_desc < 0) {
+	gattlib_adapter->dev_id = dev_id;
+	gattlib_adapter->device_desc = hci_open_dev(dev_id);
+	if (gattlib_adapter->device_desc < 0) {
 		fprintf(stderr, "ERROR: Could not open device.\n");
+		free(gattlib_adapter);
 		return GATTLIB_DEVICE_ERROR;
 	}
 
+#if BLUEZ_VERSION_MAJOR == 5
+	if (options & GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT) {
+		gattlib_adapter->mgmt = gattlib_mgmt_open(dev_id);
+		if (gattlib_adapter->mgmt == NULL) {
+			hci_close_dev(gattlib_adapter->device_desc);
+			free(gattlib_adapter);
+			return GATTLIB_DEVICE_ERROR;
+		}
+
+		gattlib_mgmt_set_device_connected_cb(gattlib_adapter->mgmt, auto_connect_on_device_connected, gattlib_adapter);
+	}
+#endif
+
+	// Extended scanning is used when the controller supports it
+	if (ble_read_le_features(gattlib_adapter->device_desc, gattlib_adapter->le_features) != GATTLIB_SUCCESS) {
+		memset(gattlib_adapter->le_features, 0, sizeof(gattlib_adapter->le_features));
+	}
+
+	gattlib_adapter->scan_parameters.scan_type = GATTLIB_SCAN_TYPE_ACTIVE;
+	gattlib_adapter->scan_parameters.scan_phys = GATTLIB_SCAN_PHY_1M;
+	gattlib_adapter->scan_parameters.interval = DISCOV_LE_SCAN_INT;
+	gattlib_adapter->scan_parameters.window = DISCOV_LE_SCAN_WIN;
+	gattlib_adapter->scan_parameters.own_address_type = 0x00;
+	gattlib_adapter->scan_parameters.filter_policy = 0x00;
+
+	gattlib_adapter->scan_scheduler = gattlib_scan_scheduler_new(gattlib_adapter, ble_scan_scheduler_set_scan_enable);
+	if (gattlib_adapter->scan_scheduler == NULL) {
+#if BLUEZ_VERSION_MAJOR == 5
+		gattlib_mgmt_close(gattlib_adapter->mgmt);
+#endif
+		hci_close_dev(gattlib_adapter->device_desc);
+		free(gattlib_adapter);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	*adapter = gattlib_adapter;
 	return GATTLIB_SUCCESS;
 }
 
-static char* parse_name(uint8_t* data, size_t size) {
-	size_t offset = 0;
+/*
+ * Parameters of an on-going scan
+ */
+struct ble_scan_arg {
+	gattlib_discovered_device_t callback;
+	void *user_data;
+	uint32_t enabled_filters;
+	int16_t rssi_threshold;
+	struct gattlib_scan_coalescer *coalescer;
+	// Set when the devices are delivered in batches
+	struct gattlib_scan_batch *batch;
+	// Set when the controller reports extended advertisements
+	struct ble_ext_adv_reassembly *reassembly;
+};
 
-	while (offset < size) {
-		uint8_t field_len = data[0];
-		size_t name_len;
+/*
+ * Extended advertising data received in several fragments
+ */
+struct ble_ext_adv_fragment {
+	bool     in_use;
+	bdaddr_t bdaddr;
+	uint8_t  bdaddr_type;
+	uint8_t  sid;
+	bool     scan_response;
+	// Sequence number of the last fragment to evict the oldest slot
+	uint32_t last_update;
+	size_t   length;
+	uint8_t  data[BLE_EXT_ADV_DATA_MAX_LEN];
+};
 
-		if (field_len == 0 || offset + field_len > size)
-			return NULL;
+struct ble_ext_adv_reassembly {
+	uint32_t sequence;
+	struct ble_ext_adv_fragment slots[BLE_EXT_ADV_REASSEMBLY_SLOTS];
+};
 
-		switch (data[1]) {
-		case EIR_NAME_SHORT:
-		case EIR_NAME_COMPLETE:
-			name_len = field_len - 1;
-			if (name_len > size)
-				return NULL;
+static int ble_scan_arg_init(struct ble_scan_arg *arg, struct gattlib_adapter *gattlib_adapter, bool notify_change) {
+	arg->coalescer = gattlib_scan_coalescer_new(&gattlib_adapter->scan_coalescing, notify_change);
+	if (arg->coalescer == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
 
-			return strndup((const char*)(data + 2), name_len);
+	if (gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_EXTENDED_ADV)) {
+		arg->reassembly = calloc(1, sizeof(struct ble_ext_adv_reassembly));
+		if (arg->reassembly == NULL) {
+			gattlib_scan_coalescer_free(arg->coalescer);
+			arg->coalescer = NULL;
+			return GATTLIB_OUT_OF_MEMORY;
 		}
-
-		offset += field_len + 1;
-		data += field_len + 1;
 	}
 
-	return NULL;
+	return GATTLIB_SUCCESS;
+}
+
+static void ble_scan_arg_release(struct ble_scan_arg *arg) {
+	gattlib_scan_coalescer_free(arg->coalescer);
+	free(arg->reassembly);
 }
 
-static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t discovered_device_cb, int timeout, void *user_data) {
+// Serialize the background scan watch callbacks with 'gattlib_adapter_scan_stop()'
+static GRecMutex g_background_scan_mutex;
+
+/*
+ * State of the scan started by 'gattlib_adapter_scan_start()'
+ */
+struct gattlib_background_scan {
+	struct gattlib_adapter *adapter;
+	struct ble_scan_arg arg;
+
 	struct hci_filter old_options;
-	socklen_t slen = sizeof(old_options);
-	struct hci_filter new_options;
-	unsigned char buffer[HCI_MAX_EVENT_SIZE];
-	evt_le_meta_event* meta = (evt_le_meta_event*)(buffer + HCI_EVENT_HDR_SIZE + 1);
-	le_advertising_info* info;
+	GIOChannel *io;
+	GSource *source;
+};
+
+static void ble_scan_on_advertisement(struct gattlib_adapter *gattlib_adapter, const bdaddr_t *bdaddr,
+		const uint8_t *data, size_t data_length, int8_t rssi, const struct ble_scan_arg *arg)
+{
 	char addr[18];
-	int len;
-#if BLUEZ_VERSION_MAJOR == 4
-	struct timeval wait;
-	fd_set read_set;
+	bool report = (arg->callback != NULL) || (arg->batch != NULL);
+	struct gattlib_scan_table *scan_table;
+
+	GATTLIB_STATS_INC(gattlib_adapter->stats.scan_events_received);
+
+	// Evaluate the filters first to avoid any processing of the filtered out advertisements
+	if ((arg->enabled_filters & GATTLIB_DISCOVER_FILTER_USE_RSSI) && (rssi < arg->rssi_threshold)) {
+		report = false;
+	} else if (report && !gattlib_ad_filters_match_raw(&gattlib_adapter->scan_ad_filters, data, data_length)) {
+		report = false;
+	}
+
+	scan_table = gattlib_scan_table_get(&gattlib_adapter->scan_table);
+	if (!report && (scan_table == NULL)) {
+		return;
+	}
+
+	ba2str(bdaddr, addr);
+
+	char* name = gattlib_eir_parse_name(data, data_length);
+
+	if (scan_table != NULL) {
+		gattlib_scan_table_update(scan_table, addr, name, rssi, data, data_length);
+		gattlib_scan_table_unref(scan_table);
+	}
+
+	if (report) {
+		uint32_t payload_hash = 0;
+
+		if (gattlib_scan_coalescer_needs_payload(arg->coalescer)) {
+			payload_hash = gattlib_scan_payload_hash(0, data, data_length);
+		}
+
+		if (gattlib_scan_coalescer_should_notify(arg->coalescer, addr, rssi, payload_hash)) {
+			GATTLIB_STATS_INC(gattlib_adapter->stats.scan_events_delivered);
+
+			if (arg->batch != NULL) {
+				gattlib_scan_batch_add(arg->batch, addr, name, rssi);
+			} else {
+				arg->callback(gattlib_adapter, addr, name, arg->user_data);
+			}
+		}
+	}
+
+	if (name) {
+		free(name);
+	}
+}
+
+/*
+ * Return true if the background scan has been stopped by a user callback.
+ * 'source' is NULL for the blocking scan.
+ */
+static bool ble_scan_is_stopped(GSource *source) {
+	return (source != NULL) && g_source_is_destroyed(source);
+}
+
+#if BLUEZ_VERSION_MAJOR == 5
+// Wake up the blocking scans on 'gattlib_adapter_scan_disable()'
+static GMutex g_blocking_scan_mutex;
+static GCond g_blocking_scan_cond;
+
+/*
+ * Device reported by the kernel discovery (called from the gattlib thread)
+ */
+static void ble_scan_on_mgmt_device_found(const bdaddr_t *bdaddr, uint8_t bdaddr_type, int8_t rssi,
+		const uint8_t *eir, size_t eir_length, void *user_data)
+{
+	struct gattlib_background_scan *background_scan = user_data;
+
+	// Note: 'background_scan' must not be accessed after this call as the callback might stop the scan
+	ble_scan_on_advertisement(background_scan->adapter, bdaddr, eir, eir_length, rssi, &background_scan->arg);
+}
+
+/*
+ * Blocking scan through the kernel management interface
+ */
+static int ble_mgmt_scan(struct gattlib_adapter *gattlib_adapter, gattlib_discovered_device_t discovered_device_cb, int timeout, void *user_data) {
+	struct gattlib_background_scan scan = {
+		.adapter = gattlib_adapter,
+		.arg = {
+			.callback = discovered_device_cb,
+			.user_data = user_data,
+			.enabled_filters = GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE,
+		},
+	};
+	int ret;
+
+	ret = ble_scan_arg_init(&scan.arg, gattlib_adapter, true);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	g_mutex_lock(&g_blocking_scan_mutex);
+	gattlib_adapter->blocking_scan_stop = false;
+	g_mutex_unlock(&g_blocking_scan_mutex);
+
+	ret = gattlib_mgmt_start_discovery(gattlib_adapter->mgmt, ble_scan_on_mgmt_device_found, &scan);
+	if (ret == GATTLIB_SUCCESS) {
+		gint64 end_time = g_get_monotonic_time() + (gint64)timeout * G_USEC_PER_SEC;
+
+		// Scan until the timeout or until 'gattlib_adapter_scan_disable()' is called (eg: from the callback)
+		g_mutex_lock(&g_blocking_scan_mutex);
+		while (!gattlib_adapter->blocking_scan_stop) {
+			if (!g_cond_wait_until(&g_blocking_scan_cond, &g_blocking_scan_mutex, end_time)) {
+				break;
+			}
+		}
+		g_mutex_unlock(&g_blocking_scan_mutex);
+
+		ret = gattlib_mgmt_stop_discovery(gattlib_adapter->mgmt);
+	}
+
+	ble_scan_arg_release(&scan.arg);
+	return ret;
+}
+#endif
+
+static struct ble_ext_adv_fragment *ble_ext_adv_get_fragment(struct ble_ext_adv_reassembly *reassembly,
+		const bdaddr_t *bdaddr, uint8_t bdaddr_type, uint8_t sid, bool scan_response, bool create)
+{
+	struct ble_ext_adv_fragment *free_slot = NULL;
+	struct ble_ext_adv_fragment *oldest = NULL;
+
+	for (int i = 0; i < BLE_EXT_ADV_REASSEMBLY_SLOTS; i++) {
+		struct ble_ext_adv_fragment *fragment = &reassembly->slots[i];
+
+		if (!fragment->in_use) {
+			if (free_slot == NULL) {
+				free_slot = fragment;
+			}
+			continue;
+		}
+
+		if ((bacmp(&fragment->bdaddr, bdaddr) == 0) && (fragment->bdaddr_type == bdaddr_type) &&
+		    (fragment->sid == sid) && (fragment->scan_response == scan_response)) {
+			return fragment;
+		}
+
+		if ((oldest == NULL) || (reassembly->sequence - fragment->last_update > reassembly->sequence - oldest->last_update)) {
+			oldest = fragment;
+		}
+	}
+
+	if (!create) {
+		return NULL;
+	}
+
+	// Use a free slot or drop the advertisement whose last fragment is the oldest
+	if (free_slot == NULL) {
+		free_slot = oldest;
+	}
+
+	bacpy(&free_slot->bdaddr, bdaddr);
+	free_slot->bdaddr_type = bdaddr_type;
+	free_slot->sid = sid;
+	free_slot->scan_response = scan_response;
+	free_slot->length = 0;
+	free_slot->in_use = true;
+	return free_slot;
+}
+
+/*
+ * Parse the reports of a LE Extended Advertising Report event. The advertising data might be split in several
+ * reports (of the same or of the following events) that are reassembled before calling the user.
+ */
+static void ble_scan_on_ext_advertising_report(struct gattlib_adapter *gattlib_adapter, const unsigned char *data,
+		const unsigned char *end, const struct ble_scan_arg *arg, GSource *source)
+{
+	struct ble_ext_adv_reassembly *reassembly = arg->reassembly;
+	uint8_t report_count = data[0];
+	const unsigned char *report = data + 1;
+
+	for (uint8_t i = 0; i < report_count; i++) {
+		// | event type (2) | address type | address (6) | primary PHY | secondary PHY | SID | TX power | RSSI |
+		// | periodic advertising interval (2) | direct address type | direct address (6) | data length | data |
+		if (report + LE_EXT_ADV_REPORT_HDR_SIZE > end) {
+			break;
+		}
+
+		uint16_t event_type = report[0] | (report[1] << 8);
+		uint8_t bdaddr_type = report[2];
+		const bdaddr_t *bdaddr = (const bdaddr_t*)&report[3];
+		uint8_t sid = report[11];
+		int8_t rssi = (int8_t)report[13];
+		uint8_t data_length = report[23];
+		const uint8_t *adv_data = report + LE_EXT_ADV_REPORT_HDR_SIZE;
+		bool scan_response = (event_type & LE_EXT_ADV_EVT_TYPE_SCAN_RSP) != 0;
+		uint8_t status = LE_EXT_ADV_DATA_STATUS(event_type);
+
+		if (adv_data + data_length > end) {
+			break;
+		}
+		report = adv_data + data_length;
+
+		// Anonymous advertisements cannot be reported without address
+		if (bdaddr_type == LE_EXT_ADV_ANONYMOUS_ADDR_TYPE) {
+			continue;
+		}
+
+		struct ble_ext_adv_fragment *fragment = ble_ext_adv_get_fragment(reassembly, bdaddr, bdaddr_type, sid,
+				scan_response, status == LE_EXT_ADV_DATA_INCOMPLETE);
+
+		if (fragment == NULL) {
+			// Complete (or truncated) advertisement received in a single report
+			ble_scan_on_advertisement(gattlib_adapter, bdaddr, adv_data, data_length, rssi, arg);
+		} else {
+			size_t copy_length = MIN(data_length, sizeof(fragment->data) - fragment->length);
+
+			memcpy(fragment->data + fragment->length, adv_data, copy_length);
+			fragment->length += copy_length;
+			fragment->last_update = ++reassembly->sequence;
+
+			if (status == LE_EXT_ADV_DATA_INCOMPLETE) {
+				continue;
+			}
+
+			// Last fragment. Truncated data are reported as received.
+			fragment->in_use = false;
+			ble_scan_on_advertisement(gattlib_adapter, bdaddr, fragment->data, fragment->length, rssi, arg);
+		}
+
+		if (ble_scan_is_stopped(source)) {
+			return;
+		}
+	}
+}
+
+static void ble_scan_on_event(struct gattlib_adapter *gattlib_adapter, unsigned char *buffer, size_t len,
+		const struct ble_scan_arg *arg, GSource *source)
+{
+	// | HCI packet type | HCI event header | LE subevent | number of reports | reports... |
+	hci_event_hdr* hdr = (hci_event_hdr*)(buffer + 1);
+	evt_le_meta_event* meta = (evt_le_meta_event*)(buffer + HCI_EVENT_HDR_SIZE + 1);
+	const unsigned char *end = buffer + len;
+	unsigned char *report;
+	uint8_t report_count;
+
+	if ((len < 1 + HCI_EVENT_HDR_SIZE + 2) || (hdr->evt != EVT_LE_META_EVENT)) {
+		return;
+	}
+
+	if ((meta->subevent == EVT_LE_EXT_ADVERTISING_REPORT) && (arg->reassembly != NULL)) {
+		ble_scan_on_ext_advertising_report(gattlib_adapter, meta->data, end, arg, source);
+		return;
+	} else if (meta->subevent != EVT_LE_ADVERTISING_REPORT) {
+		return;
+	}
+
+	// All the report types (connectable, scannable, non-connectable advertisements and scan responses) are handled
+	report_count = meta->data[0];
+	report = meta->data + 1;
+
+	for (uint8_t i = 0; i < report_count; i++) {
+		le_advertising_info* info = (le_advertising_info*)report;
+
+		// Each report is followed by its RSSI
+		if ((report + LE_ADVERTISING_INFO_SIZE > end) || (info->data + info->length + 1 > end)) {
+			break;
+		}
+
+		// The RSSI follows the advertising data in the report
+		ble_scan_on_advertisement(gattlib_adapter, &info->bdaddr, info->data, info->length,
+				(int8_t)info->data[info->length], arg);
+		if (ble_scan_is_stopped(source)) {
+			return;
+		}
+
+		report = info->data + info->length + 1;
+	}
+}
+
+/*
+ * Read and process the HCI events queued on the socket in batches of BLE_SCAN_EVENT_BATCH events.
+ * Return the number of events processed or -1 on error.
+ */
+static int ble_scan_read_events(struct gattlib_adapter *gattlib_adapter, const struct ble_scan_arg *arg, GSource *source) {
+	unsigned char buffers[BLE_SCAN_EVENT_BATCH][HCI_MAX_EVENT_SIZE];
+	struct iovec iovecs[BLE_SCAN_EVENT_BATCH];
+	struct mmsghdr msgs[BLE_SCAN_EVENT_BATCH];
+	int total = 0;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (int i = 0; i < BLE_SCAN_EVENT_BATCH; i++) {
+		iovecs[i].iov_base = buffers[i];
+		iovecs[i].iov_len = HCI_MAX_EVENT_SIZE;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	while (1) {
+		int count = recvmmsg(gattlib_adapter->device_desc, msgs, BLE_SCAN_EVENT_BATCH, MSG_DONTWAIT, NULL);
+		if (count < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+				return total;
+			}
+			fprintf(stderr, "Read error\n");
+			return -1;
+		}
+
+		for (int i = 0; i < count; i++) {
+#if BLUEZ_VERSION_MAJOR == 5
+			if (GATTLIB_CAPTURE_ENABLED() && (msgs[i].msg_len > 1) && (buffers[i][0] == HCI_EVENT_PKT)) {
+				gattlib_capture_hci_event(gattlib_adapter->dev_id, buffers[i] + 1, msgs[i].msg_len - 1);
+			}
 #endif
+			ble_scan_on_event(gattlib_adapter, buffers[i], msgs[i].msg_len, arg, source);
+			if (ble_scan_is_stopped(source)) {
+				return total + i + 1;
+			}
+		}
+		total += count;
 
-	if (getsockopt(device_desc, SOL_HCI, HCI_FILTER, &old_options, &slen) < 0) {
+		// The socket has been drained
+		if (count < BLE_SCAN_EVENT_BATCH) {
+			return total;
+		}
+	}
+}
+
+static int ble_scan_set_socket_filter(int device_desc, struct hci_filter *old_options) {
+	socklen_t slen = sizeof(*old_options);
+	struct hci_filter new_options;
+
+	if (getsockopt(device_desc, SOL_HCI, HCI_FILTER, old_options, &slen) < 0) {
 		fprintf(stderr, "ERROR: Could not get socket options.\n");
-		return 1;
+		return GATTLIB_DEVICE_ERROR;
 	}
 
 	hci_filter_clear(&new_options);
@@ -110,6 +621,132 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 	if (setsockopt(device_desc, SOL_HCI, HCI_FILTER,
 				   &new_options, sizeof(new_options)) < 0) {
 		fprintf(stderr, "ERROR: Could not set socket options.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static int ble_send_le_command(int device_desc, uint16_t ocf, void *cparam, int clen) {
+	struct hci_request rq;
+	uint8_t status;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf = OGF_LE_CTL;
+	rq.ocf = ocf;
+	rq.cparam = cparam;
+	rq.clen = clen;
+	rq.rparam = &status;
+	rq.rlen = 1;
+
+	if (hci_send_req(device_desc, &rq, 10000) < 0) {
+		return -1;
+	}
+
+	if (status) {
+		errno = EIO;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int ble_ext_scan_enable_controller(struct gattlib_adapter *gattlib_adapter, uint8_t filter_dup) {
+	const gattlib_scan_parameters_t *params = &gattlib_adapter->scan_parameters;
+	// | own address type | filter policy | scanning PHYs | (scan type | interval (2) | window (2)) per PHY |
+	uint8_t cparam[3 + 2 * 5];
+	// | enable | filter duplicates | duration (2) | period (2) |
+	uint8_t enable_cparam[6] = { 0x01, filter_dup, 0x00, 0x00, 0x00, 0x00 };
+	int clen = 3;
+
+	cparam[0] = params->own_address_type;
+	cparam[1] = params->filter_policy;
+	cparam[2] = 0;
+
+	for (unsigned int phy = 0; phy <= 2; phy++) {
+		// Only the LE 1M (bit 0) and LE Coded (bit 2) PHYs can be scanned
+		if ((phy == 1) || !(params->scan_phys & (1 << phy))) {
+			continue;
+		}
+
+		cparam[2] |= (1 << phy);
+		cparam[clen++] = params->scan_type;
+		cparam[clen++] = params->interval & 0xFF;
+		cparam[clen++] = params->interval >> 8;
+		cparam[clen++] = params->window & 0xFF;
+		cparam[clen++] = params->window >> 8;
+	}
+
+	if (ble_send_le_command(gattlib_adapter->device_desc, OCF_LE_SET_EXT_SCAN_PARAMETERS, cparam, clen) < 0) {
+		fprintf(stderr, "ERROR: Set extended scan parameters failed (are you root?).\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	// No duration nor period: the scan runs until it is disabled
+	if (ble_send_le_command(gattlib_adapter->device_desc, OCF_LE_SET_EXT_SCAN_ENABLE, enable_cparam, sizeof(enable_cparam)) < 0) {
+		fprintf(stderr, "ERROR: Enable extended scan failed.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static int ble_scan_disable_controller(struct gattlib_adapter *gattlib_adapter) {
+	if (gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_EXTENDED_ADV)) {
+		uint8_t cparam[6] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+		return ble_send_le_command(gattlib_adapter->device_desc, OCF_LE_SET_EXT_SCAN_ENABLE, cparam, sizeof(cparam));
+	} else {
+		return hci_le_set_scan_enable(gattlib_adapter->device_desc, 0x00, 1, 10000);
+	}
+}
+
+static int ble_scan_enable_controller(struct gattlib_adapter *gattlib_adapter, uint8_t filter_dup) {
+	const gattlib_scan_parameters_t *params = &gattlib_adapter->scan_parameters;
+	int device_desc = gattlib_adapter->device_desc;
+
+	// Once the extended commands are used, the controller rejects the legacy ones.
+	// Legacy advertisements are also reported by the LE Extended Advertising Report event.
+	if (gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_EXTENDED_ADV)) {
+		return ble_ext_scan_enable_controller(gattlib_adapter, filter_dup);
+	}
+
+	int ret = hci_le_set_scan_parameters(device_desc, params->scan_type, htobs(params->interval), htobs(params->window),
+			params->own_address_type, params->filter_policy, 10000);
+	if (ret < 0) {
+		fprintf(stderr, "ERROR: Set scan parameters failed (are you root?).\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	ret = hci_le_set_scan_enable(device_desc, 0x01, filter_dup, 10000);
+	if (ret < 0) {
+		fprintf(stderr, "ERROR: Enable scan failed.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static int ble_scan(struct gattlib_adapter *gattlib_adapter, gattlib_discovered_device_t discovered_device_cb, int timeout, void *user_data) {
+	int device_desc = gattlib_adapter->device_desc;
+	struct hci_filter old_options;
+	// This scanner has always reported every advertisement
+	struct ble_scan_arg arg = {
+		.callback = discovered_device_cb,
+		.user_data = user_data,
+		.enabled_filters = GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE,
+	};
+#if BLUEZ_VERSION_MAJOR == 4
+	struct timeval wait;
+	fd_set read_set;
+#endif
+
+	if (ble_scan_set_socket_filter(device_desc, &old_options) != GATTLIB_SUCCESS) {
+		return 1;
+	}
+
+	if (ble_scan_arg_init(&arg, gattlib_adapter, true) != GATTLIB_SUCCESS) {
+		setsockopt(device_desc, SOL_HCI, HCI_FILTER, &old_options, sizeof(old_options));
 		return 1;
 	}
 
@@ -126,24 +763,10 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 			break;
 		}
 
-		len = read(device_desc, buffer, sizeof(buffer));
-		if (len < 0) {
-			fprintf(stderr, "Read error\n");
+		if (ble_scan_read_events(gattlib_adapter, &arg, NULL) < 0) {
 			break;
 		}
 
-		if (meta->subevent != 0x02 || (uint8_t)buffer[BLE_EVENT_TYPE] != BLE_SCAN_RESPONSE)
-			continue;
-
-		info = (le_advertising_info*) (meta->data + 1);
-		ba2str(&info->bdaddr, addr);
-
-		char* name = parse_name(info->data, info->length);
-		discovered_device_cb(adapter, addr, name, user_data);
-		if (name) {
-			free(name);
-		}
-
 		int elapsed = time(NULL) - ts;
 		if (elapsed >= timeout) {
 			fprintf(stderr, "Timeout error\n");
@@ -165,51 +788,36 @@ static int ble_scan(void *adapter, int device_desc, gattlib_discovered_device_t
 			continue;
 		}
 
-		len = read(device_desc, buffer, sizeof(buffer));
-		if (len < 0) {
-			fprintf(stderr, "Read error\n");
+		if (ble_scan_read_events(gattlib_adapter, &arg, NULL) < 0) {
 			break;
 		}
-
-		if (meta->subevent != 0x02 || (uint8_t)buffer[BLE_EVENT_TYPE] != BLE_SCAN_RESPONSE)
-			continue;
-
-		info = (le_advertising_info*) (meta->data + 1);
-		ba2str(&info->bdaddr, addr);
-
-		char* name = parse_name(info->data, info->length);
-		discovered_device_cb(adapter, addr, name, user_data);
-		if (name) {
-			free(name);
-		}
 	}
 #endif
 
+	ble_scan_arg_release(&arg);
 	setsockopt(device_desc, SOL_HCI, HCI_FILTER, &old_options, sizeof(old_options));
 	return GATTLIB_SUCCESS;
 }
 
 int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data) {
-	int device_desc = *(int*)adapter;
+	struct gattlib_adapter *gattlib_adapter = adapter;
 
-	uint16_t interval = htobs(DISCOV_LE_SCAN_INT);
-	uint16_t window = htobs(DISCOV_LE_SCAN_WIN);
-	uint8_t own_address_type = 0x00;
-	uint8_t filter_policy = 0x00;
+	if (gattlib_adapter->background_scan != NULL) {
+		return GATTLIB_BUSY;
+	}
 
-	int ret = hci_le_set_scan_parameters(device_desc, LE_SCAN_ACTIVE, interval, window, own_address_type, filter_policy, 10000);
-	if (ret < 0) {
-		fprintf(stderr, "ERROR: Set scan parameters failed (are you root?).\n");
-		return 1;
+#if BLUEZ_VERSION_MAJOR == 5
+	if (gattlib_adapter->mgmt != NULL) {
+		return ble_mgmt_scan(gattlib_adapter, discovered_device_cb, timeout, user_data);
 	}
+#endif
 
-	ret = hci_le_set_scan_enable(device_desc, 0x01, 1, 10000);
-	if (ret < 0) {
-		fprintf(stderr, "ERROR: Enable scan failed.\n");
+	int ret = ble_scan_enable_controller(gattlib_adapter, 0x01);
+	if (ret != GATTLIB_SUCCESS) {
 		return 1;
 	}
 
-	ret = ble_scan(adapter, device_desc, discovered_device_cb, timeout, user_data);
+	ret = ble_scan(gattlib_adapter, discovered_device_cb, timeout, user_data);
 	if (ret != 0) {
 		fprintf(stderr, "ERROR: Advertisement fail.\n");
 		return 1;
@@ -218,6 +826,262 @@ int gattlib_adapter_scan_enable(void* adapter, gattlib_discovered_device_t disco
 	return GATTLIB_SUCCESS;
 }
 
+/*
+ * Pause or resume the background scan for the scan scheduler (called from the gattlib thread)
+ */
+static int ble_scan_scheduler_set_scan_enable(void *adapter, bool enable) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_background_scan *background_scan = gattlib_adapter->background_scan;
+
+	if (background_scan == NULL) {
+		return GATTLIB_SUCCESS;
+	}
+
+#if BLUEZ_VERSION_MAJOR == 5
+	if (gattlib_adapter->mgmt != NULL) {
+		if (enable) {
+			return gattlib_mgmt_start_discovery(gattlib_adapter->mgmt, ble_scan_on_mgmt_device_found, background_scan);
+		} else {
+			return gattlib_mgmt_stop_discovery(gattlib_adapter->mgmt);
+		}
+	}
+#endif
+
+	// The HCI socket is not read while this function runs in the gattlib thread
+	if (enable) {
+		return ble_scan_enable_controller(gattlib_adapter,
+				(background_scan->arg.enabled_filters & GATTLIB_DISCOVER_FILTER_NO_DUPLICATE_DATA) ? 0x01 : 0x00);
+	} else if (ble_scan_disable_controller(gattlib_adapter) < 0) {
+		return GATTLIB_DEVICE_ERROR;
+	}
+	return GATTLIB_SUCCESS;
+}
+
+static gboolean ble_scan_io_cb(GIOChannel *io, GIOCondition cond, gpointer user_data) {
+	struct gattlib_background_scan *background_scan = user_data;
+	gboolean ret = TRUE;
+
+	g_rec_mutex_lock(&g_background_scan_mutex);
+
+	// The scan might have been stopped by another thread while this callback was dispatched
+	if (g_source_is_destroyed(g_main_current_source())) {
+		ret = FALSE;
+		goto EXIT;
+	}
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		fprintf(stderr, "ERROR: Background scan stopped on HCI socket error.\n");
+		ret = FALSE;
+		goto EXIT;
+	}
+
+	// Note: 'background_scan' must not be accessed after this call as the callback might stop the scan
+	if (ble_scan_read_events(background_scan->adapter, &background_scan->arg, g_main_current_source()) < 0) {
+		ret = FALSE;
+	}
+
+EXIT:
+	g_rec_mutex_unlock(&g_background_scan_mutex);
+	return ret;
+}
+
+/*
+ * Start the background scan. When 'batch_cb' is set, the devices are delivered in batches instead of 'discovered_device_cb'.
+ */
+static int adapter_scan_start(struct gattlib_adapter *gattlib_adapter, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb,
+		gattlib_discovered_devices_batch_t batch_cb, size_t max_batch_size, uint32_t max_batch_delay_ms,
+		void *user_data)
+{
+	struct gattlib_background_scan *background_scan;
+	int ret;
+
+	// Advertised UUIDs are not parsed by the legacy scanner
+	if (enabled_filters & GATTLIB_DISCOVER_FILTER_USE_UUID) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	if (gattlib_adapter->background_scan != NULL) {
+		return GATTLIB_BUSY;
+	}
+
+	background_scan = calloc(1, sizeof(struct gattlib_background_scan));
+	if (background_scan == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	background_scan->adapter = gattlib_adapter;
+	background_scan->arg.callback = discovered_device_cb;
+	background_scan->arg.user_data = user_data;
+	background_scan->arg.enabled_filters = enabled_filters;
+	background_scan->arg.rssi_threshold = rssi_threshold;
+	ret = ble_scan_arg_init(&background_scan->arg, gattlib_adapter, enabled_filters & GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE);
+	if (ret != GATTLIB_SUCCESS) {
+		free(background_scan);
+		return ret;
+	}
+
+#if BLUEZ_VERSION_MAJOR == 5
+	// The kernel reports the devices to the gattlib thread that is kept alive by the management interface
+	if (gattlib_adapter->mgmt != NULL) {
+		if (batch_cb != NULL) {
+			background_scan->arg.batch = gattlib_scan_batch_new(gattlib_adapter, g_gattlib_thread.loop_context,
+					max_batch_size, max_batch_delay_ms, batch_cb, user_data);
+			if (background_scan->arg.batch == NULL) {
+				ble_scan_arg_release(&background_scan->arg);
+				free(background_scan);
+				return GATTLIB_OUT_OF_MEMORY;
+			}
+		}
+
+		gattlib_adapter->background_scan = background_scan;
+		ret = gattlib_mgmt_start_discovery(gattlib_adapter->mgmt, ble_scan_on_mgmt_device_found, background_scan);
+		if (ret != GATTLIB_SUCCESS) {
+			gattlib_adapter->background_scan = NULL;
+			gattlib_scan_batch_free(background_scan->arg.batch);
+			ble_scan_arg_release(&background_scan->arg);
+			free(background_scan);
+			return ret;
+		}
+
+		gattlib_scan_scheduler_scan_started(gattlib_adapter->scan_scheduler, g_gattlib_thread.loop_context);
+		return GATTLIB_SUCCESS;
+	}
+#endif
+
+	// The HCI commands must be sent before the socket is watched as their replies are read from the same socket
+	ret = ble_scan_enable_controller(gattlib_adapter,
+			(enabled_filters & GATTLIB_DISCOVER_FILTER_NO_DUPLICATE_DATA) ? 0x01 : 0x00);
+	if (ret != GATTLIB_SUCCESS) {
+		ble_scan_arg_release(&background_scan->arg);
+		free(background_scan);
+		return ret;
+	}
+
+	ret = ble_scan_set_socket_filter(gattlib_adapter->device_desc, &background_scan->old_options);
+	if (ret != GATTLIB_SUCCESS) {
+		ble_scan_disable_controller(gattlib_adapter);
+		ble_scan_arg_release(&background_scan->arg);
+		free(background_scan);
+		return ret;
+	}
+
+	ret = gattlib_thread_ref();
+	if (ret != GATTLIB_SUCCESS) {
+		setsockopt(gattlib_adapter->device_desc, SOL_HCI, HCI_FILTER,
+				&background_scan->old_options, sizeof(background_scan->old_options));
+		ble_scan_disable_controller(gattlib_adapter);
+		ble_scan_arg_release(&background_scan->arg);
+		free(background_scan);
+		return ret;
+	}
+
+	// The batch timer must run in the gattlib thread that reads the advertising reports
+	if (batch_cb != NULL) {
+		background_scan->arg.batch = gattlib_scan_batch_new(gattlib_adapter, g_gattlib_thread.loop_context,
+				max_batch_size, max_batch_delay_ms, batch_cb, user_data);
+		if (background_scan->arg.batch == NULL) {
+			gattlib_thread_unref();
+			setsockopt(gattlib_adapter->device_desc, SOL_HCI, HCI_FILTER,
+					&background_scan->old_options, sizeof(background_scan->old_options));
+			ble_scan_disable_controller(gattlib_adapter);
+			ble_scan_arg_release(&background_scan->arg);
+			free(background_scan);
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+	}
+
+	// Advertising reports are read by the gattlib thread
+	background_scan->io = g_io_channel_unix_new(gattlib_adapter->device_desc);
+	gattlib_adapter->background_scan = background_scan;
+	background_scan->source = gattlib_watch_connection_full(background_scan->io,
+			G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			ble_scan_io_cb, background_scan, NULL);
+	// Keep the source alive until the scan is stopped, even if the watch is removed on error
+	g_source_ref(background_scan->source);
+
+	// The scan is paused and resumed from the gattlib thread
+	gattlib_scan_scheduler_scan_started(gattlib_adapter->scan_scheduler, g_gattlib_thread.loop_context);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_scan_start(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb, void *user_data)
+{
+	if (adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return adapter_scan_start(adapter, rssi_threshold, enabled_filters, discovered_device_cb, NULL, 0, 0, user_data);
+}
+
+int gattlib_adapter_scan_start_batched(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_devices_batch_t discovered_devices_cb, size_t max_batch_size, uint32_t max_batch_delay_ms,
+		void *user_data)
+{
+	if ((adapter == NULL) || (discovered_devices_cb == NULL) || (max_batch_size == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return adapter_scan_start(adapter, rssi_threshold, enabled_filters, NULL,
+			discovered_devices_cb, max_batch_size, max_batch_delay_ms, user_data);
+}
+
+int gattlib_adapter_scan_stop(void *adapter) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_background_scan *background_scan;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	background_scan = gattlib_adapter->background_scan;
+	if (background_scan == NULL) {
+		return GATTLIB_SUCCESS;
+	}
+
+	// The scheduler must not pause or resume the scan anymore
+	gattlib_scan_scheduler_scan_stopped(gattlib_adapter->scan_scheduler);
+	gattlib_adapter->background_scan = NULL;
+
+#if BLUEZ_VERSION_MAJOR == 5
+	if (gattlib_adapter->mgmt != NULL) {
+		// No device is reported once the discovery is stopped
+		int ret = gattlib_mgmt_stop_discovery(gattlib_adapter->mgmt);
+
+		gattlib_scan_batch_free(background_scan->arg.batch);
+		ble_scan_arg_release(&background_scan->arg);
+		free(background_scan);
+		return ret;
+	}
+#endif
+
+	// Stop watching the socket before sending the HCI commands.
+	// The lock ensures the watch callback is not running in the gattlib thread while the scan is freed.
+	g_rec_mutex_lock(&g_background_scan_mutex);
+	g_source_destroy(background_scan->source);
+	g_rec_mutex_unlock(&g_background_scan_mutex);
+
+	g_source_unref(background_scan->source);
+	g_io_channel_unref(background_scan->io);
+	// Deliver the pending devices before releasing the gattlib thread
+	gattlib_scan_batch_free(background_scan->arg.batch);
+	gattlib_thread_unref();
+
+	setsockopt(gattlib_adapter->device_desc, SOL_HCI, HCI_FILTER,
+			&background_scan->old_options, sizeof(background_scan->old_options));
+	ble_scan_arg_release(&background_scan->arg);
+	free(background_scan);
+
+	if (ble_scan_disable_controller(gattlib_adapter) < 0) {
+		fprintf(stderr, "ERROR: Disable scan failed.\n");
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
 		gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data)
 {
@@ -225,22 +1089,292 @@ int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, i
 }
 
 int gattlib_adapter_scan_disable(void* adapter) {
-	int device_desc = *(int*)adapter;
+	struct gattlib_adapter *gattlib_adapter = adapter;
 
-	if (device_desc == -1) {
+	if (gattlib_adapter->device_desc == -1) {
 		fprintf(stderr, "ERROR: Could not disable scan, not enabled yet.\n");
 		return 1;
 	}
 
-	int result = hci_le_set_scan_enable(device_desc, 0x00, 1, 10000);
+#if BLUEZ_VERSION_MAJOR == 5
+	if (gattlib_adapter->mgmt != NULL) {
+		g_mutex_lock(&g_blocking_scan_mutex);
+		gattlib_adapter->blocking_scan_stop = true;
+		g_cond_broadcast(&g_blocking_scan_cond);
+		g_mutex_unlock(&g_blocking_scan_mutex);
+
+		return gattlib_mgmt_stop_discovery(gattlib_adapter->mgmt);
+	}
+#endif
+
+	int result = ble_scan_disable_controller(gattlib_adapter);
 	if (result < 0) {
 		fprintf(stderr, "ERROR: Disable scan failed.\n");
 	}
 	return result;
 }
 
+int gattlib_adapter_set_scan_parameters(void *adapter, const gattlib_scan_parameters_t *parameters) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if ((gattlib_adapter == NULL) || (parameters == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (((parameters->scan_type != GATTLIB_SCAN_TYPE_PASSIVE) && (parameters->scan_type != GATTLIB_SCAN_TYPE_ACTIVE)) ||
+	    (parameters->interval < LE_SCAN_INTERVAL_MIN) || (parameters->interval > LE_SCAN_INTERVAL_MAX) ||
+	    (parameters->window < LE_SCAN_INTERVAL_MIN) || (parameters->window > parameters->interval) ||
+	    (parameters->scan_phys & ~(GATTLIB_SCAN_PHY_1M | GATTLIB_SCAN_PHY_CODED))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The PHYs can only be selected with the extended scan commands
+	if ((parameters->scan_phys & GATTLIB_SCAN_PHY_CODED) &&
+	    (!gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_EXTENDED_ADV) || !gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_CODED_PHY))) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+#if BLUEZ_VERSION_MAJOR == 5
+	// The kernel discovery is always an active scan on the PHYs selected by the kernel
+	if (gattlib_adapter->mgmt != NULL) {
+		if ((parameters->scan_type != GATTLIB_SCAN_TYPE_ACTIVE) || (parameters->scan_phys & GATTLIB_SCAN_PHY_CODED)) {
+			return GATTLIB_NOT_SUPPORTED;
+		}
+
+		int ret = gattlib_mgmt_set_scan_params(gattlib_adapter->mgmt, parameters->interval, parameters->window);
+		if (ret != GATTLIB_SUCCESS) {
+			return ret;
+		}
+	}
+#endif
+
+	gattlib_adapter->scan_parameters = *parameters;
+	if (gattlib_adapter->scan_parameters.scan_phys == 0) {
+		gattlib_adapter->scan_parameters.scan_phys = GATTLIB_SCAN_PHY_1M;
+	}
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_set_scan_coalescing(void *adapter, uint32_t min_interval_ms, uint8_t min_rssi_delta, bool notify_on_payload_change) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_adapter->scan_coalescing.min_interval_ms = min_interval_ms;
+	gattlib_adapter->scan_coalescing.min_rssi_delta = min_rssi_delta;
+	gattlib_adapter->scan_coalescing.notify_on_payload_change = notify_on_payload_change;
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_set_scan_schedule(void *adapter, const gattlib_scan_schedule_t *schedule) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return gattlib_scan_scheduler_set_schedule(gattlib_adapter->scan_scheduler, schedule);
+}
+
+int gattlib_adapter_radio_hold(void *adapter) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_scan_scheduler_hold(gattlib_adapter->scan_scheduler);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_radio_release(void *adapter) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_scan_scheduler_release(gattlib_adapter->scan_scheduler);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_get_stats(void *adapter, gattlib_adapter_stats_t *stats) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if ((gattlib_adapter == NULL) || (stats == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_stats_copy(stats, &gattlib_adapter->stats, sizeof(gattlib_adapter_stats_t));
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_set_device_pruning(void *adapter, uint32_t max_age_s) {
+	// This backend does not create Bluez device objects
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_set_scan_ad_filters(void *adapter, const gattlib_ad_filter_t *filters, size_t filter_count) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if ((gattlib_adapter == NULL) || ((filters == NULL) && (filter_count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return gattlib_ad_filters_set(&gattlib_adapter->scan_ad_filters, filters, filter_count);
+}
+
+struct gattlib_scan_table **gattlib_adapter_scan_table_ptr(void *adapter) {
+	return &((struct gattlib_adapter *)adapter)->scan_table;
+}
+
+int gattlib_adapter_advertisement_monitor_add(void *adapter, const gattlib_advertisement_monitor_t *monitor,
+		gattlib_advertisement_monitor_cb_t device_found_cb, gattlib_advertisement_monitor_cb_t device_lost_cb,
+		void *user_data, void **monitor_handle)
+{
+	// Advertisement monitors are a Bluez DBus API
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_advertisement_monitor_remove(void *adapter, void *monitor_handle)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_auto_connect_add(void *adapter, const char *dst, unsigned long options,
+		gatt_connect_cb_t connect_cb, void *user_data)
+{
+#if BLUEZ_VERSION_MAJOR == 5
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_auto_connect_device *device;
+	unsigned long address_types;
+	bdaddr_t bdaddr;
+	uint8_t bdaddr_type;
+	int ret;
+
+	if ((gattlib_adapter == NULL) || (dst == NULL) || (connect_cb == NULL) || (str2ba(dst, &bdaddr) != 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	address_types = options & (GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC | GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM);
+	if (address_types == GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC) {
+		bdaddr_type = BDADDR_LE_PUBLIC;
+	} else if (address_types == GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM) {
+		bdaddr_type = BDADDR_LE_RANDOM;
+	} else {
+		// The accept list needs the exact address type
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The accept list is managed by the kernel
+	if (gattlib_adapter->mgmt == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	g_mutex_lock(&g_auto_connect_mutex);
+	device = auto_connect_find_locked(gattlib_adapter, &bdaddr, bdaddr_type);
+	if (device != NULL) {
+		// Only update the connection options and callback of a known device
+		device->options = options;
+		device->connect_cb = connect_cb;
+		device->user_data = user_data;
+		g_mutex_unlock(&g_auto_connect_mutex);
+		return GATTLIB_SUCCESS;
+	}
+
+	device = calloc(1, sizeof(struct gattlib_auto_connect_device));
+	if (device == NULL) {
+		g_mutex_unlock(&g_auto_connect_mutex);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	bacpy(&device->bdaddr, &bdaddr);
+	device->bdaddr_type = bdaddr_type;
+	device->options = options;
+	device->connect_cb = connect_cb;
+	device->user_data = user_data;
+
+	// The device is listed before the kernel might report its connection
+	gattlib_adapter->auto_connect_devices = g_slist_append(gattlib_adapter->auto_connect_devices, device);
+	g_mutex_unlock(&g_auto_connect_mutex);
+
+	ret = gattlib_mgmt_add_device(gattlib_adapter->mgmt, &bdaddr, bdaddr_type, MGMT_ADD_DEVICE_AUTO_CONNECT);
+	if (ret != GATTLIB_SUCCESS) {
+		g_mutex_lock(&g_auto_connect_mutex);
+		gattlib_adapter->auto_connect_devices = g_slist_remove(gattlib_adapter->auto_connect_devices, device);
+		g_mutex_unlock(&g_auto_connect_mutex);
+		free(device);
+	}
+
+	return ret;
+#else
+	return GATTLIB_NOT_SUPPORTED;
+#endif
+}
+
+int gattlib_adapter_auto_connect_remove(void *adapter, const char *dst) {
+#if BLUEZ_VERSION_MAJOR == 5
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_auto_connect_device *device = NULL;
+	bdaddr_t bdaddr;
+	int ret;
+
+	if ((gattlib_adapter == NULL) || (dst == NULL) || (str2ba(dst, &bdaddr) != 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_mutex_lock(&g_auto_connect_mutex);
+	for (GSList *l = gattlib_adapter->auto_connect_devices; l != NULL; l = l->next) {
+		struct gattlib_auto_connect_device *entry = l->data;
+
+		if (bacmp(&entry->bdaddr, &bdaddr) == 0) {
+			device = entry;
+			gattlib_adapter->auto_connect_devices = g_slist_delete_link(gattlib_adapter->auto_connect_devices, l);
+			break;
+		}
+	}
+	g_mutex_unlock(&g_auto_connect_mutex);
+
+	if (device == NULL) {
+		return GATTLIB_NOT_FOUND;
+	}
+
+	ret = gattlib_mgmt_remove_device(gattlib_adapter->mgmt, &device->bdaddr, device->bdaddr_type);
+	free(device);
+	return ret;
+#else
+	return GATTLIB_NOT_SUPPORTED;
+#endif
+}
+
 int gattlib_adapter_close(void* adapter) {
-	hci_close_dev(*(int*)adapter);
-	free(adapter);
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	gattlib_adapter_scan_stop(adapter);
+	gattlib_periodic_sync_stop_all(gattlib_adapter);
+	gattlib_scan_scheduler_free(gattlib_adapter->scan_scheduler);
+#if BLUEZ_VERSION_MAJOR == 5
+	// Do not let the kernel connect the devices once the adapter is closed
+	g_mutex_lock(&g_auto_connect_mutex);
+	GSList *auto_connect_devices = gattlib_adapter->auto_connect_devices;
+	gattlib_adapter->auto_connect_devices = NULL;
+	g_mutex_unlock(&g_auto_connect_mutex);
+
+	for (GSList *l = auto_connect_devices; l != NULL; l = l->next) {
+		struct gattlib_auto_connect_device *device = l->data;
+
+		gattlib_mgmt_remove_device(gattlib_adapter->mgmt, &device->bdaddr, device->bdaddr_type);
+	}
+	g_slist_free_full(auto_connect_devices, free);
+
+	gattlib_mgmt_close(gattlib_adapter->mgmt);
+#endif
+	hci_close_dev(gattlib_adapter->device_desc);
+	gattlib_ad_filters_clear(&gattlib_adapter->scan_ad_filters);
+	gattlib_scan_table_disable(gattlib_adapter);
+	free(gattlib_adapter);
 	return GATTLIB_SUCCESS;
 }
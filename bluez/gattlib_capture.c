@@ -0,0 +1,444 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "gattlib_internal.h"
+
+//
+// Capture of the ATT PDUs of the connections and of the HCI events of the scanner (see 'gattlib_capture_start()').
+//
+// The packets are recorded by the threads doing the I/O into a ring of fixed-size slots without taking any lock:
+// a writer reserves its slot with an atomic increment of the head and publishes it with the slot sequence
+// (odd while written, even once complete). The ring is drained into the btsnoop file by the flush thread or
+// by 'gattlib_capture_flush()'. The packets overwritten before being flushed are reported as dropped.
+//
+
+#if BLUEZ_VERSION_MAJOR == 5
+
+#include "att.h"
+#include "hci.h"
+#include "src/shared/btsnoop.h"
+
+// Largest packet kept in full: the HCI events and the ATT PDUs of the LE connections are not truncated
+#define CAPTURE_SNAPLEN                 MAX(HCI_MAX_EVENT_SIZE, BT_ATT_MAX_LE_MTU)
+#define CAPTURE_MAX_CONNECTIONS         32
+
+
+struct capture_packet {
+	// 2*n+1 while the packet 'n' is written in the slot, 2*n+2 once it is complete
+	uint64_t sequence;
+	gint64 timestamp;
+	uint16_t index;
+	uint16_t opcode;
+	uint16_t handle;
+	uint16_t length;
+	// Length of the packet before its truncation to the slot (larger than 'length' if truncated)
+	uint32_t original_length;
+	uint8_t data[CAPTURE_SNAPLEN];
+};
+
+struct gattlib_capture {
+	struct capture_packet *packets;
+	uint64_t mask;
+	// Number of the next packet to record
+	uint64_t head;
+
+	// Protect the fields below (only used by the flushes)
+	pthread_mutex_t mutex;
+	// Number of the next packet to flush
+	uint64_t tail;
+	// Packets lost since the last packet flushed
+	uint32_t drops;
+	struct btsnoop *btsnoop;
+
+	pthread_t thread;
+	pthread_cond_t cond;
+	unsigned int flush_period_ms;
+	bool stopping;
+};
+
+int g_gattlib_capture_enabled;
+
+static struct gattlib_capture *m_capture;
+// Number of threads recording a packet (the ring is released once there are none)
+static int m_capture_writers;
+
+// Serialize the calls to 'gattlib_capture_start()' and 'gattlib_capture_stop()'
+static pthread_mutex_t m_capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ATT sockets of the connections: (fd + 1) << 32 | index << 16 | handle (0 for a free entry)
+static uint64_t m_capture_connections[CAPTURE_MAX_CONNECTIONS];
+
+static void capture_record(uint16_t index, uint16_t opcode, uint16_t handle, const void *data, size_t length) {
+	struct gattlib_capture *capture;
+	struct capture_packet *packet;
+	uint64_t n;
+
+	__atomic_add_fetch(&m_capture_writers, 1, __ATOMIC_SEQ_CST);
+
+	capture = __atomic_load_n(&m_capture, __ATOMIC_SEQ_CST);
+	if (capture == NULL) {
+		goto EXIT;
+	}
+
+	n = __atomic_fetch_add(&capture->head, 1, __ATOMIC_RELAXED);
+	packet = &capture->packets[n & capture->mask];
+
+	__atomic_store_n(&packet->sequence, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	packet->timestamp = g_get_real_time();
+	packet->index = index;
+	packet->opcode = opcode;
+	packet->handle = handle;
+	packet->length = MIN(length, CAPTURE_SNAPLEN);
+	packet->original_length = MIN(length, UINT32_MAX);
+	memcpy(packet->data, data, packet->length);
+
+	__atomic_store_n(&packet->sequence, 2 * n + 2, __ATOMIC_RELEASE);
+
+EXIT:
+	__atomic_sub_fetch(&m_capture_writers, 1, __ATOMIC_RELEASE);
+}
+
+void gattlib_capture_att(int fd, bool received, const void *pdu, size_t length) {
+	uint64_t key = (uint64_t)(fd + 1) << 32;
+
+	for (int i = 0; i < CAPTURE_MAX_CONNECTIONS; i++) {
+		uint64_t connection = __atomic_load_n(&m_capture_connections[i], __ATOMIC_RELAXED);
+
+		if ((connection & 0xFFFFFFFF00000000ULL) == key) {
+			capture_record((connection >> 16) & 0xFFFF,
+					received ? BTSNOOP_OPCODE_ACL_RX_PKT : BTSNOOP_OPCODE_ACL_TX_PKT,
+					connection & 0xFFFF, pdu, length);
+			return;
+		}
+	}
+
+	// Not a socket of a gattlib connection (eg: the socket of the loopback peer)
+}
+
+void gattlib_capture_hci_event(uint16_t index, const void *event, size_t length) {
+	capture_record(index, BTSNOOP_OPCODE_EVENT_PKT, 0, event, length);
+}
+
+static void capture_note(uint16_t index, const char *format, ...) {
+	char note[CAPTURE_SNAPLEN];
+	va_list args;
+	int length;
+
+	va_start(args, format);
+	length = vsnprintf(note, sizeof(note), format, args);
+	va_end(args);
+
+	// The note is recorded with its null terminator
+	capture_record(index, BTSNOOP_OPCODE_SYSTEM_NOTE, 0, note, MIN(length + 1, (int)sizeof(note)));
+}
+
+void gattlib_capture_add_connection(int fd, uint16_t index, uint16_t handle, const char *address) {
+	uint64_t connection = ((uint64_t)(fd + 1) << 32) | ((uint64_t)index << 16) | handle;
+
+	for (int i = 0; i < CAPTURE_MAX_CONNECTIONS; i++) {
+		uint64_t expected = 0;
+
+		if (__atomic_compare_exchange_n(&m_capture_connections[i], &expected, connection, false,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		{
+			if (GATTLIB_CAPTURE_ENABLED()) {
+				capture_note(index, "gattlib: ATT connection to %s (handle 0x%04x)",
+						(address[0] != '\0') ? address : "loopback peer", handle);
+			}
+			return;
+		}
+	}
+
+	fprintf(stderr, "Too many connections to capture their ATT PDUs.\n");
+}
+
+void gattlib_capture_remove_connection(int fd) {
+	uint64_t key = (uint64_t)(fd + 1) << 32;
+
+	for (int i = 0; i < CAPTURE_MAX_CONNECTIONS; i++) {
+		uint64_t connection = __atomic_load_n(&m_capture_connections[i], __ATOMIC_RELAXED);
+
+		if ((connection & 0xFFFFFFFF00000000ULL) == key) {
+			__atomic_store_n(&m_capture_connections[i], 0, __ATOMIC_RELAXED);
+			if (GATTLIB_CAPTURE_ENABLED()) {
+				capture_note((connection >> 16) & 0xFFFF, "gattlib: ATT disconnection (handle 0x%04lx)",
+						(unsigned long)(connection & 0xFFFF));
+			}
+			return;
+		}
+	}
+}
+
+static void capture_write_packet(struct gattlib_capture *capture, const struct capture_packet *packet) {
+	uint8_t buffer[8 + CAPTURE_SNAPLEN];
+	struct timeval tv;
+	uint16_t size;
+	int note_length;
+
+	tv.tv_sec = packet->timestamp / G_USEC_PER_SEC;
+	tv.tv_usec = packet->timestamp % G_USEC_PER_SEC;
+
+	if ((packet->opcode == BTSNOOP_OPCODE_ACL_TX_PKT) || (packet->opcode == BTSNOOP_OPCODE_ACL_RX_PKT)) {
+		// The ATT PDU is wrapped into the ACL and L2CAP headers of the ATT channel as seen on the controller
+		if (packet->opcode == BTSNOOP_OPCODE_ACL_TX_PKT) {
+			put_le16(acl_handle_pack(packet->handle, ACL_START_NO_FLUSH), buffer);
+		} else {
+			put_le16(acl_handle_pack(packet->handle, ACL_START), buffer);
+		}
+		put_le16(packet->length + 4, buffer + 2);
+		// The L2CAP length keeps the length of the PDU before its truncation
+		put_le16(MIN(packet->original_length, UINT16_MAX), buffer + 4);
+		put_le16(ATT_CID, buffer + 6);
+		memcpy(buffer + 8, packet->data, packet->length);
+		size = packet->length + 8;
+	} else {
+		memcpy(buffer, packet->data, packet->length);
+		size = packet->length;
+	}
+
+	if (btsnoop_write_hci(capture->btsnoop, &tv, packet->index, packet->opcode, capture->drops, buffer, size)) {
+		capture->drops = 0;
+	}
+
+	// The btsnoop records have no original length: mark the truncation with a note following the packet
+	if (packet->original_length > packet->length) {
+		note_length = snprintf((char*)buffer, sizeof(buffer), "gattlib: previous packet truncated from %u to %u bytes",
+				(unsigned int)packet->original_length, (unsigned int)packet->length);
+		btsnoop_write_hci(capture->btsnoop, &tv, packet->index, BTSNOOP_OPCODE_SYSTEM_NOTE, 0,
+				buffer, MIN(note_length + 1, (int)sizeof(buffer)));
+	}
+}
+
+// Write the complete packets of the ring not flushed yet. 'capture->mutex' must be held.
+static void capture_flush_locked(struct gattlib_capture *capture) {
+	uint64_t head = __atomic_load_n(&capture->head, __ATOMIC_ACQUIRE);
+	struct capture_packet packet;
+
+	// Skip the packets already overwritten
+	if (head - capture->tail > capture->mask + 1) {
+		capture->drops += head - capture->tail - (capture->mask + 1);
+		capture->tail = head - (capture->mask + 1);
+	}
+
+	while (capture->tail < head) {
+		const struct capture_packet *slot = &capture->packets[capture->tail & capture->mask];
+		uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+		if (sequence < 2 * capture->tail + 2) {
+			// Still being written: it will be flushed with the next flush
+			break;
+		} else if (sequence == 2 * capture->tail + 2) {
+			memcpy(&packet, slot, sizeof(packet));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+			// Check the packet has not been overwritten while it was copied
+			if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+				capture_write_packet(capture, &packet);
+			} else {
+				capture->drops++;
+			}
+		} else {
+			capture->drops++;
+		}
+		capture->tail++;
+	}
+}
+
+static void *capture_flush_thread(void *arg) {
+	struct gattlib_capture *capture = arg;
+	struct timespec deadline;
+
+	pthread_mutex_lock(&capture->mutex);
+	while (!capture->stopping) {
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += capture->flush_period_ms / 1000;
+		deadline.tv_nsec += (capture->flush_period_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_cond_timedwait(&capture->cond, &capture->mutex, &deadline);
+		capture_flush_locked(capture);
+	}
+	pthread_mutex_unlock(&capture->mutex);
+
+	return NULL;
+}
+
+static void capture_free(struct gattlib_capture *capture) {
+	pthread_cond_destroy(&capture->cond);
+	pthread_mutex_destroy(&capture->mutex);
+	btsnoop_unref(capture->btsnoop);
+	free(capture->packets);
+	free(capture);
+}
+
+int gattlib_capture_start(const char *path, size_t packet_count, unsigned int flush_period_ms) {
+	struct gattlib_capture *capture;
+	uint64_t size = 1;
+	int ret;
+
+	if ((path == NULL) || (packet_count == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	while (size < packet_count) {
+		size <<= 1;
+	}
+
+	pthread_mutex_lock(&m_capture_mutex);
+
+	if (m_capture != NULL) {
+		fprintf(stderr, "The capture has already been started.\n");
+		ret = GATTLIB_BUSY;
+		goto EXIT;
+	}
+
+	capture = calloc(1, sizeof(struct gattlib_capture));
+	if (capture == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+
+	capture->packets = calloc(size, sizeof(struct capture_packet));
+	if (capture->packets == NULL) {
+		free(capture);
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+	capture->mask = size - 1;
+	capture->flush_period_ms = flush_period_ms;
+	pthread_mutex_init(&capture->mutex, NULL);
+	pthread_cond_init(&capture->cond, NULL);
+
+	// Same format as 'btmon -w' so the file can be read with 'btmon -r' or Wireshark
+	capture->btsnoop = btsnoop_create(path, BTSNOOP_FORMAT_MONITOR);
+	if (capture->btsnoop == NULL) {
+		fprintf(stderr, "Failed to create the capture file '%s': %s\n", path, strerror(errno));
+		capture_free(capture);
+		ret = GATTLIB_ERROR_INTERNAL;
+		goto EXIT;
+	}
+
+	if (flush_period_ms > 0) {
+		ret = pthread_create(&capture->thread, NULL, capture_flush_thread, capture);
+		if (ret != 0) {
+			fprintf(stderr, "Failed to create the capture flush thread.\n");
+			capture_free(capture);
+			ret = GATTLIB_ERROR_INTERNAL;
+			goto EXIT;
+		}
+	}
+
+	__atomic_store_n(&m_capture, capture, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&g_gattlib_capture_enabled, 1, __ATOMIC_RELAXED);
+	ret = GATTLIB_SUCCESS;
+
+EXIT:
+	pthread_mutex_unlock(&m_capture_mutex);
+	return ret;
+}
+
+int gattlib_capture_flush(void) {
+	struct gattlib_capture *capture;
+	int ret = GATTLIB_SUCCESS;
+
+	pthread_mutex_lock(&m_capture_mutex);
+
+	capture = m_capture;
+	if (capture == NULL) {
+		ret = GATTLIB_INVALID_PARAMETER;
+	} else {
+		pthread_mutex_lock(&capture->mutex);
+		capture_flush_locked(capture);
+		pthread_mutex_unlock(&capture->mutex);
+	}
+
+	pthread_mutex_unlock(&m_capture_mutex);
+	return ret;
+}
+
+int gattlib_capture_stop(void) {
+	struct gattlib_capture *capture;
+
+	pthread_mutex_lock(&m_capture_mutex);
+
+	capture = m_capture;
+	if (capture == NULL) {
+		pthread_mutex_unlock(&m_capture_mutex);
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Stop the recording and wait for the packets being recorded
+	__atomic_store_n(&g_gattlib_capture_enabled, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&m_capture, NULL, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&m_capture_writers, __ATOMIC_ACQUIRE) != 0) {
+		sched_yield();
+	}
+
+	if (capture->flush_period_ms > 0) {
+		pthread_mutex_lock(&capture->mutex);
+		capture->stopping = true;
+		pthread_cond_signal(&capture->cond);
+		pthread_mutex_unlock(&capture->mutex);
+
+		pthread_join(capture->thread, NULL);
+	}
+
+	capture_flush_locked(capture);
+	capture_free(capture);
+
+	pthread_mutex_unlock(&m_capture_mutex);
+	return GATTLIB_SUCCESS;
+}
+
+#else
+
+int gattlib_capture_start(const char *path, size_t packet_count, unsigned int flush_period_ms) {
+	// The btsnoop writer is only part of Bluez v5
+	fprintf(stderr, "The capture is not supported with Bluez v4.\n");
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_capture_flush(void) {
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_capture_stop(void) {
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef __GATTLIB_CAPTURE_H__
+#define __GATTLIB_CAPTURE_H__
+
+//
+// Recording of the packets into the capture ring (see 'gattlib_capture_start()').
+// This header does not depend on glib nor gattlib so it can be included by the Bluez sources.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+extern int g_gattlib_capture_enabled;
+#define GATTLIB_CAPTURE_ENABLED() __builtin_expect(__atomic_load_n(&g_gattlib_capture_enabled, __ATOMIC_RELAXED), 0)
+
+/**
+ * Record the ATT PDU sent or received on the socket 'fd' if it belongs to a connection added to the capture
+ */
+void gattlib_capture_att(int fd, bool received, const void *pdu, size_t length);
+/**
+ * Record the HCI event (without the HCI packet type) received from the adapter 'index'
+ */
+void gattlib_capture_hci_event(uint16_t index, const void *event, size_t length);
+/**
+ * Add/remove the ATT socket of a connection to/from the capture. The connections are identified in the capture
+ * by their adapter index and HCI handle.
+ */
+void gattlib_capture_add_connection(int fd, uint16_t index, uint16_t handle, const char *address);
+void gattlib_capture_remove_connection(int fd);
+
+#endif
@@ -22,9 +22,12 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/socket.h>
 
 #include <bluetooth/bluetooth.h>
 
@@ -32,6 +35,7 @@
 
 #include "att.h"
 #include "btio.h"
+#include "gatt.h"
 #include "gattrib.h"
 #include "hci.h"
 #include "hci_lib.h"
@@ -49,6 +53,151 @@ typedef struct {
 	void*              user_data;
 } io_connect_arg_t;
 
+static bool is_service_changed_uuid(const uuid_t *uuid) {
+	return (uuid->type == SDP_UUID16) && (uuid->value.uuid16 == GATT_CHARAC_SERVICE_CHANGED);
+}
+
+/*
+ * Rediscover the changed range to update the correspondence handle/UUID and the GATT database.
+ * The discovery cannot be done from the ATT event handler as it waits for the responses
+ * dispatched by the same source.
+ */
+static gboolean service_changed_cb(gpointer user_data) {
+	gatt_connection_t *conn = user_data;
+	gattlib_context_t* conn_context = conn->context;
+	gattlib_characteristic_t *merged_characteristics;
+	gattlib_gatt_tree_t *tree = NULL;
+	uint16_t start = conn_context->service_changed_start;
+	uint16_t end = conn_context->service_changed_end;
+	size_t characteristic_count = 0;
+	int count = 0;
+	int ret;
+
+	conn_context->service_changed_source = NULL;
+
+	ret = discover_range(conn, start, end, &tree);
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "Failed to discover the changed range 0x%04x-0x%04x.\n", start, end);
+		// The stale characteristics of the range are removed anyway. The GATT database rediscovers it later.
+		tree = NULL;
+	}
+
+	for (size_t s = 0; (tree != NULL) && (s < tree->services_count); s++) {
+		characteristic_count += tree->services[s].characteristics_count;
+	}
+
+	merged_characteristics = malloc((conn_context->characteristic_count + characteristic_count + 1) * sizeof(gattlib_characteristic_t));
+	if (merged_characteristics != NULL) {
+		for (int i = 0; i < conn_context->characteristic_count; i++) {
+			if ((conn_context->characteristics[i].handle < start) || (conn_context->characteristics[i].handle > end)) {
+				merged_characteristics[count++] = conn_context->characteristics[i];
+			}
+		}
+		for (size_t s = 0; (tree != NULL) && (s < tree->services_count); s++) {
+			for (size_t c = 0; c < tree->services[s].characteristics_count; c++) {
+				const gattlib_characteristic_t *characteristic = &tree->services[s].characteristics[c].characteristic;
+
+				if ((characteristic->handle >= start) && (characteristic->handle <= end)) {
+					merged_characteristics[count++] = *characteristic;
+				}
+			}
+		}
+
+		free(conn_context->characteristics);
+		conn_context->characteristics = merged_characteristics;
+		conn_context->characteristic_count = count;
+	}
+
+	gattlib_gatt_db_service_changed(conn, start, end, tree);
+	free(tree);
+
+	return FALSE;
+}
+
+static void service_changed_schedule(gatt_connection_t *conn, uint16_t start, uint16_t end) {
+	gattlib_context_t* conn_context = conn->context;
+
+	if (start > end) {
+		return;
+	}
+
+	// Merge with the range not processed yet
+	if (conn_context->service_changed_source != NULL) {
+		conn_context->service_changed_start = MIN(conn_context->service_changed_start, start);
+		conn_context->service_changed_end = MAX(conn_context->service_changed_end, end);
+		return;
+	}
+
+	conn_context->service_changed_start = start;
+	conn_context->service_changed_end = end;
+
+	GSource *source = g_idle_source_new();
+	assert(source != NULL);
+
+	g_source_set_callback(source, service_changed_cb, conn, NULL);
+
+	guint id = g_source_attach(source, g_gattlib_thread.loop_context);
+	assert(id != 0);
+	conn_context->service_changed_source = source;
+	g_source_unref(source);
+}
+
+/*
+ * Enable the 'Service Changed' indications. Bonded devices keep it enabled but the others
+ * only send them once the Client Characteristic Configuration has been written.
+ */
+static void enable_service_changed_indication(gatt_connection_t *conn) {
+	gattlib_context_t* conn_context = conn->context;
+	gattlib_primary_service_t *services = NULL;
+	gattlib_descriptor_t *descriptors = NULL;
+	uint16_t value_handle = 0, end = 0xffff;
+	int services_count = 0, descriptor_count = 0;
+	guint8 write_status;
+
+	for (int i = 0; i < conn_context->characteristic_count; i++) {
+		if (is_service_changed_uuid(&conn_context->characteristics[i].uuid)) {
+			value_handle = conn_context->characteristics[i].value_handle;
+		}
+	}
+	if (value_handle == 0) {
+		return;
+	}
+
+	// The descriptors of the characteristic end before the next characteristic declaration
+	// and at the end of its service
+	for (int i = 0; i < conn_context->characteristic_count; i++) {
+		if (conn_context->characteristics[i].handle > value_handle) {
+			end = MIN(end, conn_context->characteristics[i].handle - 1);
+		}
+	}
+	if (discover_primary(conn, &services, &services_count) == GATTLIB_SUCCESS) {
+		for (int i = 0; i < services_count; i++) {
+			if ((services[i].attr_handle_start < value_handle) && (value_handle <= services[i].attr_handle_end)) {
+				end = MIN(end, services[i].attr_handle_end);
+			}
+		}
+		free(services);
+	}
+	if (end <= value_handle) {
+		return;
+	}
+
+	// These requests are not issued by the application. They are neither traced nor counted.
+	if (discover_desc_range(conn, value_handle + 1, end, &descriptors, &descriptor_count) != GATTLIB_SUCCESS) {
+		return;
+	}
+
+	for (int i = 0; i < descriptor_count; i++) {
+		if (descriptors[i].uuid16 == GATT_CLIENT_CHARAC_CFG_UUID) {
+			const uint8_t enable_indication[] = { 0x02, 0x00 };
+
+			write_char_by_handle(conn, descriptors[i].handle, enable_indication, sizeof(enable_indication), &write_status);
+			break;
+		}
+	}
+	free(descriptors);
+}
+
 static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data) {
 	gatt_connection_t *conn = user_data;
 	uint8_t opdu[ATT_MAX_MTU];
@@ -63,18 +212,42 @@ static void events_handler(const uint8_t *pdu, uint16_t len, gpointer user_data)
 
 	int ret = get_uuid_from_handle(conn, handle, &uuid);
 	if (ret) {
+		// Attribute unknown to the connection
+		GATTLIB_STATS_INC(conn->stats.notifications_received);
+		GATTLIB_STATS_INC(conn->stats.notifications_dropped);
+		GATTLIB_STATS_ADD(conn->stats.bytes_notified, len - 3);
 		return;
 	}
 
 	switch (pdu[0]) {
 	case ATT_OP_HANDLE_NOTIFY:
+		GATTLIB_STATS_INC(conn->stats.notifications_received);
+		GATTLIB_STATS_ADD(conn->stats.bytes_notified, len - 3);
+
 		if (gattlib_has_valid_handler(&conn->notification)) {
 			gattlib_call_notification_handler(&conn->notification, &uuid, &pdu[3], len - 3);
+		} else {
+			GATTLIB_STATS_INC(conn->stats.notifications_dropped);
 		}
 		break;
 	case ATT_OP_HANDLE_IND:
-		if (gattlib_has_valid_handler(&conn->indication)) {
-			gattlib_call_notification_handler(&conn->notification, &uuid, &pdu[3], len - 3);
+		if (is_service_changed_uuid(&uuid)) {
+			if (len >= 7) {
+#if BLUEZ_VERSION_MAJOR == 4
+				service_changed_schedule(conn, att_get_u16(&pdu[3]), att_get_u16(&pdu[5]));
+#else
+				service_changed_schedule(conn, get_le16(&pdu[3]), get_le16(&pdu[5]));
+#endif
+			}
+		} else {
+			GATTLIB_STATS_INC(conn->stats.notifications_received);
+			GATTLIB_STATS_ADD(conn->stats.bytes_notified, len - 3);
+
+			if (gattlib_has_valid_handler(&conn->indication)) {
+				gattlib_call_notification_handler(&conn->notification, &uuid, &pdu[3], len - 3);
+			} else {
+				GATTLIB_STATS_INC(conn->stats.notifications_dropped);
+			}
 		}
 		break;
 	default:
@@ -115,6 +288,27 @@ static gboolean io_listen_cb(gpointer user_data) {
 	return FALSE;
 }
 
+#if BLUEZ_VERSION_MAJOR == 5
+// Identify the ATT PDUs of the connection in the capture by its adapter index and HCI handle
+static void capture_add_connection(gatt_connection_t *conn, GIOChannel *io) {
+	int fd = g_io_channel_unix_get_fd(io);
+	uint16_t handle;
+	bdaddr_t sba;
+	char src[18];
+	int index = -1;
+
+	if (bt_io_get(io, NULL, BT_IO_OPT_SOURCE_BDADDR, &sba, BT_IO_OPT_HANDLE, &handle, BT_IO_OPT_INVALID)) {
+		ba2str(&sba, src);
+		index = hci_devid(src);
+	} else {
+		// Not a Bluetooth socket (eg: loopback connection): use a pseudo handle
+		handle = fd & 0x0FFF;
+	}
+
+	gattlib_capture_add_connection(fd, (index >= 0) ? index : 0, handle, conn->device_address);
+}
+#endif
+
 static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 	io_connect_arg_t* io_connect_arg = user_data;
 
@@ -132,6 +326,8 @@ static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 		conn_context->attrib = g_attrib_new(io);
 #else
 		conn_context->attrib = g_attrib_new(io, BT_ATT_DEFAULT_LE_MTU, false);
+
+		capture_add_connection(io_connect_arg->conn, io);
 #endif
 
 		//
@@ -150,7 +346,12 @@ static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 		//
 		// Save list of characteristics to do the correspondence handle/UUID
 		//
-		gattlib_discover_char(io_connect_arg->conn, &conn_context->characteristics, &conn_context->characteristic_count);
+		discover_char_range(io_connect_arg->conn, 0x0001, 0xffff, &conn_context->characteristics, &conn_context->characteristic_count);
+
+		//
+		// Subscribe to the changes of the GATT database of the device
+		//
+		enable_service_changed_indication(io_connect_arg->conn);
 
 		//
 		// Call callback if defined
@@ -166,49 +367,85 @@ static void io_connect_cb(GIOChannel *io, GError *err, gpointer user_data) {
 	}
 }
 
+static pthread_mutex_t g_gattlib_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static void *connection_thread(void* arg) {
 	struct gattlib_thread_t* loop_thread = arg;
+	GMainContext* loop_context = g_main_context_new();
+	GMainLoop* loop = g_main_loop_new(loop_context, TRUE);
+
+	loop_thread->loop_context = loop_context;
+	loop_thread->loop = loop;
 
-	loop_thread->loop_context = g_main_context_new();
-	loop_thread->loop = g_main_loop_new(loop_thread->loop_context, TRUE);
+	g_main_loop_run(loop);
 
-	g_main_loop_run(loop_thread->loop);
-	g_main_loop_unref(loop_thread->loop);
-	assert(0);
+	// The loop has been quit by the release of the last reference
+	g_main_loop_unref(loop);
+	g_main_context_unref(loop_context);
 	return NULL;
 }
 
-static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const gchar *dst,
-		uint8_t dest_type, BtIOSecLevel sec_level, int psm, int mtu,
-		gatt_connect_cb_t connect_cb,
-		io_connect_arg_t* io_connect_arg)
-{
-	bdaddr_t sba, dba;
-	GError *err = NULL;
-	int ret;
+int gattlib_thread_ref(void) {
+	int ret = GATTLIB_SUCCESS;
 
-	io_connect_arg->error = NULL;
+	pthread_mutex_lock(&g_gattlib_thread_mutex);
 
 	/* Check if the GattLib thread has been started */
 	if (g_gattlib_thread.ref == 0) {
 		/* Start it */
+		g_gattlib_thread.loop = NULL;
+		g_gattlib_thread.loop_context = NULL;
 
 		/* Create a thread that will handle Bluetooth events */
 		int error = pthread_create(&g_gattlib_thread.thread, NULL, &connection_thread, &g_gattlib_thread);
 		if (error != 0) {
 			fprintf(stderr, "Cannot create connection thread: %s", strerror(error));
-			return NULL;
+			ret = GATTLIB_ERROR_INTERNAL;
+			goto EXIT;
 		}
 
 		/* Wait for the loop to be started */
 		while (!g_gattlib_thread.loop || !g_main_loop_is_running (g_gattlib_thread.loop)) {
 			usleep(1000);
 		}
-	} else {
-		/* Increase the reference to know how many GATT connection use the loop */
-		g_gattlib_thread.ref++;
 	}
 
+	/* Increase the reference to know how many users (GATT connections, scans) use the loop */
+	g_gattlib_thread.ref++;
+
+EXIT:
+	pthread_mutex_unlock(&g_gattlib_thread_mutex);
+	return ret;
+}
+
+void gattlib_thread_unref(void) {
+	pthread_mutex_lock(&g_gattlib_thread_mutex);
+
+	/* Decrease the reference counter of the loop */
+	g_gattlib_thread.ref--;
+	/* Check if we are the last one */
+	if (g_gattlib_thread.ref == 0) {
+		// The thread releases the loop and its context on exit
+		g_main_loop_quit(g_gattlib_thread.loop);
+
+		// Detach the thread
+		pthread_detach(g_gattlib_thread.thread);
+	}
+
+	pthread_mutex_unlock(&g_gattlib_thread_mutex);
+}
+
+static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const gchar *dst,
+		uint8_t dest_type, BtIOSecLevel sec_level, int psm, int mtu,
+		gatt_connect_cb_t connect_cb,
+		io_connect_arg_t* io_connect_arg)
+{
+	bdaddr_t sba, dba;
+	GError *err = NULL;
+	int ret;
+
+	io_connect_arg->error = NULL;
+
 	/* Remote device */
 	if (dst == NULL) {
 		fprintf(stderr, "Remote Bluetooth address required\n");
@@ -245,18 +482,26 @@ static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const
 		return NULL;
 	}
 
+	/* Start the thread that will handle Bluetooth events if not already running */
+	if (gattlib_thread_ref() != GATTLIB_SUCCESS) {
+		return NULL;
+	}
+
 	gattlib_context_t* conn_context = calloc(sizeof(gattlib_context_t), 1);
 	if (conn_context == NULL) {
+		gattlib_thread_unref();
 		return NULL;
 	}
 
 	gatt_connection_t* conn = calloc(sizeof(gatt_connection_t), 1);
 	if (conn == NULL) {
 		free(conn_context);
+		gattlib_thread_unref();
 		return NULL;
 	}
 
 	conn->context = conn_context;
+	strncpy(conn->device_address, dst, sizeof(conn->device_address) - 1);
 
 	/* Intialize bt_io_connect argument */
 	io_connect_arg->conn       = conn;
@@ -304,6 +549,7 @@ static gatt_connection_t *initialize_gattlib_connection(const gchar *src, const
 		g_error_free(err);
 		free(conn_context);
 		free(conn);
+		gattlib_thread_unref();
 		return NULL;
 	} else {
 		return conn;
@@ -374,6 +620,34 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 	return conn;
 }
 
+gatt_connection_t *gattlib_connect_le_async(int dev_id, const bdaddr_t *dst, uint8_t dest_type, unsigned long options,
+		gatt_connect_cb_t connect_cb, void *user_data)
+{
+	char src[16], dst_str[18];
+	gatt_connection_t *conn;
+	BtIOSecLevel bt_io_sec_level;
+	int psm, mtu;
+
+	get_connection_options(options, &bt_io_sec_level, &psm, &mtu);
+
+	io_connect_arg_t* io_connect_arg = malloc(sizeof(io_connect_arg_t));
+	if (io_connect_arg == NULL) {
+		return NULL;
+	}
+	io_connect_arg->user_data = user_data;
+
+	snprintf(src, sizeof(src), "hci%d", dev_id);
+	ba2str(dst, dst_str);
+
+	conn = initialize_gattlib_connection(src, dst_str, dest_type, bt_io_sec_level,
+			psm, mtu, connect_cb, io_connect_arg);
+	if (conn == NULL) {
+		free(io_connect_arg);
+	}
+
+	return conn;
+}
+
 static gboolean connection_timeout(gpointer user_data) {
 	io_connect_arg_t* io_connect_arg = user_data;
 
@@ -440,19 +714,18 @@ static gatt_connection_t *gattlib_connect_with_options(const char *src, const ch
  * @param dst		Remote Bluetooth address
  * @param options	Options to connect to BLE device. See `GATTLIB_CONNECTION_OPTIONS_*`
  */
-gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
+static gatt_connection_t *connect_device(void* adapter, const char *dst, unsigned long options)
 {
-	const char* adapter_mac_address;
-	gatt_connection_t *conn;
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	const char* adapter_mac_address = NULL;
+	char adapter_name[16];
+	gatt_connection_t *conn = NULL;
 	BtIOSecLevel bt_io_sec_level;
 	int psm, mtu;
 
-	if (adapter != NULL) {
-		fprintf(stderr, "Missing support");
-		assert(0); // Need to add support
-		return NULL;
-	} else {
-		adapter_mac_address = NULL;
+	if (gattlib_adapter != NULL) {
+		snprintf(adapter_name, sizeof(adapter_name), "hci%d", gattlib_adapter->dev_id);
+		adapter_mac_address = adapter_name;
 	}
 
 	// Check parameters
@@ -465,18 +738,242 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 
 	get_connection_options(options, &bt_io_sec_level, &psm, &mtu);
 
+	// Wait for the background scan of the adapter to leave the radio to the connection
+	if (gattlib_adapter != NULL) {
+		gattlib_scan_scheduler_hold(gattlib_adapter->scan_scheduler);
+	}
+
 	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC) {
 		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_PUBLIC, bt_io_sec_level, psm, mtu);
-		if (conn != NULL) {
-			return conn;
-		}
 	}
 
-	if (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM) {
+	if ((conn == NULL) && (options & GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM)) {
 		conn = gattlib_connect_with_options(adapter_mac_address, dst, BDADDR_LE_RANDOM, bt_io_sec_level, psm, mtu);
 	}
 
+	if (gattlib_adapter != NULL) {
+		gattlib_scan_scheduler_release(gattlib_adapter->scan_scheduler);
+	}
+
+	return conn;
+}
+
+gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
+{
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_CONNECT, NULL, dst, 0, NULL, 0);
+	gatt_connection_t *conn;
+
+	conn = connect_device(adapter, dst, options);
+
+	if (traced) {
+		trace.connection = conn;
+		gattlib_trace_end(&trace, (conn != NULL) ? GATTLIB_SUCCESS : GATTLIB_NOT_CONNECTED, 0);
+	}
+	return conn;
+}
+
+// State of a loopback connection shared by the caller waiting for it and the gattlib thread completing it.
+// The connection is released by the gattlib thread if the caller has given up when it completes.
+struct loopback_connect {
+	gint ref;
+	gatt_connection_t *conn;
+	bool started;
+	bool completed;
+	bool connected;
+	bool abandoned;
+};
+
+// Protect the 'struct loopback_connect' flags
+static GMutex g_loopback_connect_mutex;
+
+static void loopback_connect_unref(gpointer data) {
+	struct loopback_connect *loopback_connect = data;
+
+	if (g_atomic_int_dec_and_test(&loopback_connect->ref)) {
+		free(loopback_connect);
+	}
+}
+
+static void loopback_on_connected(gatt_connection_t* connection, void* user_data) {
+	struct loopback_connect *loopback_connect = user_data;
+	bool abandoned;
+
+	g_mutex_lock(&g_loopback_connect_mutex);
+	loopback_connect->completed = true;
+	loopback_connect->connected = (connection != NULL);
+	abandoned = loopback_connect->abandoned;
+	g_mutex_unlock(&g_loopback_connect_mutex);
+
+	if (abandoned) {
+		gattlib_disconnect(loopback_connect->conn);
+	}
+}
+
+static gboolean loopback_connect_cb(gpointer user_data) {
+	struct loopback_connect *loopback_connect = user_data;
+	gattlib_context_t* conn_context = loopback_connect->conn->context;
+	io_connect_arg_t* io_connect_arg;
+	bool abandoned;
+
+	g_mutex_lock(&g_loopback_connect_mutex);
+	loopback_connect->started = true;
+	abandoned = loopback_connect->abandoned;
+	g_mutex_unlock(&g_loopback_connect_mutex);
+
+	if (abandoned) {
+		// The connection has already been released by the caller
+		return FALSE;
+	}
+
+	// Released by 'io_connect_cb()' as for the asynchronous connections
+	io_connect_arg = calloc(1, sizeof(io_connect_arg_t));
+	if (io_connect_arg == NULL) {
+		loopback_on_connected(NULL, loopback_connect);
+		return FALSE;
+	}
+	io_connect_arg->conn       = loopback_connect->conn;
+	io_connect_arg->connect_cb = loopback_on_connected;
+	io_connect_arg->user_data  = loopback_connect;
+
+	io_connect_cb(conn_context->io, NULL, io_connect_arg);
+	return FALSE;
+}
+
+static gboolean loopback_connect_timeout(gpointer user_data) {
+	struct loopback_connect *loopback_connect = user_data;
+
+	g_mutex_lock(&g_loopback_connect_mutex);
+	if (!loopback_connect->completed) {
+		loopback_connect->abandoned = true;
+	}
+	g_mutex_unlock(&g_loopback_connect_mutex);
+
+	return FALSE;
+}
+
+/**
+ * @brief Function to connect to the in-process peer described by a device description file
+ *
+ * @param description_file	Description of the devices (same format as the fake Bluez service)
+ * @param dst			Address of the device in the description file (NULL for the first one)
+ */
+gatt_connection_t *gattlib_connect_loopback(const char *description_file, const char *dst)
+{
+	struct loopback_connect *loopback_connect;
+	gattlib_context_t* conn_context;
+	gatt_connection_t *conn;
+	GSource *source, *timeout;
+	bool started, completed, connected, abandoned;
+	int fds[2];
+
+	if (description_file == NULL) {
+		return NULL;
+	}
+
+	loopback_connect = calloc(1, sizeof(struct loopback_connect));
+	if (loopback_connect == NULL) {
+		return NULL;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		fprintf(stderr, "Failed to create the loopback socket pair: %s\n", strerror(errno));
+		free(loopback_connect);
+		return NULL;
+	}
+
+	/* Start the thread that will handle the ATT sockets if not already running */
+	if (gattlib_thread_ref() != GATTLIB_SUCCESS) {
+		goto CLOSE_SOCKETS;
+	}
+
+	conn_context = calloc(sizeof(gattlib_context_t), 1);
+	if (conn_context == NULL) {
+		goto UNREF_THREAD;
+	}
+
+	conn = calloc(sizeof(gatt_connection_t), 1);
+	if (conn == NULL) {
+		free(conn_context);
+		goto UNREF_THREAD;
+	}
+	conn->context = conn_context;
+	if (dst != NULL) {
+		strncpy(conn->device_address, dst, sizeof(conn->device_address) - 1);
+	}
+
+	// The peer owns its end of the socket pair from here
+	conn_context->loopback = gattlib_loopback_new(description_file, dst, fds[1]);
+	if (conn_context->loopback == NULL) {
+		free(conn_context);
+		free(conn);
+		gattlib_thread_unref();
+		close(fds[0]);
+		free(loopback_connect);
+		return NULL;
+	}
+
+	conn_context->io = g_io_channel_unix_new(fds[0]);
+	g_io_channel_set_close_on_unref(conn_context->io, TRUE);
+
+	// One reference for the caller, one for each source
+	loopback_connect->ref = 3;
+	loopback_connect->conn = conn;
+
+	// Complete the connection from the gattlib thread as bt_io does for the Bluetooth sockets
+	source = g_idle_source_new();
+	g_source_set_callback(source, loopback_connect_cb, loopback_connect, loopback_connect_unref);
+	g_source_attach(source, g_gattlib_thread.loop_context);
+
+	// Timeout of 'CONNECTION_TIMEOUT+4' seconds as for the Bluetooth connections
+	timeout = g_timeout_source_new_seconds(CONNECTION_TIMEOUT + 4);
+	g_source_set_callback(timeout, loopback_connect_timeout, loopback_connect, loopback_connect_unref);
+	g_source_attach(timeout, g_gattlib_thread.loop_context);
+
+	// Wait for the connection to be done
+	do {
+		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
+
+		g_mutex_lock(&g_loopback_connect_mutex);
+		started = loopback_connect->started;
+		completed = loopback_connect->completed;
+		connected = loopback_connect->connected;
+		abandoned = loopback_connect->abandoned;
+		g_mutex_unlock(&g_loopback_connect_mutex);
+	} while (!completed && !abandoned);
+
+	// Disconnect the timeout source and the connection source if it has not been dispatched
+	g_source_destroy(timeout);
+	g_source_unref(timeout);
+	g_source_destroy(source);
+	g_source_unref(source);
+
+	if (abandoned) {
+		fprintf(stderr, "gattlib_connect_loopback - connection timeout\n");
+		// A connection in progress is released by the gattlib thread once it completes
+		if (!started) {
+			gattlib_disconnect(conn);
+		}
+		loopback_connect_unref(loopback_connect);
+		return NULL;
+	}
+
+	loopback_connect_unref(loopback_connect);
+
+	if (!connected) {
+		fprintf(stderr, "gattlib_connect_loopback - connection error\n");
+		gattlib_disconnect(conn);
+		return NULL;
+	}
 	return conn;
+
+UNREF_THREAD:
+	gattlib_thread_unref();
+CLOSE_SOCKETS:
+	close(fds[0]);
+	close(fds[1]);
+	free(loopback_connect);
+	return NULL;
 }
 
 int gattlib_disconnect(gatt_connection_t* connection) {
@@ -489,24 +986,27 @@ int gattlib_disconnect(gatt_connection_t* connection) {
 	g_io_channel_unref(conn_context->io);
 #endif
 
+	if (conn_context->service_changed_source != NULL) {
+		g_source_destroy(conn_context->service_changed_source);
+	}
+
+#if BLUEZ_VERSION_MAJOR == 5
+	gattlib_capture_remove_connection(g_io_channel_unix_get_fd(conn_context->io));
+#endif
 	g_attrib_unref(conn_context->attrib);
 
+	if (conn_context->loopback != NULL) {
+		g_io_channel_unref(conn_context->io);
+		gattlib_loopback_free(conn_context->loopback);
+	}
+
 	free(conn_context->characteristics);
 	free(connection->context);
+	gattlib_gatt_db_free(connection->gatt_db);
 	free(connection);
 
-	//TODO: Add a mutex around this code to avoid a race condition
-	/* Decrease the reference counter of the loop */
-	g_gattlib_thread.ref--;
-	/* Check if we are the last one */
-	if (g_gattlib_thread.ref == 0) {
-		g_main_loop_quit(g_gattlib_thread.loop);
-		g_main_loop_unref(g_gattlib_thread.loop);
-		g_main_context_unref(g_gattlib_thread.loop_context);
-
-		// Detach the thread
-		pthread_detach(g_gattlib_thread.thread);
-	}
+	/* Release the loop used by the connection */
+	gattlib_thread_unref();
 
 	return GATTLIB_SUCCESS;
 }
@@ -544,7 +1044,12 @@ GSource* gattlib_timeout_add_seconds(guint interval, GSourceFunc function, gpoin
 
 int get_uuid_from_handle(gatt_connection_t* connection, uint16_t handle, uuid_t* uuid) {
 	gattlib_context_t* conn_context = connection->context;
-	int i;
+	int i, ret;
+
+	// Use the index of the GATT database when it has been discovered
+	if (gattlib_gatt_db_lookup_uuid(connection, handle, uuid, &ret)) {
+		return ret;
+	}
 
 	for (i = 0; i < conn_context->characteristic_count; i++) {
 		if (conn_context->characteristics[i].value_handle == handle) {
@@ -557,7 +1062,11 @@ int get_uuid_from_handle(gatt_connection_t* connection, uint16_t handle, uuid_t*
 
 int get_handle_from_uuid(gatt_connection_t* connection, const uuid_t* uuid, uint16_t* handle) {
 	gattlib_context_t* conn_context = connection->context;
-	int i;
+	int i, ret;
+
+	if (gattlib_gatt_db_lookup_value_handle(connection, uuid, handle, &ret)) {
+		return ret;
+	}
 
 	for (i = 0; i < conn_context->characteristic_count; i++) {
 		if (gattlib_uuid_cmp(&conn_context->characteristics[i].uuid, uuid) == 0) {
@@ -568,12 +1077,10 @@ int get_handle_from_uuid(gatt_connection_t* connection, const uuid_t* uuid, uint
 	return GATTLIB_NOT_FOUND;
 }
 
-#if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 int gattlib_get_rssi(gatt_connection_t *connection, int16_t *rssi)
 {
 	return GATTLIB_NOT_SUPPORTED;
 }
-#endif
 
 int gattlib_get_rssi_from_mac(void *adapter, const char *mac_address, int16_t *rssi)
 {
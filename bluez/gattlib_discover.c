@@ -74,7 +74,7 @@ done:
 	data->discovered = TRUE;
 }
 
-int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
+int discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
 	struct primary_all_cb_t user_data;
 	guint ret;
 
@@ -103,6 +103,21 @@ int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_serv
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_primary(connection, services, services_count);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 struct characteristic_cb_t {
 	gattlib_characteristic_t* characteristics;
 	int characteristics_count;
@@ -146,7 +161,7 @@ done:
 	data->discovered = TRUE;
 }
 
-int gattlib_discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
+int discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
 	struct characteristic_cb_t user_data;
 	guint ret;
 
@@ -170,6 +185,21 @@ int gattlib_discover_char_range(gatt_connection_t* connection, int start, int en
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_char_range(connection, start, end, characteristics, characteristics_count);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 int gattlib_discover_char(gatt_connection_t* connection, gattlib_characteristic_t** characteristics, int* characteristics_count) {
 	return gattlib_discover_char_range(connection, 0x0001, 0xffff, characteristics, characteristics_count);
 }
@@ -264,7 +294,7 @@ done:
 }
 #endif
 
-int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int end, gattlib_descriptor_t** descriptors, int* descriptor_count) {
+int discover_desc_range(gatt_connection_t* connection, int start, int end, gattlib_descriptor_t** descriptors, int* descriptor_count) {
 	gattlib_context_t* conn_context = connection->context;
 	struct descriptor_cb_t descriptor_data;
 	guint ret;
@@ -292,10 +322,106 @@ int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int en
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int end, gattlib_descriptor_t** descriptors, int* descriptor_count) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_desc_range(connection, start, end, descriptors, descriptor_count);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 int gattlib_discover_desc(gatt_connection_t* connection, gattlib_descriptor_t** descriptors, int* descriptor_count) {
 	return gattlib_discover_desc_range(connection, 0x0001, 0xffff, descriptors, descriptor_count);
 }
 
+int discover_range(gatt_connection_t* connection, uint16_t start, uint16_t end, gattlib_gatt_tree_t** tree) {
+	gattlib_primary_service_t* services = NULL;
+	gattlib_characteristic_t* characteristics = NULL;
+	gattlib_descriptor_t* descriptors = NULL;
+	gattlib_gatt_tree_service_t* tree_services = NULL;
+	int services_count = 0, characteristics_count = 0, descriptors_count = 0;
+	int tree_services_count = 0;
+	int ret;
+
+	// ATT has no procedure to read the whole database: discover each attribute type once over the range
+	ret = discover_primary(connection, &services, &services_count);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
+	}
+
+	ret = discover_char_range(connection, start, end, &characteristics, &characteristics_count);
+	if (ret != GATTLIB_SUCCESS) {
+		goto EXIT;
+	}
+
+	ret = discover_desc_range(connection, start, end, &descriptors, &descriptors_count);
+	if (ret != GATTLIB_SUCCESS) {
+		goto EXIT;
+	}
+
+	tree_services = calloc(services_count, sizeof(gattlib_gatt_tree_service_t));
+	if ((tree_services == NULL) && (services_count > 0)) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+		goto EXIT;
+	}
+
+	// The primary service discovery has no range. Keep the services overlapping the range so the characteristics
+	// of the range are attached to their service even when it starts before the range.
+	for (int i = 0; i < services_count; i++) {
+		if ((services[i].attr_handle_start <= end) && (services[i].attr_handle_end >= start)) {
+			tree_services[tree_services_count].service = services[i];
+			tree_services[tree_services_count].primary = true;
+			tree_services_count++;
+		}
+	}
+
+	*tree = gattlib_gatt_tree_new(tree_services, tree_services_count,
+			characteristics, characteristics_count, descriptors, descriptors_count);
+	if (*tree == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+	}
+
+EXIT:
+	free(tree_services);
+	free(descriptors);
+	free(characteristics);
+	free(services);
+	return ret;
+}
+
+int gattlib_discover_range(gatt_connection_t* connection, uint16_t start, uint16_t end, gattlib_gatt_tree_t** tree) {
+	gattlib_trace_event_t trace;
+	bool traced;
+	int ret;
+
+	if ((connection == NULL) || (tree == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// Traced and counted as a single discovery
+	traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_range(connection, start, end, tree);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
+int gattlib_discover_all(gatt_connection_t* connection, gattlib_gatt_tree_t** tree) {
+	return gattlib_discover_range(connection, 0x0001, 0xffff, tree);
+}
+
 /**
  * @brief Function to retrieve Advertisement Data from a MAC Address
  *
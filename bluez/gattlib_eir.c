@@ -0,0 +1,62 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Parsing of the advertising data (EIR format) reported by the controller.
+// It does not depend on the adapter so it can be benchmarked on its own (see 'benchmarks/gattlib_microbench.c').
+//
+
+#define EIR_NAME_SHORT     0x08  /* shortened local name */
+#define EIR_NAME_COMPLETE  0x09  /* complete local name */
+
+char* gattlib_eir_parse_name(const uint8_t* data, size_t size) {
+	size_t offset = 0;
+
+	while (offset < size) {
+		uint8_t field_len = data[0];
+		size_t name_len;
+
+		if (field_len == 0 || offset + field_len > size)
+			return NULL;
+
+		switch (data[1]) {
+		case EIR_NAME_SHORT:
+		case EIR_NAME_COMPLETE:
+			name_len = field_len - 1;
+			if (name_len > size)
+				return NULL;
+
+			return strndup((const char*)(data + 2), name_len);
+		}
+
+		offset += field_len + 1;
+		data += field_len + 1;
+	}
+
+	return NULL;
+}
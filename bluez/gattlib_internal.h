@@ -35,8 +35,9 @@
 #include "uuid.h"
 
 #if BLUEZ_VERSION_MAJOR == 5
-  #include "src/shared/att-types.h"
+  #include "src/shared/att.h"
   #include "src/shared/util.h"
+  #include "gattlib_capture.h"
 #endif
 
 typedef struct _GAttrib GAttrib;
@@ -55,10 +56,138 @@ typedef struct {
 	// We keep a list of characteristics to make the correspondence handle/UUID.
 	gattlib_characteristic_t* characteristics;
 	int                       characteristic_count;
+
+	// Range reported by the 'Service Changed' indications and not processed yet
+	GSource*                  service_changed_source;
+	uint16_t                  service_changed_start;
+	uint16_t                  service_changed_end;
+
+	// In-process peer of the connections created by 'gattlib_connect_loopback()' (NULL otherwise)
+	struct gattlib_loopback*  loopback;
 } gattlib_context_t;
 
+struct gattlib_adapter {
+	int dev_id;
+	int device_desc;
+
+	// LE features supported by the controller (all cleared if they could not be read)
+	uint8_t le_features[8];
+
+	// Scan started by 'gattlib_adapter_scan_start()' (NULL when not scanning)
+	struct gattlib_background_scan *background_scan;
+
+	// Set by 'gattlib_adapter_scan_disable()' to end the blocking scan of 'gattlib_adapter_scan_enable()'
+	bool blocking_scan_stop;
+
+	// HCI scan parameters applied to the next scans
+	gattlib_scan_parameters_t scan_parameters;
+
+	// Per-device coalescing rules applied to the next scans
+	struct gattlib_scan_coalescing scan_coalescing;
+
+	// Manufacturer/service data filters evaluated before the scan callbacks
+	struct gattlib_ad_filters scan_ad_filters;
+
+	// Live device table fed by the scanner (NULL when disabled)
+	struct gattlib_scan_table *scan_table;
+
+	// Periodic advertising syncs (NULL until the first sync is started)
+	struct gattlib_periodic_sync_manager *periodic_sync_manager;
+
+	// Kernel management interface used for scanning and connection control
+	// (NULL when the adapter drives the controller with raw HCI commands)
+	struct gattlib_mgmt *mgmt;
+
+	// Devices connected by the kernel as soon as they advertise (list of 'struct gattlib_auto_connect_device')
+	GSList *auto_connect_devices;
+
+	// Interleaving of the background scan with the connections
+	struct gattlib_scan_scheduler *scan_scheduler;
+
+	// Counters returned by 'gattlib_adapter_get_stats()'
+	gattlib_adapter_stats_t stats;
+};
+
+// LE supported features (bit numbers)
+#define LE_FEATURE_CODED_PHY            11
+#define LE_FEATURE_EXTENDED_ADV         12
+#define LE_FEATURE_PERIODIC_ADV         13
+
+/**
+ * Return the (shortened or complete) local name of the advertising data or NULL. The name is allocated with malloc().
+ */
+char* gattlib_eir_parse_name(const uint8_t* data, size_t size);
+
+/**
+ * Return true if the controller of the adapter supports the given LE feature
+ */
+bool gattlib_adapter_has_le_feature(const struct gattlib_adapter *gattlib_adapter, unsigned int feature);
+
+/**
+ * Terminate the periodic advertising syncs of the adapter and release their resources
+ */
+void gattlib_periodic_sync_stop_all(struct gattlib_adapter *gattlib_adapter);
+
+#if BLUEZ_VERSION_MAJOR == 5
+// 'Add Device' action: connect the device as soon as it advertises
+#define MGMT_ADD_DEVICE_AUTO_CONNECT    0x02
+
+typedef void (*gattlib_mgmt_device_found_cb_t)(const bdaddr_t *bdaddr, uint8_t bdaddr_type, int8_t rssi,
+		const uint8_t *eir, size_t eir_length, void *user_data);
+typedef void (*gattlib_mgmt_device_connected_cb_t)(const bdaddr_t *bdaddr, uint8_t bdaddr_type, void *user_data);
+
+/**
+ * Open the kernel management interface for the adapter 'index'
+ */
+struct gattlib_mgmt *gattlib_mgmt_open(uint16_t index);
+/**
+ * Use an already opened management channel (eg: one end of a socketpair emulating the kernel)
+ */
+struct gattlib_mgmt *gattlib_mgmt_new(int fd, uint16_t index);
+void gattlib_mgmt_close(struct gattlib_mgmt *gattlib_mgmt);
+
+/**
+ * Start LE discovery. 'device_found_cb' is called from the gattlib thread until the discovery is stopped.
+ */
+int gattlib_mgmt_start_discovery(struct gattlib_mgmt *gattlib_mgmt, gattlib_mgmt_device_found_cb_t device_found_cb, void *user_data);
+int gattlib_mgmt_stop_discovery(struct gattlib_mgmt *gattlib_mgmt);
+int gattlib_mgmt_set_scan_params(struct gattlib_mgmt *gattlib_mgmt, uint16_t interval, uint16_t window);
+/**
+ * Add the device to the kernel device list. 'action' is one of the MGMT 'Add Device' actions (eg: 0x02 for auto-connect)
+ */
+int gattlib_mgmt_add_device(struct gattlib_mgmt *gattlib_mgmt, const bdaddr_t *bdaddr, uint8_t bdaddr_type, uint8_t action);
+int gattlib_mgmt_remove_device(struct gattlib_mgmt *gattlib_mgmt, const bdaddr_t *bdaddr, uint8_t bdaddr_type);
+/**
+ * Set the callback called from the gattlib thread when the kernel reports a new connection (NULL to unset it)
+ */
+void gattlib_mgmt_set_device_connected_cb(struct gattlib_mgmt *gattlib_mgmt, gattlib_mgmt_device_connected_cb_t device_connected_cb, void *user_data);
+#endif
+
+/**
+ * Start an asynchronous ATT connection from the adapter 'dev_id' to an LE device.
+ * 'connect_cb' is mandatory and is called with a NULL connection on failure.
+ */
+gatt_connection_t *gattlib_connect_le_async(int dev_id, const bdaddr_t *dst, uint8_t dest_type, unsigned long options,
+		gatt_connect_cb_t connect_cb, void *user_data);
+
+/**
+ * Serve the ATT socket 'fd' from the gattlib thread with a GATT server populated with the device 'address'
+ * of the description file (the first device when 'address' is NULL). The peer takes ownership of 'fd'.
+ */
+struct gattlib_loopback *gattlib_loopback_new(const char *description_file, const char *address, int fd);
+void gattlib_loopback_free(struct gattlib_loopback *loopback);
+
 extern struct gattlib_thread_t g_gattlib_thread;
 
+/**
+ * Start the gattlib thread if needed and take a reference on it
+ */
+int gattlib_thread_ref(void);
+/**
+ * Release a reference on the gattlib thread. The thread is stopped with the last reference.
+ */
+void gattlib_thread_unref(void);
+
 /**
  * Watch the GATT connection for conditions
  */
@@ -66,6 +195,21 @@ GSource* gattlib_watch_connection_full(GIOChannel* io, GIOCondition condition,
 								 GIOFunc func, gpointer user_data, GDestroyNotify notify);
 GSource* gattlib_timeout_add_seconds(guint interval, GSourceFunc function, gpointer data);
 
+/**
+ * GATT operations issued by gattlib itself. Unlike their public counterparts, they are neither
+ * traced nor counted in the statistics of the connection.
+ */
+int discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count);
+int discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count);
+int discover_desc_range(gatt_connection_t* connection, int start, int end, gattlib_descriptor_t** descriptors, int* descriptor_count);
+int discover_range(gatt_connection_t* connection, uint16_t start, uint16_t end, gattlib_gatt_tree_t** tree);
+/**
+ * Write the handle and wait for the response. Return 0 once the response is received, its ATT
+ * status being set in 'write_status'.
+ */
+int write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len,
+		guint8 *write_status);
+
 void uuid_to_bt_uuid(uuid_t* uuid, bt_uuid_t* bt_uuid);
 void bt_uuid_to_uuid(bt_uuid_t* bt_uuid, uuid_t* uuid);
 
@@ -0,0 +1,612 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// In-process ATT peer of the loopback connections (see 'gattlib_connect_loopback()').
+//
+// The peer end of the socket pair is served by the Bluez GATT server populated from a device description file.
+// The file has the format of the configuration of the fake Bluez service of the DBus backend
+// (see 'dbus/fake-bluez/fake-bluez.conf') so the same devices can be used with both backends.
+// The ATT sockets of the connection and of the peer are both watched from the gattlib thread.
+//
+
+#if BLUEZ_VERSION_MAJOR == 5
+
+#include "src/shared/queue.h"
+#include "src/shared/gatt-db.h"
+#include "src/shared/gatt-server.h"
+
+#define LOOPBACK_CCC_UUID16     0x2902
+
+struct loopback_service {
+	char *uuid;
+	bool primary;
+	GSList *characteristics;
+};
+
+struct loopback_characteristic {
+	struct gattlib_loopback *loopback;
+
+	char *uuid;
+	uint8_t properties;
+	GByteArray *value;
+	uint16_t value_handle;
+
+	// Notifications sent every 'notify_interval_ms' once enabled by the client (0 to disable them)
+	uint32_t notify_interval_ms;
+	// Replace the first 4 bytes of the notified value by a little-endian sequence number
+	bool notify_sequence;
+	uint32_t sequence;
+	GSource *notify_source;
+
+	GSList *descriptors;
+};
+
+struct loopback_descriptor {
+	struct loopback_characteristic *characteristic;
+
+	char *uuid;
+	bool is_ccc;
+	GByteArray *value;
+};
+
+// Response delayed by the latency of the device
+struct loopback_response {
+	struct gattlib_loopback *loopback;
+	struct gatt_db_attribute *attribute;
+	unsigned int id;
+	bool write;
+	int error;
+	GByteArray *value;
+	GSource *source;
+};
+
+struct gattlib_loopback {
+	struct gatt_db *db;
+	struct bt_att *att;
+	struct bt_gatt_server *server;
+
+	// Delay of the responses to the read and write requests
+	uint32_t latency_ms;
+
+	GSList *services;
+	GSList *pending_responses;
+};
+
+static GByteArray *parse_hex_bytes(const char *str) {
+	GByteArray *bytes = g_byte_array_new();
+
+	while ((str != NULL) && (*str != '\0')) {
+		char *end;
+		unsigned long byte;
+		guint8 value;
+
+		while ((*str == ' ') || (*str == ':')) {
+			str++;
+		}
+		if (*str == '\0') {
+			break;
+		}
+
+		byte = strtoul(str, &end, 16);
+		if ((end == str) || (byte > 0xFF)) {
+			fprintf(stderr, "Invalid byte in '%s'.\n", str);
+			break;
+		}
+		value = byte;
+		g_byte_array_append(bytes, &value, 1);
+		str = end;
+	}
+
+	return bytes;
+}
+
+static uint8_t parse_properties(char **flags) {
+	uint8_t properties = 0;
+
+	for (char **flag = flags; (flag != NULL) && (*flag != NULL); flag++) {
+		if (strcmp(*flag, "read") == 0) {
+			properties |= BT_GATT_CHRC_PROP_READ;
+		} else if (strcmp(*flag, "write") == 0) {
+			properties |= BT_GATT_CHRC_PROP_WRITE;
+		} else if (strcmp(*flag, "write-without-response") == 0) {
+			properties |= BT_GATT_CHRC_PROP_WRITE_WITHOUT_RESP;
+		} else if (strcmp(*flag, "notify") == 0) {
+			properties |= BT_GATT_CHRC_PROP_NOTIFY;
+		} else if (strcmp(*flag, "indicate") == 0) {
+			properties |= BT_GATT_CHRC_PROP_INDICATE;
+		}
+	}
+	return properties;
+}
+
+//
+// Responses to the ATT requests
+//
+
+static void loopback_response_send(struct loopback_response *response) {
+	if (response->write) {
+		gatt_db_attribute_write_result(response->attribute, response->id, response->error);
+	} else if (response->error) {
+		gatt_db_attribute_read_result(response->attribute, response->id, response->error, NULL, 0);
+	} else {
+		gatt_db_attribute_read_result(response->attribute, response->id, 0, response->value->data, response->value->len);
+	}
+}
+
+static void loopback_response_free(struct loopback_response *response) {
+	if (response->value != NULL) {
+		g_byte_array_unref(response->value);
+	}
+	free(response);
+}
+
+static gboolean on_response_timeout(gpointer user_data) {
+	struct loopback_response *response = user_data;
+	struct gattlib_loopback *loopback = response->loopback;
+
+	loopback->pending_responses = g_slist_remove(loopback->pending_responses, response);
+	loopback_response_send(response);
+	loopback_response_free(response);
+	return FALSE;
+}
+
+static void loopback_respond(struct gattlib_loopback *loopback, struct gatt_db_attribute *attribute, unsigned int id,
+		bool write, int error, const GByteArray *value, uint16_t offset)
+{
+	struct loopback_response *response = calloc(1, sizeof(struct loopback_response));
+
+	if (response == NULL) {
+		if (write) {
+			gatt_db_attribute_write_result(attribute, id, BT_ATT_ERROR_UNLIKELY);
+		} else {
+			gatt_db_attribute_read_result(attribute, id, BT_ATT_ERROR_UNLIKELY, NULL, 0);
+		}
+		return;
+	}
+
+	response->loopback = loopback;
+	response->attribute = attribute;
+	response->id = id;
+	response->write = write;
+	response->error = error;
+	if (value != NULL) {
+		response->value = g_byte_array_new();
+		g_byte_array_append(response->value, value->data + offset, value->len - offset);
+	}
+
+	if (loopback->latency_ms == 0) {
+		loopback_response_send(response);
+		loopback_response_free(response);
+		return;
+	}
+
+	response->source = g_timeout_source_new(loopback->latency_ms);
+	g_source_set_callback(response->source, on_response_timeout, response, NULL);
+	g_source_attach(response->source, g_gattlib_thread.loop_context);
+	g_source_unref(response->source);
+
+	loopback->pending_responses = g_slist_prepend(loopback->pending_responses, response);
+}
+
+static void loopback_read_value(struct gattlib_loopback *loopback, struct gatt_db_attribute *attribute, unsigned int id,
+		const GByteArray *value, uint16_t offset)
+{
+	if (offset > value->len) {
+		loopback_respond(loopback, attribute, id, false, BT_ATT_ERROR_INVALID_OFFSET, NULL, 0);
+	} else {
+		loopback_respond(loopback, attribute, id, false, 0, value, offset);
+	}
+}
+
+static int loopback_write_value(GByteArray *value, uint16_t offset, const uint8_t *data, size_t length) {
+	if (offset > value->len) {
+		return BT_ATT_ERROR_INVALID_OFFSET;
+	}
+
+	g_byte_array_set_size(value, offset);
+	g_byte_array_append(value, data, length);
+	return 0;
+}
+
+//
+// Notifications
+//
+
+static gboolean on_notify_timeout(gpointer user_data) {
+	struct loopback_characteristic *characteristic = user_data;
+
+	if (characteristic->notify_sequence && (characteristic->value->len >= 4)) {
+		characteristic->value->data[0] = characteristic->sequence & 0xFF;
+		characteristic->value->data[1] = (characteristic->sequence >> 8) & 0xFF;
+		characteristic->value->data[2] = (characteristic->sequence >> 16) & 0xFF;
+		characteristic->value->data[3] = (characteristic->sequence >> 24) & 0xFF;
+	}
+	characteristic->sequence++;
+
+	bt_gatt_server_send_notification(characteristic->loopback->server, characteristic->value_handle,
+			characteristic->value->data, characteristic->value->len);
+	return TRUE;
+}
+
+static void loopback_notify_stop(struct loopback_characteristic *characteristic) {
+	if (characteristic->notify_source != NULL) {
+		g_source_destroy(characteristic->notify_source);
+		characteristic->notify_source = NULL;
+	}
+}
+
+static void loopback_notify_start(struct loopback_characteristic *characteristic) {
+	if ((characteristic->notify_interval_ms == 0) || (characteristic->notify_source != NULL)) {
+		return;
+	}
+
+	characteristic->notify_source = g_timeout_source_new(characteristic->notify_interval_ms);
+	g_source_set_callback(characteristic->notify_source, on_notify_timeout, characteristic, NULL);
+	g_source_attach(characteristic->notify_source, g_gattlib_thread.loop_context);
+	g_source_unref(characteristic->notify_source);
+}
+
+//
+// GATT database callbacks
+//
+
+static void on_characteristic_read(struct gatt_db_attribute *attribute, unsigned int id, uint16_t offset,
+		uint8_t opcode, struct bt_att *att, void *user_data)
+{
+	struct loopback_characteristic *characteristic = user_data;
+
+	loopback_read_value(characteristic->loopback, attribute, id, characteristic->value, offset);
+}
+
+static void on_characteristic_write(struct gatt_db_attribute *attribute, unsigned int id, uint16_t offset,
+		const uint8_t *value, size_t length, uint8_t opcode, struct bt_att *att, void *user_data)
+{
+	struct loopback_characteristic *characteristic = user_data;
+	int error = loopback_write_value(characteristic->value, offset, value, length);
+
+	loopback_respond(characteristic->loopback, attribute, id, true, error, NULL, 0);
+}
+
+static void on_descriptor_read(struct gatt_db_attribute *attribute, unsigned int id, uint16_t offset,
+		uint8_t opcode, struct bt_att *att, void *user_data)
+{
+	struct loopback_descriptor *descriptor = user_data;
+
+	loopback_read_value(descriptor->characteristic->loopback, attribute, id, descriptor->value, offset);
+}
+
+static void on_descriptor_write(struct gatt_db_attribute *attribute, unsigned int id, uint16_t offset,
+		const uint8_t *value, size_t length, uint8_t opcode, struct bt_att *att, void *user_data)
+{
+	struct loopback_descriptor *descriptor = user_data;
+	int error = loopback_write_value(descriptor->value, offset, value, length);
+
+	// The Client Characteristic Configuration enables the notifications. Indications are not supported.
+	if ((error == 0) && descriptor->is_ccc) {
+		if ((descriptor->value->len > 0) && (descriptor->value->data[0] & 0x01)) {
+			loopback_notify_start(descriptor->characteristic);
+		} else {
+			loopback_notify_stop(descriptor->characteristic);
+		}
+	}
+
+	loopback_respond(descriptor->characteristic->loopback, attribute, id, true, error, NULL, 0);
+}
+
+//
+// Description file
+//
+
+static struct loopback_service *loopback_find_service(struct gattlib_loopback *loopback, const char *uuid) {
+	for (GSList *l = loopback->services; l != NULL; l = l->next) {
+		struct loopback_service *service = l->data;
+
+		if (g_ascii_strcasecmp(service->uuid, uuid) == 0) {
+			return service;
+		}
+	}
+	return NULL;
+}
+
+static int loopback_load_characteristic(struct gattlib_loopback *loopback, GKeyFile *key_file, const char *group, const char *uuid) {
+	struct loopback_characteristic *characteristic;
+	struct loopback_service *service;
+	char **flags, **descriptor_uuids;
+	char *service_uuid, *value;
+	bt_uuid_t bt_uuid;
+
+	service_uuid = g_key_file_get_string(key_file, group, "Service", NULL);
+	service = (service_uuid != NULL) ? loopback_find_service(loopback, service_uuid) : NULL;
+	g_free(service_uuid);
+	if (service == NULL) {
+		fprintf(stderr, "Missing or unknown 'Service' in '[%s]'.\n", group);
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	characteristic = calloc(1, sizeof(struct loopback_characteristic));
+	if (characteristic == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	characteristic->loopback = loopback;
+	characteristic->uuid = g_strdup(uuid);
+	characteristic->notify_interval_ms = g_key_file_get_integer(key_file, group, "NotifyIntervalMs", NULL);
+	characteristic->notify_sequence = g_key_file_get_boolean(key_file, group, "NotifySequence", NULL);
+
+	flags = g_key_file_get_string_list(key_file, group, "Flags", NULL, NULL);
+	characteristic->properties = parse_properties(flags);
+	g_strfreev(flags);
+
+	value = g_key_file_get_string(key_file, group, "Value", NULL);
+	characteristic->value = parse_hex_bytes(value);
+	g_free(value);
+
+	service->characteristics = g_slist_append(service->characteristics, characteristic);
+
+	descriptor_uuids = g_key_file_get_string_list(key_file, group, "Descriptors", NULL, NULL);
+	for (char **d = descriptor_uuids; (d != NULL) && (*d != NULL); d++) {
+		struct loopback_descriptor *descriptor = calloc(1, sizeof(struct loopback_descriptor));
+		if (descriptor == NULL) {
+			g_strfreev(descriptor_uuids);
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+
+		descriptor->characteristic = characteristic;
+		descriptor->uuid = g_strdup(*d);
+		descriptor->value = g_byte_array_new();
+		descriptor->is_ccc = (bt_string_to_uuid(&bt_uuid, *d) == 0) &&
+				(bt_uuid.type == BT_UUID16) && (bt_uuid.value.u16 == LOOPBACK_CCC_UUID16);
+		characteristic->descriptors = g_slist_append(characteristic->descriptors, descriptor);
+	}
+	g_strfreev(descriptor_uuids);
+
+	return GATTLIB_SUCCESS;
+}
+
+/*
+ * Load the services and characteristics of the device. The groups are '[Device <address>]',
+ * '[Service <address> <uuid>]' and '[Characteristic <address> <uuid>]'.
+ */
+static int loopback_load(struct gattlib_loopback *loopback, const char *description_file, const char *address) {
+	GKeyFile *key_file = g_key_file_new();
+	GError *error = NULL;
+	char *device_address = NULL;
+	char **groups;
+	int ret = GATTLIB_SUCCESS;
+
+	if (!g_key_file_load_from_file(key_file, description_file, G_KEY_FILE_NONE, &error)) {
+		fprintf(stderr, "Failed to load '%s': %s\n", description_file, error->message);
+		g_error_free(error);
+		g_key_file_free(key_file);
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	groups = g_key_file_get_groups(key_file, NULL);
+	for (char **group = groups; (*group != NULL) && (ret == GATTLIB_SUCCESS); group++) {
+		char **tokens = g_strsplit(*group, " ", 3);
+
+		if ((strcmp(tokens[0], "Device") == 0) && (tokens[1] != NULL) && (device_address == NULL) &&
+		    ((address == NULL) || (g_ascii_strcasecmp(tokens[1], address) == 0))) {
+			device_address = g_strdup(tokens[1]);
+			loopback->latency_ms = g_key_file_get_integer(key_file, *group, "LatencyMs", NULL);
+		} else if ((device_address == NULL) || (tokens[1] == NULL) || (tokens[2] == NULL) ||
+		           (g_ascii_strcasecmp(tokens[1], device_address) != 0)) {
+			// Group of another device
+		} else if (strcmp(tokens[0], "Service") == 0) {
+			struct loopback_service *service = calloc(1, sizeof(struct loopback_service));
+			if (service == NULL) {
+				ret = GATTLIB_OUT_OF_MEMORY;
+			} else {
+				service->uuid = g_strdup(tokens[2]);
+				service->primary = g_key_file_has_key(key_file, *group, "Primary", NULL) ?
+						g_key_file_get_boolean(key_file, *group, "Primary", NULL) : true;
+				loopback->services = g_slist_append(loopback->services, service);
+			}
+		} else if (strcmp(tokens[0], "Characteristic") == 0) {
+			ret = loopback_load_characteristic(loopback, key_file, *group, tokens[2]);
+		}
+
+		g_strfreev(tokens);
+	}
+	g_strfreev(groups);
+	g_key_file_free(key_file);
+
+	if ((ret == GATTLIB_SUCCESS) && (device_address == NULL)) {
+		fprintf(stderr, "Device '%s' not found in '%s'.\n", address ? address : "(any)", description_file);
+		ret = GATTLIB_NOT_FOUND;
+	}
+	g_free(device_address);
+
+	return ret;
+}
+
+/*
+ * Populate the GATT database. The handles are allocated in the order of the description file.
+ */
+static int loopback_populate_db(struct gattlib_loopback *loopback) {
+	for (GSList *s = loopback->services; s != NULL; s = s->next) {
+		struct loopback_service *service = s->data;
+		struct gatt_db_attribute *service_attribute;
+		uint16_t num_handles = 1;
+		bt_uuid_t uuid;
+
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			num_handles += 2 + g_slist_length(((struct loopback_characteristic *)c->data)->descriptors);
+		}
+
+		if (bt_string_to_uuid(&uuid, service->uuid) != 0) {
+			fprintf(stderr, "Invalid service UUID '%s'.\n", service->uuid);
+			return GATTLIB_INVALID_PARAMETER;
+		}
+
+		service_attribute = gatt_db_add_service(loopback->db, &uuid, service->primary, num_handles);
+		if (service_attribute == NULL) {
+			return GATTLIB_ERROR_INTERNAL;
+		}
+
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct loopback_characteristic *characteristic = c->data;
+			struct gatt_db_attribute *value_attribute;
+
+			if (bt_string_to_uuid(&uuid, characteristic->uuid) != 0) {
+				fprintf(stderr, "Invalid characteristic UUID '%s'.\n", characteristic->uuid);
+				return GATTLIB_INVALID_PARAMETER;
+			}
+
+			value_attribute = gatt_db_service_add_characteristic(service_attribute, &uuid,
+					BT_ATT_PERM_READ | BT_ATT_PERM_WRITE, characteristic->properties,
+					on_characteristic_read, on_characteristic_write, characteristic);
+			if (value_attribute == NULL) {
+				return GATTLIB_ERROR_INTERNAL;
+			}
+			characteristic->value_handle = gatt_db_attribute_get_handle(value_attribute);
+
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				struct loopback_descriptor *descriptor = d->data;
+
+				if (bt_string_to_uuid(&uuid, descriptor->uuid) != 0) {
+					fprintf(stderr, "Invalid descriptor UUID '%s'.\n", descriptor->uuid);
+					return GATTLIB_INVALID_PARAMETER;
+				}
+
+				if (gatt_db_service_add_descriptor(service_attribute, &uuid, BT_ATT_PERM_READ | BT_ATT_PERM_WRITE,
+						on_descriptor_read, on_descriptor_write, descriptor) == NULL) {
+					return GATTLIB_ERROR_INTERNAL;
+				}
+			}
+		}
+
+		gatt_db_service_set_active(service_attribute, true);
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static void loopback_services_free(GSList *services) {
+	for (GSList *s = services; s != NULL; s = s->next) {
+		struct loopback_service *service = s->data;
+
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct loopback_characteristic *characteristic = c->data;
+
+			loopback_notify_stop(characteristic);
+
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				struct loopback_descriptor *descriptor = d->data;
+
+				g_free(descriptor->uuid);
+				g_byte_array_unref(descriptor->value);
+				free(descriptor);
+			}
+			g_slist_free(characteristic->descriptors);
+
+			g_free(characteristic->uuid);
+			g_byte_array_unref(characteristic->value);
+			free(characteristic);
+		}
+		g_slist_free(service->characteristics);
+
+		g_free(service->uuid);
+		free(service);
+	}
+	g_slist_free(services);
+}
+
+struct gattlib_loopback *gattlib_loopback_new(const char *description_file, const char *address, int fd) {
+	struct gattlib_loopback *loopback = calloc(1, sizeof(struct gattlib_loopback));
+
+	if (loopback == NULL) {
+		return NULL;
+	}
+
+	loopback->db = gatt_db_new();
+	if ((loopback->db == NULL) ||
+	    (loopback_load(loopback, description_file, address) != GATTLIB_SUCCESS) ||
+	    (loopback_populate_db(loopback) != GATTLIB_SUCCESS)) {
+		goto ERROR;
+	}
+
+	loopback->att = bt_att_new(fd, false);
+	if (loopback->att == NULL) {
+		goto ERROR;
+	}
+	bt_att_set_close_on_unref(loopback->att, true);
+
+	loopback->server = bt_gatt_server_new(loopback->db, loopback->att, BT_ATT_DEFAULT_LE_MTU);
+	if (loopback->server == NULL) {
+		goto ERROR;
+	}
+
+	return loopback;
+
+ERROR:
+	gattlib_loopback_free(loopback);
+	return NULL;
+}
+
+void gattlib_loopback_free(struct gattlib_loopback *loopback) {
+	if (loopback == NULL) {
+		return;
+	}
+
+	for (GSList *l = loopback->pending_responses; l != NULL; l = l->next) {
+		struct loopback_response *response = l->data;
+
+		g_source_destroy(response->source);
+		loopback_response_free(response);
+	}
+	g_slist_free(loopback->pending_responses);
+
+	if (loopback->server != NULL) {
+		bt_gatt_server_unref(loopback->server);
+	}
+	if (loopback->att != NULL) {
+		bt_att_unref(loopback->att);
+	}
+	if (loopback->db != NULL) {
+		gatt_db_unref(loopback->db);
+	}
+
+	loopback_services_free(loopback->services);
+	free(loopback);
+}
+
+#else
+
+struct gattlib_loopback *gattlib_loopback_new(const char *description_file, const char *address, int fd) {
+	// The Bluez GATT server is only part of Bluez v5
+	fprintf(stderr, "Loopback connections are not supported with Bluez v4.\n");
+	return NULL;
+}
+
+void gattlib_loopback_free(struct gattlib_loopback *loopback) {
+}
+
+#endif
@@ -0,0 +1,465 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gattlib_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "lib/mgmt.h"
+#include "src/shared/mgmt.h"
+
+//
+// Scanning and connection control through the kernel management interface.
+//
+// The 'struct mgmt' of Bluez is not thread safe. Its socket is watched by the gattlib thread
+// (see 'io-glib.c'), so every access to it is done from the gattlib thread. The calls from the user
+// threads are marshalled with 'g_main_context_invoke()' and wait for the reply of the kernel.
+//
+
+// Maximum time to wait for the reply of the kernel (in microseconds)
+#define MGMT_REPLY_TIMEOUT_US     (5 * G_USEC_PER_SEC)
+
+// Discovery of the LE public and random addresses
+#define MGMT_DISCOVERY_TYPE_LE    ((1 << BDADDR_LE_PUBLIC) | (1 << BDADDR_LE_RANDOM))
+
+struct gattlib_mgmt {
+	struct mgmt *mgmt;
+	uint16_t index;
+
+	unsigned int device_found_id;
+	unsigned int discovering_id;
+	gattlib_mgmt_device_found_cb_t device_found_cb;
+	void *device_found_user_data;
+
+	unsigned int device_connected_id;
+	gattlib_mgmt_device_connected_cb_t device_connected_cb;
+	void *device_connected_user_data;
+};
+
+/*
+ * Request sent to the kernel from any thread
+ */
+struct mgmt_request {
+	gint ref;
+	struct gattlib_mgmt *gattlib_mgmt;
+
+	uint16_t opcode;
+	uint16_t length;
+	const void *param;
+
+	GMutex mutex;
+	GCond cond;
+	bool done;
+	uint8_t status;
+};
+
+/*
+ * Function executed in the gattlib thread by 'mgmt_invoke_sync()'
+ */
+struct mgmt_invoke {
+	GSourceFunc func;
+	void *data;
+
+	GMutex mutex;
+	GCond cond;
+	bool done;
+};
+
+static bool mgmt_is_gattlib_thread(void) {
+	return g_main_context_is_owner(g_gattlib_thread.loop_context);
+}
+
+static gboolean mgmt_invoke_cb(gpointer user_data) {
+	struct mgmt_invoke *invoke = user_data;
+
+	invoke->func(invoke->data);
+
+	g_mutex_lock(&invoke->mutex);
+	invoke->done = true;
+	g_cond_signal(&invoke->cond);
+	g_mutex_unlock(&invoke->mutex);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Run 'func' in the gattlib thread and wait for it to return.
+ */
+static void mgmt_invoke_sync(GSourceFunc func, void *data) {
+	struct mgmt_invoke invoke = { .func = func, .data = data, .done = false };
+
+	if (mgmt_is_gattlib_thread()) {
+		func(data);
+		return;
+	}
+
+	g_mutex_init(&invoke.mutex);
+	g_cond_init(&invoke.cond);
+
+	g_main_context_invoke(g_gattlib_thread.loop_context, mgmt_invoke_cb, &invoke);
+
+	g_mutex_lock(&invoke.mutex);
+	while (!invoke.done) {
+		g_cond_wait(&invoke.cond, &invoke.mutex);
+	}
+	g_mutex_unlock(&invoke.mutex);
+
+	g_cond_clear(&invoke.cond);
+	g_mutex_clear(&invoke.mutex);
+}
+
+static struct mgmt_request *mgmt_request_ref(struct mgmt_request *request) {
+	g_atomic_int_inc(&request->ref);
+	return request;
+}
+
+static void mgmt_request_unref(void *user_data) {
+	struct mgmt_request *request = user_data;
+
+	if (g_atomic_int_dec_and_test(&request->ref)) {
+		g_cond_clear(&request->cond);
+		g_mutex_clear(&request->mutex);
+		free(request);
+	}
+}
+
+static void mgmt_request_complete(uint8_t status, uint16_t length, const void *param, void *user_data) {
+	struct mgmt_request *request = user_data;
+
+	g_mutex_lock(&request->mutex);
+	request->done = true;
+	request->status = status;
+	g_cond_signal(&request->cond);
+	g_mutex_unlock(&request->mutex);
+}
+
+static gboolean mgmt_request_send(gpointer user_data) {
+	struct mgmt_request *request = user_data;
+	unsigned int id;
+
+	// The parameters are copied by 'mgmt_send()'. The request is released by its destroy function.
+	id = mgmt_send(request->gattlib_mgmt->mgmt, request->opcode, request->gattlib_mgmt->index,
+			request->length, request->param,
+			mgmt_request_complete, mgmt_request_ref(request), mgmt_request_unref);
+	if (id == 0) {
+		mgmt_request_complete(MGMT_STATUS_FAILED, 0, NULL, request);
+		mgmt_request_unref(request);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static int mgmt_status_to_gattlib_error(uint8_t status) {
+	switch (status) {
+	case MGMT_STATUS_SUCCESS:
+		return GATTLIB_SUCCESS;
+	case MGMT_STATUS_INVALID_PARAMS:
+	case MGMT_STATUS_INVALID_INDEX:
+		return GATTLIB_INVALID_PARAMETER;
+	case MGMT_STATUS_BUSY:
+		return GATTLIB_BUSY;
+	case MGMT_STATUS_UNKNOWN_COMMAND:
+	case MGMT_STATUS_NOT_SUPPORTED:
+		return GATTLIB_NOT_SUPPORTED;
+	case MGMT_STATUS_NO_RESOURCES:
+		return GATTLIB_OUT_OF_MEMORY;
+	default:
+		return GATTLIB_DEVICE_ERROR;
+	}
+}
+
+/*
+ * Send a command to the kernel and return its status.
+ * When called from the gattlib thread (eg: from a scan callback), the command is sent without waiting for its status.
+ */
+static uint8_t mgmt_send_wait(struct gattlib_mgmt *gattlib_mgmt, uint16_t opcode, uint16_t length, const void *param) {
+	struct mgmt_request *request;
+	gint64 end_time;
+	uint8_t status;
+
+	if (mgmt_is_gattlib_thread()) {
+		if (mgmt_send(gattlib_mgmt->mgmt, opcode, gattlib_mgmt->index, length, param, NULL, NULL, NULL) == 0) {
+			return MGMT_STATUS_FAILED;
+		}
+		return MGMT_STATUS_SUCCESS;
+	}
+
+	request = calloc(1, sizeof(struct mgmt_request));
+	if (request == NULL) {
+		return MGMT_STATUS_NO_RESOURCES;
+	}
+
+	request->ref = 1;
+	request->gattlib_mgmt = gattlib_mgmt;
+	request->opcode = opcode;
+	request->length = length;
+	request->param = param;
+	g_mutex_init(&request->mutex);
+	g_cond_init(&request->cond);
+
+	// 'param' must stay valid until the command has been queued
+	mgmt_invoke_sync(mgmt_request_send, request);
+
+	end_time = g_get_monotonic_time() + MGMT_REPLY_TIMEOUT_US;
+
+	g_mutex_lock(&request->mutex);
+	while (!request->done) {
+		if (!g_cond_wait_until(&request->cond, &request->mutex, end_time)) {
+			break;
+		}
+	}
+	status = request->done ? request->status : MGMT_STATUS_TIMEOUT;
+	g_mutex_unlock(&request->mutex);
+
+	mgmt_request_unref(request);
+	return status;
+}
+
+static int mgmt_send_sync(struct gattlib_mgmt *gattlib_mgmt, uint16_t opcode, uint16_t length, const void *param) {
+	uint8_t status = mgmt_send_wait(gattlib_mgmt, opcode, length, param);
+
+	if (status != MGMT_STATUS_SUCCESS) {
+		fprintf(stderr, "ERROR: Management command 0x%04x failed: %s\n", opcode, mgmt_errstr(status));
+	}
+	return mgmt_status_to_gattlib_error(status);
+}
+
+static void mgmt_on_device_found(uint16_t index, uint16_t length, const void *param, void *user_data) {
+	struct gattlib_mgmt *gattlib_mgmt = user_data;
+	const struct mgmt_ev_device_found *ev = param;
+	uint16_t eir_len;
+
+	if ((gattlib_mgmt->device_found_cb == NULL) || (length < sizeof(*ev))) {
+		return;
+	}
+
+	eir_len = btohs(ev->eir_len);
+	if (length != sizeof(*ev) + eir_len) {
+		return;
+	}
+
+	gattlib_mgmt->device_found_cb(&ev->addr.bdaddr, ev->addr.type, ev->rssi, ev->eir, eir_len,
+			gattlib_mgmt->device_found_user_data);
+}
+
+static void mgmt_on_discovering(uint16_t index, uint16_t length, const void *param, void *user_data) {
+	struct gattlib_mgmt *gattlib_mgmt = user_data;
+	const struct mgmt_ev_discovering *ev = param;
+	struct mgmt_cp_start_discovery cp = { .type = MGMT_DISCOVERY_TYPE_LE };
+
+	if (length < sizeof(*ev)) {
+		return;
+	}
+
+	// The kernel stops the LE discovery after a few seconds. Restart it while the scan is running.
+	if (!ev->discovering && (gattlib_mgmt->device_found_cb != NULL)) {
+		mgmt_send(gattlib_mgmt->mgmt, MGMT_OP_START_DISCOVERY, gattlib_mgmt->index, sizeof(cp), &cp, NULL, NULL, NULL);
+	}
+}
+
+static void mgmt_on_device_connected(uint16_t index, uint16_t length, const void *param, void *user_data) {
+	struct gattlib_mgmt *gattlib_mgmt = user_data;
+	const struct mgmt_ev_device_connected *ev = param;
+
+	if ((gattlib_mgmt->device_connected_cb == NULL) || (length < sizeof(*ev))) {
+		return;
+	}
+
+	gattlib_mgmt->device_connected_cb(&ev->addr.bdaddr, ev->addr.type, gattlib_mgmt->device_connected_user_data);
+}
+
+static struct gattlib_mgmt *mgmt_wrap(struct mgmt *mgmt, uint16_t index) {
+	struct gattlib_mgmt *gattlib_mgmt;
+
+	if (mgmt == NULL) {
+		return NULL;
+	}
+
+	gattlib_mgmt = calloc(1, sizeof(struct gattlib_mgmt));
+	if (gattlib_mgmt == NULL) {
+		mgmt_unref(mgmt);
+		return NULL;
+	}
+
+	gattlib_mgmt->mgmt = mgmt;
+	gattlib_mgmt->index = index;
+	gattlib_mgmt->device_found_id = mgmt_register(mgmt, MGMT_EV_DEVICE_FOUND, index,
+			mgmt_on_device_found, gattlib_mgmt, NULL);
+	gattlib_mgmt->discovering_id = mgmt_register(mgmt, MGMT_EV_DISCOVERING, index,
+			mgmt_on_discovering, gattlib_mgmt, NULL);
+	gattlib_mgmt->device_connected_id = mgmt_register(mgmt, MGMT_EV_DEVICE_CONNECTED, index,
+			mgmt_on_device_connected, gattlib_mgmt, NULL);
+
+	return gattlib_mgmt;
+}
+
+struct gattlib_mgmt *gattlib_mgmt_new(int fd, uint16_t index) {
+	struct gattlib_mgmt *gattlib_mgmt;
+
+	if (gattlib_thread_ref() != GATTLIB_SUCCESS) {
+		return NULL;
+	}
+
+	gattlib_mgmt = mgmt_wrap(mgmt_new(fd), index);
+	if (gattlib_mgmt == NULL) {
+		gattlib_thread_unref();
+	}
+
+	return gattlib_mgmt;
+}
+
+struct gattlib_mgmt *gattlib_mgmt_open(uint16_t index) {
+	struct gattlib_mgmt *gattlib_mgmt;
+
+	// The management socket is watched by the gattlib thread
+	if (gattlib_thread_ref() != GATTLIB_SUCCESS) {
+		return NULL;
+	}
+
+	gattlib_mgmt = mgmt_wrap(mgmt_new_default(), index);
+	if (gattlib_mgmt == NULL) {
+		fprintf(stderr, "ERROR: Could not open the management interface.\n");
+		gattlib_thread_unref();
+		return NULL;
+	}
+
+	return gattlib_mgmt;
+}
+
+static gboolean mgmt_release(gpointer user_data) {
+	struct gattlib_mgmt *gattlib_mgmt = user_data;
+
+	mgmt_unregister(gattlib_mgmt->mgmt, gattlib_mgmt->device_found_id);
+	mgmt_unregister(gattlib_mgmt->mgmt, gattlib_mgmt->discovering_id);
+	mgmt_unregister(gattlib_mgmt->mgmt, gattlib_mgmt->device_connected_id);
+	mgmt_unref(gattlib_mgmt->mgmt);
+	return G_SOURCE_REMOVE;
+}
+
+void gattlib_mgmt_close(struct gattlib_mgmt *gattlib_mgmt) {
+	if (gattlib_mgmt == NULL) {
+		return;
+	}
+
+	mgmt_invoke_sync(mgmt_release, gattlib_mgmt);
+	free(gattlib_mgmt);
+	gattlib_thread_unref();
+}
+
+struct mgmt_discovery_arg {
+	struct gattlib_mgmt *gattlib_mgmt;
+	gattlib_mgmt_device_found_cb_t device_found_cb;
+	void *user_data;
+};
+
+static gboolean mgmt_set_device_found_cb(gpointer user_data) {
+	struct mgmt_discovery_arg *arg = user_data;
+
+	arg->gattlib_mgmt->device_found_cb = arg->device_found_cb;
+	arg->gattlib_mgmt->device_found_user_data = arg->user_data;
+	return G_SOURCE_REMOVE;
+}
+
+int gattlib_mgmt_start_discovery(struct gattlib_mgmt *gattlib_mgmt, gattlib_mgmt_device_found_cb_t device_found_cb, void *user_data) {
+	struct mgmt_discovery_arg arg = { gattlib_mgmt, device_found_cb, user_data };
+	struct mgmt_cp_start_discovery cp = { .type = MGMT_DISCOVERY_TYPE_LE };
+	int ret;
+
+	mgmt_invoke_sync(mgmt_set_device_found_cb, &arg);
+
+	ret = mgmt_send_sync(gattlib_mgmt, MGMT_OP_START_DISCOVERY, sizeof(cp), &cp);
+	if (ret != GATTLIB_SUCCESS) {
+		arg.device_found_cb = NULL;
+		arg.user_data = NULL;
+		mgmt_invoke_sync(mgmt_set_device_found_cb, &arg);
+	}
+
+	return ret;
+}
+
+int gattlib_mgmt_stop_discovery(struct gattlib_mgmt *gattlib_mgmt) {
+	struct mgmt_discovery_arg arg = { gattlib_mgmt, NULL, NULL };
+	struct mgmt_cp_stop_discovery cp = { .type = MGMT_DISCOVERY_TYPE_LE };
+	uint8_t status;
+
+	// No device is reported once this function returns
+	mgmt_invoke_sync(mgmt_set_device_found_cb, &arg);
+
+	// The discovery might have been stopped by the kernel and not restarted yet
+	status = mgmt_send_wait(gattlib_mgmt, MGMT_OP_STOP_DISCOVERY, sizeof(cp), &cp);
+	if ((status != MGMT_STATUS_SUCCESS) && (status != MGMT_STATUS_REJECTED)) {
+		fprintf(stderr, "ERROR: Could not stop discovery: %s\n", mgmt_errstr(status));
+		return mgmt_status_to_gattlib_error(status);
+	}
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_mgmt_set_scan_params(struct gattlib_mgmt *gattlib_mgmt, uint16_t interval, uint16_t window) {
+	struct mgmt_cp_set_scan_params cp = { .interval = htobs(interval), .window = htobs(window) };
+
+	return mgmt_send_sync(gattlib_mgmt, MGMT_OP_SET_SCAN_PARAMS, sizeof(cp), &cp);
+}
+
+int gattlib_mgmt_add_device(struct gattlib_mgmt *gattlib_mgmt, const bdaddr_t *bdaddr, uint8_t bdaddr_type, uint8_t action) {
+	struct mgmt_cp_add_device cp;
+
+	memset(&cp, 0, sizeof(cp));
+	bacpy(&cp.addr.bdaddr, bdaddr);
+	cp.addr.type = bdaddr_type;
+	cp.action = action;
+
+	return mgmt_send_sync(gattlib_mgmt, MGMT_OP_ADD_DEVICE, sizeof(cp), &cp);
+}
+
+int gattlib_mgmt_remove_device(struct gattlib_mgmt *gattlib_mgmt, const bdaddr_t *bdaddr, uint8_t bdaddr_type) {
+	struct mgmt_cp_remove_device cp;
+
+	memset(&cp, 0, sizeof(cp));
+	bacpy(&cp.addr.bdaddr, bdaddr);
+	cp.addr.type = bdaddr_type;
+
+	return mgmt_send_sync(gattlib_mgmt, MGMT_OP_REMOVE_DEVICE, sizeof(cp), &cp);
+}
+
+struct mgmt_device_connected_arg {
+	struct gattlib_mgmt *gattlib_mgmt;
+	gattlib_mgmt_device_connected_cb_t device_connected_cb;
+	void *user_data;
+};
+
+static gboolean mgmt_set_device_connected_cb(gpointer user_data) {
+	struct mgmt_device_connected_arg *arg = user_data;
+
+	arg->gattlib_mgmt->device_connected_cb = arg->device_connected_cb;
+	arg->gattlib_mgmt->device_connected_user_data = arg->user_data;
+	return G_SOURCE_REMOVE;
+}
+
+void gattlib_mgmt_set_device_connected_cb(struct gattlib_mgmt *gattlib_mgmt, gattlib_mgmt_device_connected_cb_t device_connected_cb, void *user_data) {
+	struct mgmt_device_connected_arg arg = { gattlib_mgmt, device_connected_cb, user_data };
+
+	mgmt_invoke_sync(mgmt_set_device_connected_cb, &arg);
+}
@@ -0,0 +1,669 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gattlib_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/hci_lib.h>
+
+//
+// Periodic advertising syncs of the legacy backend.
+//
+// The syncs use their own HCI socket watched by the gattlib thread. The controller only accepts one
+// 'LE Periodic Advertising Create Sync' command at a time. When several syncs are pending, they are added
+// to the Periodic Advertiser List of the controller so a single command syncs with the first advertiser found.
+// The controller never times out a Create Sync command on its own: it is cancelled after
+// PERIODIC_SYNC_CREATE_TIMEOUT and created again after a delay growing up to PERIODIC_SYNC_RETRY_DELAY_MAX.
+// A lost sync is created again until it is stopped by the user.
+// Note: the controller must be scanning (eg: with 'gattlib_adapter_scan_start()') to establish a sync.
+//
+
+#define OCF_LE_PERIODIC_ADV_CREATE_SYNC          0x0044
+#define OCF_LE_PERIODIC_ADV_CREATE_SYNC_CANCEL   0x0045
+#define OCF_LE_PERIODIC_ADV_TERMINATE_SYNC       0x0046
+#define OCF_LE_ADD_DEVICE_TO_PERIODIC_ADV_LIST   0x0047
+#define OCF_LE_CLEAR_PERIODIC_ADV_LIST           0x0049
+#define OCF_LE_READ_PERIODIC_ADV_LIST_SIZE       0x004A
+
+// Options of the Create Sync command
+#define PERIODIC_SYNC_OPTION_USE_LIST            0x01
+
+#define EVT_LE_PERIODIC_ADV_SYNC_ESTABLISHED     0x0E
+#define EVT_LE_PERIODIC_ADV_REPORT               0x0F
+#define EVT_LE_PERIODIC_ADV_SYNC_LOST            0x10
+
+#define PERIODIC_ADV_DATA_COMPLETE               0x00
+#define PERIODIC_ADV_DATA_INCOMPLETE             0x01
+
+// Maximum length of the periodic advertising data
+#define PERIODIC_ADV_DATA_MAX_LEN                1650
+
+// Supervision timeout of the sync (in 10 ms units)
+#define PERIODIC_SYNC_TIMEOUT                    1000
+
+// Time given to the controller to establish a sync before cancelling its creation (in seconds)
+#define PERIODIC_SYNC_CREATE_TIMEOUT             10
+// Delay before creating the syncs again after a failure, doubled on each consecutive failure (in seconds)
+#define PERIODIC_SYNC_RETRY_DELAY_MIN            1
+#define PERIODIC_SYNC_RETRY_DELAY_MAX            32
+
+enum periodic_sync_state {
+	PERIODIC_SYNC_PENDING = 0,  // Waiting for its Create Sync command to be sent
+	PERIODIC_SYNC_CREATING,     // Create Sync command sent
+	PERIODIC_SYNC_ESTABLISHED,
+};
+
+struct gattlib_periodic_sync {
+	bdaddr_t bdaddr;
+	uint8_t  bdaddr_type;
+	uint8_t  sid;
+	char     addr[18];
+
+	enum periodic_sync_state state;
+	uint16_t handle;
+	// Set when the sync has been stopped while its creation was in progress. It is then only referenced
+	// by the list of the syncs being created.
+	bool     cancelled;
+
+	gattlib_periodic_advertisement_cb_t callback;
+	void *user_data;
+
+	// Reassembly of the fragmented advertising data
+	size_t  length;
+	uint8_t data[PERIODIC_ADV_DATA_MAX_LEN];
+};
+
+struct gattlib_periodic_sync_manager {
+	struct gattlib_adapter *adapter;
+
+	int device_desc;
+	GIOChannel *io;
+	GSource *source;
+
+	GSList *syncs;
+	// Syncs of the Create Sync command in progress (only one command at a time)
+	GSList *creating;
+	GSource *create_timeout;
+
+	// Pending until the syncs can be created again after a failure
+	GSource *retry_timeout;
+	guint retry_delay;
+
+	// Size of the Periodic Advertiser List of the controller (0 if it cannot be used)
+	uint8_t advertiser_list_size;
+};
+
+// Serialize the HCI event handler running in the gattlib thread with the user calls
+static GRecMutex g_periodic_sync_mutex;
+
+static int periodic_sync_send_create(struct gattlib_periodic_sync_manager *manager, struct gattlib_periodic_sync *sync, bool use_list) {
+	// | options | SID | address type | address (6) | skip (2) | sync timeout (2) | sync CTE type |
+	uint8_t cparam[14];
+
+	// The SID and the address are ignored by the controller when the Periodic Advertiser List is used
+	cparam[0] = use_list ? PERIODIC_SYNC_OPTION_USE_LIST : 0x00;
+	cparam[1] = sync->sid;
+	cparam[2] = sync->bdaddr_type;
+	memcpy(&cparam[3], &sync->bdaddr, 6);
+	cparam[9] = 0x00;
+	cparam[10] = 0x00;
+	cparam[11] = PERIODIC_SYNC_TIMEOUT & 0xFF;
+	cparam[12] = PERIODIC_SYNC_TIMEOUT >> 8;
+	cparam[13] = 0x00;
+
+	// The command status and the sync established event are received by 'periodic_sync_io_cb()'
+	if (hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_PERIODIC_ADV_CREATE_SYNC, sizeof(cparam), cparam) < 0) {
+		fprintf(stderr, "ERROR: Failed to create periodic advertising sync with %s.\n", sync->addr);
+		return GATTLIB_DEVICE_ERROR;
+	}
+	return GATTLIB_SUCCESS;
+}
+
+/*
+ * Replace the content of the Periodic Advertiser List by the given syncs. The commands are executed by the
+ * controller before the next Create Sync command. A device that could not be added is created again later.
+ */
+static int periodic_sync_set_advertiser_list(struct gattlib_periodic_sync_manager *manager, GSList *syncs) {
+	if (hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_CLEAR_PERIODIC_ADV_LIST, 0, NULL) < 0) {
+		return GATTLIB_DEVICE_ERROR;
+	}
+
+	for (GSList *l = syncs; l != NULL; l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+		// | address type | address (6) | SID |
+		uint8_t cparam[8];
+
+		cparam[0] = sync->bdaddr_type;
+		memcpy(&cparam[1], &sync->bdaddr, 6);
+		cparam[7] = sync->sid;
+
+		if (hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_ADD_DEVICE_TO_PERIODIC_ADV_LIST, sizeof(cparam), cparam) < 0) {
+			return GATTLIB_DEVICE_ERROR;
+		}
+	}
+	return GATTLIB_SUCCESS;
+}
+
+static void periodic_sync_create_next(struct gattlib_periodic_sync_manager *manager);
+
+static gboolean periodic_sync_on_retry_timeout(gpointer user_data) {
+	struct gattlib_periodic_sync_manager *manager = user_data;
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	// The manager might have been released by another thread while this callback was dispatched
+	if (!g_source_is_destroyed(g_main_current_source())) {
+		manager->retry_timeout = NULL;
+		periodic_sync_create_next(manager);
+	}
+
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+	return FALSE;
+}
+
+static void periodic_sync_retry_later(struct gattlib_periodic_sync_manager *manager) {
+	if (manager->retry_timeout != NULL) {
+		return;
+	}
+
+	if (manager->retry_delay == 0) {
+		manager->retry_delay = PERIODIC_SYNC_RETRY_DELAY_MIN;
+	} else {
+		manager->retry_delay = MIN(manager->retry_delay * 2, PERIODIC_SYNC_RETRY_DELAY_MAX);
+	}
+	manager->retry_timeout = gattlib_timeout_add_seconds(manager->retry_delay, periodic_sync_on_retry_timeout, manager);
+}
+
+static gboolean periodic_sync_on_create_timeout(gpointer user_data) {
+	struct gattlib_periodic_sync_manager *manager = user_data;
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	// The manager might have been released by another thread while this callback was dispatched
+	if (!g_source_is_destroyed(g_main_current_source())) {
+		manager->create_timeout = NULL;
+
+		// The end of the creation is reported by a sync established event with the
+		// 'Operation Cancelled by Host' status
+		fprintf(stderr, "Periodic advertising sync not established in %d seconds.\n", PERIODIC_SYNC_CREATE_TIMEOUT);
+		hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_PERIODIC_ADV_CREATE_SYNC_CANCEL, 0, NULL);
+	}
+
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+	return FALSE;
+}
+
+/*
+ * Send the Create Sync command of the pending syncs if no creation is in progress.
+ */
+static void periodic_sync_create_next(struct gattlib_periodic_sync_manager *manager) {
+	GSList *pending = NULL;
+	guint pending_count = 0;
+	int ret;
+
+	if ((manager->creating != NULL) || (manager->retry_timeout != NULL)) {
+		return;
+	}
+
+	for (GSList *l = manager->syncs; l != NULL; l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+
+		if (sync->state == PERIODIC_SYNC_PENDING) {
+			pending = g_slist_append(pending, sync);
+			pending_count++;
+			if (pending_count >= MAX(manager->advertiser_list_size, 1)) {
+				break;
+			}
+		}
+	}
+
+	if (pending == NULL) {
+		return;
+	}
+
+	if (pending_count > 1) {
+		ret = periodic_sync_set_advertiser_list(manager, pending);
+	} else {
+		ret = GATTLIB_SUCCESS;
+	}
+
+	if (ret == GATTLIB_SUCCESS) {
+		ret = periodic_sync_send_create(manager, pending->data, pending_count > 1);
+	}
+
+	if (ret != GATTLIB_SUCCESS) {
+		g_slist_free(pending);
+		periodic_sync_retry_later(manager);
+		return;
+	}
+
+	for (GSList *l = pending; l != NULL; l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+		sync->state = PERIODIC_SYNC_CREATING;
+	}
+	manager->creating = pending;
+	manager->create_timeout = gattlib_timeout_add_seconds(PERIODIC_SYNC_CREATE_TIMEOUT, periodic_sync_on_create_timeout, manager);
+}
+
+static struct gattlib_periodic_sync *periodic_sync_find_by_handle(struct gattlib_periodic_sync_manager *manager, uint16_t handle) {
+	for (GSList *l = manager->syncs; l != NULL; l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+
+		if ((sync->state == PERIODIC_SYNC_ESTABLISHED) && (sync->handle == handle)) {
+			return sync;
+		}
+	}
+	return NULL;
+}
+
+static void periodic_sync_terminate(struct gattlib_periodic_sync_manager *manager, uint16_t handle) {
+	uint8_t cparam[2] = { handle & 0xFF, handle >> 8 };
+
+	hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_PERIODIC_ADV_TERMINATE_SYNC, sizeof(cparam), cparam);
+}
+
+static void periodic_sync_on_established(struct gattlib_periodic_sync_manager *manager, const uint8_t *data, size_t len) {
+	struct gattlib_periodic_sync *established = NULL;
+	bool synced, cancelled_by_user = false;
+	GSList *creating = manager->creating;
+
+	// | status | sync handle (2) | SID | address type | address (6) | PHY | interval (2) | clock accuracy |
+	if ((len < 15) || (creating == NULL)) {
+		return;
+	}
+
+	uint8_t status = data[0];
+	uint16_t handle = data[1] | (data[2] << 8);
+
+	// Find the advertiser the controller has synced with
+	for (GSList *l = creating; (status == 0) && (l != NULL); l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+
+		// Address types 0x02 and 0x03 are the resolved public and random identity addresses
+		if ((sync->sid == data[3]) && (sync->bdaddr_type == (data[4] & 0x01)) && (memcmp(&sync->bdaddr, &data[5], 6) == 0)) {
+			established = sync;
+			break;
+		}
+	}
+
+	synced = (established != NULL) && !established->cancelled;
+
+	manager->creating = NULL;
+	if (manager->create_timeout != NULL) {
+		g_source_destroy(manager->create_timeout);
+		manager->create_timeout = NULL;
+	}
+
+	if ((status == 0) && (established == NULL)) {
+		// Not one of ours anymore
+		periodic_sync_terminate(manager, handle);
+	}
+
+	for (GSList *l = creating; l != NULL; l = l->next) {
+		struct gattlib_periodic_sync *sync = l->data;
+
+		if (sync->cancelled) {
+			// The sync has been stopped by the user while it was being created
+			if (sync == established) {
+				periodic_sync_terminate(manager, handle);
+			}
+			cancelled_by_user = true;
+			free(sync);
+		} else if (sync == established) {
+			sync->state = PERIODIC_SYNC_ESTABLISHED;
+			sync->handle = handle;
+			sync->length = 0;
+		} else {
+			sync->state = PERIODIC_SYNC_PENDING;
+			// Move the sync at the end of the list to give a chance to the other syncs
+			manager->syncs = g_slist_remove(manager->syncs, sync);
+			manager->syncs = g_slist_append(manager->syncs, sync);
+		}
+	}
+	g_slist_free(creating);
+
+	if (synced) {
+		manager->retry_delay = 0;
+		periodic_sync_create_next(manager);
+	} else if (cancelled_by_user) {
+		// The creation of the other syncs has only been interrupted by the user
+		periodic_sync_create_next(manager);
+	} else {
+		// The creation has been rejected by the controller or cancelled on timeout
+		periodic_sync_retry_later(manager);
+	}
+}
+
+static void periodic_sync_on_report(struct gattlib_periodic_sync_manager *manager, const uint8_t *data, size_t len) {
+	// | sync handle (2) | TX power | RSSI | CTE type | data status | data length | data |
+	if ((len < 7) || (len < 7 + (size_t)data[6])) {
+		return;
+	}
+
+	struct gattlib_periodic_sync *sync = periodic_sync_find_by_handle(manager, data[0] | (data[1] << 8));
+	if (sync == NULL) {
+		return;
+	}
+
+	int8_t tx_power = (int8_t)data[2];
+	int8_t rssi = (int8_t)data[3];
+	uint8_t data_status = data[5];
+	uint8_t data_length = data[6];
+	size_t copy_length = MIN(data_length, sizeof(sync->data) - sync->length);
+
+	memcpy(sync->data + sync->length, data + 7, copy_length);
+	sync->length += copy_length;
+
+	if (data_status == PERIODIC_ADV_DATA_INCOMPLETE) {
+		return;
+	}
+
+	// Complete or truncated data. Note: the callback might stop the sync.
+	size_t length = sync->length;
+	sync->length = 0;
+	sync->callback(manager->adapter, sync->addr, sync->sid, rssi, tx_power, sync->data, length, sync->user_data);
+}
+
+static void periodic_sync_on_lost(struct gattlib_periodic_sync_manager *manager, const uint8_t *data, size_t len) {
+	if (len < 2) {
+		return;
+	}
+
+	struct gattlib_periodic_sync *sync = periodic_sync_find_by_handle(manager, data[0] | (data[1] << 8));
+	if (sync == NULL) {
+		return;
+	}
+
+	fprintf(stderr, "Periodic advertising sync lost with %s.\n", sync->addr);
+	sync->state = PERIODIC_SYNC_PENDING;
+	periodic_sync_create_next(manager);
+}
+
+static void periodic_sync_on_event(struct gattlib_periodic_sync_manager *manager, const uint8_t *buffer, size_t len) {
+	const hci_event_hdr *hdr = (const hci_event_hdr*)(buffer + 1);
+	const uint8_t *params = buffer + 1 + HCI_EVENT_HDR_SIZE;
+
+	if ((len < 1 + HCI_EVENT_HDR_SIZE) || (len < 1 + HCI_EVENT_HDR_SIZE + hdr->plen)) {
+		return;
+	}
+	len = hdr->plen;
+
+	if (hdr->evt == EVT_CMD_STATUS) {
+		const evt_cmd_status *cs = (const evt_cmd_status*)params;
+
+		// The Create Sync command has been rejected by the controller
+		if ((len >= EVT_CMD_STATUS_SIZE) && (cs->status != 0) &&
+		    (btohs(cs->opcode) == cmd_opcode_pack(OGF_LE_CTL, OCF_LE_PERIODIC_ADV_CREATE_SYNC)) &&
+		    (manager->creating != NULL)) {
+			uint8_t status[15] = { cs->status };
+			periodic_sync_on_established(manager, status, sizeof(status));
+		}
+	} else if ((hdr->evt == EVT_LE_META_EVENT) && (len >= 1)) {
+		switch (params[0]) {
+		case EVT_LE_PERIODIC_ADV_SYNC_ESTABLISHED:
+			periodic_sync_on_established(manager, params + 1, len - 1);
+			break;
+		case EVT_LE_PERIODIC_ADV_REPORT:
+			periodic_sync_on_report(manager, params + 1, len - 1);
+			break;
+		case EVT_LE_PERIODIC_ADV_SYNC_LOST:
+			periodic_sync_on_lost(manager, params + 1, len - 1);
+			break;
+		}
+	}
+}
+
+static gboolean periodic_sync_io_cb(GIOChannel *io, GIOCondition cond, gpointer user_data) {
+	struct gattlib_periodic_sync_manager *manager = user_data;
+	unsigned char buffer[HCI_MAX_EVENT_SIZE];
+	gboolean ret = TRUE;
+	ssize_t len;
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	// The manager might have been released by another thread while this callback was dispatched
+	if (g_source_is_destroyed(g_main_current_source())) {
+		ret = FALSE;
+		goto EXIT;
+	}
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		fprintf(stderr, "ERROR: Periodic advertising syncs stopped on HCI socket error.\n");
+		ret = FALSE;
+		goto EXIT;
+	}
+
+	len = read(g_io_channel_unix_get_fd(io), buffer, sizeof(buffer));
+	if (len < 0) {
+		if ((errno != EAGAIN) && (errno != EINTR)) {
+			fprintf(stderr, "Read error\n");
+			ret = FALSE;
+		}
+		goto EXIT;
+	}
+
+	periodic_sync_on_event(manager, buffer, len);
+
+EXIT:
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+	return ret;
+}
+
+static uint8_t periodic_sync_read_advertiser_list_size(int device_desc) {
+	// | status | list size |
+	uint8_t rp[2] = { 0 };
+	struct hci_request rq;
+
+	memset(&rq, 0, sizeof(rq));
+	rq.ogf = OGF_LE_CTL;
+	rq.ocf = OCF_LE_READ_PERIODIC_ADV_LIST_SIZE;
+	rq.rparam = rp;
+	rq.rlen = sizeof(rp);
+
+	if ((hci_send_req(device_desc, &rq, 1000) < 0) || (rp[0] != 0)) {
+		return 0;
+	}
+	return rp[1];
+}
+
+static struct gattlib_periodic_sync_manager *periodic_sync_manager_new(struct gattlib_adapter *gattlib_adapter) {
+	struct gattlib_periodic_sync_manager *manager;
+	struct hci_filter filter;
+
+	manager = calloc(1, sizeof(struct gattlib_periodic_sync_manager));
+	if (manager == NULL) {
+		return NULL;
+	}
+	manager->adapter = gattlib_adapter;
+
+	// A dedicated socket ensures the events are not consumed by the commands sent by the scanner
+	manager->device_desc = hci_open_dev(gattlib_adapter->dev_id);
+	if (manager->device_desc < 0) {
+		fprintf(stderr, "ERROR: Could not open device.\n");
+		free(manager);
+		return NULL;
+	}
+
+	// Read before the socket is watched by the gattlib thread as the request waits for its own response
+	manager->advertiser_list_size = periodic_sync_read_advertiser_list_size(manager->device_desc);
+
+	hci_filter_clear(&filter);
+	hci_filter_set_ptype(HCI_EVENT_PKT, &filter);
+	hci_filter_set_event(EVT_LE_META_EVENT, &filter);
+	hci_filter_set_event(EVT_CMD_STATUS, &filter);
+
+	if (setsockopt(manager->device_desc, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0) {
+		fprintf(stderr, "ERROR: Could not set socket options.\n");
+		hci_close_dev(manager->device_desc);
+		free(manager);
+		return NULL;
+	}
+
+	if (gattlib_thread_ref() != GATTLIB_SUCCESS) {
+		hci_close_dev(manager->device_desc);
+		free(manager);
+		return NULL;
+	}
+
+	manager->io = g_io_channel_unix_new(manager->device_desc);
+	manager->source = gattlib_watch_connection_full(manager->io,
+			G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			periodic_sync_io_cb, manager, NULL);
+	// Keep the source alive until the manager is released, even if the watch is removed on error
+	g_source_ref(manager->source);
+
+	return manager;
+}
+
+int gattlib_periodic_sync_start(void *adapter, const char *addr, uint8_t addr_type, uint8_t sid,
+		gattlib_periodic_advertisement_cb_t periodic_advertisement_cb, void *user_data, void **sync_handle)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_periodic_sync *sync;
+	bdaddr_t bdaddr;
+
+	if ((gattlib_adapter == NULL) || (addr == NULL) || (periodic_advertisement_cb == NULL) || (sync_handle == NULL) ||
+	    ((addr_type != BDADDR_LE_PUBLIC) && (addr_type != BDADDR_LE_RANDOM)) || (sid > 0x0F) ||
+	    (str2ba(addr, &bdaddr) != 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (!gattlib_adapter_has_le_feature(gattlib_adapter, LE_FEATURE_PERIODIC_ADV)) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	sync = calloc(1, sizeof(struct gattlib_periodic_sync));
+	if (sync == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	bacpy(&sync->bdaddr, &bdaddr);
+	// HCI address types: 0x00 public, 0x01 random
+	sync->bdaddr_type = (addr_type == BDADDR_LE_PUBLIC) ? 0x00 : 0x01;
+	sync->sid = sid;
+	ba2str(&bdaddr, sync->addr);
+	sync->callback = periodic_advertisement_cb;
+	sync->user_data = user_data;
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	if (gattlib_adapter->periodic_sync_manager == NULL) {
+		gattlib_adapter->periodic_sync_manager = periodic_sync_manager_new(gattlib_adapter);
+		if (gattlib_adapter->periodic_sync_manager == NULL) {
+			g_rec_mutex_unlock(&g_periodic_sync_mutex);
+			free(sync);
+			return GATTLIB_DEVICE_ERROR;
+		}
+	}
+
+	gattlib_adapter->periodic_sync_manager->syncs = g_slist_append(gattlib_adapter->periodic_sync_manager->syncs, sync);
+	periodic_sync_create_next(gattlib_adapter->periodic_sync_manager);
+
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+
+	*sync_handle = sync;
+	return GATTLIB_SUCCESS;
+}
+
+/*
+ * Remove the sync from the manager. Must be called with the mutex held.
+ */
+static void periodic_sync_remove(struct gattlib_periodic_sync_manager *manager, struct gattlib_periodic_sync *sync) {
+	manager->syncs = g_slist_remove(manager->syncs, sync);
+
+	if (sync->state == PERIODIC_SYNC_CREATING) {
+		// The sync is released when the controller reports the end of its creation. The creation of the
+		// other syncs of the Periodic Advertiser List is cancelled too and started again at that time.
+		sync->cancelled = true;
+		hci_send_cmd(manager->device_desc, OGF_LE_CTL, OCF_LE_PERIODIC_ADV_CREATE_SYNC_CANCEL, 0, NULL);
+		return;
+	}
+
+	if (sync->state == PERIODIC_SYNC_ESTABLISHED) {
+		periodic_sync_terminate(manager, sync->handle);
+	}
+	free(sync);
+}
+
+int gattlib_periodic_sync_stop(void *adapter, void *sync_handle) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_periodic_sync_manager *manager;
+	int ret = GATTLIB_SUCCESS;
+
+	if ((gattlib_adapter == NULL) || (sync_handle == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	manager = gattlib_adapter->periodic_sync_manager;
+	if ((manager == NULL) || (g_slist_find(manager->syncs, sync_handle) == NULL)) {
+		ret = GATTLIB_NOT_FOUND;
+	} else {
+		periodic_sync_remove(manager, sync_handle);
+	}
+
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+	return ret;
+}
+
+void gattlib_periodic_sync_stop_all(struct gattlib_adapter *gattlib_adapter) {
+	struct gattlib_periodic_sync_manager *manager = gattlib_adapter->periodic_sync_manager;
+
+	if (manager == NULL) {
+		return;
+	}
+
+	g_rec_mutex_lock(&g_periodic_sync_mutex);
+
+	while (manager->syncs != NULL) {
+		periodic_sync_remove(manager, manager->syncs->data);
+	}
+	// No event will be received anymore for the syncs being cancelled
+	g_slist_free_full(manager->creating, free);
+	manager->creating = NULL;
+
+	if (manager->create_timeout != NULL) {
+		g_source_destroy(manager->create_timeout);
+	}
+	if (manager->retry_timeout != NULL) {
+		g_source_destroy(manager->retry_timeout);
+	}
+	g_source_destroy(manager->source);
+	gattlib_adapter->periodic_sync_manager = NULL;
+
+	g_rec_mutex_unlock(&g_periodic_sync_mutex);
+
+	g_source_unref(manager->source);
+	g_io_channel_unref(manager->io);
+	gattlib_thread_unref();
+
+	hci_close_dev(manager->device_desc);
+	free(manager);
+}
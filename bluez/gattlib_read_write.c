@@ -35,6 +35,14 @@ struct gattlib_result_read_uuid_t {
 	size_t*        buffer_len;
 	gatt_read_cb_t callback;
 	int            completed;
+	// ATT status of the response
+	guint8         status;
+};
+
+struct gattlib_result_write_t {
+	int            completed;
+	// ATT status of the response
+	guint8         status;
 };
 
 static void gattlib_result_read_uuid_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
@@ -42,6 +50,8 @@ static void gattlib_result_read_uuid_cb(guint8 status, const guint8 *pdu, guint1
 	struct att_data_list *list;
 	int i;
 
+	gattlib_result->status = status;
+
 	if (status == ATT_ECODE_ATTR_NOT_FOUND) {
 		goto done;
 	}
@@ -110,15 +120,25 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid,
 	bt_uuid_t bt_uuid;
 	const int start = 0x0001;
 	const int end   = 0xffff;
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_READ, connection, NULL, 0, uuid, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_READ].issued);
 
 	gattlib_result = malloc(sizeof(struct gattlib_result_read_uuid_t));
 	if (gattlib_result == NULL) {
+		gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_READ, GATTLIB_OUT_OF_MEMORY);
+		if (traced) {
+			gattlib_trace_end(&trace, GATTLIB_OUT_OF_MEMORY, 0);
+		}
 		return GATTLIB_OUT_OF_MEMORY;
 	}
 	gattlib_result->buffer         = buffer;
 	gattlib_result->buffer_len     = buffer_len;
 	gattlib_result->callback       = NULL;
 	gattlib_result->completed      = FALSE;
+	gattlib_result->status         = 0;
 
 	uuid_to_bt_uuid(uuid, &bt_uuid);
 
@@ -130,8 +150,23 @@ int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid,
 		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
 	}
 
+	// The statistics, the trace hooks and the caller get the same result
+	if (gattlib_result->status == 0) {
+		ret = GATTLIB_SUCCESS;
+		GATTLIB_STATS_ADD(connection->stats.bytes_read, *buffer_len);
+	} else if (gattlib_result->status == ATT_ECODE_ATTR_NOT_FOUND) {
+		ret = GATTLIB_NOT_FOUND;
+	} else {
+		ret = GATTLIB_ERROR_BLUEZ;
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_READ, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? *buffer_len : 0);
+	}
+
 	free(gattlib_result);
-	return GATTLIB_SUCCESS;
+	return ret;
 }
 
 int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid,
@@ -165,28 +200,66 @@ int gattlib_read_char_by_uuid_async(gatt_connection_t* connection, uuid_t* uuid,
 }
 
 void gattlib_write_result_cb(guint8 status, const guint8 *pdu, guint16 len, gpointer user_data) {
-	int* write_completed = user_data;
+	struct gattlib_result_write_t* write_result = user_data;
 
-	*write_completed = TRUE;
+	write_result->status    = status;
+	write_result->completed = TRUE;
 }
 
-int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len) {
+/*
+ * Write the handle and wait for the response. 'write_status' is set to the ATT status of the response.
+ */
+int write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len,
+		guint8 *write_status) {
 	gattlib_context_t* conn_context = connection->context;
-	int write_completed = FALSE;
+	struct gattlib_result_write_t write_result = { .completed = FALSE, .status = 0 };
 
 	guint ret = gatt_write_char(conn_context->attrib, handle, (void*)buffer, buffer_len,
-				    gattlib_write_result_cb, &write_completed);
+				    gattlib_write_result_cb, &write_result);
 	if (ret == 0) {
 		return 1;
 	}
 
 	// Wait for completion of the event
-	while(write_completed == FALSE) {
+	while(write_result.completed == FALSE) {
 		g_main_context_iteration(g_gattlib_thread.loop_context, FALSE);
 	}
+	*write_status = write_result.status;
 	return 0;
 }
 
+// Result of 'write_char_by_handle()' as a GATTLIB_* code
+static int write_result(int ret, guint8 write_status) {
+	if (ret != 0) {
+		return GATTLIB_ERROR_INTERNAL;
+	} else if (write_status != 0) {
+		return GATTLIB_ERROR_BLUEZ;
+	} else {
+		return GATTLIB_SUCCESS;
+	}
+}
+
+int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE, connection, NULL, handle, NULL, buffer_len);
+	guint8 write_status = 0;
+	int ret, result;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_WRITE].issued);
+
+	ret = write_char_by_handle(connection, handle, buffer, buffer_len, &write_status);
+	result = write_result(ret, write_status);
+	if (result == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_written, buffer_len);
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_WRITE, result);
+
+	if (traced) {
+		gattlib_trace_end(&trace, result, (result == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
+	return result;
+}
+
 int gattlib_write_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len) {
 	uint16_t handle = 0;
 	int ret;
@@ -212,28 +285,99 @@ int gattlib_write_without_response_char_by_handle(gatt_connection_t* connection,
 	return GATTLIB_NOT_SUPPORTED;
 }
 
+int gattlib_write_char_by_uuid_stream_open(gatt_connection_t* connection, uuid_t* uuid, gatt_stream_t **stream, uint16_t *mtu)
+{
+	// Only supported in the DBUS API (ie: Bluez >= v5.48) at the moment
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_write_char_stream_write(gatt_stream_t *stream, const void *buffer, size_t buffer_len)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_write_char_stream_close(gatt_stream_t *stream)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+/*
+ * Return the handle of the Client Characteristic Configuration Descriptor of the characteristic value.
+ * Without the GATT database, the descriptor is assumed to follow the value.
+ */
+static int get_cccd_handle(gatt_connection_t* connection, uint16_t value_handle, uint16_t* cccd_handle) {
+	int ret;
+
+	if (gattlib_gatt_db_lookup_cccd(connection, value_handle, cccd_handle, &ret)) {
+		return ret;
+	}
+
+	*cccd_handle = value_handle + 1;
+	return GATTLIB_SUCCESS;
+}
+
 int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid) {
-	uint16_t handle;
+	uint16_t handle, cccd_handle;
 	uint16_t enable_notification = 0x0001;
+	guint8 write_status = 0;
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_NOTIFICATION_START, connection, NULL, 0, uuid, 0);
+	int result;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_NOTIFICATION_START].issued);
 
 	int ret = get_handle_from_uuid(connection, uuid, &handle);
+	if (ret == GATTLIB_SUCCESS) {
+		ret = get_cccd_handle(connection, handle, &cccd_handle);
+	}
 	if (ret) {
-		return -1;
+		gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_START, ret);
+		if (traced) {
+			gattlib_trace_end(&trace, ret, 0);
+		}
+		return ret;
 	}
 
 	// Enable Status Notification
-	return gattlib_write_char_by_handle(connection, handle + 1, &enable_notification, sizeof(enable_notification));
+	ret = write_char_by_handle(connection, cccd_handle, &enable_notification, sizeof(enable_notification), &write_status);
+	result = write_result(ret, write_status);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_START, result);
+
+	if (traced) {
+		gattlib_trace_end(&trace, result, 0);
+	}
+	return result;
 }
 
 int gattlib_notification_stop(gatt_connection_t* connection, const uuid_t* uuid) {
-	uint16_t handle;
+	uint16_t handle, cccd_handle;
 	uint16_t enable_notification = 0x0000;
+	guint8 write_status = 0;
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_NOTIFICATION_STOP, connection, NULL, 0, uuid, 0);
+	int result;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_NOTIFICATION_STOP].issued);
 
 	int ret = get_handle_from_uuid(connection, uuid, &handle);
+	if (ret == GATTLIB_SUCCESS) {
+		ret = get_cccd_handle(connection, handle, &cccd_handle);
+	}
 	if (ret) {
-		return -1;
+		gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_STOP, ret);
+		if (traced) {
+			gattlib_trace_end(&trace, ret, 0);
+		}
+		return ret;
 	}
 
 	// Enable Status Notification
-	return gattlib_write_char_by_handle(connection, handle + 1, &enable_notification, sizeof(enable_notification));
+	ret = write_char_by_handle(connection, cccd_handle, &enable_notification, sizeof(enable_notification), &write_status);
+	result = write_result(ret, write_status);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_STOP, result);
+
+	if (traced) {
+		gattlib_trace_end(&trace, result, 0);
+	}
+	return result;
 }
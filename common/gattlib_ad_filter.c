@@ -0,0 +1,259 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Manufacturer data and service data filters evaluated by the scanners before calling the user callback.
+// Service UUIDs are compared in their 128-bit form (big endian) so 16-bit and 32-bit UUIDs match their
+// 128-bit representation as reported by Bluez.
+//
+// The filters can be replaced while a scan evaluates them from its own thread: the new entries are published
+// under the mutex and the previous ones are released once no evaluation uses them anymore.
+//
+
+#define AD_TYPE_SERVICE_DATA_16BIT_UUID   0x16
+#define AD_TYPE_SERVICE_DATA_32BIT_UUID   0x20
+#define AD_TYPE_SERVICE_DATA_128BIT_UUID  0x21
+#define AD_TYPE_MANUFACTURER_DATA         0xFF
+
+// Bluetooth Base UUID: 00000000-0000-1000-8000-00805F9B34FB
+static const uint8_t m_bluetooth_base_uuid[16] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+	0x80, 0x00, 0x00, 0x80, 0x5F, 0x9B, 0x34, 0xFB
+};
+
+// Protect the entries of the filters of all the adapters
+static GMutex m_ad_filters_mutex;
+
+void gattlib_uuid_to_uuid128(const uuid_t *uuid, uint8_t uuid128[16]) {
+	memcpy(uuid128, m_bluetooth_base_uuid, 16);
+
+	if (uuid->type == SDP_UUID16) {
+		uuid128[2] = uuid->value.uuid16 >> 8;
+		uuid128[3] = uuid->value.uuid16 & 0xFF;
+	} else if (uuid->type == SDP_UUID32) {
+		uuid128[0] = uuid->value.uuid32 >> 24;
+		uuid128[1] = (uuid->value.uuid32 >> 16) & 0xFF;
+		uuid128[2] = (uuid->value.uuid32 >> 8) & 0xFF;
+		uuid128[3] = uuid->value.uuid32 & 0xFF;
+	} else if (uuid->type == SDP_UUID128) {
+		memcpy(uuid128, &uuid->value.uuid128, 16);
+	}
+}
+
+int gattlib_ad_filters_set(struct gattlib_ad_filters *ad_filters, const gattlib_ad_filter_t *filters, size_t filter_count) {
+	struct gattlib_ad_filter_entry *entries = NULL, *previous_entries;
+
+	for (size_t i = 0; i < filter_count; i++) {
+		if (((filters[i].type != GATTLIB_AD_FILTER_MANUFACTURER_DATA) && (filters[i].type != GATTLIB_AD_FILTER_SERVICE_DATA)) ||
+		    (filters[i].data_length > GATTLIB_AD_FILTER_MAX_LEN)) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+	}
+
+	if (filter_count > 0) {
+		entries = calloc(filter_count, sizeof(struct gattlib_ad_filter_entry));
+		if (entries == NULL) {
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+
+		for (size_t i = 0; i < filter_count; i++) {
+			entries[i].filter = filters[i];
+			if (filters[i].type == GATTLIB_AD_FILTER_SERVICE_DATA) {
+				gattlib_uuid_to_uuid128(&filters[i].service_uuid, entries[i].uuid128);
+			}
+		}
+	}
+
+	g_mutex_lock(&m_ad_filters_mutex);
+	previous_entries = ad_filters->entries;
+	ad_filters->entries = entries;
+	ad_filters->count = filter_count;
+	g_mutex_unlock(&m_ad_filters_mutex);
+
+	free(previous_entries);
+	return GATTLIB_SUCCESS;
+}
+
+void gattlib_ad_filters_clear(struct gattlib_ad_filters *ad_filters) {
+	gattlib_ad_filters_set(ad_filters, NULL, 0);
+}
+
+bool gattlib_ad_filters_is_empty(const struct gattlib_ad_filters *ad_filters) {
+	bool empty;
+
+	g_mutex_lock(&m_ad_filters_mutex);
+	empty = (ad_filters->count == 0);
+	g_mutex_unlock(&m_ad_filters_mutex);
+
+	return empty;
+}
+
+static bool ad_filter_match_data(const gattlib_ad_filter_t *filter, const uint8_t *data, size_t data_length) {
+	if (data_length < filter->data_length) {
+		return false;
+	}
+
+	if (filter->flags & GATTLIB_AD_FILTER_FLAG_USE_MASK) {
+		for (size_t i = 0; i < filter->data_length; i++) {
+			if ((data[i] & filter->mask[i]) != (filter->data[i] & filter->mask[i])) {
+				return false;
+			}
+		}
+		return true;
+	} else {
+		return memcmp(data, filter->data, filter->data_length) == 0;
+	}
+}
+
+static bool ad_filters_match_manufacturer_data_locked(const struct gattlib_ad_filters *ad_filters,
+		uint16_t company_id, const uint8_t *data, size_t data_length)
+{
+	for (size_t i = 0; i < ad_filters->count; i++) {
+		const gattlib_ad_filter_t *filter = &ad_filters->entries[i].filter;
+
+		if ((filter->type == GATTLIB_AD_FILTER_MANUFACTURER_DATA) && (filter->company_id == company_id) &&
+		    ad_filter_match_data(filter, data, data_length)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ad_filters_match_service_data_locked(const struct gattlib_ad_filters *ad_filters,
+		const uint8_t uuid128[16], const uint8_t *data, size_t data_length)
+{
+	for (size_t i = 0; i < ad_filters->count; i++) {
+		const struct gattlib_ad_filter_entry *entry = &ad_filters->entries[i];
+
+		if ((entry->filter.type == GATTLIB_AD_FILTER_SERVICE_DATA) && (memcmp(entry->uuid128, uuid128, 16) == 0) &&
+		    ad_filter_match_data(&entry->filter, data, data_length)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool gattlib_ad_filters_match_manufacturer_data(const struct gattlib_ad_filters *ad_filters,
+		uint16_t company_id, const uint8_t *data, size_t data_length)
+{
+	bool match;
+
+	g_mutex_lock(&m_ad_filters_mutex);
+	match = ad_filters_match_manufacturer_data_locked(ad_filters, company_id, data, data_length);
+	g_mutex_unlock(&m_ad_filters_mutex);
+
+	return match;
+}
+
+bool gattlib_ad_filters_match_service_data(const struct gattlib_ad_filters *ad_filters,
+		const uint8_t uuid128[16], const uint8_t *data, size_t data_length)
+{
+	bool match;
+
+	g_mutex_lock(&m_ad_filters_mutex);
+	match = ad_filters_match_service_data_locked(ad_filters, uuid128, data, data_length);
+	g_mutex_unlock(&m_ad_filters_mutex);
+
+	return match;
+}
+
+static bool ad_filters_match_raw_locked(const struct gattlib_ad_filters *ad_filters, const uint8_t *ad_data, size_t ad_data_length) {
+	size_t offset = 0;
+
+	if (ad_filters->count == 0) {
+		return true;
+	}
+
+	// Walk the AD structures: | length | type | data (length - 1 bytes) |
+	while (offset + 1 < ad_data_length) {
+		uint8_t field_len = ad_data[offset];
+		const uint8_t *field = &ad_data[offset + 2];
+		uint8_t uuid128[16];
+
+		if ((field_len == 0) || (offset + 1 + field_len > ad_data_length)) {
+			break;
+		}
+
+		size_t data_len = field_len - 1;
+
+		switch (ad_data[offset + 1]) {
+		case AD_TYPE_MANUFACTURER_DATA:
+			if ((data_len >= 2) &&
+			    ad_filters_match_manufacturer_data_locked(ad_filters, field[0] | (field[1] << 8), field + 2, data_len - 2)) {
+				return true;
+			}
+			break;
+		case AD_TYPE_SERVICE_DATA_16BIT_UUID:
+			if (data_len >= 2) {
+				memcpy(uuid128, m_bluetooth_base_uuid, 16);
+				uuid128[2] = field[1];
+				uuid128[3] = field[0];
+				if (ad_filters_match_service_data_locked(ad_filters, uuid128, field + 2, data_len - 2)) {
+					return true;
+				}
+			}
+			break;
+		case AD_TYPE_SERVICE_DATA_32BIT_UUID:
+			if (data_len >= 4) {
+				memcpy(uuid128, m_bluetooth_base_uuid, 16);
+				for (int i = 0; i < 4; i++) {
+					uuid128[i] = field[3 - i];
+				}
+				if (ad_filters_match_service_data_locked(ad_filters, uuid128, field + 4, data_len - 4)) {
+					return true;
+				}
+			}
+			break;
+		case AD_TYPE_SERVICE_DATA_128BIT_UUID:
+			if (data_len >= 16) {
+				// UUIDs are little endian in the advertisement data
+				for (int i = 0; i < 16; i++) {
+					uuid128[i] = field[15 - i];
+				}
+				if (ad_filters_match_service_data_locked(ad_filters, uuid128, field + 16, data_len - 16)) {
+					return true;
+				}
+			}
+			break;
+		}
+
+		offset += field_len + 1;
+	}
+
+	return false;
+}
+
+bool gattlib_ad_filters_match_raw(const struct gattlib_ad_filters *ad_filters, const uint8_t *ad_data, size_t ad_data_length) {
+	bool match;
+
+	g_mutex_lock(&m_ad_filters_mutex);
+	match = ad_filters_match_raw_locked(ad_filters, ad_data, ad_data_length);
+	g_mutex_unlock(&m_ad_filters_mutex);
+
+	return match;
+}
@@ -0,0 +1,640 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Queryable GATT database of a connection.
+//
+// The database is built once from the GATT tree returned by 'gattlib_discover_all()'. The tree is already
+// sorted by handle so the attributes are flattened in handle order and looked up by binary search. The
+// characteristics are additionally indexed by their 128-bit UUID.
+//
+// When the device reports a change of its database, the backend either provides the rediscovered range or
+// the attributes of the affected range are dropped straight away and the range is only rediscovered on the
+// next 'gattlib_gatt_db_get()'.
+//
+// A database is never modified once published to the connection: a change builds a new database that replaces
+// it under 'm_gatt_db_mutex'. Each database returned by 'gattlib_gatt_db_get()' holds a reference of the
+// application so the pointers already returned (database, characteristics, descriptors) stay valid while the
+// device changes its database from the gattlib thread. A replaced database is released as soon as the
+// application has released all its references, the ones never released are released with the connection.
+//
+
+#define GATT_DB_CCCD_UUID16    0x2902
+
+struct gatt_db_uuid_entry {
+	uint8_t uuid128[16];
+	const gattlib_gatt_tree_characteristic_t *characteristic;
+};
+
+struct gattlib_gatt_db {
+	gattlib_gatt_tree_t *tree;
+
+	// All the attributes sorted by handle
+	gattlib_gatt_db_attribute_t *attributes;
+	size_t attributes_count;
+
+	// Characteristics sorted by UUID, then by handle
+	struct gatt_db_uuid_entry *uuids;
+	size_t uuids_count;
+
+	// Range of handles changed by the device and not rediscovered yet (protected by 'm_gatt_db_mutex')
+	bool stale;
+	uint16_t stale_start;
+	uint16_t stale_end;
+	// Number of changes reported by the device since the connection
+	unsigned int changes;
+
+	// References returned by 'gattlib_gatt_db_get()' and not released yet (protected by 'm_gatt_db_mutex')
+	unsigned int refs;
+
+	// Replaced databases still referenced by the application (only set on the database of the connection)
+	struct gattlib_gatt_db *previous;
+};
+
+// Protect the publication of the databases and their stale range
+static GMutex m_gatt_db_mutex;
+
+static int gatt_db_uuid_entry_cmp(const void *a, const void *b) {
+	const struct gatt_db_uuid_entry *entry_a = a, *entry_b = b;
+	int ret;
+
+	ret = memcmp(entry_a->uuid128, entry_b->uuid128, sizeof(entry_a->uuid128));
+	if (ret != 0) {
+		return ret;
+	}
+	return (int)entry_a->characteristic->characteristic.handle - (int)entry_b->characteristic->characteristic.handle;
+}
+
+/*
+ * Return the index of the first attribute whose handle is greater or equal to 'handle'
+ */
+static size_t gatt_db_lower_bound(const struct gattlib_gatt_db *db, uint16_t handle) {
+	size_t low = 0, high = db->attributes_count;
+
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+
+		if (db->attributes[middle].handle < handle) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+/*
+ * Set the tree of a new database and build its indexes. The database takes the ownership of the tree.
+ */
+static int gatt_db_index(struct gattlib_gatt_db *db, gattlib_gatt_tree_t *tree) {
+	gattlib_gatt_db_attribute_t *attributes;
+	struct gatt_db_uuid_entry *uuids;
+	size_t attributes_count = 0, characteristics_count = 0;
+	size_t a = 0, u = 0;
+
+	for (size_t s = 0; s < tree->services_count; s++) {
+		const gattlib_gatt_tree_service_t *service = &tree->services[s];
+
+		attributes_count++;
+		characteristics_count += service->characteristics_count;
+		for (size_t c = 0; c < service->characteristics_count; c++) {
+			attributes_count += 1 + service->characteristics[c].descriptors_count;
+		}
+	}
+
+	attributes = malloc(attributes_count * sizeof(gattlib_gatt_db_attribute_t));
+	uuids = malloc(characteristics_count * sizeof(struct gatt_db_uuid_entry));
+	if (((attributes == NULL) && (attributes_count > 0)) || ((uuids == NULL) && (characteristics_count > 0))) {
+		free(attributes);
+		free(uuids);
+		free(tree);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	// The services, their characteristics and their descriptors are sorted by handle in the tree
+	for (size_t s = 0; s < tree->services_count; s++) {
+		const gattlib_gatt_tree_service_t *service = &tree->services[s];
+
+		attributes[a++] = (gattlib_gatt_db_attribute_t) {
+			.type = GATTLIB_GATT_DB_ATTRIBUTE_SERVICE,
+			.handle = service->service.attr_handle_start,
+			.service = service,
+		};
+
+		for (size_t c = 0; c < service->characteristics_count; c++) {
+			const gattlib_gatt_tree_characteristic_t *characteristic = &service->characteristics[c];
+
+			attributes[a++] = (gattlib_gatt_db_attribute_t) {
+				.type = GATTLIB_GATT_DB_ATTRIBUTE_CHARACTERISTIC,
+				.handle = characteristic->characteristic.handle,
+				.service = service,
+				.characteristic = characteristic,
+			};
+
+			uuids[u].characteristic = characteristic;
+			gattlib_uuid_to_uuid128(&characteristic->characteristic.uuid, uuids[u].uuid128);
+			u++;
+
+			for (size_t d = 0; d < characteristic->descriptors_count; d++) {
+				attributes[a++] = (gattlib_gatt_db_attribute_t) {
+					.type = GATTLIB_GATT_DB_ATTRIBUTE_DESCRIPTOR,
+					.handle = characteristic->descriptors[d].handle,
+					.service = service,
+					.characteristic = characteristic,
+					.descriptor = &characteristic->descriptors[d],
+				};
+			}
+		}
+	}
+
+	qsort(uuids, u, sizeof(struct gatt_db_uuid_entry), gatt_db_uuid_entry_cmp);
+
+	db->tree = tree;
+	db->attributes = attributes;
+	db->attributes_count = a;
+	db->uuids = uuids;
+	db->uuids_count = u;
+	return GATTLIB_SUCCESS;
+}
+
+/*
+ * Append the attributes of the tree that are (or are not) in the range of handles to the flat lists
+ */
+static void gatt_db_flatten(const gattlib_gatt_tree_t *tree, uint16_t start, uint16_t end, bool in_range,
+		GArray *services, GArray *characteristics, GArray *descriptors)
+{
+	for (size_t s = 0; s < tree->services_count; s++) {
+		const gattlib_gatt_tree_service_t *service = &tree->services[s];
+		uint16_t handle = service->service.attr_handle_start;
+
+		if (((handle >= start) && (handle <= end)) == in_range) {
+			gattlib_gatt_tree_service_t flat_service = *service;
+
+			flat_service.characteristics = NULL;
+			flat_service.characteristics_count = 0;
+			g_array_append_val(services, flat_service);
+		}
+
+		for (size_t c = 0; c < service->characteristics_count; c++) {
+			const gattlib_gatt_tree_characteristic_t *characteristic = &service->characteristics[c];
+
+			handle = characteristic->characteristic.handle;
+			if (((handle >= start) && (handle <= end)) == in_range) {
+				g_array_append_val(characteristics, characteristic->characteristic);
+			}
+
+			for (size_t d = 0; d < characteristic->descriptors_count; d++) {
+				handle = characteristic->descriptors[d].handle;
+				if (((handle >= start) && (handle <= end)) == in_range) {
+					g_array_append_val(descriptors, characteristic->descriptors[d]);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Return a new database with the attributes of the range of handles replaced by the ones of 'range_tree'
+ * (removed if NULL). The stale range is inherited from 'db'.
+ */
+static struct gattlib_gatt_db *gatt_db_replace_range(const struct gattlib_gatt_db *db, uint16_t start, uint16_t end,
+		const gattlib_gatt_tree_t *range_tree)
+{
+	struct gattlib_gatt_db *new_db;
+	GArray *services, *characteristics, *descriptors;
+	gattlib_gatt_tree_t *tree;
+
+	services = g_array_new(FALSE, TRUE, sizeof(gattlib_gatt_tree_service_t));
+	characteristics = g_array_new(FALSE, TRUE, sizeof(gattlib_characteristic_t));
+	descriptors = g_array_new(FALSE, TRUE, sizeof(gattlib_descriptor_t));
+
+	gatt_db_flatten(db->tree, start, end, false, services, characteristics, descriptors);
+	if (range_tree != NULL) {
+		gatt_db_flatten(range_tree, start, end, true, services, characteristics, descriptors);
+	}
+
+	tree = gattlib_gatt_tree_new((gattlib_gatt_tree_service_t*)services->data, services->len,
+			(gattlib_characteristic_t*)characteristics->data, characteristics->len,
+			(gattlib_descriptor_t*)descriptors->data, descriptors->len);
+
+	g_array_free(services, TRUE);
+	g_array_free(characteristics, TRUE);
+	g_array_free(descriptors, TRUE);
+
+	new_db = gattlib_gatt_db_new(tree);
+	if (new_db == NULL) {
+		return NULL;
+	}
+
+	new_db->stale = db->stale;
+	new_db->stale_start = db->stale_start;
+	new_db->stale_end = db->stale_end;
+	new_db->changes = db->changes;
+	return new_db;
+}
+
+static void gatt_db_destroy(struct gattlib_gatt_db *db) {
+	free(db->attributes);
+	free(db->uuids);
+	free(db->tree);
+	free(db);
+}
+
+/*
+ * Replace the database of the connection. Must be called with 'm_gatt_db_mutex' held.
+ */
+static void gatt_db_publish_locked(gatt_connection_t* connection, struct gattlib_gatt_db *db) {
+	struct gattlib_gatt_db *replaced = connection->gatt_db;
+
+	if (replaced != NULL) {
+		// The new database keeps the list of the replaced databases still referenced
+		db->previous = replaced->previous;
+		replaced->previous = NULL;
+
+		if (replaced->refs > 0) {
+			replaced->previous = db->previous;
+			db->previous = replaced;
+		} else {
+			gatt_db_destroy(replaced);
+		}
+	}
+	connection->gatt_db = db;
+}
+
+struct gattlib_gatt_db *gattlib_gatt_db_new(gattlib_gatt_tree_t *tree) {
+	struct gattlib_gatt_db *db;
+
+	db = calloc(1, sizeof(struct gattlib_gatt_db));
+	if (db == NULL) {
+		free(tree);
+		return NULL;
+	}
+
+	// The tree is released by 'gatt_db_index()' on failure
+	if (gatt_db_index(db, tree) != GATTLIB_SUCCESS) {
+		free(db);
+		return NULL;
+	}
+	return db;
+}
+
+void gattlib_gatt_db_free(struct gattlib_gatt_db *db) {
+	// Release the database and the replaced ones the application still references
+	while (db != NULL) {
+		struct gattlib_gatt_db *previous = db->previous;
+
+		gatt_db_destroy(db);
+		db = previous;
+	}
+}
+
+int gattlib_gatt_db_get(gatt_connection_t* connection, const gattlib_gatt_db_t** db) {
+	struct gattlib_gatt_db *current, *new_db;
+	gattlib_gatt_tree_t *tree;
+	uint16_t stale_start = 0, stale_end = 0;
+	unsigned int changes = 0;
+	int ret;
+
+	if ((connection == NULL) || (db == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The lock is not held during the discovery as the device might report a change meanwhile
+	while (true) {
+		g_mutex_lock(&m_gatt_db_mutex);
+		current = connection->gatt_db;
+		if ((current != NULL) && !current->stale) {
+			current->refs++;
+			*db = current;
+			g_mutex_unlock(&m_gatt_db_mutex);
+			return GATTLIB_SUCCESS;
+		}
+		if (current != NULL) {
+			stale_start = current->stale_start;
+			stale_end = current->stale_end;
+			changes = current->changes;
+		}
+		g_mutex_unlock(&m_gatt_db_mutex);
+
+		// The database is discovered once and kept for the lifetime of the connection
+		if (current == NULL) {
+			ret = gattlib_discover_all(connection, &tree);
+			if (ret != GATTLIB_SUCCESS) {
+				return ret;
+			}
+
+			new_db = gattlib_gatt_db_new(tree);
+			if (new_db == NULL) {
+				return GATTLIB_OUT_OF_MEMORY;
+			}
+
+			g_mutex_lock(&m_gatt_db_mutex);
+			if (connection->gatt_db == NULL) {
+				gatt_db_publish_locked(connection, new_db);
+				new_db = NULL;
+			}
+			connection->gatt_db->refs++;
+			*db = connection->gatt_db;
+			g_mutex_unlock(&m_gatt_db_mutex);
+
+			// Another thread has published the database first
+			gattlib_gatt_db_free(new_db);
+			return GATTLIB_SUCCESS;
+		}
+
+		// Only rediscover the range changed by the device
+		ret = gattlib_discover_range(connection, stale_start, stale_end, &tree);
+		if (ret != GATTLIB_SUCCESS) {
+			return ret;
+		}
+
+		g_mutex_lock(&m_gatt_db_mutex);
+		current = connection->gatt_db;
+		if (current->changes != changes) {
+			// The device has reported another change during the discovery. Discover the merged range.
+			g_mutex_unlock(&m_gatt_db_mutex);
+			free(tree);
+			continue;
+		}
+
+		new_db = gatt_db_replace_range(current, stale_start, stale_end, tree);
+		free(tree);
+		if (new_db == NULL) {
+			g_mutex_unlock(&m_gatt_db_mutex);
+			return GATTLIB_OUT_OF_MEMORY;
+		}
+
+		new_db->stale = false;
+		gatt_db_publish_locked(connection, new_db);
+		new_db->refs++;
+		*db = new_db;
+		g_mutex_unlock(&m_gatt_db_mutex);
+		return GATTLIB_SUCCESS;
+	}
+}
+
+void gattlib_gatt_db_release(gatt_connection_t* connection, const gattlib_gatt_db_t* db) {
+	struct gattlib_gatt_db **previous;
+
+	if ((connection == NULL) || (db == NULL)) {
+		return;
+	}
+
+	g_mutex_lock(&m_gatt_db_mutex);
+	for (previous = &connection->gatt_db; *previous != NULL; previous = &(*previous)->previous) {
+		struct gattlib_gatt_db *entry = *previous;
+
+		if (entry != db) {
+			continue;
+		}
+
+		if (entry->refs > 0) {
+			entry->refs--;
+		}
+		// The database of the connection is kept for the next calls
+		if ((entry->refs == 0) && (entry != connection->gatt_db)) {
+			*previous = entry->previous;
+			gatt_db_destroy(entry);
+		}
+		break;
+	}
+	g_mutex_unlock(&m_gatt_db_mutex);
+}
+
+void gattlib_gatt_db_service_changed(gatt_connection_t* connection, uint16_t start, uint16_t end,
+		const gattlib_gatt_tree_t *range_tree)
+{
+	struct gattlib_gatt_db *db, *new_db;
+
+	g_mutex_lock(&m_gatt_db_mutex);
+	db = connection->gatt_db;
+	if (db != NULL) {
+		// Without the new attributes, drop the ones of the range so the lookups do not return stale handles
+		// until it is rediscovered
+		new_db = gatt_db_replace_range(db, start, end, range_tree);
+		if (new_db != NULL) {
+			gatt_db_publish_locked(connection, new_db);
+			db = new_db;
+		} else {
+			fprintf(stderr, "Failed to update the changed attributes of the GATT database.\n");
+		}
+
+		if ((range_tree != NULL) && (new_db != NULL)) {
+			// Up to date
+		} else if (db->stale) {
+			db->stale_start = MIN(db->stale_start, start);
+			db->stale_end = MAX(db->stale_end, end);
+		} else {
+			db->stale = true;
+			db->stale_start = start;
+			db->stale_end = end;
+		}
+		// A discovery started before this change by 'gattlib_gatt_db_get()' is out of date
+		db->changes++;
+	}
+	g_mutex_unlock(&m_gatt_db_mutex);
+
+	if (connection->service_changed_handler != NULL) {
+		connection->service_changed_handler(connection, start, end, connection->service_changed_user_data);
+	}
+}
+
+bool gattlib_gatt_db_lookup_uuid(gatt_connection_t* connection, uint16_t value_handle, uuid_t* uuid, int* ret) {
+	const gattlib_gatt_tree_characteristic_t *characteristic;
+	const struct gattlib_gatt_db *db;
+
+	g_mutex_lock(&m_gatt_db_mutex);
+	db = connection->gatt_db;
+	if ((db == NULL) || (db->stale && (value_handle >= db->stale_start) && (value_handle <= db->stale_end))) {
+		g_mutex_unlock(&m_gatt_db_mutex);
+		return false;
+	}
+
+	characteristic = gattlib_gatt_db_find_char_by_handle(db, value_handle);
+	if ((characteristic == NULL) || (characteristic->characteristic.value_handle != value_handle)) {
+		*ret = GATTLIB_NOT_FOUND;
+	} else {
+		memcpy(uuid, &characteristic->characteristic.uuid, sizeof(uuid_t));
+		*ret = GATTLIB_SUCCESS;
+	}
+	g_mutex_unlock(&m_gatt_db_mutex);
+	return true;
+}
+
+bool gattlib_gatt_db_lookup_value_handle(gatt_connection_t* connection, const uuid_t* uuid, uint16_t* value_handle, int* ret) {
+	const gattlib_gatt_tree_characteristic_t *characteristic;
+	const struct gattlib_gatt_db *db;
+
+	g_mutex_lock(&m_gatt_db_mutex);
+	db = connection->gatt_db;
+	if (db == NULL) {
+		g_mutex_unlock(&m_gatt_db_mutex);
+		return false;
+	}
+
+	characteristic = gattlib_gatt_db_find_char_by_uuid(db, uuid);
+	if (characteristic != NULL) {
+		*value_handle = characteristic->characteristic.value_handle;
+		*ret = GATTLIB_SUCCESS;
+	} else if (db->stale) {
+		// The characteristic might be in the range not rediscovered yet
+		g_mutex_unlock(&m_gatt_db_mutex);
+		return false;
+	} else {
+		*ret = GATTLIB_NOT_FOUND;
+	}
+	g_mutex_unlock(&m_gatt_db_mutex);
+	return true;
+}
+
+bool gattlib_gatt_db_lookup_cccd(gatt_connection_t* connection, uint16_t value_handle, uint16_t* cccd_handle, int* ret) {
+	const gattlib_descriptor_t *cccd;
+	const struct gattlib_gatt_db *db;
+
+	g_mutex_lock(&m_gatt_db_mutex);
+	db = connection->gatt_db;
+	if ((db == NULL) || (db->stale && (value_handle >= db->stale_start) && (value_handle <= db->stale_end))) {
+		g_mutex_unlock(&m_gatt_db_mutex);
+		return false;
+	}
+
+	cccd = gattlib_gatt_db_find_cccd(db, value_handle);
+	if (cccd != NULL) {
+		*cccd_handle = cccd->handle;
+		*ret = GATTLIB_SUCCESS;
+	} else {
+		*ret = GATTLIB_NOT_SUPPORTED;
+	}
+	g_mutex_unlock(&m_gatt_db_mutex);
+	return true;
+}
+
+void gattlib_register_on_service_changed(gatt_connection_t* connection, gattlib_service_changed_handler_t handler, void* user_data) {
+	connection->service_changed_handler = handler;
+	connection->service_changed_user_data = user_data;
+}
+
+const gattlib_gatt_tree_t* gattlib_gatt_db_get_tree(const gattlib_gatt_db_t* db) {
+	return db->tree;
+}
+
+const gattlib_gatt_tree_characteristic_t* gattlib_gatt_db_find_char_by_uuid(const gattlib_gatt_db_t* db, const uuid_t* uuid) {
+	struct gatt_db_uuid_entry key;
+	size_t low = 0, high = db->uuids_count;
+
+	gattlib_uuid_to_uuid128(uuid, key.uuid128);
+
+	// Look for the first characteristic with this UUID
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+
+		if (memcmp(db->uuids[middle].uuid128, key.uuid128, sizeof(key.uuid128)) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if ((low < db->uuids_count) && (memcmp(db->uuids[low].uuid128, key.uuid128, sizeof(key.uuid128)) == 0)) {
+		return db->uuids[low].characteristic;
+	} else {
+		return NULL;
+	}
+}
+
+const gattlib_gatt_tree_characteristic_t* gattlib_gatt_db_find_char_by_handle(const gattlib_gatt_db_t* db, uint16_t handle) {
+	const gattlib_gatt_db_attribute_t *attribute;
+	size_t index = gatt_db_lower_bound(db, handle);
+
+	// The value of a characteristic is not an attribute of the database. Look at the preceding attribute.
+	if ((index == db->attributes_count) || (db->attributes[index].handle != handle)) {
+		if (index == 0) {
+			return NULL;
+		}
+		index--;
+	}
+
+	attribute = &db->attributes[index];
+	if ((attribute->type == GATTLIB_GATT_DB_ATTRIBUTE_CHARACTERISTIC) &&
+	    ((attribute->characteristic->characteristic.handle == handle) ||
+	     (attribute->characteristic->characteristic.value_handle == handle))) {
+		return attribute->characteristic;
+	} else {
+		return NULL;
+	}
+}
+
+const gattlib_descriptor_t* gattlib_gatt_db_find_cccd(const gattlib_gatt_db_t* db, uint16_t value_handle) {
+	const gattlib_gatt_tree_characteristic_t *characteristic;
+
+	characteristic = gattlib_gatt_db_find_char_by_handle(db, value_handle);
+	if ((characteristic == NULL) || (characteristic->characteristic.value_handle != value_handle)) {
+		return NULL;
+	}
+
+	for (size_t d = 0; d < characteristic->descriptors_count; d++) {
+		if (characteristic->descriptors[d].uuid16 == GATT_DB_CCCD_UUID16) {
+			return &characteristic->descriptors[d];
+		}
+	}
+	return NULL;
+}
+
+const gattlib_gatt_tree_service_t* gattlib_gatt_db_find_service_by_handle(const gattlib_gatt_db_t* db, uint16_t handle) {
+	const gattlib_gatt_tree_t *tree = db->tree;
+	size_t low = 0, high = tree->services_count;
+
+	// Look for the last service starting before the handle
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+
+		if (tree->services[middle].service.attr_handle_start <= handle) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	if ((low > 0) && (handle <= tree->services[low - 1].service.attr_handle_end)) {
+		return &tree->services[low - 1];
+	} else {
+		return NULL;
+	}
+}
+
+void gattlib_gatt_db_foreach_in_range(const gattlib_gatt_db_t* db, uint16_t start, uint16_t end,
+		gattlib_gatt_db_foreach_cb_t callback, void* user_data)
+{
+	for (size_t i = gatt_db_lower_bound(db, start); (i < db->attributes_count) && (db->attributes[i].handle <= end); i++) {
+		if (!callback(&db->attributes[i], user_data)) {
+			break;
+		}
+	}
+}
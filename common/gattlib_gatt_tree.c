@@ -0,0 +1,162 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "gattlib_internal.h"
+
+//
+// Build the GATT tree returned by 'gattlib_discover_all()' from the flat lists of attributes.
+//
+// The attributes are attached to their parent by handle: a characteristic belongs to the last service starting
+// before it and a descriptor to the last characteristic declared before it. The tree is a single allocation
+// (header, then services, characteristics and descriptors) so the caller releases it with a single 'free()'.
+//
+
+// Attribute types reported by 'Find Information' that are not descriptors
+#define GATT_TREE_PRIMARY_SERVICE_UUID16    0x2800
+#define GATT_TREE_SECONDARY_SERVICE_UUID16  0x2801
+#define GATT_TREE_INCLUDE_UUID16            0x2802
+#define GATT_TREE_CHARACTERISTIC_UUID16     0x2803
+
+static int gatt_tree_service_cmp(const void *a, const void *b) {
+	const gattlib_gatt_tree_service_t *service_a = a, *service_b = b;
+	return (int)service_a->service.attr_handle_start - (int)service_b->service.attr_handle_start;
+}
+
+static int gatt_tree_characteristic_cmp(const void *a, const void *b) {
+	const gattlib_characteristic_t *characteristic_a = a, *characteristic_b = b;
+	return (int)characteristic_a->handle - (int)characteristic_b->handle;
+}
+
+static int gatt_tree_descriptor_cmp(const void *a, const void *b) {
+	const gattlib_descriptor_t *descriptor_a = a, *descriptor_b = b;
+	return (int)descriptor_a->handle - (int)descriptor_b->handle;
+}
+
+static bool gatt_tree_is_declaration(const gattlib_descriptor_t *descriptor) {
+	return (descriptor->uuid16 == GATT_TREE_PRIMARY_SERVICE_UUID16) ||
+	       (descriptor->uuid16 == GATT_TREE_SECONDARY_SERVICE_UUID16) ||
+	       (descriptor->uuid16 == GATT_TREE_INCLUDE_UUID16) ||
+	       (descriptor->uuid16 == GATT_TREE_CHARACTERISTIC_UUID16);
+}
+
+gattlib_gatt_tree_t *gattlib_gatt_tree_new(gattlib_gatt_tree_service_t *services, size_t services_count,
+		gattlib_characteristic_t *characteristics, size_t characteristics_count,
+		gattlib_descriptor_t *descriptors, size_t descriptors_count)
+{
+	gattlib_gatt_tree_characteristic_t *tree_characteristics;
+	gattlib_gatt_tree_service_t *tree_services;
+	gattlib_descriptor_t *tree_descriptors;
+	gattlib_gatt_tree_t *tree;
+	size_t s, c, d;
+
+	tree = malloc(sizeof(gattlib_gatt_tree_t) +
+			services_count * sizeof(gattlib_gatt_tree_service_t) +
+			characteristics_count * sizeof(gattlib_gatt_tree_characteristic_t) +
+			descriptors_count * sizeof(gattlib_descriptor_t));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	tree_services = (gattlib_gatt_tree_service_t *)(tree + 1);
+	tree_characteristics = (gattlib_gatt_tree_characteristic_t *)(tree_services + services_count);
+	tree_descriptors = (gattlib_descriptor_t *)(tree_characteristics + characteristics_count);
+
+	tree->services = tree_services;
+	tree->services_count = services_count;
+
+	qsort(services, services_count, sizeof(gattlib_gatt_tree_service_t), gatt_tree_service_cmp);
+	qsort(characteristics, characteristics_count, sizeof(gattlib_characteristic_t), gatt_tree_characteristic_cmp);
+	qsort(descriptors, descriptors_count, sizeof(gattlib_descriptor_t), gatt_tree_descriptor_cmp);
+
+	for (s = 0; s < services_count; s++) {
+		tree_services[s].service = services[s].service;
+		tree_services[s].primary = services[s].primary;
+		tree_services[s].characteristics = NULL;
+		tree_services[s].characteristics_count = 0;
+	}
+
+	// Attach the characteristics to their service
+	s = 0;
+	c = 0;
+	for (size_t i = 0; (i < characteristics_count) && (services_count > 0); i++) {
+		while ((s + 1 < services_count) && (tree_services[s + 1].service.attr_handle_start <= characteristics[i].handle)) {
+			s++;
+		}
+		if (characteristics[i].handle < tree_services[s].service.attr_handle_start) {
+			continue;
+		}
+
+		tree_characteristics[c].characteristic = characteristics[i];
+		tree_characteristics[c].descriptors = NULL;
+		tree_characteristics[c].descriptors_count = 0;
+
+		if (tree_services[s].characteristics == NULL) {
+			tree_services[s].characteristics = &tree_characteristics[c];
+		}
+		tree_services[s].characteristics_count++;
+		tree_services[s].service.attr_handle_end = MAX(tree_services[s].service.attr_handle_end,
+				characteristics[i].value_handle);
+		c++;
+	}
+
+	// Attach the descriptors to their characteristic. The characteristics of the tree are sorted by handle.
+	characteristics_count = c;
+	s = 0;
+	c = 0;
+	d = 0;
+	for (size_t i = 0; (i < descriptors_count) && (characteristics_count > 0); i++) {
+		gattlib_gatt_tree_characteristic_t *characteristic;
+
+		if (gatt_tree_is_declaration(&descriptors[i])) {
+			continue;
+		}
+
+		while ((c + 1 < characteristics_count) && (tree_characteristics[c + 1].characteristic.handle < descriptors[i].handle)) {
+			c++;
+		}
+		characteristic = &tree_characteristics[c];
+		while ((s + 1 < services_count) && (tree_services[s + 1].service.attr_handle_start <= characteristic->characteristic.handle)) {
+			s++;
+		}
+
+		// Skip the attributes preceding the first characteristic, the characteristic values and the attributes
+		// of the following services without characteristic
+		if ((descriptors[i].handle <= characteristic->characteristic.value_handle) ||
+		    ((s + 1 < services_count) && (descriptors[i].handle >= tree_services[s + 1].service.attr_handle_start))) {
+			continue;
+		}
+
+		tree_descriptors[d] = descriptors[i];
+		if (characteristic->descriptors == NULL) {
+			characteristic->descriptors = &tree_descriptors[d];
+		}
+		characteristic->descriptors_count++;
+		tree_services[s].service.attr_handle_end = MAX(tree_services[s].service.attr_handle_end, descriptors[i].handle);
+		d++;
+	}
+
+	return tree;
+}
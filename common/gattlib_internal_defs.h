@@ -1,6 +1,7 @@
 #ifndef __GATTLIB_INTERNAL_DEFS_H__
 #define __GATTLIB_INTERNAL_DEFS_H__
 
+#include <glib.h>
 #include <stdbool.h>
 
 #include "gattlib.h"
@@ -20,13 +21,168 @@ struct gattlib_handler {
 struct _gatt_connection_t {
 	void* context;
 
+	// GATT database returned by 'gattlib_gatt_db_get()' (NULL until it is requested)
+	struct gattlib_gatt_db *gatt_db;
+
+	// Handler called when the device reports a change of its GATT database
+	gattlib_service_changed_handler_t service_changed_handler;
+	void* service_changed_user_data;
+
 	struct gattlib_handler notification;
 	struct gattlib_handler indication;
 	struct gattlib_handler disconnection;
+
+	// MAC address of the device (empty string if unknown)
+	char device_address[18];
+
+	// Counters returned by 'gattlib_get_stats()' (see 'gattlib_stats.c')
+	gattlib_connection_stats_t stats;
 };
 
 bool gattlib_has_valid_handler(struct gattlib_handler *handler);
 void gattlib_call_disconnection_handler(struct gattlib_handler *handler);
 void gattlib_call_notification_handler(struct gattlib_handler *handler, const uuid_t* uuid, const uint8_t* data, size_t data_length);
 
+/*
+ * Lock-free counters of the connections and adapters (see 'gattlib_stats.c')
+ */
+#define GATTLIB_STATS_ADD(counter, value)  __atomic_fetch_add(&(counter), (uint64_t)(value), __ATOMIC_RELAXED)
+#define GATTLIB_STATS_INC(counter)         GATTLIB_STATS_ADD(counter, 1)
+
+// Count the end of an operation previously counted as issued
+void gattlib_stats_operation_done(gattlib_connection_stats_t *stats, gattlib_stats_operation_t operation, int ret);
+// Copy counters incremented with 'GATTLIB_STATS_ADD()'. 'size' must be a multiple of sizeof(uint64_t)
+void gattlib_stats_copy(void *dst, const void *src, size_t size);
+
+/*
+ * Hooks around the public operations (see 'gattlib_trace.c')
+ */
+extern int g_gattlib_trace_enabled;
+
+// Evaluates to true, after calling the begin hook, if the operation is traced. Costs a single test without hooks.
+#define GATTLIB_TRACE_BEGIN(event, ...) \
+	(G_UNLIKELY(__atomic_load_n(&g_gattlib_trace_enabled, __ATOMIC_RELAXED)) && gattlib_trace_begin(event, __VA_ARGS__))
+
+// 'mac_address' can be NULL to report the address of the connection
+bool gattlib_trace_begin(gattlib_trace_event_t *event, gattlib_trace_operation_t operation, gatt_connection_t *connection,
+		const char *mac_address, uint16_t handle, const uuid_t *uuid, size_t length);
+void gattlib_trace_end(gattlib_trace_event_t *event, int result, size_t length);
+
+/*
+ * Live device table fed by the scanners (see 'gattlib_scan_table.c')
+ */
+struct gattlib_scan_table;
+
+int gattlib_string_to_addr48(const char *addr, uint64_t *addr48);
+
+struct gattlib_scan_table *gattlib_scan_table_new(size_t max_devices, unsigned int rssi_smoothing);
+void gattlib_scan_table_unref(struct gattlib_scan_table *table);
+// Return a reference on the table of the adapter (NULL if disabled). Release it with 'gattlib_scan_table_unref()'.
+struct gattlib_scan_table *gattlib_scan_table_get(struct gattlib_scan_table **table_ptr);
+// Location of the table of the adapter (implemented by each backend)
+struct gattlib_scan_table **gattlib_adapter_scan_table_ptr(void *adapter);
+void gattlib_scan_table_update(struct gattlib_scan_table *table, const char *addr, const char *name, int16_t rssi,
+		const uint8_t *ad_data, size_t ad_data_length);
+size_t gattlib_scan_table_snapshot(struct gattlib_scan_table *table, gattlib_scan_entry_t *out, size_t max);
+void gattlib_scan_table_prune(struct gattlib_scan_table *table, uint64_t max_age_ms);
+
+/*
+ * Per-device coalescing of the advertisements reported by the scanners (see 'gattlib_scan_coalescing.c')
+ */
+struct gattlib_scan_coalescing {
+	uint32_t min_interval_ms;
+	uint8_t  min_rssi_delta;
+	bool     notify_on_payload_change;
+};
+
+struct gattlib_scan_coalescer;
+
+uint32_t gattlib_scan_payload_hash(uint32_t hash, const uint8_t *data, size_t data_length);
+
+struct gattlib_scan_coalescer *gattlib_scan_coalescer_new(const struct gattlib_scan_coalescing *params, bool notify_change);
+void gattlib_scan_coalescer_free(struct gattlib_scan_coalescer *coalescer);
+bool gattlib_scan_coalescer_needs_payload(const struct gattlib_scan_coalescer *coalescer);
+bool gattlib_scan_coalescer_should_notify(struct gattlib_scan_coalescer *coalescer, const char *addr, int16_t rssi, uint32_t payload_hash);
+void gattlib_scan_coalescer_prune(struct gattlib_scan_coalescer *coalescer, uint64_t max_age_ms);
+
+/*
+ * Batched delivery of the scan results (see 'gattlib_scan_batch.c')
+ */
+struct gattlib_scan_batch;
+
+struct gattlib_scan_batch *gattlib_scan_batch_new(void *adapter, GMainContext *context,
+		size_t max_batch_size, uint32_t max_delay_ms,
+		gattlib_discovered_devices_batch_t callback, void *user_data);
+void gattlib_scan_batch_add(struct gattlib_scan_batch *batch, const char *addr, const char *name, int16_t rssi);
+void gattlib_scan_batch_free(struct gattlib_scan_batch *batch);
+
+/*
+ * Interleaving of the background scan with the connections (see 'gattlib_scan_scheduler.c')
+ */
+struct gattlib_scan_scheduler;
+
+// Enable or disable the scan of the adapter. Called from the main context given to 'gattlib_scan_scheduler_scan_started()'
+typedef int (*gattlib_scan_scheduler_enable_cb_t)(void *adapter, bool enable);
+
+struct gattlib_scan_scheduler *gattlib_scan_scheduler_new(void *adapter, gattlib_scan_scheduler_enable_cb_t set_scan_enable);
+void gattlib_scan_scheduler_free(struct gattlib_scan_scheduler *scheduler);
+int gattlib_scan_scheduler_set_schedule(struct gattlib_scan_scheduler *scheduler, const gattlib_scan_schedule_t *schedule);
+void gattlib_scan_scheduler_scan_started(struct gattlib_scan_scheduler *scheduler, GMainContext *context);
+void gattlib_scan_scheduler_scan_stopped(struct gattlib_scan_scheduler *scheduler);
+void gattlib_scan_scheduler_hold(struct gattlib_scan_scheduler *scheduler);
+void gattlib_scan_scheduler_release(struct gattlib_scan_scheduler *scheduler);
+
+/*
+ * GATT tree returned by 'gattlib_discover_all()' (see 'gattlib_gatt_tree.c')
+ */
+gattlib_gatt_tree_t *gattlib_gatt_tree_new(gattlib_gatt_tree_service_t *services, size_t services_count,
+		gattlib_characteristic_t *characteristics, size_t characteristics_count,
+		gattlib_descriptor_t *descriptors, size_t descriptors_count);
+
+/*
+ * GATT database of the connections (see 'gattlib_gatt_db.c')
+ */
+struct gattlib_gatt_db *gattlib_gatt_db_new(gattlib_gatt_tree_t *tree);
+void gattlib_gatt_db_free(struct gattlib_gatt_db *db);
+// Called by the backends when the attributes of the range of handles have been added, removed or modified.
+// 'range_tree' is the rediscovered range or NULL to rediscover it on the next 'gattlib_gatt_db_get()'.
+void gattlib_gatt_db_service_changed(gatt_connection_t* connection, uint16_t start, uint16_t end,
+		const gattlib_gatt_tree_t *range_tree);
+// Look up the UUID of a characteristic value handle (or the value handle of a UUID) in the GATT database of
+// the connection. Return false if the database has not been discovered or if the handle might be in a range
+// changed by the device and not rediscovered yet: '*ret' is then not set.
+bool gattlib_gatt_db_lookup_uuid(gatt_connection_t* connection, uint16_t value_handle, uuid_t* uuid, int* ret);
+bool gattlib_gatt_db_lookup_value_handle(gatt_connection_t* connection, const uuid_t* uuid, uint16_t* value_handle, int* ret);
+// Look up the Client Characteristic Configuration Descriptor of a characteristic value handle in the same way.
+// '*ret' is GATTLIB_NOT_SUPPORTED if the characteristic has no such descriptor.
+bool gattlib_gatt_db_lookup_cccd(gatt_connection_t* connection, uint16_t value_handle, uint16_t* cccd_handle, int* ret);
+
+// Discover the GATT tree of a range of handles. Implemented by the backends.
+int gattlib_discover_range(gatt_connection_t* connection, uint16_t start, uint16_t end, gattlib_gatt_tree_t** tree);
+
+/*
+ * Advertisement data filters evaluated by the scanners (see 'gattlib_ad_filter.c')
+ */
+struct gattlib_ad_filter_entry {
+	gattlib_ad_filter_t filter;
+	// 128-bit form of 'filter.service_uuid'
+	uint8_t uuid128[16];
+};
+
+struct gattlib_ad_filters {
+	struct gattlib_ad_filter_entry *entries;
+	size_t count;
+};
+
+void gattlib_uuid_to_uuid128(const uuid_t *uuid, uint8_t uuid128[16]);
+
+int gattlib_ad_filters_set(struct gattlib_ad_filters *ad_filters, const gattlib_ad_filter_t *filters, size_t filter_count);
+void gattlib_ad_filters_clear(struct gattlib_ad_filters *ad_filters);
+bool gattlib_ad_filters_is_empty(const struct gattlib_ad_filters *ad_filters);
+bool gattlib_ad_filters_match_manufacturer_data(const struct gattlib_ad_filters *ad_filters,
+		uint16_t company_id, const uint8_t *data, size_t data_length);
+bool gattlib_ad_filters_match_service_data(const struct gattlib_ad_filters *ad_filters,
+		const uint8_t uuid128[16], const uint8_t *data, size_t data_length);
+bool gattlib_ad_filters_match_raw(const struct gattlib_ad_filters *ad_filters, const uint8_t *ad_data, size_t ad_data_length);
+
 #endif
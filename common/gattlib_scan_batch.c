@@ -0,0 +1,169 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Batched delivery of the scan results.
+//
+// The results are accumulated in a preallocated array and delivered to the user when the array is full
+// or when the oldest pending result has waited for 'max_delay_ms'. The timer is attached to the main context
+// that dispatches the scan events so results are always delivered from the same thread.
+//
+
+struct gattlib_scan_batch {
+	gint ref;
+	GRecMutex mutex;
+
+	void *adapter;
+	gattlib_discovered_devices_batch_t callback;
+	void *user_data;
+
+	GMainContext *context;
+	uint32_t max_delay_ms;
+	// Timer armed by the first pending result (NULL when the batch is empty)
+	GSource *timer;
+
+	size_t capacity;
+	size_t count;
+	gattlib_scan_result_t results[];
+};
+
+static void scan_batch_unref(gpointer data) {
+	struct gattlib_scan_batch *batch = data;
+
+	if (g_atomic_int_dec_and_test(&batch->ref)) {
+		g_rec_mutex_clear(&batch->mutex);
+		if (batch->context != NULL) {
+			g_main_context_unref(batch->context);
+		}
+		free(batch);
+	}
+}
+
+struct gattlib_scan_batch *gattlib_scan_batch_new(void *adapter, GMainContext *context,
+		size_t max_batch_size, uint32_t max_delay_ms,
+		gattlib_discovered_devices_batch_t callback, void *user_data)
+{
+	struct gattlib_scan_batch *batch;
+
+	if ((max_batch_size == 0) || (callback == NULL)) {
+		return NULL;
+	}
+
+	batch = calloc(1, sizeof(struct gattlib_scan_batch) + max_batch_size * sizeof(gattlib_scan_result_t));
+	if (batch == NULL) {
+		return NULL;
+	}
+
+	batch->ref = 1;
+	g_rec_mutex_init(&batch->mutex);
+	batch->adapter = adapter;
+	batch->callback = callback;
+	batch->user_data = user_data;
+	batch->context = (context != NULL) ? g_main_context_ref(context) : NULL;
+	batch->max_delay_ms = max_delay_ms;
+	batch->capacity = max_batch_size;
+
+	return batch;
+}
+
+/*
+ * Deliver the pending results. Must be called with the batch mutex held.
+ */
+static void scan_batch_flush_locked(struct gattlib_scan_batch *batch) {
+	size_t count = batch->count;
+
+	if (batch->timer != NULL) {
+		g_source_destroy(batch->timer);
+		g_source_unref(batch->timer);
+		batch->timer = NULL;
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	// Reset the batch before calling the user as the callback might add new results or stop the scan
+	batch->count = 0;
+	batch->callback(batch->adapter, batch->results, count, batch->user_data);
+}
+
+static gboolean scan_batch_on_timeout(gpointer data) {
+	struct gattlib_scan_batch *batch = data;
+
+	g_rec_mutex_lock(&batch->mutex);
+	// The timer might have been destroyed by a flush from another thread while being dispatched
+	if (!g_source_is_destroyed(g_main_current_source())) {
+		scan_batch_flush_locked(batch);
+	}
+	g_rec_mutex_unlock(&batch->mutex);
+
+	return FALSE;
+}
+
+void gattlib_scan_batch_add(struct gattlib_scan_batch *batch, const char *addr, const char *name, int16_t rssi) {
+	gattlib_scan_result_t *result;
+
+	// Keep the batch alive in case the user callback stops the scan
+	g_atomic_int_inc(&batch->ref);
+	g_rec_mutex_lock(&batch->mutex);
+
+	result = &batch->results[batch->count++];
+	memset(result, 0, sizeof(*result));
+	strncpy(result->addr, addr, sizeof(result->addr) - 1);
+	if (name != NULL) {
+		strncpy(result->name, name, sizeof(result->name) - 1);
+	}
+	result->rssi = rssi;
+
+	if (batch->count >= batch->capacity) {
+		scan_batch_flush_locked(batch);
+	} else if ((batch->timer == NULL) && (batch->max_delay_ms > 0)) {
+		batch->timer = g_timeout_source_new(batch->max_delay_ms);
+		// The timer holds a reference on the batch until it has been dispatched or destroyed
+		g_atomic_int_inc(&batch->ref);
+		g_source_set_callback(batch->timer, scan_batch_on_timeout, batch, scan_batch_unref);
+		g_source_attach(batch->timer, batch->context);
+	}
+
+	g_rec_mutex_unlock(&batch->mutex);
+	scan_batch_unref(batch);
+}
+
+void gattlib_scan_batch_free(struct gattlib_scan_batch *batch) {
+	if (batch == NULL) {
+		return;
+	}
+
+	// Deliver the last results
+	g_rec_mutex_lock(&batch->mutex);
+	scan_batch_flush_locked(batch);
+	g_rec_mutex_unlock(&batch->mutex);
+
+	scan_batch_unref(batch);
+}
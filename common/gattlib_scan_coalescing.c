@@ -0,0 +1,172 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "gattlib_internal.h"
+
+//
+// Decide for each received advertisement whether the user callback should be invoked.
+//
+// The first advertisement of a device is always reported. With GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE,
+// the following ones are reported once the minimum interval has elapsed and, if requested, only if
+// the RSSI or the payload have changed since the last reported advertisement.
+//
+
+#define FNV1A_32_OFFSET_BASIS  0x811C9DC5
+#define FNV1A_32_PRIME         0x01000193
+
+struct scan_coalescer_device {
+	uint64_t addr48;
+	// Time of the last advertisement (reported or not)
+	uint64_t last_seen;
+
+	// State of the last advertisement reported to the user
+	uint64_t last_notified;
+	int16_t  rssi;
+	uint32_t payload_hash;
+};
+
+struct gattlib_scan_coalescer {
+	struct gattlib_scan_coalescing params;
+	bool notify_change;
+
+	GHashTable *devices;
+};
+
+uint32_t gattlib_scan_payload_hash(uint32_t hash, const uint8_t *data, size_t data_length) {
+	if (hash == 0) {
+		hash = FNV1A_32_OFFSET_BASIS;
+	}
+
+	for (size_t i = 0; i < data_length; i++) {
+		hash = (hash ^ data[i]) * FNV1A_32_PRIME;
+	}
+	return hash;
+}
+
+struct gattlib_scan_coalescer *gattlib_scan_coalescer_new(const struct gattlib_scan_coalescing *params, bool notify_change) {
+	struct gattlib_scan_coalescer *coalescer = calloc(1, sizeof(struct gattlib_scan_coalescer));
+	if (coalescer == NULL) {
+		return NULL;
+	}
+
+	coalescer->params = *params;
+	coalescer->notify_change = notify_change;
+	// The key is the 'addr48' field of the value
+	coalescer->devices = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free);
+
+	return coalescer;
+}
+
+void gattlib_scan_coalescer_free(struct gattlib_scan_coalescer *coalescer) {
+	if (coalescer == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy(coalescer->devices);
+	free(coalescer);
+}
+
+bool gattlib_scan_coalescer_needs_payload(const struct gattlib_scan_coalescer *coalescer) {
+	return coalescer->notify_change && coalescer->params.notify_on_payload_change;
+}
+
+bool gattlib_scan_coalescer_should_notify(struct gattlib_scan_coalescer *coalescer, const char *addr, int16_t rssi, uint32_t payload_hash) {
+	const struct gattlib_scan_coalescing *params = &coalescer->params;
+	struct scan_coalescer_device *device;
+	uint64_t now = g_get_monotonic_time() / 1000;
+	uint64_t addr48;
+
+	if (gattlib_string_to_addr48(addr, &addr48) != GATTLIB_SUCCESS) {
+		return false;
+	}
+
+	device = g_hash_table_lookup(coalescer->devices, &addr48);
+	if (device == NULL) {
+		// First time this device is seen
+		device = malloc(sizeof(struct scan_coalescer_device));
+		if (device == NULL) {
+			return true;
+		}
+
+		device->addr48 = addr48;
+		device->last_seen = now;
+		device->last_notified = now;
+		device->rssi = rssi;
+		device->payload_hash = payload_hash;
+		g_hash_table_insert(coalescer->devices, &device->addr48, device);
+		return true;
+	}
+
+	device->last_seen = now;
+
+	if (!coalescer->notify_change) {
+		return false;
+	}
+
+	if (now - device->last_notified < params->min_interval_ms) {
+		return false;
+	}
+
+	if ((params->min_rssi_delta > 0) || params->notify_on_payload_change) {
+		bool changed = false;
+
+		if ((params->min_rssi_delta > 0) && (abs(rssi - device->rssi) >= params->min_rssi_delta)) {
+			changed = true;
+		}
+		if (params->notify_on_payload_change && (payload_hash != device->payload_hash)) {
+			changed = true;
+		}
+
+		if (!changed) {
+			return false;
+		}
+	}
+
+	device->last_notified = now;
+	device->rssi = rssi;
+	device->payload_hash = payload_hash;
+	return true;
+}
+
+static gboolean scan_coalescer_is_stale(gpointer key, gpointer value, gpointer user_data) {
+	const struct scan_coalescer_device *device = value;
+	const uint64_t *oldest = user_data;
+
+	return device->last_seen < *oldest;
+}
+
+void gattlib_scan_coalescer_prune(struct gattlib_scan_coalescer *coalescer, uint64_t max_age_ms) {
+	uint64_t now = g_get_monotonic_time() / 1000;
+	uint64_t oldest;
+
+	if ((coalescer == NULL) || (now < max_age_ms)) {
+		return;
+	}
+
+	// A pruned device is reported again as a new device when it comes back
+	oldest = now - max_age_ms;
+	g_hash_table_foreach_remove(coalescer->devices, scan_coalescer_is_stale, &oldest);
+}
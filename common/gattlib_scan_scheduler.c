@@ -0,0 +1,314 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gattlib_internal.h"
+
+//
+// Interleaving of the background scan with the connections.
+//
+// While no connection is in progress, the scan runs continuously. While connections hold the radio
+// (see 'gattlib_scan_scheduler_hold()'), the scan is duty cycled: it runs 'scan_duty_percent' of every
+// 'period_ms' and is paused for the rest of the period. A new connection waits for the end of the current
+// scan window, but never longer than 'max_connect_wait_ms'.
+//
+// The scan is only enabled and disabled from the main context that dispatches the scan events so the
+// backends do not have to synchronize their scan state with the user threads. The backend is called
+// without the mutex held as it might block on the controller or on Bluez.
+//
+
+struct gattlib_scan_scheduler {
+	gint ref;
+	GMutex mutex;
+	GCond cond;
+
+	void *adapter;
+	gattlib_scan_scheduler_enable_cb_t set_scan_enable;
+
+	bool enabled;
+	gattlib_scan_schedule_t schedule;
+
+	// Set between 'gattlib_scan_scheduler_scan_started()' and 'gattlib_scan_scheduler_scan_stopped()'
+	GMainContext *context;
+	bool scanning;
+	// Set while the backend pauses or resumes the scan outside of the mutex
+	bool applying;
+	// Start of the current scan window or pause (monotonic time in microseconds)
+	gint64 phase_start;
+	// The scan must be paused at this time for the pending holders
+	gint64 pause_deadline;
+	GSource *timer;
+
+	unsigned int holders;
+};
+
+static void scan_scheduler_update(struct gattlib_scan_scheduler *scheduler);
+
+static struct gattlib_scan_scheduler *scan_scheduler_ref(struct gattlib_scan_scheduler *scheduler) {
+	g_atomic_int_inc(&scheduler->ref);
+	return scheduler;
+}
+
+static void scan_scheduler_unref(gpointer data) {
+	struct gattlib_scan_scheduler *scheduler = data;
+
+	if (g_atomic_int_dec_and_test(&scheduler->ref)) {
+		g_cond_clear(&scheduler->cond);
+		g_mutex_clear(&scheduler->mutex);
+		free(scheduler);
+	}
+}
+
+struct gattlib_scan_scheduler *gattlib_scan_scheduler_new(void *adapter, gattlib_scan_scheduler_enable_cb_t set_scan_enable) {
+	struct gattlib_scan_scheduler *scheduler;
+
+	scheduler = calloc(1, sizeof(struct gattlib_scan_scheduler));
+	if (scheduler == NULL) {
+		return NULL;
+	}
+
+	scheduler->ref = 1;
+	g_mutex_init(&scheduler->mutex);
+	g_cond_init(&scheduler->cond);
+	scheduler->adapter = adapter;
+	scheduler->set_scan_enable = set_scan_enable;
+	scheduler->pause_deadline = G_MAXINT64;
+
+	return scheduler;
+}
+
+void gattlib_scan_scheduler_free(struct gattlib_scan_scheduler *scheduler) {
+	if (scheduler == NULL) {
+		return;
+	}
+
+	gattlib_scan_scheduler_scan_stopped(scheduler);
+	scan_scheduler_unref(scheduler);
+}
+
+static gboolean scan_scheduler_on_source(gpointer data) {
+	scan_scheduler_update(data);
+	return FALSE;
+}
+
+/*
+ * Run the scheduler from its main context in 'delay_ms'. Must be called with the mutex held.
+ */
+static void scan_scheduler_arm_locked(struct gattlib_scan_scheduler *scheduler, guint delay_ms) {
+	if (scheduler->timer != NULL) {
+		g_source_destroy(scheduler->timer);
+		g_source_unref(scheduler->timer);
+	}
+
+	scheduler->timer = (delay_ms == 0) ? g_idle_source_new() : g_timeout_source_new(delay_ms);
+	g_source_set_callback(scheduler->timer, scan_scheduler_on_source, scan_scheduler_ref(scheduler), scan_scheduler_unref);
+	g_source_attach(scheduler->timer, scheduler->context);
+}
+
+/*
+ * Enter the new scan phase. The caller applies it with the backend once the mutex is released.
+ */
+static void scan_scheduler_set_phase_locked(struct gattlib_scan_scheduler *scheduler, bool scanning, gint64 now) {
+	scheduler->applying = true;
+	scheduler->scanning = scanning;
+	scheduler->phase_start = now;
+	if (!scanning) {
+		scheduler->pause_deadline = G_MAXINT64;
+	}
+}
+
+static guint scan_scheduler_delay_ms(gint64 now, gint64 deadline) {
+	return (guint)((deadline - now + 999) / 1000);
+}
+
+/*
+ * Evaluate the scan phase. Called from the main context of the scan.
+ */
+static void scan_scheduler_update(struct gattlib_scan_scheduler *scheduler) {
+	gint64 now = g_get_monotonic_time();
+	gint64 scan_window_us, pause_window_us, phase_end;
+	bool scanning;
+	int ret;
+
+	g_mutex_lock(&scheduler->mutex);
+
+	if (scheduler->context == NULL) {
+		goto EXIT;
+	}
+
+	// Without holder, the scan runs continuously
+	if (!scheduler->enabled || (scheduler->holders == 0)) {
+		if (!scheduler->scanning) {
+			scan_scheduler_set_phase_locked(scheduler, true, now);
+		}
+		goto EXIT;
+	}
+
+	scan_window_us = (gint64)scheduler->schedule.period_ms * 1000 * scheduler->schedule.scan_duty_percent / 100;
+	pause_window_us = (gint64)scheduler->schedule.period_ms * 1000 - scan_window_us;
+
+	if (scheduler->scanning) {
+		phase_end = MIN(scheduler->phase_start + scan_window_us, scheduler->pause_deadline);
+		if (now >= phase_end) {
+			scan_scheduler_set_phase_locked(scheduler, false, now);
+			scan_scheduler_arm_locked(scheduler, scan_scheduler_delay_ms(now, now + pause_window_us));
+		} else {
+			scan_scheduler_arm_locked(scheduler, scan_scheduler_delay_ms(now, phase_end));
+		}
+	} else {
+		phase_end = scheduler->phase_start + pause_window_us;
+		if (now >= phase_end) {
+			scan_scheduler_set_phase_locked(scheduler, true, now);
+			scan_scheduler_arm_locked(scheduler, scan_scheduler_delay_ms(now, now + scan_window_us));
+		} else {
+			scan_scheduler_arm_locked(scheduler, scan_scheduler_delay_ms(now, phase_end));
+		}
+	}
+
+EXIT:
+	if (scheduler->applying) {
+		scanning = scheduler->scanning;
+		g_mutex_unlock(&scheduler->mutex);
+
+		ret = scheduler->set_scan_enable(scheduler->adapter, scanning);
+		if (ret != GATTLIB_SUCCESS) {
+			fprintf(stderr, "ERROR: Scan scheduler could not %s the scan: %d\n", scanning ? "resume" : "pause", ret);
+		}
+
+		g_mutex_lock(&scheduler->mutex);
+		scheduler->applying = false;
+	}
+	g_cond_broadcast(&scheduler->cond);
+	g_mutex_unlock(&scheduler->mutex);
+}
+
+int gattlib_scan_scheduler_set_schedule(struct gattlib_scan_scheduler *scheduler, const gattlib_scan_schedule_t *schedule) {
+	if ((schedule != NULL) && ((schedule->period_ms == 0) || (schedule->scan_duty_percent > 100))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	g_mutex_lock(&scheduler->mutex);
+	scheduler->enabled = (schedule != NULL);
+	if (schedule != NULL) {
+		scheduler->schedule = *schedule;
+	}
+	// Apply the new policy to the running scan
+	if (scheduler->context != NULL) {
+		scan_scheduler_arm_locked(scheduler, 0);
+	}
+	g_mutex_unlock(&scheduler->mutex);
+
+	return GATTLIB_SUCCESS;
+}
+
+void gattlib_scan_scheduler_scan_started(struct gattlib_scan_scheduler *scheduler, GMainContext *context) {
+	g_mutex_lock(&scheduler->mutex);
+	scheduler->context = g_main_context_ref(context);
+	scheduler->scanning = true;
+	scheduler->phase_start = g_get_monotonic_time();
+	scheduler->pause_deadline = G_MAXINT64;
+	// Connections might already hold the radio
+	scan_scheduler_arm_locked(scheduler, 0);
+	g_mutex_unlock(&scheduler->mutex);
+}
+
+void gattlib_scan_scheduler_scan_stopped(struct gattlib_scan_scheduler *scheduler) {
+	g_mutex_lock(&scheduler->mutex);
+	// The backend must not pause or resume the scan once it is stopped
+	while (scheduler->applying) {
+		g_cond_wait(&scheduler->cond, &scheduler->mutex);
+	}
+	if (scheduler->timer != NULL) {
+		g_source_destroy(scheduler->timer);
+		g_source_unref(scheduler->timer);
+		scheduler->timer = NULL;
+	}
+	if (scheduler->context != NULL) {
+		g_main_context_unref(scheduler->context);
+		scheduler->context = NULL;
+	}
+	scheduler->scanning = false;
+	// Release the holders waiting for a pause
+	g_cond_broadcast(&scheduler->cond);
+	g_mutex_unlock(&scheduler->mutex);
+}
+
+void gattlib_scan_scheduler_hold(struct gattlib_scan_scheduler *scheduler) {
+	gint64 now, wait_deadline;
+	gint64 scan_window_us;
+
+	if (scheduler == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&scheduler->mutex);
+	scheduler->holders++;
+
+	if (!scheduler->enabled || (scheduler->context == NULL) || !scheduler->scanning ||
+	    (scheduler->schedule.scan_duty_percent == 100)) {
+		g_mutex_unlock(&scheduler->mutex);
+		return;
+	}
+
+	// Wait for the end of the current scan window or for 'max_connect_wait_ms'
+	now = g_get_monotonic_time();
+	scan_window_us = (gint64)scheduler->schedule.period_ms * 1000 * scheduler->schedule.scan_duty_percent / 100;
+	scheduler->pause_deadline = MIN(scheduler->pause_deadline,
+			MIN(scheduler->phase_start + scan_window_us, now + (gint64)scheduler->schedule.max_connect_wait_ms * 1000));
+	scan_scheduler_arm_locked(scheduler, 0);
+
+	// The scan is paused from its main context. Do not wait forever if nobody dispatches it.
+	wait_deadline = MAX(scheduler->pause_deadline, now) + (gint64)scheduler->schedule.max_connect_wait_ms * 1000;
+	if ((scheduler->context != NULL) && g_main_context_is_owner(scheduler->context)) {
+		// Called from the scan context: it cannot be dispatched while we wait
+		wait_deadline = now;
+	}
+
+	while ((scheduler->scanning || scheduler->applying) && (scheduler->context != NULL)) {
+		if (!g_cond_wait_until(&scheduler->cond, &scheduler->mutex, wait_deadline)) {
+			break;
+		}
+	}
+
+	g_mutex_unlock(&scheduler->mutex);
+}
+
+void gattlib_scan_scheduler_release(struct gattlib_scan_scheduler *scheduler) {
+	if (scheduler == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&scheduler->mutex);
+	if (scheduler->holders > 0) {
+		scheduler->holders--;
+	}
+	// Resume the continuous scan when the last holder leaves
+	if ((scheduler->holders == 0) && (scheduler->context != NULL)) {
+		scheduler->pause_deadline = G_MAXINT64;
+		scan_scheduler_arm_locked(scheduler, 0);
+	}
+	g_mutex_unlock(&scheduler->mutex);
+}
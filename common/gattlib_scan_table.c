@@ -0,0 +1,416 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Live device table maintained by the scanners.
+//
+// Devices are indexed by their 48-bit address in an open-addressing hash table (linear probing).
+// The keys are stored in their own array so a lookup only touches a few contiguous cache lines;
+// the larger per-device records are only accessed once the slot has been found.
+//
+// The table of an adapter is reference counted: the scanners and 'gattlib_scan_snapshot()' hold a reference
+// while they use it so 'gattlib_scan_table_disable()' can be called from any thread.
+//
+
+// Marker added to the 48-bit address so a valid key is never 0 (0 means 'empty slot')
+#define SCAN_TABLE_KEY_VALID         (1ULL << 48)
+
+// Fixed-point fractional bits used by the moving averages
+#define SCAN_TABLE_FIXED_POINT_SHIFT 8
+
+// Maximum weight shift of the moving average (ie: alpha = 1/2^15)
+#define SCAN_TABLE_MAX_SMOOTHING     15
+
+struct gattlib_scan_table_slot {
+	gattlib_scan_entry_t entry;
+
+	// RSSI moving average (fixed-point)
+	int32_t  rssi_average;
+	// Moving average of the interval between two advertisements in milliseconds (fixed-point)
+	uint32_t interval_average;
+};
+
+struct gattlib_scan_table {
+	gint ref_count;
+	GMutex mutex;
+
+	uint64_t *keys;
+	struct gattlib_scan_table_slot *slots;
+
+	unsigned int capacity_bits;
+	size_t capacity;
+	size_t max_devices;
+	size_t count;
+
+	unsigned int rssi_smoothing;
+};
+
+// Protect the 'scan_table' pointer of the adapters while a reference is taken or the table is replaced
+static GMutex m_scan_table_ptr_mutex;
+
+static inline size_t scan_table_hash(const struct gattlib_scan_table *table, uint64_t key) {
+	// Fibonacci hashing - keep the most significant bits
+	return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - table->capacity_bits));
+}
+
+int gattlib_string_to_addr48(const char *addr, uint64_t *addr48) {
+	unsigned int bytes[6];
+
+	if (sscanf(addr, "%2x:%2x:%2x:%2x:%2x:%2x",
+			&bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	*addr48 = 0;
+	for (int i = 0; i < 6; i++) {
+		*addr48 = (*addr48 << 8) | bytes[i];
+	}
+	return GATTLIB_SUCCESS;
+}
+
+struct gattlib_scan_table *gattlib_scan_table_new(size_t max_devices, unsigned int rssi_smoothing) {
+	struct gattlib_scan_table *table;
+
+	if (max_devices == 0) {
+		return NULL;
+	}
+
+	table = calloc(1, sizeof(struct gattlib_scan_table));
+	if (table == NULL) {
+		return NULL;
+	}
+
+	// Keep the load factor under 50% to have short probe sequences
+	table->capacity_bits = 1;
+	while (((size_t)1 << table->capacity_bits) < max_devices * 2) {
+		table->capacity_bits++;
+	}
+	table->capacity = (size_t)1 << table->capacity_bits;
+	table->max_devices = max_devices;
+	table->rssi_smoothing = MIN(rssi_smoothing, SCAN_TABLE_MAX_SMOOTHING);
+
+	table->keys = calloc(table->capacity, sizeof(uint64_t));
+	table->slots = calloc(table->capacity, sizeof(struct gattlib_scan_table_slot));
+	if ((table->keys == NULL) || (table->slots == NULL)) {
+		free(table->keys);
+		free(table->slots);
+		free(table);
+		return NULL;
+	}
+
+	g_mutex_init(&table->mutex);
+	table->ref_count = 1;
+	return table;
+}
+
+void gattlib_scan_table_unref(struct gattlib_scan_table *table) {
+	if ((table == NULL) || !g_atomic_int_dec_and_test(&table->ref_count)) {
+		return;
+	}
+
+	g_mutex_clear(&table->mutex);
+	free(table->keys);
+	free(table->slots);
+	free(table);
+}
+
+struct gattlib_scan_table *gattlib_scan_table_get(struct gattlib_scan_table **table_ptr) {
+	struct gattlib_scan_table *table;
+
+	// Avoid the lock when the table is not enabled (the common case of the scanners)
+	if (g_atomic_pointer_get(table_ptr) == NULL) {
+		return NULL;
+	}
+
+	g_mutex_lock(&m_scan_table_ptr_mutex);
+	table = *table_ptr;
+	if (table != NULL) {
+		g_atomic_int_inc(&table->ref_count);
+	}
+	g_mutex_unlock(&m_scan_table_ptr_mutex);
+
+	return table;
+}
+
+/**
+ * Remove the slot at 'index' and shift back the following entries of the probe sequence
+ * (no tombstone needed with linear probing).
+ */
+static void scan_table_remove_slot(struct gattlib_scan_table *table, size_t index) {
+	const size_t mask = table->capacity - 1;
+	size_t hole = index;
+	size_t next = index;
+
+	while (1) {
+		next = (next + 1) & mask;
+		if (table->keys[next] == 0) {
+			break;
+		}
+
+		size_t ideal = scan_table_hash(table, table->keys[next]);
+
+		// Move the entry into the hole if its ideal slot is not cyclically within (hole, next]
+		bool stay = (hole <= next) ? ((hole < ideal) && (ideal <= next)) : ((hole < ideal) || (ideal <= next));
+		if (!stay) {
+			table->keys[hole] = table->keys[next];
+			table->slots[hole] = table->slots[next];
+			hole = next;
+		}
+	}
+
+	table->keys[hole] = 0;
+	table->count--;
+}
+
+static void scan_table_evict_oldest(struct gattlib_scan_table *table) {
+	size_t oldest_index = 0;
+	uint64_t oldest_time = UINT64_MAX;
+
+	for (size_t i = 0; i < table->capacity; i++) {
+		if ((table->keys[i] != 0) && (table->slots[i].entry.last_seen < oldest_time)) {
+			oldest_time = table->slots[i].entry.last_seen;
+			oldest_index = i;
+		}
+	}
+
+	if (oldest_time != UINT64_MAX) {
+		scan_table_remove_slot(table, oldest_index);
+	}
+}
+
+/*
+ * Copy the AD structures that fit in the entry. The structures are kept whole: the ones that do not fit
+ * (eg: long structures of extended advertisements) are skipped. The copy stops at the first malformed structure.
+ */
+static size_t scan_table_copy_ad_data(uint8_t *out, size_t max_out, const uint8_t *ad_data, size_t ad_data_length) {
+	size_t offset = 0, out_length = 0;
+
+	while (offset < ad_data_length) {
+		size_t structure_length = 1 + ad_data[offset];
+
+		if ((ad_data[offset] == 0) || (offset + structure_length > ad_data_length)) {
+			break;
+		}
+
+		if (out_length + structure_length <= max_out) {
+			memcpy(&out[out_length], &ad_data[offset], structure_length);
+			out_length += structure_length;
+		}
+		offset += structure_length;
+	}
+	return out_length;
+}
+
+void gattlib_scan_table_update(struct gattlib_scan_table *table, const char *addr, const char *name, int16_t rssi,
+		const uint8_t *ad_data, size_t ad_data_length)
+{
+	struct gattlib_scan_table_slot *slot;
+	const size_t mask = table->capacity - 1;
+	uint64_t now = g_get_monotonic_time() / 1000;
+	uint64_t addr48, key;
+	size_t index;
+
+	if (gattlib_string_to_addr48(addr, &addr48) != GATTLIB_SUCCESS) {
+		return;
+	}
+	key = addr48 | SCAN_TABLE_KEY_VALID;
+
+	g_mutex_lock(&table->mutex);
+
+	for (index = scan_table_hash(table, key); table->keys[index] != 0; index = (index + 1) & mask) {
+		if (table->keys[index] == key) {
+			break;
+		}
+	}
+
+	if (table->keys[index] == 0) {
+		// New device. Make room if the table is full
+		if (table->count >= table->max_devices) {
+			scan_table_evict_oldest(table);
+
+			// The eviction might have shifted the probe sequence
+			for (index = scan_table_hash(table, key); table->keys[index] != 0; index = (index + 1) & mask);
+		}
+
+		table->keys[index] = key;
+		table->count++;
+
+		slot = &table->slots[index];
+		memset(slot, 0, sizeof(*slot));
+		strncpy(slot->entry.addr, addr, sizeof(slot->entry.addr) - 1);
+		slot->entry.first_seen = now;
+		slot->rssi_average = (int32_t)rssi << SCAN_TABLE_FIXED_POINT_SHIFT;
+	} else {
+		slot = &table->slots[index];
+
+		// Exponentially weighted moving averages: avg += (sample - avg) / 2^smoothing
+		slot->rssi_average += (((int32_t)rssi << SCAN_TABLE_FIXED_POINT_SHIFT) - slot->rssi_average) / (1 << table->rssi_smoothing);
+
+		uint32_t interval = (uint32_t)MIN(now - slot->entry.last_seen, (uint64_t)UINT16_MAX) << SCAN_TABLE_FIXED_POINT_SHIFT;
+		if (slot->interval_average == 0) {
+			slot->interval_average = interval;
+		} else {
+			slot->interval_average += ((int64_t)interval - (int64_t)slot->interval_average) / (1 << table->rssi_smoothing);
+		}
+	}
+
+	slot->entry.rssi = rssi;
+	slot->entry.last_seen = now;
+	slot->entry.advertisement_count++;
+
+	if (name != NULL) {
+		strncpy(slot->entry.name, name, sizeof(slot->entry.name) - 1);
+		slot->entry.name[sizeof(slot->entry.name) - 1] = '\0';
+	}
+
+	if ((ad_data != NULL) && (ad_data_length > 0)) {
+		slot->entry.ad_data_length = scan_table_copy_ad_data(slot->entry.ad_data, sizeof(slot->entry.ad_data),
+				ad_data, ad_data_length);
+	}
+
+	g_mutex_unlock(&table->mutex);
+}
+
+void gattlib_scan_table_prune(struct gattlib_scan_table *table, uint64_t max_age_ms) {
+	uint64_t now = g_get_monotonic_time() / 1000;
+	size_t i = 0;
+
+	if ((table == NULL) || (now < max_age_ms)) {
+		return;
+	}
+
+	g_mutex_lock(&table->mutex);
+
+	while (i < table->capacity) {
+		if ((table->keys[i] != 0) && (now - table->slots[i].entry.last_seen >= max_age_ms)) {
+			// The removal moves back the following entries into this slot: check it again
+			scan_table_remove_slot(table, i);
+		} else {
+			i++;
+		}
+	}
+
+	g_mutex_unlock(&table->mutex);
+}
+
+size_t gattlib_scan_table_snapshot(struct gattlib_scan_table *table, gattlib_scan_entry_t *out, size_t max) {
+	size_t count = 0;
+
+	g_mutex_lock(&table->mutex);
+
+	for (size_t i = 0; (i < table->capacity) && (count < max); i++) {
+		if (table->keys[i] == 0) {
+			continue;
+		}
+
+		const struct gattlib_scan_table_slot *slot = &table->slots[i];
+
+		out[count] = slot->entry;
+		out[count].rssi_average = slot->rssi_average / (1 << SCAN_TABLE_FIXED_POINT_SHIFT);
+		if (slot->interval_average > 0) {
+			// Convert the average interval (in ms, fixed-point) into milli-Hertz
+			out[count].advertisement_rate = (uint32_t)((1000000ULL << SCAN_TABLE_FIXED_POINT_SHIFT) / slot->interval_average);
+		} else {
+			out[count].advertisement_rate = 0;
+		}
+		count++;
+	}
+
+	g_mutex_unlock(&table->mutex);
+
+	return count;
+}
+
+int gattlib_scan_table_enable(void *adapter, size_t max_devices, unsigned int rssi_smoothing) {
+	struct gattlib_scan_table **table_ptr;
+	struct gattlib_scan_table *table;
+	int ret = GATTLIB_SUCCESS;
+
+	if ((adapter == NULL) || (max_devices == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	table = gattlib_scan_table_new(max_devices, rssi_smoothing);
+	if (table == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	table_ptr = gattlib_adapter_scan_table_ptr(adapter);
+
+	g_mutex_lock(&m_scan_table_ptr_mutex);
+	if (*table_ptr != NULL) {
+		ret = GATTLIB_BUSY;
+	} else {
+		g_atomic_pointer_set(table_ptr, table);
+		table = NULL;
+	}
+	g_mutex_unlock(&m_scan_table_ptr_mutex);
+
+	gattlib_scan_table_unref(table);
+	return ret;
+}
+
+int gattlib_scan_table_disable(void *adapter) {
+	struct gattlib_scan_table **table_ptr;
+	struct gattlib_scan_table *table;
+
+	if (adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	table_ptr = gattlib_adapter_scan_table_ptr(adapter);
+
+	g_mutex_lock(&m_scan_table_ptr_mutex);
+	table = *table_ptr;
+	g_atomic_pointer_set(table_ptr, NULL);
+	g_mutex_unlock(&m_scan_table_ptr_mutex);
+
+	// The table is freed once the scanner or the snapshot using it have released it
+	gattlib_scan_table_unref(table);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_scan_snapshot(void *adapter, gattlib_scan_entry_t *entries, size_t max_entries, size_t *entries_count) {
+	struct gattlib_scan_table *table;
+
+	if ((adapter == NULL) || (entries_count == NULL) || ((entries == NULL) && (max_entries > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	table = gattlib_scan_table_get(gattlib_adapter_scan_table_ptr(adapter));
+	if (table == NULL) {
+		*entries_count = 0;
+		return GATTLIB_NOT_FOUND;
+	}
+
+	*entries_count = gattlib_scan_table_snapshot(table, entries, max_entries);
+	gattlib_scan_table_unref(table);
+	return GATTLIB_SUCCESS;
+}
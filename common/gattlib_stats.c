@@ -0,0 +1,53 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdint.h>
+
+#include "gattlib_internal.h"
+
+void gattlib_stats_operation_done(gattlib_connection_stats_t *stats, gattlib_stats_operation_t operation, int ret) {
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_INC(stats->operations[operation].completed);
+	} else {
+		GATTLIB_STATS_INC(stats->operations[operation].failed);
+	}
+}
+
+void gattlib_stats_copy(void *dst, const void *src, size_t size) {
+	uint64_t *dst_counters = dst;
+	const uint64_t *src_counters = src;
+
+	// The counters are incremented concurrently, each of them must be loaded atomically
+	for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+		dst_counters[i] = __atomic_load_n(&src_counters[i], __ATOMIC_RELAXED);
+	}
+}
+
+int gattlib_get_stats(gatt_connection_t *connection, gattlib_connection_stats_t *stats) {
+	if ((connection == NULL) || (stats == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_stats_copy(stats, &connection->stats, sizeof(gattlib_connection_stats_t));
+	return GATTLIB_SUCCESS;
+}
@@ -0,0 +1,81 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gattlib_internal.h"
+
+static gattlib_trace_begin_cb_t m_trace_begin_cb;
+static gattlib_trace_end_cb_t m_trace_end_cb;
+static void* m_trace_user_data;
+
+int g_gattlib_trace_enabled;
+
+void gattlib_set_trace_hooks(gattlib_trace_begin_cb_t begin_cb, gattlib_trace_end_cb_t end_cb, void *user_data) {
+	// Disable the tracing while the hooks are changed
+	__atomic_store_n(&g_gattlib_trace_enabled, 0, __ATOMIC_SEQ_CST);
+
+	__atomic_store_n(&m_trace_begin_cb, begin_cb, __ATOMIC_RELAXED);
+	__atomic_store_n(&m_trace_end_cb, end_cb, __ATOMIC_RELAXED);
+	__atomic_store_n(&m_trace_user_data, user_data, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&g_gattlib_trace_enabled, (begin_cb != NULL) || (end_cb != NULL), __ATOMIC_SEQ_CST);
+}
+
+bool gattlib_trace_begin(gattlib_trace_event_t *event, gattlib_trace_operation_t operation, gatt_connection_t *connection,
+		const char *mac_address, uint16_t handle, const uuid_t *uuid, size_t length)
+{
+	gattlib_trace_begin_cb_t begin_cb = __atomic_load_n(&m_trace_begin_cb, __ATOMIC_RELAXED);
+
+	event->operation = operation;
+	event->connection = connection;
+	if (mac_address != NULL) {
+		event->mac_address = mac_address;
+	} else if ((connection != NULL) && (connection->device_address[0] != '\0')) {
+		event->mac_address = connection->device_address;
+	} else {
+		event->mac_address = NULL;
+	}
+	event->handle = handle;
+	event->uuid = uuid;
+	event->length = length;
+	event->begin_us = g_get_monotonic_time();
+	event->end_us = 0;
+	event->result = GATTLIB_SUCCESS;
+	event->context = NULL;
+
+	if (begin_cb != NULL) {
+		begin_cb(event, __atomic_load_n(&m_trace_user_data, __ATOMIC_RELAXED));
+	}
+	return true;
+}
+
+void gattlib_trace_end(gattlib_trace_event_t *event, int result, size_t length) {
+	gattlib_trace_end_cb_t end_cb = __atomic_load_n(&m_trace_end_cb, __ATOMIC_RELAXED);
+
+	event->end_us = g_get_monotonic_time();
+	event->result = result;
+	event->length = length;
+
+	if (end_cb != NULL) {
+		end_cb(event, __atomic_load_n(&m_trace_user_data, __ATOMIC_RELAXED));
+	}
+}
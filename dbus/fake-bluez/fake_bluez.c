@@ -0,0 +1,1401 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// Fake 'org.bluez' service to run the DBus backend of gattlib without Bluetooth hardware.
+//
+// The service owns 'org.bluez' on the system bus given by 'DBUS_SYSTEM_BUS_ADDRESS' (see 'run-with-fake-bluez.sh'
+// to start it on a private dbus-daemon) and exports an adapter with the devices described by a configuration
+// file (see 'fake-bluez.conf'). The devices are known from the start, advertise while the adapter is discovering
+// and expose their GATT database once connected. The advertisement monitors registered to the adapter are
+// notified of the devices whose advertising data match their patterns.
+//
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <glib-unix.h>
+
+#include "org-bluez-adaptater1.h"
+#include "org-bluez-advertisementmonitormanager1.h"
+#include "org-bluez-device1.h"
+#include "org-bluez-gattcharacteristic1.h"
+#include "org-bluez-gattdescriptor1.h"
+#include "org-bluez-gattservice1.h"
+
+#define FAKE_BLUEZ_DEFAULT_ADAPTER                  "hci0"
+#define FAKE_BLUEZ_DEFAULT_ADAPTER_ADDRESS          "00:00:00:00:00:01"
+#define FAKE_BLUEZ_DEFAULT_RSSI                     -60
+#define FAKE_BLUEZ_DEFAULT_ADVERTISING_INTERVAL_MS  100
+#define FAKE_BLUEZ_MTU                              247
+
+struct fake_device;
+
+struct fake_descriptor {
+	struct fake_device *device;
+
+	char *uuid;
+	uint16_t handle;
+	GByteArray *value;
+
+	char *object_path;
+	GDBusObjectSkeleton *object;
+	OrgBluezGattDescriptor1 *descriptor1;
+};
+
+struct fake_characteristic {
+	struct fake_device *device;
+
+	char *uuid;
+	char *service_uuid;
+	char **flags;
+	uint16_t handle;
+	GByteArray *value;
+
+	// Notifications sent every 'notify_interval_ms' once enabled (0 to disable them)
+	uint32_t notify_interval_ms;
+	// Replace the first 4 bytes of the notified value by a little-endian sequence number
+	bool notify_sequence;
+	uint32_t sequence;
+	guint notify_timeout_id;
+	bool notifying;
+
+	// Sockets returned by 'AcquireNotify' and 'AcquireWrite' (-1 when not acquired)
+	int notify_fd;
+	int write_fd;
+	guint write_fd_source_id;
+
+	GSList *descriptors;
+
+	char *object_path;
+	GDBusObjectSkeleton *object;
+	OrgBluezGattCharacteristic1 *characteristic1;
+};
+
+struct fake_service {
+	char *uuid;
+	bool primary;
+	uint16_t handle;
+
+	GSList *characteristics;
+
+	char *object_path;
+	GDBusObjectSkeleton *object;
+	OrgBluezGattService1 *service1;
+};
+
+struct fake_device {
+	char *address;
+	char *address_type;
+	char *name;
+	int16_t rssi;
+
+	// Delay of the replies to the DBus method calls of the device
+	uint32_t latency_ms;
+
+	// Period of the advertisements while the adapter is discovering
+	uint32_t advertising_interval_ms;
+	guint advertising_timeout_id;
+	unsigned int advertising_count;
+
+	int manufacturer_id;
+	GByteArray *manufacturer_data;
+
+	// The device stops advertising 'advertising_duration_ms' after being found by a monitor (0 to advertise forever)
+	uint32_t advertising_duration_ms;
+	guint advertising_end_timeout_id;
+	bool advertising_ended;
+
+	bool connected;
+	GSList *services;
+
+	char *object_path;
+	GDBusObjectSkeleton *object;
+	OrgBluezDevice1 *device1;
+};
+
+// Application registered with 'RegisterMonitor'. Its monitors are the objects exported under its root path.
+struct fake_monitor_application {
+	char *owner;
+	char *path;
+	GCancellable *cancellable;
+	GDBusObjectManager *object_manager;
+	GSList *monitors;
+};
+
+struct fake_monitor {
+	struct fake_monitor_application *application;
+	GDBusProxy *proxy;
+	// Devices reported by 'DeviceFound' and not lost yet
+	GSList *found_devices;
+};
+
+// Reply to a method call sent once the latency of the device has elapsed
+struct fake_reply {
+	GDBusMethodInvocation *invocation;
+	GVariant *parameters;
+	GUnixFDList *fd_list;
+	void (*action)(struct fake_device *device);
+	struct fake_device *device;
+};
+
+static char *g_adapter_name;
+static char *g_adapter_address;
+static char *g_adapter_path;
+static OrgBluezAdapter1 *g_adapter1;
+static OrgBluezAdvertisementMonitorManager1 *g_advertisement_monitor_manager1;
+static GSList *g_monitor_applications;
+
+static GDBusConnection *g_connection;
+static GDBusObjectManagerServer *g_object_manager;
+static GSList *g_devices;
+static GMainLoop *g_main_loop;
+
+//
+// Helpers
+//
+
+static GByteArray *parse_hex_bytes(const char *str) {
+	GByteArray *bytes = g_byte_array_new();
+
+	while ((str != NULL) && (*str != '\0')) {
+		char *end;
+		unsigned long byte;
+		guint8 value;
+
+		while ((*str == ' ') || (*str == ':')) {
+			str++;
+		}
+		if (*str == '\0') {
+			break;
+		}
+
+		byte = strtoul(str, &end, 16);
+		if ((end == str) || (byte > 0xFF)) {
+			fprintf(stderr, "Invalid byte in '%s'.\n", str);
+			break;
+		}
+		value = byte;
+		g_byte_array_append(bytes, &value, 1);
+		str = end;
+	}
+
+	return bytes;
+}
+
+static GVariant *byte_array_to_variant(const GByteArray *bytes) {
+	return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, bytes->data, bytes->len, sizeof(guint8));
+}
+
+static void byte_array_set_from_variant(GByteArray *bytes, GVariant *value) {
+	gsize length;
+	const guint8 *data = g_variant_get_fixed_array(value, &length, sizeof(guint8));
+
+	g_byte_array_set_size(bytes, 0);
+	g_byte_array_append(bytes, data, length);
+}
+
+static void reply_free(struct fake_reply *reply) {
+	if (reply->fd_list != NULL) {
+		g_object_unref(reply->fd_list);
+	}
+	free(reply);
+}
+
+static gboolean on_reply_timeout(gpointer user_data) {
+	struct fake_reply *reply = user_data;
+
+	if (reply->action != NULL) {
+		reply->action(reply->device);
+	}
+
+	if (reply->fd_list != NULL) {
+		g_dbus_method_invocation_return_value_with_unix_fd_list(reply->invocation, reply->parameters, reply->fd_list);
+	} else {
+		g_dbus_method_invocation_return_value(reply->invocation, reply->parameters);
+	}
+
+	reply_free(reply);
+	return FALSE;
+}
+
+/*
+ * Reply to the method call after the latency of the device. The action is executed just before the reply.
+ */
+static void reply_after_latency(struct fake_device *device, GDBusMethodInvocation *invocation, GVariant *parameters,
+		GUnixFDList *fd_list, void (*action)(struct fake_device *device))
+{
+	struct fake_reply *reply = calloc(1, sizeof(struct fake_reply));
+
+	if (reply == NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.Failed", "Out of memory");
+		return;
+	}
+
+	reply->invocation = invocation;
+	reply->parameters = parameters;
+	reply->fd_list = (fd_list != NULL) ? g_object_ref(fd_list) : NULL;
+	reply->action = action;
+	reply->device = device;
+
+	if ((device == NULL) || (device->latency_ms == 0)) {
+		on_reply_timeout(reply);
+	} else {
+		g_timeout_add(device->latency_ms, on_reply_timeout, reply);
+	}
+}
+
+static bool characteristic_has_flag(const struct fake_characteristic *characteristic, const char *flag) {
+	return (characteristic->flags != NULL) && g_strv_contains((const gchar *const *)characteristic->flags, flag);
+}
+
+static void emit_properties_changed(const char *object_path, const char *interface_name, const char *property_name, GVariant *value) {
+	GVariantBuilder changed_properties;
+
+	g_variant_builder_init(&changed_properties, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&changed_properties, "{sv}", property_name, value);
+
+	g_dbus_connection_emit_signal(g_connection, NULL, object_path,
+			"org.freedesktop.DBus.Properties", "PropertiesChanged",
+			g_variant_new("(sa{sv}as)", interface_name, &changed_properties, NULL),
+			NULL);
+}
+
+//
+// GATT Descriptors
+//
+
+static gboolean on_descriptor_read_value(OrgBluezGattDescriptor1 *descriptor1, GDBusMethodInvocation *invocation,
+		GVariant *options, gpointer user_data)
+{
+	struct fake_descriptor *descriptor = user_data;
+
+	reply_after_latency(descriptor->device, invocation, g_variant_new("(@ay)", byte_array_to_variant(descriptor->value)), NULL, NULL);
+	return TRUE;
+}
+
+static gboolean on_descriptor_write_value(OrgBluezGattDescriptor1 *descriptor1, GDBusMethodInvocation *invocation,
+		GVariant *value, GVariant *options, gpointer user_data)
+{
+	struct fake_descriptor *descriptor = user_data;
+
+	byte_array_set_from_variant(descriptor->value, value);
+	reply_after_latency(descriptor->device, invocation, NULL, NULL, NULL);
+	return TRUE;
+}
+
+//
+// GATT Characteristics
+//
+
+static void characteristic_notify(struct fake_characteristic *characteristic) {
+	if (characteristic->notify_sequence && (characteristic->value->len >= 4)) {
+		characteristic->value->data[0] = characteristic->sequence & 0xFF;
+		characteristic->value->data[1] = (characteristic->sequence >> 8) & 0xFF;
+		characteristic->value->data[2] = (characteristic->sequence >> 16) & 0xFF;
+		characteristic->value->data[3] = (characteristic->sequence >> 24) & 0xFF;
+	}
+	characteristic->sequence++;
+
+	if (characteristic->notify_fd >= 0) {
+		if (send(characteristic->notify_fd, characteristic->value->data, characteristic->value->len, MSG_DONTWAIT) < 0) {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				// The client has closed its side of the socket
+				close(characteristic->notify_fd);
+				characteristic->notify_fd = -1;
+				org_bluez_gatt_characteristic1_set_notify_acquired(characteristic->characteristic1, FALSE);
+			}
+		}
+	} else if (characteristic->notifying) {
+		// The value is emitted even if it has not changed as Bluez does for every notification
+		emit_properties_changed(characteristic->object_path, "org.bluez.GattCharacteristic1", "Value",
+				byte_array_to_variant(characteristic->value));
+	}
+}
+
+static gboolean on_notify_timeout(gpointer user_data) {
+	struct fake_characteristic *characteristic = user_data;
+
+	characteristic_notify(characteristic);
+	if (!characteristic->notifying && (characteristic->notify_fd < 0)) {
+		characteristic->notify_timeout_id = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void characteristic_notify_start(struct fake_characteristic *characteristic) {
+	if ((characteristic->notify_interval_ms > 0) && (characteristic->notify_timeout_id == 0)) {
+		characteristic->notify_timeout_id = g_timeout_add(characteristic->notify_interval_ms, on_notify_timeout, characteristic);
+	}
+}
+
+static void characteristic_notify_stop(struct fake_characteristic *characteristic) {
+	characteristic->notifying = false;
+	if (characteristic->notify_fd >= 0) {
+		close(characteristic->notify_fd);
+		characteristic->notify_fd = -1;
+	}
+	if (characteristic->notify_timeout_id != 0) {
+		g_source_remove(characteristic->notify_timeout_id);
+		characteristic->notify_timeout_id = 0;
+	}
+	if (characteristic->write_fd_source_id != 0) {
+		g_source_remove(characteristic->write_fd_source_id);
+		characteristic->write_fd_source_id = 0;
+	}
+	if (characteristic->write_fd >= 0) {
+		close(characteristic->write_fd);
+		characteristic->write_fd = -1;
+	}
+}
+
+static gboolean on_characteristic_read_value(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		GVariant *options, gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+
+	if (!characteristic_has_flag(characteristic, "read")) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotPermitted", "Read not permitted");
+		return TRUE;
+	}
+
+	reply_after_latency(characteristic->device, invocation,
+			g_variant_new("(@ay)", byte_array_to_variant(characteristic->value)), NULL, NULL);
+	return TRUE;
+}
+
+static gboolean on_characteristic_write_value(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		GVariant *value, GVariant *options, gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+
+	if (!characteristic_has_flag(characteristic, "write") && !characteristic_has_flag(characteristic, "write-without-response")) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotPermitted", "Write not permitted");
+		return TRUE;
+	}
+
+	byte_array_set_from_variant(characteristic->value, value);
+	reply_after_latency(characteristic->device, invocation, NULL, NULL, NULL);
+	return TRUE;
+}
+
+static gboolean on_characteristic_start_notify(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+
+	if (!characteristic_has_flag(characteristic, "notify") && !characteristic_has_flag(characteristic, "indicate")) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotSupported", "Notify not supported");
+		return TRUE;
+	}
+
+	characteristic->notifying = true;
+	org_bluez_gatt_characteristic1_set_notifying(characteristic1, TRUE);
+	characteristic_notify_start(characteristic);
+
+	reply_after_latency(characteristic->device, invocation, NULL, NULL, NULL);
+	return TRUE;
+}
+
+static gboolean on_characteristic_stop_notify(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+
+	characteristic->notifying = false;
+	org_bluez_gatt_characteristic1_set_notifying(characteristic1, FALSE);
+
+	reply_after_latency(characteristic->device, invocation, NULL, NULL, NULL);
+	return TRUE;
+}
+
+static gboolean on_write_fd_event(gint fd, GIOCondition condition, gpointer user_data) {
+	struct fake_characteristic *characteristic = user_data;
+	uint8_t buffer[FAKE_BLUEZ_MTU];
+	ssize_t length;
+
+	if (condition & G_IO_IN) {
+		length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (length > 0) {
+			g_byte_array_set_size(characteristic->value, 0);
+			g_byte_array_append(characteristic->value, buffer, length);
+			return TRUE;
+		}
+	}
+
+	// The client has released the write access
+	close(characteristic->write_fd);
+	characteristic->write_fd = -1;
+	characteristic->write_fd_source_id = 0;
+	org_bluez_gatt_characteristic1_set_write_acquired(characteristic->characteristic1, FALSE);
+	return FALSE;
+}
+
+/*
+ * Create a socket pair. The first socket is kept by the service, the second one is returned in the FD list.
+ */
+static GUnixFDList *create_socket_pair(int *local_fd) {
+	GUnixFDList *fd_list;
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		fprintf(stderr, "Failed to create the socket pair: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	// The list takes the ownership of the remote socket
+	fd_list = g_unix_fd_list_new_from_array(&fds[1], 1);
+	*local_fd = fds[0];
+	return fd_list;
+}
+
+static gboolean on_characteristic_acquire_write(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		GUnixFDList *in_fd_list, GVariant *options, gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+	GUnixFDList *fd_list;
+
+	if (!characteristic_has_flag(characteristic, "write-without-response")) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotSupported", "Write without response not supported");
+		return TRUE;
+	} else if (characteristic->write_fd >= 0) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotPermitted", "Write already acquired");
+		return TRUE;
+	}
+
+	fd_list = create_socket_pair(&characteristic->write_fd);
+	if (fd_list == NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.Failed", "Failed to create the socket");
+		return TRUE;
+	}
+
+	characteristic->write_fd_source_id = g_unix_fd_add(characteristic->write_fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+			on_write_fd_event, characteristic);
+	org_bluez_gatt_characteristic1_set_write_acquired(characteristic1, TRUE);
+
+	reply_after_latency(characteristic->device, invocation, g_variant_new("(hq)", 0, FAKE_BLUEZ_MTU), fd_list, NULL);
+	g_object_unref(fd_list);
+	return TRUE;
+}
+
+static gboolean on_characteristic_acquire_notify(OrgBluezGattCharacteristic1 *characteristic1, GDBusMethodInvocation *invocation,
+		GVariant *options, gpointer user_data)
+{
+	struct fake_characteristic *characteristic = user_data;
+	GUnixFDList *fd_list;
+
+	if (!characteristic_has_flag(characteristic, "notify")) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotSupported", "Notify not supported");
+		return TRUE;
+	} else if ((characteristic->notify_fd >= 0) || characteristic->notifying) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.NotPermitted", "Notify already enabled");
+		return TRUE;
+	}
+
+	fd_list = create_socket_pair(&characteristic->notify_fd);
+	if (fd_list == NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.Failed", "Failed to create the socket");
+		return TRUE;
+	}
+
+	org_bluez_gatt_characteristic1_set_notify_acquired(characteristic1, TRUE);
+	characteristic_notify_start(characteristic);
+
+	// 'AcquireNotify' has no 'UnixFD' annotation: the FD list is attached to the reply directly
+	reply_after_latency(characteristic->device, invocation, g_variant_new("(hq)", 0, FAKE_BLUEZ_MTU), fd_list, NULL);
+	g_object_unref(fd_list);
+	return TRUE;
+}
+
+//
+// Export of the GATT database of the devices
+//
+
+static void device_export_gatt(struct fake_device *device) {
+	GPtrArray *service_paths = g_ptr_array_new();
+
+	for (GSList *s = device->services; s != NULL; s = s->next) {
+		struct fake_service *service = s->data;
+		GPtrArray *characteristic_paths = g_ptr_array_new();
+
+		service->object_path = g_strdup_printf("%s/service%04x", device->object_path, service->handle);
+		g_ptr_array_add(service_paths, service->object_path);
+
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct fake_characteristic *characteristic = c->data;
+			GPtrArray *descriptor_paths = g_ptr_array_new();
+
+			characteristic->object_path = g_strdup_printf("%s/char%04x", service->object_path, characteristic->handle);
+			g_ptr_array_add(characteristic_paths, characteristic->object_path);
+
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				struct fake_descriptor *descriptor = d->data;
+
+				descriptor->object_path = g_strdup_printf("%s/desc%04x", characteristic->object_path, descriptor->handle);
+				g_ptr_array_add(descriptor_paths, descriptor->object_path);
+
+				descriptor->descriptor1 = org_bluez_gatt_descriptor1_skeleton_new();
+				org_bluez_gatt_descriptor1_set_uuid(descriptor->descriptor1, descriptor->uuid);
+				org_bluez_gatt_descriptor1_set_characteristic(descriptor->descriptor1, characteristic->object_path);
+				g_signal_connect(descriptor->descriptor1, "handle-read-value", G_CALLBACK(on_descriptor_read_value), descriptor);
+				g_signal_connect(descriptor->descriptor1, "handle-write-value", G_CALLBACK(on_descriptor_write_value), descriptor);
+
+				descriptor->object = g_dbus_object_skeleton_new(descriptor->object_path);
+				g_dbus_object_skeleton_add_interface(descriptor->object, G_DBUS_INTERFACE_SKELETON(descriptor->descriptor1));
+			}
+			g_ptr_array_add(descriptor_paths, NULL);
+
+			characteristic->characteristic1 = org_bluez_gatt_characteristic1_skeleton_new();
+			org_bluez_gatt_characteristic1_set_uuid(characteristic->characteristic1, characteristic->uuid);
+			org_bluez_gatt_characteristic1_set_service(characteristic->characteristic1, service->object_path);
+			org_bluez_gatt_characteristic1_set_flags(characteristic->characteristic1, (const gchar *const *)characteristic->flags);
+			org_bluez_gatt_characteristic1_set_descriptors(characteristic->characteristic1, (const gchar *const *)descriptor_paths->pdata);
+			g_signal_connect(characteristic->characteristic1, "handle-read-value", G_CALLBACK(on_characteristic_read_value), characteristic);
+			g_signal_connect(characteristic->characteristic1, "handle-write-value", G_CALLBACK(on_characteristic_write_value), characteristic);
+			g_signal_connect(characteristic->characteristic1, "handle-start-notify", G_CALLBACK(on_characteristic_start_notify), characteristic);
+			g_signal_connect(characteristic->characteristic1, "handle-stop-notify", G_CALLBACK(on_characteristic_stop_notify), characteristic);
+			g_signal_connect(characteristic->characteristic1, "handle-acquire-write", G_CALLBACK(on_characteristic_acquire_write), characteristic);
+			g_signal_connect(characteristic->characteristic1, "handle-acquire-notify", G_CALLBACK(on_characteristic_acquire_notify), characteristic);
+			g_ptr_array_free(descriptor_paths, TRUE);
+
+			characteristic->object = g_dbus_object_skeleton_new(characteristic->object_path);
+			g_dbus_object_skeleton_add_interface(characteristic->object, G_DBUS_INTERFACE_SKELETON(characteristic->characteristic1));
+		}
+		g_ptr_array_add(characteristic_paths, NULL);
+
+		service->service1 = org_bluez_gatt_service1_skeleton_new();
+		org_bluez_gatt_service1_set_uuid(service->service1, service->uuid);
+		org_bluez_gatt_service1_set_device(service->service1, device->object_path);
+		org_bluez_gatt_service1_set_primary(service->service1, service->primary);
+		org_bluez_gatt_service1_set_characteristics(service->service1, (const gchar *const *)characteristic_paths->pdata);
+		g_ptr_array_free(characteristic_paths, TRUE);
+
+		service->object = g_dbus_object_skeleton_new(service->object_path);
+		g_dbus_object_skeleton_add_interface(service->object, G_DBUS_INTERFACE_SKELETON(service->service1));
+	}
+	g_ptr_array_add(service_paths, NULL);
+
+	// Export the objects once their properties are complete. Bluez exports the services first.
+	for (GSList *s = device->services; s != NULL; s = s->next) {
+		struct fake_service *service = s->data;
+
+		g_dbus_object_manager_server_export(g_object_manager, service->object);
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct fake_characteristic *characteristic = c->data;
+
+			g_dbus_object_manager_server_export(g_object_manager, characteristic->object);
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				g_dbus_object_manager_server_export(g_object_manager, ((struct fake_descriptor *)d->data)->object);
+			}
+		}
+	}
+
+	org_bluez_device1_set_gatt_services(device->device1, (const gchar *const *)service_paths->pdata);
+	g_ptr_array_free(service_paths, TRUE);
+}
+
+static void device_unexport_gatt(struct fake_device *device) {
+	for (GSList *s = device->services; s != NULL; s = s->next) {
+		struct fake_service *service = s->data;
+
+		if (service->object == NULL) {
+			continue;
+		}
+
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct fake_characteristic *characteristic = c->data;
+
+			characteristic_notify_stop(characteristic);
+
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				struct fake_descriptor *descriptor = d->data;
+
+				g_dbus_object_manager_server_unexport(g_object_manager, descriptor->object_path);
+				g_clear_object(&descriptor->object);
+				g_clear_object(&descriptor->descriptor1);
+				g_clear_pointer(&descriptor->object_path, g_free);
+			}
+
+			g_dbus_object_manager_server_unexport(g_object_manager, characteristic->object_path);
+			g_clear_object(&characteristic->object);
+			g_clear_object(&characteristic->characteristic1);
+			g_clear_pointer(&characteristic->object_path, g_free);
+		}
+
+		g_dbus_object_manager_server_unexport(g_object_manager, service->object_path);
+		g_clear_object(&service->object);
+		g_clear_object(&service->service1);
+		g_clear_pointer(&service->object_path, g_free);
+	}
+
+	org_bluez_device1_set_gatt_services(device->device1, NULL);
+}
+
+//
+// Devices
+//
+
+static gboolean on_services_resolved_timeout(gpointer user_data) {
+	struct fake_device *device = user_data;
+
+	if (device->connected) {
+		org_bluez_device1_set_services_resolved(device->device1, TRUE);
+	}
+	return FALSE;
+}
+
+static void device_connect(struct fake_device *device) {
+	if (device->connected) {
+		return;
+	}
+
+	device->connected = true;
+	device_export_gatt(device);
+	org_bluez_device1_set_connected(device->device1, TRUE);
+
+	// As Bluez, the services are resolved after the reply to 'Connect'
+	g_timeout_add(device->latency_ms, on_services_resolved_timeout, device);
+}
+
+static void device_disconnect(struct fake_device *device) {
+	if (!device->connected) {
+		return;
+	}
+
+	device->connected = false;
+	org_bluez_device1_set_services_resolved(device->device1, FALSE);
+	device_unexport_gatt(device);
+	org_bluez_device1_set_connected(device->device1, FALSE);
+}
+
+static gboolean on_device_connect(OrgBluezDevice1 *device1, GDBusMethodInvocation *invocation, gpointer user_data) {
+	struct fake_device *device = user_data;
+
+	reply_after_latency(device, invocation, NULL, NULL, device_connect);
+	return TRUE;
+}
+
+static gboolean on_device_disconnect(OrgBluezDevice1 *device1, GDBusMethodInvocation *invocation, gpointer user_data) {
+	struct fake_device *device = user_data;
+
+	reply_after_latency(device, invocation, NULL, NULL, device_disconnect);
+	return TRUE;
+}
+
+static gboolean on_advertising_timeout(gpointer user_data) {
+	struct fake_device *device = user_data;
+
+	// Alternate the RSSI to have Bluez-like property changes for every advertisement
+	device->advertising_count++;
+	org_bluez_device1_set_rssi(device->device1, device->rssi - (device->advertising_count & 1));
+	return TRUE;
+}
+
+static void device_export(struct fake_device *device) {
+	GVariantBuilder manufacturer_data;
+	GPtrArray *uuids = g_ptr_array_new();
+
+	device->object_path = g_strdup_printf("%s/dev_%s", g_adapter_path, device->address);
+	for (char *c = device->object_path + strlen(g_adapter_path); *c != '\0'; c++) {
+		if (*c == ':') {
+			*c = '_';
+		}
+	}
+
+	for (GSList *s = device->services; s != NULL; s = s->next) {
+		g_ptr_array_add(uuids, ((struct fake_service *)s->data)->uuid);
+	}
+	g_ptr_array_add(uuids, NULL);
+
+	g_variant_builder_init(&manufacturer_data, G_VARIANT_TYPE("a{qv}"));
+	if (device->manufacturer_id >= 0) {
+		g_variant_builder_add(&manufacturer_data, "{qv}", (guint16)device->manufacturer_id,
+				byte_array_to_variant(device->manufacturer_data));
+	}
+
+	device->device1 = org_bluez_device1_skeleton_new();
+	org_bluez_device1_set_address(device->device1, device->address);
+	org_bluez_device1_set_address_type(device->device1, device->address_type);
+	org_bluez_device1_set_adapter(device->device1, g_adapter_path);
+	if (device->name != NULL) {
+		org_bluez_device1_set_name(device->device1, device->name);
+		org_bluez_device1_set_alias(device->device1, device->name);
+	}
+	org_bluez_device1_set_rssi(device->device1, device->rssi);
+	org_bluez_device1_set_uuids(device->device1, (const gchar *const *)uuids->pdata);
+	org_bluez_device1_set_manufacturer_data(device->device1, g_variant_builder_end(&manufacturer_data));
+	g_signal_connect(device->device1, "handle-connect", G_CALLBACK(on_device_connect), device);
+	g_signal_connect(device->device1, "handle-disconnect", G_CALLBACK(on_device_disconnect), device);
+	g_ptr_array_free(uuids, TRUE);
+
+	device->object = g_dbus_object_skeleton_new(device->object_path);
+	g_dbus_object_skeleton_add_interface(device->object, G_DBUS_INTERFACE_SKELETON(device->device1));
+	g_dbus_object_manager_server_export(g_object_manager, device->object);
+}
+
+static void device_unexport(struct fake_device *device) {
+	device_disconnect(device);
+
+	if (device->advertising_timeout_id != 0) {
+		g_source_remove(device->advertising_timeout_id);
+		device->advertising_timeout_id = 0;
+	}
+	if (device->advertising_end_timeout_id != 0) {
+		g_source_remove(device->advertising_end_timeout_id);
+		device->advertising_end_timeout_id = 0;
+	}
+
+	g_dbus_object_manager_server_unexport(g_object_manager, device->object_path);
+	g_clear_object(&device->object);
+	g_clear_object(&device->device1);
+	g_clear_pointer(&device->object_path, g_free);
+}
+
+//
+// Advertisement monitors
+//
+
+/*
+ * Return the data of the AD structure 'ad_type' the device advertises (name and manufacturer data)
+ */
+static GByteArray *device_get_ad_data(const struct fake_device *device, uint8_t ad_type) {
+	GByteArray *data = NULL;
+
+	if ((ad_type == 0x09) && (device->name != NULL)) {
+		data = g_byte_array_new();
+		g_byte_array_append(data, (const guint8 *)device->name, strlen(device->name));
+	} else if ((ad_type == 0xFF) && (device->manufacturer_id >= 0)) {
+		guint8 company_id[2] = { device->manufacturer_id & 0xFF, device->manufacturer_id >> 8 };
+
+		data = g_byte_array_new();
+		g_byte_array_append(data, company_id, sizeof(company_id));
+		g_byte_array_append(data, device->manufacturer_data->data, device->manufacturer_data->len);
+	}
+
+	return data;
+}
+
+/*
+ * As Bluez 'or_patterns' monitors, the device matches if any pattern is found in its advertising data
+ */
+static bool monitor_match_device(struct fake_monitor *monitor, const struct fake_device *device) {
+	GVariant *patterns = g_dbus_proxy_get_cached_property(monitor->proxy, "Patterns");
+	GVariantIter iter;
+	GVariant *content;
+	guint8 start_position, ad_type;
+	bool match = false;
+
+	if (patterns == NULL) {
+		return false;
+	}
+
+	g_variant_iter_init(&iter, patterns);
+	while (!match && g_variant_iter_next(&iter, "(yy@ay)", &start_position, &ad_type, &content)) {
+		GByteArray *data = device_get_ad_data(device, ad_type);
+		gsize content_length;
+		const guint8 *content_data = g_variant_get_fixed_array(content, &content_length, sizeof(guint8));
+
+		if (data != NULL) {
+			match = (start_position + content_length <= data->len) &&
+					(memcmp(data->data + start_position, content_data, content_length) == 0);
+			g_byte_array_unref(data);
+		}
+		g_variant_unref(content);
+	}
+
+	g_variant_unref(patterns);
+	return match;
+}
+
+static gboolean on_advertising_end_timeout(gpointer user_data) {
+	struct fake_device *device = user_data;
+
+	device->advertising_end_timeout_id = 0;
+	device->advertising_ended = true;
+
+	// The device is lost by the monitors that have found it
+	for (GSList *a = g_monitor_applications; a != NULL; a = a->next) {
+		struct fake_monitor_application *application = a->data;
+
+		for (GSList *m = application->monitors; m != NULL; m = m->next) {
+			struct fake_monitor *monitor = m->data;
+
+			if (g_slist_find(monitor->found_devices, device) != NULL) {
+				monitor->found_devices = g_slist_remove(monitor->found_devices, device);
+				g_dbus_proxy_call(monitor->proxy, "DeviceLost", g_variant_new("(o)", device->object_path),
+						G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+			}
+		}
+	}
+	return FALSE;
+}
+
+static void monitor_activate(struct fake_monitor *monitor) {
+	g_dbus_proxy_call(monitor->proxy, "Activate", NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if ((device->object == NULL) || device->advertising_ended || !monitor_match_device(monitor, device)) {
+			continue;
+		}
+
+		monitor->found_devices = g_slist_append(monitor->found_devices, device);
+		g_dbus_proxy_call(monitor->proxy, "DeviceFound", g_variant_new("(o)", device->object_path),
+				G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+
+		if ((device->advertising_duration_ms > 0) && (device->advertising_end_timeout_id == 0)) {
+			device->advertising_end_timeout_id = g_timeout_add(device->advertising_duration_ms, on_advertising_end_timeout, device);
+		}
+	}
+}
+
+static void monitor_free(struct fake_monitor *monitor) {
+	g_slist_free(monitor->found_devices);
+	g_object_unref(monitor->proxy);
+	free(monitor);
+}
+
+static void on_monitor_object_added(GDBusObjectManager *object_manager, GDBusObject *object, gpointer user_data) {
+	struct fake_monitor_application *application = user_data;
+	GDBusInterface *interface = g_dbus_object_get_interface(object, "org.bluez.AdvertisementMonitor1");
+	struct fake_monitor *monitor;
+	GVariant *type;
+
+	if (interface == NULL) {
+		return;
+	}
+
+	// Only the monitors of type 'or_patterns' are supported
+	type = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "Type");
+	if ((type == NULL) || (strcmp(g_variant_get_string(type, NULL), "or_patterns") != 0)) {
+		g_dbus_proxy_call(G_DBUS_PROXY(interface), "Release", NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+		g_clear_pointer(&type, g_variant_unref);
+		g_object_unref(interface);
+		return;
+	}
+	g_variant_unref(type);
+
+	monitor = calloc(1, sizeof(struct fake_monitor));
+	if (monitor == NULL) {
+		g_object_unref(interface);
+		return;
+	}
+
+	monitor->application = application;
+	monitor->proxy = G_DBUS_PROXY(interface);
+	application->monitors = g_slist_append(application->monitors, monitor);
+
+	monitor_activate(monitor);
+}
+
+static void on_monitor_object_removed(GDBusObjectManager *object_manager, GDBusObject *object, gpointer user_data) {
+	struct fake_monitor_application *application = user_data;
+
+	for (GSList *m = application->monitors; m != NULL; m = m->next) {
+		struct fake_monitor *monitor = m->data;
+
+		if (strcmp(g_dbus_proxy_get_object_path(monitor->proxy), g_dbus_object_get_object_path(object)) == 0) {
+			application->monitors = g_slist_delete_link(application->monitors, m);
+			monitor_free(monitor);
+			return;
+		}
+	}
+}
+
+static void on_monitor_application_ready(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+	struct fake_monitor_application *application = user_data;
+	GDBusObjectManager *object_manager;
+	GError *error = NULL;
+	GList *objects;
+
+	object_manager = g_dbus_object_manager_client_new_finish(result, &error);
+	if (object_manager == NULL) {
+		// The application might have been unregistered in the meantime
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			fprintf(stderr, "Failed to get the monitors of '%s': %s\n", application->path, error->message);
+		}
+		g_error_free(error);
+		return;
+	}
+
+	application->object_manager = object_manager;
+	g_signal_connect(object_manager, "object-added", G_CALLBACK(on_monitor_object_added), application);
+	g_signal_connect(object_manager, "object-removed", G_CALLBACK(on_monitor_object_removed), application);
+
+	objects = g_dbus_object_manager_get_objects(object_manager);
+	for (GList *l = objects; l != NULL; l = l->next) {
+		on_monitor_object_added(object_manager, l->data, application);
+	}
+	g_list_free_full(objects, g_object_unref);
+}
+
+static void monitor_application_free(struct fake_monitor_application *application) {
+	g_cancellable_cancel(application->cancellable);
+	g_object_unref(application->cancellable);
+	if (application->object_manager != NULL) {
+		g_signal_handlers_disconnect_by_data(application->object_manager, application);
+		g_object_unref(application->object_manager);
+	}
+	g_slist_free_full(application->monitors, (GDestroyNotify)monitor_free);
+	g_free(application->owner);
+	g_free(application->path);
+	free(application);
+}
+
+static struct fake_monitor_application *find_monitor_application(const char *owner, const char *path) {
+	for (GSList *l = g_monitor_applications; l != NULL; l = l->next) {
+		struct fake_monitor_application *application = l->data;
+
+		if ((strcmp(application->owner, owner) == 0) && (strcmp(application->path, path) == 0)) {
+			return application;
+		}
+	}
+	return NULL;
+}
+
+static gboolean on_register_monitor(OrgBluezAdvertisementMonitorManager1 *manager1, GDBusMethodInvocation *invocation,
+		const gchar *application_path, gpointer user_data)
+{
+	const char *owner = g_dbus_method_invocation_get_sender(invocation);
+	struct fake_monitor_application *application;
+
+	if (find_monitor_application(owner, application_path) != NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.AlreadyExists", "Already Exists");
+		return TRUE;
+	}
+
+	application = calloc(1, sizeof(struct fake_monitor_application));
+	if (application == NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.Failed", "Out of memory");
+		return TRUE;
+	}
+
+	application->owner = g_strdup(owner);
+	application->path = g_strdup(application_path);
+	application->cancellable = g_cancellable_new();
+	g_monitor_applications = g_slist_append(g_monitor_applications, application);
+
+	org_bluez_advertisement_monitor_manager1_complete_register_monitor(manager1, invocation);
+
+	// As Bluez, the monitors are retrieved once replied as the application serves 'GetManagedObjects' from its main loop
+	g_dbus_object_manager_client_new(g_connection, G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_DO_NOT_AUTO_START,
+			owner, application_path, NULL, NULL, NULL, application->cancellable, on_monitor_application_ready, application);
+	return TRUE;
+}
+
+static gboolean on_unregister_monitor(OrgBluezAdvertisementMonitorManager1 *manager1, GDBusMethodInvocation *invocation,
+		const gchar *application_path, gpointer user_data)
+{
+	struct fake_monitor_application *application =
+			find_monitor_application(g_dbus_method_invocation_get_sender(invocation), application_path);
+
+	if (application == NULL) {
+		g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.DoesNotExist", "Does Not Exist");
+		return TRUE;
+	}
+
+	g_monitor_applications = g_slist_remove(g_monitor_applications, application);
+	monitor_application_free(application);
+
+	org_bluez_advertisement_monitor_manager1_complete_unregister_monitor(manager1, invocation);
+	return TRUE;
+}
+
+//
+// Adapter
+//
+
+static gboolean on_adapter_start_discovery(OrgBluezAdapter1 *adapter1, GDBusMethodInvocation *invocation, gpointer user_data) {
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if ((device->object != NULL) && (device->advertising_timeout_id == 0) && (device->advertising_interval_ms > 0)) {
+			device->advertising_timeout_id = g_timeout_add(device->advertising_interval_ms, on_advertising_timeout, device);
+		}
+	}
+
+	org_bluez_adapter1_set_discovering(adapter1, TRUE);
+	org_bluez_adapter1_complete_start_discovery(adapter1, invocation);
+	return TRUE;
+}
+
+static gboolean on_adapter_stop_discovery(OrgBluezAdapter1 *adapter1, GDBusMethodInvocation *invocation, gpointer user_data) {
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if (device->advertising_timeout_id != 0) {
+			g_source_remove(device->advertising_timeout_id);
+			device->advertising_timeout_id = 0;
+		}
+	}
+
+	org_bluez_adapter1_set_discovering(adapter1, FALSE);
+	org_bluez_adapter1_complete_stop_discovery(adapter1, invocation);
+	return TRUE;
+}
+
+static gboolean on_adapter_set_discovery_filter(OrgBluezAdapter1 *adapter1, GDBusMethodInvocation *invocation,
+		GVariant *properties, gpointer user_data)
+{
+	// The filters are accepted but all the devices are reported
+	org_bluez_adapter1_complete_set_discovery_filter(adapter1, invocation);
+	return TRUE;
+}
+
+static gboolean on_adapter_remove_device(OrgBluezAdapter1 *adapter1, GDBusMethodInvocation *invocation,
+		const gchar *device_path, gpointer user_data)
+{
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if ((device->object_path != NULL) && (strcmp(device->object_path, device_path) == 0)) {
+			device_unexport(device);
+			org_bluez_adapter1_complete_remove_device(adapter1, invocation);
+			return TRUE;
+		}
+	}
+
+	g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.DoesNotExist", "Does Not Exist");
+	return TRUE;
+}
+
+static void adapter_export(void) {
+	const gchar *const monitor_types[] = { "or_patterns", NULL };
+	const gchar *const monitor_features[] = { NULL };
+	GDBusObjectSkeleton *object;
+
+	g_adapter1 = org_bluez_adapter1_skeleton_new();
+	org_bluez_adapter1_set_address(g_adapter1, g_adapter_address);
+	org_bluez_adapter1_set_address_type(g_adapter1, "public");
+	org_bluez_adapter1_set_name(g_adapter1, "gattlib-fake-bluez");
+	org_bluez_adapter1_set_alias(g_adapter1, "gattlib-fake-bluez");
+	org_bluez_adapter1_set_powered(g_adapter1, TRUE);
+	org_bluez_adapter1_set_discovering(g_adapter1, FALSE);
+	g_signal_connect(g_adapter1, "handle-start-discovery", G_CALLBACK(on_adapter_start_discovery), NULL);
+	g_signal_connect(g_adapter1, "handle-stop-discovery", G_CALLBACK(on_adapter_stop_discovery), NULL);
+	g_signal_connect(g_adapter1, "handle-set-discovery-filter", G_CALLBACK(on_adapter_set_discovery_filter), NULL);
+	g_signal_connect(g_adapter1, "handle-remove-device", G_CALLBACK(on_adapter_remove_device), NULL);
+
+	g_advertisement_monitor_manager1 = org_bluez_advertisement_monitor_manager1_skeleton_new();
+	org_bluez_advertisement_monitor_manager1_set_supported_monitor_types(g_advertisement_monitor_manager1, monitor_types);
+	org_bluez_advertisement_monitor_manager1_set_supported_features(g_advertisement_monitor_manager1, monitor_features);
+	g_signal_connect(g_advertisement_monitor_manager1, "handle-register-monitor", G_CALLBACK(on_register_monitor), NULL);
+	g_signal_connect(g_advertisement_monitor_manager1, "handle-unregister-monitor", G_CALLBACK(on_unregister_monitor), NULL);
+
+	object = g_dbus_object_skeleton_new(g_adapter_path);
+	g_dbus_object_skeleton_add_interface(object, G_DBUS_INTERFACE_SKELETON(g_adapter1));
+	g_dbus_object_skeleton_add_interface(object, G_DBUS_INTERFACE_SKELETON(g_advertisement_monitor_manager1));
+	g_dbus_object_manager_server_export(g_object_manager, object);
+	g_object_unref(object);
+}
+
+//
+// Configuration
+//
+
+static struct fake_device *find_device(const char *address) {
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if (g_ascii_strcasecmp(device->address, address) == 0) {
+			return device;
+		}
+	}
+	return NULL;
+}
+
+static struct fake_service *find_service(struct fake_device *device, const char *uuid) {
+	for (GSList *l = device->services; l != NULL; l = l->next) {
+		struct fake_service *service = l->data;
+
+		if (g_ascii_strcasecmp(service->uuid, uuid) == 0) {
+			return service;
+		}
+	}
+	return NULL;
+}
+
+static int load_device(GKeyFile *key_file, const char *group, const char *address) {
+	struct fake_device *device = calloc(1, sizeof(struct fake_device));
+	char *manufacturer_data;
+
+	if (device == NULL) {
+		return -1;
+	}
+
+	device->address = g_ascii_strup(address, -1);
+	device->address_type = g_key_file_get_string(key_file, group, "AddressType", NULL);
+	if (device->address_type == NULL) {
+		device->address_type = g_strdup("public");
+	}
+	device->name = g_key_file_get_string(key_file, group, "Name", NULL);
+	device->rssi = g_key_file_has_key(key_file, group, "RSSI", NULL) ?
+			g_key_file_get_integer(key_file, group, "RSSI", NULL) : FAKE_BLUEZ_DEFAULT_RSSI;
+	device->latency_ms = g_key_file_get_integer(key_file, group, "LatencyMs", NULL);
+	device->advertising_interval_ms = g_key_file_has_key(key_file, group, "AdvertisingIntervalMs", NULL) ?
+			g_key_file_get_integer(key_file, group, "AdvertisingIntervalMs", NULL) : FAKE_BLUEZ_DEFAULT_ADVERTISING_INTERVAL_MS;
+
+	device->manufacturer_id = -1;
+	if (g_key_file_has_key(key_file, group, "ManufacturerId", NULL)) {
+		char *manufacturer_id = g_key_file_get_string(key_file, group, "ManufacturerId", NULL);
+		device->manufacturer_id = strtol(manufacturer_id, NULL, 0);
+		g_free(manufacturer_id);
+	}
+	manufacturer_data = g_key_file_get_string(key_file, group, "ManufacturerData", NULL);
+	device->manufacturer_data = parse_hex_bytes(manufacturer_data);
+	g_free(manufacturer_data);
+	device->advertising_duration_ms = g_key_file_get_integer(key_file, group, "AdvertisingDurationMs", NULL);
+
+	g_devices = g_slist_append(g_devices, device);
+	return 0;
+}
+
+static int load_service(GKeyFile *key_file, const char *group, struct fake_device *device, const char *uuid) {
+	struct fake_service *service = calloc(1, sizeof(struct fake_service));
+
+	if (service == NULL) {
+		return -1;
+	}
+
+	service->uuid = g_ascii_strdown(uuid, -1);
+	service->primary = g_key_file_has_key(key_file, group, "Primary", NULL) ?
+			g_key_file_get_boolean(key_file, group, "Primary", NULL) : true;
+
+	device->services = g_slist_append(device->services, service);
+	return 0;
+}
+
+static int load_characteristic(GKeyFile *key_file, const char *group, struct fake_device *device, const char *uuid) {
+	struct fake_characteristic *characteristic;
+	struct fake_service *service;
+	char **descriptor_uuids;
+	char *service_uuid, *value;
+
+	service_uuid = g_key_file_get_string(key_file, group, "Service", NULL);
+	service = (service_uuid != NULL) ? find_service(device, service_uuid) : NULL;
+	g_free(service_uuid);
+	if (service == NULL) {
+		fprintf(stderr, "Missing or unknown 'Service' in '[%s]'.\n", group);
+		return -1;
+	}
+
+	characteristic = calloc(1, sizeof(struct fake_characteristic));
+	if (characteristic == NULL) {
+		return -1;
+	}
+
+	characteristic->device = device;
+	characteristic->uuid = g_ascii_strdown(uuid, -1);
+	characteristic->service_uuid = g_strdup(service->uuid);
+	characteristic->flags = g_key_file_get_string_list(key_file, group, "Flags", NULL, NULL);
+	characteristic->notify_interval_ms = g_key_file_get_integer(key_file, group, "NotifyIntervalMs", NULL);
+	characteristic->notify_sequence = g_key_file_get_boolean(key_file, group, "NotifySequence", NULL);
+	characteristic->notify_fd = -1;
+	characteristic->write_fd = -1;
+
+	value = g_key_file_get_string(key_file, group, "Value", NULL);
+	characteristic->value = parse_hex_bytes(value);
+	g_free(value);
+
+	descriptor_uuids = g_key_file_get_string_list(key_file, group, "Descriptors", NULL, NULL);
+	for (char **d = descriptor_uuids; (d != NULL) && (*d != NULL); d++) {
+		struct fake_descriptor *descriptor = calloc(1, sizeof(struct fake_descriptor));
+		if (descriptor == NULL) {
+			break;
+		}
+
+		descriptor->device = device;
+		descriptor->uuid = g_ascii_strdown(*d, -1);
+		descriptor->value = g_byte_array_new();
+		characteristic->descriptors = g_slist_append(characteristic->descriptors, descriptor);
+	}
+	g_strfreev(descriptor_uuids);
+
+	service->characteristics = g_slist_append(service->characteristics, characteristic);
+	return 0;
+}
+
+/*
+ * Assign the handles of the GATT database of the device in the order of the configuration
+ */
+static void device_assign_handles(struct fake_device *device) {
+	uint16_t handle = 0x0001;
+
+	for (GSList *s = device->services; s != NULL; s = s->next) {
+		struct fake_service *service = s->data;
+
+		service->handle = handle++;
+		for (GSList *c = service->characteristics; c != NULL; c = c->next) {
+			struct fake_characteristic *characteristic = c->data;
+
+			// The characteristic value follows its declaration
+			characteristic->handle = handle;
+			handle += 2;
+
+			for (GSList *d = characteristic->descriptors; d != NULL; d = d->next) {
+				((struct fake_descriptor *)d->data)->handle = handle++;
+			}
+		}
+	}
+}
+
+static int load_configuration(const char *filename) {
+	GKeyFile *key_file = g_key_file_new();
+	GError *error = NULL;
+	char **groups;
+	int ret = 0;
+
+	if (!g_key_file_load_from_file(key_file, filename, G_KEY_FILE_NONE, &error)) {
+		fprintf(stderr, "Failed to load '%s': %s\n", filename, error->message);
+		g_error_free(error);
+		g_key_file_free(key_file);
+		return -1;
+	}
+
+	g_adapter_name = g_key_file_get_string(key_file, "Adapter", "Name", NULL);
+	if (g_adapter_name == NULL) {
+		g_adapter_name = g_strdup(FAKE_BLUEZ_DEFAULT_ADAPTER);
+	}
+	g_adapter_address = g_key_file_get_string(key_file, "Adapter", "Address", NULL);
+	if (g_adapter_address == NULL) {
+		g_adapter_address = g_strdup(FAKE_BLUEZ_DEFAULT_ADAPTER_ADDRESS);
+	}
+	g_adapter_path = g_strdup_printf("/org/bluez/%s", g_adapter_name);
+
+	// The groups are '[Device <address>]', '[Service <address> <uuid>]' and '[Characteristic <address> <uuid>]'
+	groups = g_key_file_get_groups(key_file, NULL);
+	for (char **group = groups; (*group != NULL) && (ret == 0); group++) {
+		char **tokens = g_strsplit(*group, " ", 3);
+		struct fake_device *device = (tokens[0] && tokens[1]) ? find_device(tokens[1]) : NULL;
+
+		if (strcmp(tokens[0], "Adapter") == 0) {
+			// Already loaded
+		} else if ((strcmp(tokens[0], "Device") == 0) && (tokens[1] != NULL)) {
+			ret = load_device(key_file, *group, tokens[1]);
+		} else if ((device == NULL) || (tokens[2] == NULL)) {
+			fprintf(stderr, "Invalid group '[%s]': the device must be declared first.\n", *group);
+			ret = -1;
+		} else if (strcmp(tokens[0], "Service") == 0) {
+			ret = load_service(key_file, *group, device, tokens[2]);
+		} else if (strcmp(tokens[0], "Characteristic") == 0) {
+			ret = load_characteristic(key_file, *group, device, tokens[2]);
+		} else {
+			fprintf(stderr, "Unknown group '[%s]'.\n", *group);
+			ret = -1;
+		}
+
+		g_strfreev(tokens);
+	}
+	g_strfreev(groups);
+	g_key_file_free(key_file);
+
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		device_assign_handles(l->data);
+	}
+
+	return ret;
+}
+
+//
+// Main
+//
+
+static void on_bus_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+	g_connection = connection;
+
+	// Bluez exports its object manager on the root object
+	g_object_manager = g_dbus_object_manager_server_new("/");
+
+	adapter_export();
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		device_export(l->data);
+	}
+
+	g_dbus_object_manager_server_set_connection(g_object_manager, connection);
+}
+
+static void on_name_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+	printf("Fake Bluez ready with %u device(s) on adapter '%s'.\n", g_slist_length(g_devices), g_adapter_name);
+	fflush(stdout);
+}
+
+static void on_name_lost(GDBusConnection *connection, const gchar *name, gpointer user_data) {
+	fprintf(stderr, "Failed to own '%s' on the system bus. Is 'DBUS_SYSTEM_BUS_ADDRESS' set to a private bus?\n", name);
+	g_main_loop_quit(g_main_loop);
+}
+
+static gboolean on_terminate(gpointer user_data) {
+	g_main_loop_quit(g_main_loop);
+	return FALSE;
+}
+
+int main(int argc, char *argv[]) {
+	guint owner_id;
+
+	if (argc != 2) {
+		printf("%s <configuration file>\n", argv[0]);
+		return 1;
+	}
+
+	if (load_configuration(argv[1]) != 0) {
+		return 1;
+	}
+
+	g_main_loop = g_main_loop_new(NULL, FALSE);
+	g_unix_signal_add(SIGINT, on_terminate, NULL);
+	g_unix_signal_add(SIGTERM, on_terminate, NULL);
+
+	owner_id = g_bus_own_name(G_BUS_TYPE_SYSTEM, "org.bluez", G_BUS_NAME_OWNER_FLAGS_DO_NOT_QUEUE,
+			on_bus_acquired, on_name_acquired, on_name_lost, NULL, NULL);
+
+	g_main_loop_run(g_main_loop);
+
+	for (GSList *l = g_devices; l != NULL; l = l->next) {
+		struct fake_device *device = l->data;
+
+		if (device->object != NULL) {
+			device_unexport(device);
+		}
+	}
+
+	g_slist_free_full(g_monitor_applications, (GDestroyNotify)monitor_application_free);
+	g_monitor_applications = NULL;
+
+	g_bus_unown_name(owner_id);
+	g_clear_object(&g_object_manager);
+	g_clear_object(&g_advertisement_monitor_manager1);
+	g_clear_object(&g_adapter1);
+	g_main_loop_unref(g_main_loop);
+	return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Run a command against the fake Bluez service on a private dbus-daemon.
+#
+# Usage: run-with-fake-bluez.sh <gattlib-fake-bluez> <configuration> <command> [<args>...]
+#
+# The DBus backend of gattlib connects to the bus given by 'DBUS_SYSTEM_BUS_ADDRESS'.
+#
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 <gattlib-fake-bluez> <configuration> <command> [<args>...]" >&2
+	exit 1
+fi
+
+FAKE_BLUEZ=$1
+CONFIGURATION=$2
+shift 2
+
+# The session configuration lets any client own any name
+DBUS_DAEMON_INFO=$(dbus-daemon --session --fork --print-address=1 --print-pid=1) || exit 1
+DBUS_DAEMON_ADDRESS=$(echo "$DBUS_DAEMON_INFO" | sed -n 1p)
+DBUS_DAEMON_PID=$(echo "$DBUS_DAEMON_INFO" | sed -n 2p)
+
+export DBUS_SYSTEM_BUS_ADDRESS="$DBUS_DAEMON_ADDRESS"
+
+"$FAKE_BLUEZ" "$CONFIGURATION" &
+FAKE_BLUEZ_PID=$!
+
+trap 'kill $FAKE_BLUEZ_PID $DBUS_DAEMON_PID 2>/dev/null' EXIT INT TERM
+
+# Wait for the fake service to own 'org.bluez'
+for i in $(seq 50); do
+	if dbus-send --system --print-reply --dest=org.freedesktop.DBus /org/freedesktop/DBus \
+			org.freedesktop.DBus.NameHasOwner string:org.bluez 2>/dev/null | grep -q "boolean true"; then
+		break
+	fi
+	if ! kill -0 $FAKE_BLUEZ_PID 2>/dev/null; then
+		echo "The fake Bluez service has exited." >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+"$@"
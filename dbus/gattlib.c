@@ -29,14 +29,12 @@
 #include "gattlib_internal.h"
 
 #define CONNECT_TIMEOUT  4
+// Delay to gather the GATT objects added and removed by Bluez for a change of the GATT database
+#define SERVICE_CHANGED_DELAY_MS  200
 
 static const char *m_dbus_error_unknown_object = "GDBus.Error:org.freedesktop.DBus.Error.UnknownObject";
 
-gboolean on_handle_device_property_change(
-	    OrgBluezGattCharacteristic1 *object,
-	    GVariant *arg_changed_properties,
-	    const gchar *const *arg_invalidated_properties,
-	    gpointer user_data)
+static void on_handle_device_property_change(const char *object_path, GVariant *arg_changed_properties, void *user_data)
 {
 	gatt_connection_t* connection = user_data;
 	gattlib_context_t* conn_context = connection->context;
@@ -51,15 +49,26 @@ gboolean on_handle_device_property_change(
 		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
 			if (strcmp(key, "Connected") == 0) {
 				if (!g_variant_get_boolean(value)) {
+					conn_context->link_lost = true;
+
 					// Disconnection case
 					if (gattlib_has_valid_handler(&connection->disconnection)) {
 						gattlib_call_disconnection_handler(&connection->disconnection);
 					}
+				} else if (conn_context->link_lost) {
+					// Bluez has re-established the link of the open connection
+					conn_context->link_lost = false;
+					GATTLIB_STATS_INC(connection->stats.reconnects);
 				}
 			} else if (strcmp(key, "ServicesResolved") == 0) {
-				if (g_variant_get_boolean(value)) {
+				// Only the first resolution completes 'connect_device()'. The later ones happen
+				// after a service change or a re-established link of the open connection.
+				if (g_variant_get_boolean(value) && (conn_context->connection_loop != NULL)) {
 					// Stop the timeout for connection
-					g_source_remove(conn_context->connection_timeout);
+					if (conn_context->connection_timeout != 0) {
+						g_source_remove(conn_context->connection_timeout);
+						conn_context->connection_timeout = 0;
+					}
 
 					// Tell we are now connected
 					g_main_loop_quit(conn_context->connection_loop);
@@ -68,7 +77,16 @@ gboolean on_handle_device_property_change(
 		}
 		g_variant_iter_free(iter);
 	}
-	return TRUE;
+}
+
+static gboolean on_connection_timeout(gpointer user_data)
+{
+	gattlib_context_t* conn_context = user_data;
+
+	// The source is destroyed when returning FALSE. It must not be removed again.
+	conn_context->connection_timeout = 0;
+	g_main_loop_quit(conn_context->connection_loop);
+	return FALSE;
 }
 
 void get_device_path_from_mac_with_adapter(OrgBluezAdapter1* adapter, const char *mac_address, char *object_path, size_t object_path_len)
@@ -118,6 +136,137 @@ void get_device_path_from_mac(const char *adapter_name, const char *mac_address,
 	snprintf(object_path, object_path_len, "/org/bluez/%s/dev_%s", adapter, device_address_str);
 }
 
+/*
+ * Return true if the object is the device or one of its GATT objects (eg: '/org/bluez/hci0/dev_DA_94_40_95_E0_87/service0024')
+ */
+bool is_device_object_path(const char *device_object_path, const char *object_path)
+{
+	size_t device_object_path_len = strlen(device_object_path);
+
+	return (strncmp(object_path, device_object_path, device_object_path_len) == 0) &&
+	       ((object_path[device_object_path_len] == '\0') || (object_path[device_object_path_len] == '/'));
+}
+
+/*
+ * List of the DBus objects of the device (to be freed with 'g_list_free_full(objects, g_object_unref)')
+ */
+GList *get_device_objects(GDBusObjectManager *device_manager, const char *device_object_path)
+{
+	GList *objects = g_dbus_object_manager_get_objects(device_manager);
+	GList *device_objects = NULL;
+
+	for (GList *l = objects; l != NULL; l = l->next) {
+		GDBusObject *object = l->data;
+
+		if (is_device_object_path(device_object_path, g_dbus_object_get_object_path(object))) {
+			device_objects = g_list_prepend(device_objects, object);
+		} else {
+			g_object_unref(object);
+		}
+	}
+	g_list_free(objects);
+
+	return device_objects;
+}
+
+/*
+ * Object path of the GATT objects is in the form '/org/bluez/hci0/dev_DE_79_A2_A1_E9_FA/service0024/char0029'.
+ * We convert the last 4 hex characters into the handle
+ */
+static uint16_t get_handle_from_object_path(const char *object_path)
+{
+	size_t object_path_len = strlen(object_path);
+	unsigned int handle = 0;
+
+	if (object_path_len >= 4) {
+		sscanf(object_path + object_path_len - 4, "%x", &handle);
+	}
+	return handle;
+}
+
+static bool is_device_services_resolved(GDBusObjectManager *device_manager, const char *device_object_path)
+{
+	GDBusInterface *interface = g_dbus_object_manager_get_interface(device_manager, device_object_path, "org.bluez.Device1");
+	GVariant *value;
+	bool result = false;
+
+	if (interface == NULL) {
+		return false;
+	}
+
+	value = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "ServicesResolved");
+	if (value != NULL) {
+		result = g_variant_get_boolean(value);
+		g_variant_unref(value);
+	}
+	g_object_unref(interface);
+	return result;
+}
+
+static gboolean on_service_changed_timeout(gpointer user_data)
+{
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	conn_context->service_changed_timeout_id = 0;
+	gattlib_gatt_db_service_changed(connection, conn_context->service_changed_start, conn_context->service_changed_end, NULL);
+
+	return FALSE;
+}
+
+/*
+ * Bluez exports the result of the 'Service Changed' indications by adding and removing the GATT objects
+ * of the device. The handles of the objects added or removed in a row are reported as a single range.
+ */
+static void service_changed_track_object(gatt_connection_t* connection, GDBusObject *object)
+{
+	gattlib_context_t* conn_context = connection->context;
+	const char *object_path = g_dbus_object_get_object_path(object);
+	uint16_t handle;
+
+	// Ignore the device object itself and the objects added by the initial resolution of the services
+	if ((strcmp(object_path, conn_context->device_object_path) == 0) ||
+	    !is_device_services_resolved(conn_context->adapter->device_manager, conn_context->device_object_path)) {
+		return;
+	}
+
+	handle = get_handle_from_object_path(object_path);
+
+	if (conn_context->service_changed_timeout_id != 0) {
+		conn_context->service_changed_start = MIN(conn_context->service_changed_start, handle);
+		conn_context->service_changed_end = MAX(conn_context->service_changed_end, handle);
+	} else {
+		conn_context->service_changed_start = handle;
+		conn_context->service_changed_end = handle;
+		conn_context->service_changed_timeout_id = g_timeout_add(SERVICE_CHANGED_DELAY_MS,
+				on_service_changed_timeout, connection);
+	}
+}
+
+static void on_device_object_added(GDBusObjectManager *device_manager, GDBusObject *object, gpointer user_data)
+{
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+
+	if (is_device_object_path(conn_context->device_object_path, g_dbus_object_get_object_path(object))) {
+		conn_context->dbus_objects = g_list_prepend(conn_context->dbus_objects, g_object_ref(object));
+		service_changed_track_object(connection, object);
+	}
+}
+
+static void on_device_object_removed(GDBusObjectManager *device_manager, GDBusObject *object, gpointer user_data)
+{
+	gatt_connection_t* connection = user_data;
+	gattlib_context_t* conn_context = connection->context;
+	GList *link = g_list_find(conn_context->dbus_objects, object);
+
+	if (link != NULL) {
+		service_changed_track_object(connection, object);
+		g_object_unref(link->data);
+		conn_context->dbus_objects = g_list_delete_link(conn_context->dbus_objects, link);
+	}
+}
+
 /**
  * @param src		Local Adaptater interface
  * @param dst		Remote Bluetooth address
@@ -126,9 +275,10 @@ void get_device_path_from_mac(const char *adapter_name, const char *mac_address,
  * @param psm       Specify the PSM for GATT/ATT over BR/EDR
  * @param mtu       Specify the MTU size
  */
-gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
+static gatt_connection_t *connect_device(void* adapter, const char *dst, unsigned long options)
 {
 	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_scan_scheduler *scan_scheduler;
 	const char* adapter_name = NULL;
 	GDBusObjectManager *device_manager;
 	GError *error = NULL;
@@ -155,14 +305,18 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 	} else {
 		connection->context = conn_context;
 	}
+	strncpy(connection->device_address, dst, sizeof(connection->device_address) - 1);
 
+	// The changes of the device properties are received by the subscription below. The cached
+	// properties are still kept up to date by the proxy.
 	OrgBluezDevice1* device = org_bluez_device1_proxy_new_for_bus_sync(
 			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
 			"org.bluez",
 			object_path,
 			NULL,
 			&error);
+	GATTLIB_STATS_INC(connection->stats.dbus_proxies_created);
 	if (device == NULL) {
 		if (error) {
 			fprintf(stderr, "Failed to connect to DBus Bluez Device: %s\n", error->message);
@@ -175,14 +329,23 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 	}
 
 	// Register a handle for notification
-	g_signal_connect(device,
-		"g-properties-changed",
-		G_CALLBACK (on_handle_device_property_change),
-		connection);
+	conn_context->device_subscription = gattlib_properties_subscribe(object_path, "org.bluez.Device1",
+			on_handle_device_property_change, connection);
+	if (conn_context->device_subscription == NULL) {
+		fprintf(stderr, "Failed to subscribe to the property changes of '%s'\n", object_path);
+		goto FREE_DEVICE;
+	}
+
+	// Wait for the background scan of the adapter to leave the radio to the connection
+	scan_scheduler = (gattlib_adapter != NULL) ? gattlib_adapter->scan_scheduler : NULL;
+	gattlib_scan_scheduler_hold(scan_scheduler);
 
 	error = NULL;
+	GATTLIB_STATS_INC(connection->stats.dbus_calls);
 	org_bluez_device1_call_connect_sync(device, NULL, &error);
 	if (error) {
+		gattlib_scan_scheduler_release(scan_scheduler);
+
 		if (strncmp(error->message, m_dbus_error_unknown_object, strlen(m_dbus_error_unknown_object)) == 0) {
 			// You might have this error if the computer has not scanned or has not already had
 			// pairing information about the targetted device.
@@ -201,20 +364,27 @@ gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long
 	// and 'org.bluez.GattCharacteristic1' to be advertised at that moment.
 	conn_context->connection_loop = g_main_loop_new(NULL, 0);
 
-	conn_context->connection_timeout = g_timeout_add_seconds(CONNECT_TIMEOUT, stop_scan_func,
-								 conn_context->connection_loop);
+	conn_context->connection_timeout = g_timeout_add_seconds(CONNECT_TIMEOUT, on_connection_timeout, conn_context);
 	g_main_loop_run(conn_context->connection_loop);
 	g_main_loop_unref(conn_context->connection_loop);
 	// Set the attribute to NULL even if not required
 	conn_context->connection_loop = NULL;
 
-	// Get list of objects belonging to Device Manager
+	gattlib_scan_scheduler_release(scan_scheduler);
+
+	// Get the objects of the device and keep them up to date with the signals of the Device Manager
+	// so the lookups do not have to go through all the objects exported by Bluez
 	device_manager = get_device_manager_from_adapter(conn_context->adapter);
-	conn_context->dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	conn_context->dbus_objects = get_device_objects(device_manager, conn_context->device_object_path);
+	conn_context->object_added_signal_id = g_signal_connect(device_manager, "object-added",
+			G_CALLBACK(on_device_object_added), connection);
+	conn_context->object_removed_signal_id = g_signal_connect(device_manager, "object-removed",
+			G_CALLBACK(on_device_object_removed), connection);
 
 	return connection;
 
 FREE_DEVICE:
+	gattlib_properties_unsubscribe(conn_context->device_subscription);
 	free(conn_context->device_object_path);
 	g_object_unref(conn_context->device);
 
@@ -226,6 +396,21 @@ FREE_CONN_CONTEXT:
 	return NULL;
 }
 
+gatt_connection_t *gattlib_connect(void* adapter, const char *dst, unsigned long options)
+{
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_CONNECT, NULL, dst, 0, NULL, 0);
+	gatt_connection_t *connection;
+
+	connection = connect_device(adapter, dst, options);
+
+	if (traced) {
+		trace.connection = connection;
+		gattlib_trace_end(&trace, (connection != NULL) ? GATTLIB_SUCCESS : GATTLIB_NOT_CONNECTED, 0);
+	}
+	return connection;
+}
+
 gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 				unsigned long options,
 				gatt_connect_cb_t connect_cb, void* data)
@@ -240,22 +425,58 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 	return connection;
 }
 
+gatt_connection_t *gattlib_connect_loopback(const char *description_file, const char *dst)
+{
+	// Run the application with the fake Bluez service instead (see 'dbus/fake-bluez/run-with-fake-bluez.sh')
+	fprintf(stderr, "Loopback connections are not supported by the DBus backend.\n");
+	return NULL;
+}
+
+int gattlib_capture_start(const char *path, size_t packet_count, unsigned int flush_period_ms)
+{
+	// The ATT PDUs are exchanged by bluetoothd (use 'btmon' instead)
+	fprintf(stderr, "The capture is not supported by the DBus backend.\n");
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_capture_flush(void)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_capture_stop(void)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
 int gattlib_disconnect(gatt_connection_t* connection) {
 	gattlib_context_t* conn_context = connection->context;
 	GError *error = NULL;
 
+	GATTLIB_STATS_INC(connection->stats.dbus_calls);
 	org_bluez_device1_call_disconnect_sync(conn_context->device, NULL, &error);
 	if (error) {
 		fprintf(stderr, "Failed to disconnect DBus Bluez Device: %s\n", error->message);
 		g_error_free(error);
 	}
 
+	if (conn_context->adapter->device_manager != NULL) {
+		g_signal_handler_disconnect(conn_context->adapter->device_manager, conn_context->object_added_signal_id);
+		g_signal_handler_disconnect(conn_context->adapter->device_manager, conn_context->object_removed_signal_id);
+	}
+
+	if (conn_context->service_changed_timeout_id != 0) {
+		g_source_remove(conn_context->service_changed_timeout_id);
+	}
+
+	gattlib_properties_unsubscribe(conn_context->device_subscription);
 	free(conn_context->device_object_path);
 	g_object_unref(conn_context->device);
 	g_list_free_full(conn_context->dbus_objects, g_object_unref);
 	disconnect_all_notifications(conn_context);
 
 	free(connection->context);
+	gattlib_gatt_db_free(connection->gatt_db);
 	free(connection);
 	return GATTLIB_SUCCESS;
 }
@@ -277,7 +498,7 @@ static void sort_services(gattlib_primary_service_t *services, int services_coun
 	}
 }
 
-int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
+static int discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
 	gattlib_context_t* conn_context = connection->context;
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(conn_context->adapter);
 	OrgBluezDevice1* device = conn_context->device;
@@ -332,6 +553,7 @@ int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_serv
 				object_path,
 				NULL,
 				&error);
+		GATTLIB_STATS_INC(connection->stats.dbus_proxies_created);
 		if (service_proxy == NULL) {
 			if (error) {
 				fprintf(stderr, "Failed to open service '%s': %s\n", object_path, error->message);
@@ -405,9 +627,26 @@ int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_serv
 	return ret;
 }
 
+int gattlib_discover_primary(gatt_connection_t* connection, gattlib_primary_service_t** services, int* services_count) {
+	gattlib_trace_event_t trace;
+	bool traced;
+	int ret;
+
+	traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_primary(connection, services, services_count);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 int gattlib_discover_primary_from_mac(void* adapter, const char *mac_address, gattlib_primary_service_t** services, int* services_count) {
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(adapter);
-	GList *dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	GList *dbus_objects = NULL;
 	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 	OrgBluezDevice1* device;
@@ -420,6 +659,7 @@ int gattlib_discover_primary_from_mac(void* adapter, const char *mac_address, ga
 		goto FREE_OBJECTS;
 	}
 	g_object_get(G_OBJECT(device), "g-object-path", &device_object_path, NULL);
+	dbus_objects = get_device_objects(device_manager, device_object_path);
 
 	if(!org_bluez_device1_get_services_resolved(device))
 	{
@@ -563,9 +803,31 @@ static void sort_characteristics(gattlib_characteristic_t *characteristics, int
 	}
 }
 
+static uint8_t get_characteristic_properties_from_flags(const gchar *const *flags)
+{
+	uint8_t properties = 0;
+
+	for (; (flags != NULL) && (*flags != NULL); flags++) {
+		if (strcmp(*flags,"broadcast") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_BROADCAST;
+		} else if (strcmp(*flags,"read") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_READ;
+		} else if (strcmp(*flags,"write") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_WRITE;
+		} else if (strcmp(*flags,"write-without-response") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_WRITE_WITHOUT_RESP;
+		} else if (strcmp(*flags,"notify") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_NOTIFY;
+		} else if (strcmp(*flags,"indicate") == 0) {
+			properties |= GATTLIB_CHARACTERISTIC_INDICATE;
+		}
+	}
+	return properties;
+}
+
 int gattlib_discover_char_from_mac(void* adapter, const char *mac_address, gattlib_characteristic_t** characteristics, int* characteristics_count) {
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(adapter);
-	GList *dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	GList *dbus_objects = NULL;
 	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 	OrgBluezDevice1* device;
@@ -578,6 +840,7 @@ int gattlib_discover_char_from_mac(void* adapter, const char *mac_address, gattl
 		goto FREE_OBJECTS;
 	}
 	g_object_get(G_OBJECT(device), "g-object-path", &device_object_path, NULL);
+	dbus_objects = get_device_objects(device_manager, device_object_path);
 
 	if(!org_bluez_device1_get_services_resolved(device))
 	{
@@ -650,23 +913,8 @@ int gattlib_discover_char_from_mac(void* adapter, const char *mac_address, gattl
 
 		characteristic_list[count].handle = handle;
 		characteristic_list[count].value_handle = handle+1;
-		characteristic_list[count].properties = 0;
-		const gchar *const * flags = org_bluez_gatt_characteristic1_get_flags(characteristic);
-		for (; *flags != NULL; flags++) {
-			if (strcmp(*flags,"broadcast") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_BROADCAST;
-			} else if (strcmp(*flags,"read") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_READ;
-			} else if (strcmp(*flags,"write") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_WRITE;
-			} else if (strcmp(*flags,"write-without-response") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_WRITE_WITHOUT_RESP;
-			} else if (strcmp(*flags,"notify") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_NOTIFY;
-			} else if (strcmp(*flags,"indicate") == 0) {
-				characteristic_list[count].properties |= GATTLIB_CHARACTERISTIC_INDICATE;
-			}
-		}
+		characteristic_list[count].properties = get_characteristic_properties_from_flags(
+				org_bluez_gatt_characteristic1_get_flags(characteristic));
 
 		gattlib_string_to_uuid(
 				org_bluez_gatt_characteristic1_get_uuid(characteristic),
@@ -697,11 +945,12 @@ FREE_OBJECTS:
 	return ret;
 }
 
-static void add_characteristics_from_service(gattlib_context_t* conn_context, GDBusObjectManager *device_manager,
+static void add_characteristics_from_service(gatt_connection_t* connection, GDBusObjectManager *device_manager,
 			const char* service_object_path,
 			int start, int end,
 			gattlib_characteristic_t* characteristic_list, int* count)
 {
+	gattlib_context_t* conn_context = connection->context;
 	GError *error = NULL;
 
 	for (GList *l = conn_context->dbus_objects; l != NULL; l = l->next)  {
@@ -721,6 +970,7 @@ static void add_characteristics_from_service(gattlib_context_t* conn_context, GD
 				object_path,
 				NULL,
 				&error);
+		GATTLIB_STATS_INC(connection->stats.dbus_proxies_created);
 		if (characteristic == NULL) {
 			if (error) {
 				fprintf(stderr, "Failed to open characteristic '%s': %s\n", object_path, error->message);
@@ -748,23 +998,8 @@ static void add_characteristics_from_service(gattlib_context_t* conn_context, GD
 
 			characteristic_list[*count].handle = handle;
 			characteristic_list[*count].value_handle = handle+1;
-			characteristic_list[*count].properties = 0;
-			const gchar *const * flags = org_bluez_gatt_characteristic1_get_flags(characteristic);
-			for (; *flags != NULL; flags++) {
-				if (strcmp(*flags,"broadcast") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_BROADCAST;
-				} else if (strcmp(*flags,"read") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_READ;
-				} else if (strcmp(*flags,"write") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_WRITE;
-				} else if (strcmp(*flags,"write-without-response") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_WRITE_WITHOUT_RESP;
-				} else if (strcmp(*flags,"notify") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_NOTIFY;
-				} else if (strcmp(*flags,"indicate") == 0) {
-					characteristic_list[*count].properties |= GATTLIB_CHARACTERISTIC_INDICATE;
-				}
-			}
+			characteristic_list[*count].properties = get_characteristic_properties_from_flags(
+					org_bluez_gatt_characteristic1_get_flags(characteristic));
 
 			gattlib_string_to_uuid(
 					org_bluez_gatt_characteristic1_get_uuid(characteristic),
@@ -777,7 +1012,7 @@ static void add_characteristics_from_service(gattlib_context_t* conn_context, GD
 	}
 }
 
-int gattlib_discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
+static int discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
 	gattlib_context_t* conn_context = connection->context;
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(conn_context->adapter);
 	GError *error = NULL;
@@ -787,7 +1022,7 @@ int gattlib_discover_char_range(gatt_connection_t* connection, int start, int en
 		return GATTLIB_INVALID_PARAMETER;
 	}
 
-	// Count the maximum number of characteristic to allocate the array (we count all the characterstic for all devices)
+	// Count the maximum number of characteristic to allocate the array
 	int count_max = 0, count = 0;
 	for (GList *l = conn_context->dbus_objects; l != NULL; l = l->next)  {
 		GDBusObject *object = l->data;
@@ -827,6 +1062,7 @@ int gattlib_discover_char_range(gatt_connection_t* connection, int start, int en
 				object_path,
 				NULL,
 				&error);
+		GATTLIB_STATS_INC(connection->stats.dbus_proxies_created);
 		if (service_proxy == NULL) {
 			if (error) {
 				fprintf(stderr, "Failed to open service '%s': %s\n", object_path, error->message);
@@ -845,7 +1081,7 @@ int gattlib_discover_char_range(gatt_connection_t* connection, int start, int en
 		}
 
 		// Add all characteristics attached to this service
-		add_characteristics_from_service(conn_context, device_manager, object_path, start, end, characteristic_list, &count);
+		add_characteristics_from_service(connection, device_manager, object_path, start, end, characteristic_list, &count);
 		g_object_unref(service_proxy);
 	}
 
@@ -855,6 +1091,23 @@ int gattlib_discover_char_range(gatt_connection_t* connection, int start, int en
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_discover_char_range(gatt_connection_t* connection, int start, int end, gattlib_characteristic_t** characteristics, int* characteristics_count) {
+	gattlib_trace_event_t trace;
+	bool traced;
+	int ret;
+
+	traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_char_range(connection, start, end, characteristics, characteristics_count);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 int gattlib_discover_char(gatt_connection_t* connection, gattlib_characteristic_t** characteristics, int* characteristics_count)
 {
 	return gattlib_discover_char_range(connection, 0x00, 0xFF, characteristics, characteristics_count);
@@ -868,6 +1121,143 @@ int gattlib_discover_desc(gatt_connection_t* connection, gattlib_descriptor_t**
 	return GATTLIB_NOT_SUPPORTED;
 }
 
+static void get_uuid_from_cached_property(GDBusProxy *proxy, uuid_t *uuid)
+{
+	GVariant *value = g_dbus_proxy_get_cached_property(proxy, "UUID");
+
+	if (value != NULL) {
+		const gchar *uuid_str = g_variant_get_string(value, NULL);
+
+		gattlib_string_to_uuid(uuid_str, strlen(uuid_str) + 1, uuid);
+		g_variant_unref(value);
+	}
+}
+
+static int discover_all(gatt_connection_t* connection, gattlib_gatt_tree_t** tree)
+{
+	gattlib_context_t* conn_context;
+	GDBusObjectManager *device_manager;
+	GArray *services, *characteristics, *descriptors;
+	int ret = GATTLIB_SUCCESS;
+
+	if ((connection == NULL) || (tree == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	conn_context = connection->context;
+
+	// Also dispatches the pending signals so the objects of the device are up to date
+	device_manager = get_device_manager_from_adapter(conn_context->adapter);
+	if (device_manager == NULL) {
+		fprintf(stderr, "Gattlib context not initialized.\n");
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	services = g_array_new(FALSE, TRUE, sizeof(gattlib_gatt_tree_service_t));
+	characteristics = g_array_new(FALSE, TRUE, sizeof(gattlib_characteristic_t));
+	descriptors = g_array_new(FALSE, TRUE, sizeof(gattlib_descriptor_t));
+
+	// Single pass over the objects of the device. The properties are read from the cache of the
+	// object manager rather than from new proxies.
+	for (GList *l = conn_context->dbus_objects; l != NULL; l = l->next) {
+		GDBusObject *object = l->data;
+		const char *object_path = g_dbus_object_get_object_path(object);
+		GDBusInterface *interface;
+
+		interface = g_dbus_object_get_interface(object, "org.bluez.GattService1");
+		if (interface != NULL) {
+			gattlib_gatt_tree_service_t service = { 0 };
+			GVariant *primary = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "Primary");
+
+			service.service.attr_handle_start = get_handle_from_object_path(object_path);
+			service.service.attr_handle_end = service.service.attr_handle_start;
+			get_uuid_from_cached_property(G_DBUS_PROXY(interface), &service.service.uuid);
+			if (primary != NULL) {
+				service.primary = g_variant_get_boolean(primary);
+				g_variant_unref(primary);
+			}
+
+			g_array_append_val(services, service);
+			g_object_unref(interface);
+			continue;
+		}
+
+		interface = g_dbus_object_get_interface(object, "org.bluez.GattCharacteristic1");
+		if (interface != NULL) {
+			gattlib_characteristic_t characteristic = { 0 };
+			GVariant *flags = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "Flags");
+
+			characteristic.handle = get_handle_from_object_path(object_path);
+			characteristic.value_handle = characteristic.handle + 1;
+			get_uuid_from_cached_property(G_DBUS_PROXY(interface), &characteristic.uuid);
+			if (flags != NULL) {
+				const gchar **flags_strv = g_variant_get_strv(flags, NULL);
+
+				characteristic.properties = get_characteristic_properties_from_flags(flags_strv);
+				g_free(flags_strv);
+				g_variant_unref(flags);
+			}
+
+			g_array_append_val(characteristics, characteristic);
+			g_object_unref(interface);
+			continue;
+		}
+
+		interface = g_dbus_object_get_interface(object, "org.bluez.GattDescriptor1");
+		if (interface != NULL) {
+			gattlib_descriptor_t descriptor = { 0 };
+
+			descriptor.handle = get_handle_from_object_path(object_path);
+			get_uuid_from_cached_property(G_DBUS_PROXY(interface), &descriptor.uuid);
+			if (descriptor.uuid.type == SDP_UUID16) {
+				descriptor.uuid16 = descriptor.uuid.value.uuid16;
+			}
+
+			g_array_append_val(descriptors, descriptor);
+			g_object_unref(interface);
+		}
+	}
+
+	*tree = gattlib_gatt_tree_new((gattlib_gatt_tree_service_t*)services->data, services->len,
+			(gattlib_characteristic_t*)characteristics->data, characteristics->len,
+			(gattlib_descriptor_t*)descriptors->data, descriptors->len);
+	if (*tree == NULL) {
+		ret = GATTLIB_OUT_OF_MEMORY;
+	}
+
+	g_array_free(services, TRUE);
+	g_array_free(characteristics, TRUE);
+	g_array_free(descriptors, TRUE);
+	return ret;
+}
+
+int gattlib_discover_all(gatt_connection_t* connection, gattlib_gatt_tree_t** tree)
+{
+	gattlib_trace_event_t trace;
+	bool traced;
+	int ret;
+
+	if (connection == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_DISCOVER, connection, NULL, 0, NULL, 0);
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_DISCOVERY].issued);
+	ret = discover_all(connection, tree);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_DISCOVERY, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
+int gattlib_discover_range(gatt_connection_t* connection, uint16_t start, uint16_t end, gattlib_gatt_tree_t** tree)
+{
+	// The GATT objects are already exported by Bluez: the whole tree is built without any request to the device
+	return gattlib_discover_all(connection, tree);
+}
+
 static void sort_descriptors(gattlib_descriptor_t *descriptors, int descriptors_count) {
 	for(int i=0; i<descriptors_count-1; i++) {
 		uint16_t smallestHandle = descriptors[i].handle;
@@ -887,7 +1277,7 @@ static void sort_descriptors(gattlib_descriptor_t *descriptors, int descriptors_
 
 int gattlib_discover_desc_from_mac(void* adapter, const char *mac_address, gattlib_descriptor_t** descriptors, int* descriptors_count) {
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(adapter);
-	GList *dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	GList *dbus_objects = NULL;
 	GError *error = NULL;
 	int ret = GATTLIB_SUCCESS;
 	OrgBluezDevice1* device;
@@ -914,6 +1304,7 @@ int gattlib_discover_desc_from_mac(void* adapter, const char *mac_address, gattl
 		goto FREE_OBJECTS;
 	}
 	g_object_get(G_OBJECT(device), "g-object-path", &device_object_path, NULL);
+	dbus_objects = get_device_objects(device_manager, device_object_path);
 
 	if(!org_bluez_device1_get_services_resolved(device))
 	{
@@ -1118,20 +1509,42 @@ bool gattlib_is_services_resolved_from_mac(void *adapter, const char *mac_addres
 	return resolved;
 }
 
-#if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 int gattlib_get_rssi(gatt_connection_t *connection, int16_t *rssi)
 {
-	gattlib_context_t* conn_context = connection->context;
+	gattlib_context_t* conn_context;
+	GDBusObjectManager *device_manager;
+	GDBusInterface *interface;
+	GVariant *value;
 
-	if (rssi == NULL) {
+	if ((connection == NULL) || (rssi == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	conn_context = connection->context;
+
+	// Read the RSSI from the Device Manager. Its cache is refreshed by the 'PropertiesChanged'
+	// signals it already receives for all the Bluez objects.
+	device_manager = get_device_manager_from_adapter(conn_context->adapter);
+	if (device_manager == NULL) {
 		return GATTLIB_INVALID_PARAMETER;
 	}
 
-	*rssi = org_bluez_device1_get_rssi(conn_context->device);
+	interface = g_dbus_object_manager_get_interface(device_manager, conn_context->device_object_path, "org.bluez.Device1");
+	if (interface == NULL) {
+		return GATTLIB_NOT_FOUND;
+	}
+
+	value = g_dbus_proxy_get_cached_property(G_DBUS_PROXY(interface), "RSSI");
+	g_object_unref(interface);
+	if (value == NULL) {
+		// Bluez only exposes the RSSI while it receives advertisements from the device
+		return GATTLIB_NOT_FOUND;
+	}
 
+	*rssi = g_variant_get_int16(value);
+	g_variant_unref(value);
 	return GATTLIB_SUCCESS;
 }
-#endif
 
 int gattlib_get_rssi_from_mac(void *adapter, const char *mac_address, int16_t *rssi)
 {
@@ -1192,22 +1605,12 @@ int gattlib_get_advertising_flags_from_mac(void *adapter, const char *mac_addres
 	return ret;
 }
 
-int gattlib_get_raw_advertising_data_from_mac(void *adapter, const char *mac_address, uint8_t *out, size_t *out_size, size_t max_out)
+int get_raw_advertising_data_from_device(OrgBluezDevice1 *bluez_device1, uint8_t *out, size_t *out_size, size_t max_out)
 {
-	OrgBluezDevice1 *bluez_device1;
-	int ret;
+	int ret = GATTLIB_SUCCESS;
 
-	if (out == NULL && max_out != 0) {
-		return GATTLIB_INVALID_PARAMETER;
-	}
 	*out_size = 0;
 
-	ret = get_bluez_device_from_mac(adapter, mac_address, &bluez_device1);
-	if (ret != GATTLIB_SUCCESS) {
-		g_object_unref(bluez_device1);
-		return ret;
-	}
-
 	GVariant *ad_list = org_bluez_device1_get_advertising_data(bluez_device1);
 	if(ad_list != NULL)
 	{
@@ -1221,7 +1624,7 @@ int gattlib_get_raw_advertising_data_from_mac(void *adapter, const char *mac_add
 			gsize ad_size;
 			const guint8* ad_data = g_variant_get_fixed_array(ad_val, &ad_size, sizeof(guint8));
 
-			if(max_out < sizeof(uint8_t)+sizeof(uint8_t)+ad_size)
+			if(max_out < *out_size+sizeof(uint8_t)+sizeof(uint8_t)+ad_size)
 			{
 				ret = GATTLIB_OUT_OF_MEMORY;
 				continue; // if we break out of loop, data is not free'd
@@ -1238,17 +1641,44 @@ int gattlib_get_raw_advertising_data_from_mac(void *adapter, const char *mac_add
 		ret = GATTLIB_NOT_FOUND;
 	}
 
+	return ret;
+}
+
+int gattlib_get_raw_advertising_data_from_mac(void *adapter, const char *mac_address, uint8_t *out, size_t *out_size, size_t max_out)
+{
+	OrgBluezDevice1 *bluez_device1;
+	int ret;
+
+	if (out == NULL && max_out != 0) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+	*out_size = 0;
+
+	ret = get_bluez_device_from_mac(adapter, mac_address, &bluez_device1);
+	if (ret != GATTLIB_SUCCESS) {
+		g_object_unref(bluez_device1);
+		return ret;
+	}
+
+	ret = get_raw_advertising_data_from_device(bluez_device1, out, out_size, max_out);
+
 	g_object_unref(bluez_device1);
 	return ret;
 }
 
-gboolean services_resolved_cb_handler(
-	    OrgBluezDevice1 *device,
-	    GVariant *arg_changed_properties,
-	    const gchar *const *arg_invalidated_properties,
-	    gpointer user_data)
+/*
+ * Handle returned by 'gattlib_add_services_resolved_cb()'
+ */
+struct gattlib_services_resolved_handle {
+	OrgBluezDevice1 *device;
+	struct gattlib_properties_subscription *subscription;
+	services_resolved_cb cb;
+};
+
+static void services_resolved_cb_handler(const char *object_path, GVariant *arg_changed_properties, void *user_data)
 {
-	services_resolved_cb cb = user_data;
+	struct gattlib_services_resolved_handle *handle = user_data;
+	OrgBluezDevice1 *device = handle->device;
 
 	// Retrieve 'Value' from 'arg_changed_properties'
 	if (g_variant_n_children (arg_changed_properties) > 0) {
@@ -1265,17 +1695,17 @@ gboolean services_resolved_cb_handler(
 				bool is_public_addr = address_type != NULL && 0 == strcmp(address_type, "public");
 				bool services_resolved = g_variant_get_boolean(value);
 				if(address != NULL)
-					cb(address, is_public_addr, services_resolved);
+					handle->cb(address, is_public_addr, services_resolved);
 			}
 		}
 		g_variant_iter_free(iter);
 	}
-	return TRUE;
 }
 
 void* gattlib_add_services_resolved_cb(void* adapter, const char *mac, services_resolved_cb cb)
 {
 	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_services_resolved_handle *handle;
 	const char* adapter_name = NULL;
 	char object_path[100];
 	GError *error = NULL;
@@ -1289,32 +1719,46 @@ void* gattlib_add_services_resolved_cb(void* adapter, const char *mac, services_
 
 	get_device_path_from_mac(adapter_name, mac, object_path, sizeof(object_path));
 
-	OrgBluezDevice1* device = org_bluez_device1_proxy_new_for_bus_sync(
+	handle = calloc(1, sizeof(struct gattlib_services_resolved_handle));
+	if (handle == NULL) {
+		return NULL;
+	}
+	handle->cb = cb;
+
+	// Only the address of the device is read from the proxy. Its changes are received by the subscription below.
+	handle->device = org_bluez_device1_proxy_new_for_bus_sync(
 			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
 			"org.bluez",
 			object_path,
 			NULL,
 			&error);
-	if (device == NULL) {
+	if (handle->device == NULL) {
 		if (error) {
 			fprintf(stderr, "Failed to connect to DBus Bluez Device: %s\n", error->message);
 			g_error_free(error);
-			return NULL;
 		}
+		free(handle);
+		return NULL;
 	}
 
 	// Register a handle for notification
-	g_signal_connect(device,
-		"g-properties-changed",
-		G_CALLBACK (services_resolved_cb_handler),
-		cb);
+	handle->subscription = gattlib_properties_subscribe(object_path, "org.bluez.Device1", services_resolved_cb_handler, handle);
+	if (handle->subscription == NULL) {
+		g_object_unref(handle->device);
+		free(handle);
+		return NULL;
+	}
 
-	return device;
+	return handle;
 }
 
 void gattlib_remove_services_resolved_cb(void* handle)
 {
-	g_object_unref(handle);
+	struct gattlib_services_resolved_handle *services_resolved_handle = handle;
+
+	gattlib_properties_unsubscribe(services_resolved_handle->subscription);
+	g_object_unref(services_resolved_handle->device);
+	free(services_resolved_handle);
 }
 
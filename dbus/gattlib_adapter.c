@@ -25,6 +25,33 @@
 
 
 int gattlib_adapter_open(const char* adapter_name, void** adapter) {
+	return gattlib_adapter_open_with_options(adapter_name, GATTLIB_ADAPTER_OPTIONS_DEFAULT, adapter);
+}
+
+/*
+ * Pause or resume the Bluez discovery for the scan scheduler (called from the default main context)
+ */
+static int adapter_scan_scheduler_set_discovery(void *adapter, bool enable) {
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	GError *error = NULL;
+
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_calls);
+	if (enable) {
+		org_bluez_adapter1_call_start_discovery_sync(gattlib_adapter->adapter_proxy, NULL, &error);
+	} else {
+		org_bluez_adapter1_call_stop_discovery_sync(gattlib_adapter->adapter_proxy, NULL, &error);
+	}
+
+	if (error) {
+		fprintf(stderr, "Failed to %s discovery: %s\n", enable ? "start" : "stop", error->message);
+		g_error_free(error);
+		return GATTLIB_ERROR_DBUS;
+	}
+	return GATTLIB_SUCCESS;
+}
+
+// The legacy options are ignored: bluetoothd already drives the adapter through the kernel management interface
+int gattlib_adapter_open_with_options(const char* adapter_name, uint32_t options, void** adapter) {
 	char object_path[20];
 	OrgBluezAdapter1 *adapter_proxy;
 	struct gattlib_adapter *gattlib_adapter;
@@ -63,6 +90,15 @@ int gattlib_adapter_open(const char* adapter_name, void** adapter) {
 		return GATTLIB_OUT_OF_MEMORY;
 	}
 
+	// Account the adapter proxy created above
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_proxies_created);
+
+	gattlib_adapter->scan_scheduler = gattlib_scan_scheduler_new(gattlib_adapter, adapter_scan_scheduler_set_discovery);
+	if (gattlib_adapter->scan_scheduler == NULL) {
+		free(gattlib_adapter);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
 	// Initialize stucture
 	gattlib_adapter->adapter_name = strdup(adapter_name);
 	gattlib_adapter->adapter_proxy = adapter_proxy;
@@ -118,6 +154,7 @@ GDBusObjectManager *get_device_manager_from_adapter(struct gattlib_adapter *gatt
 			"/",
 			NULL, NULL, NULL, NULL,
 			&error);
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_proxies_created);
 	if (gattlib_adapter->device_manager == NULL) {
 		if (error) {
 			fprintf(stderr, "Failed to get Bluez Device Manager: %s\n", error->message);
@@ -139,11 +176,173 @@ struct discovered_device_arg {
 	uint32_t enabled_filters;
 	gattlib_discovered_device_t callback;
 	void *user_data;
-	GSList** discovered_devices_ptr;
+	struct gattlib_scan_coalescer *coalescer;
+	// Set when the devices are delivered in batches
+	struct gattlib_scan_batch *batch;
 };
 
-static void device_manager_on_device1_signal(const char* device1_path, struct discovered_device_arg *arg)
+/*
+ * State of the scan started by 'gattlib_adapter_scan_start()'
+ */
+struct gattlib_background_scan {
+	struct discovered_device_arg arg;
+
+	gulong added_signal_id;
+	gulong changed_signal_id;
+};
+
+static void scan_table_update_from_device(struct gattlib_adapter *gattlib_adapter, OrgBluezDevice1* device1)
+{
+	uint8_t ad_data[GATTLIB_SCAN_TABLE_AD_DATA_MAX_LEN];
+	size_t ad_data_length = 0;
+	struct gattlib_scan_table *scan_table = gattlib_scan_table_get(&gattlib_adapter->scan_table);
+
+	if (scan_table == NULL) {
+		return;
+	}
+
+	// Payload larger than the table entry is truncated to the AD structures that fit
+	get_raw_advertising_data_from_device(device1, ad_data, &ad_data_length, sizeof(ad_data));
+
+	gattlib_scan_table_update(scan_table,
+			org_bluez_device1_get_address(device1),
+			org_bluez_device1_get_name(device1),
+			org_bluez_device1_get_rssi(device1),
+			ad_data, ad_data_length);
+	gattlib_scan_table_unref(scan_table);
+}
+
+/*
+ * Evaluate the advertisement data filters of the adapter against the 'ManufacturerData' and 'ServiceData'
+ * properties of the device
+ */
+static bool device_match_ad_filters(const struct gattlib_ad_filters *ad_filters, GVariant *manufacturer_data, GVariant *service_data)
+{
+	GVariantIter iter;
+	GVariant *value;
+
+	if (manufacturer_data != NULL) {
+		guint16 company_id;
+
+		g_variant_iter_init(&iter, manufacturer_data);
+		while (g_variant_iter_next(&iter, "{qv}", &company_id, &value)) {
+			gsize data_length = 0;
+			const guint8 *data = g_variant_get_fixed_array(value, &data_length, sizeof(guint8));
+			bool match = gattlib_ad_filters_match_manufacturer_data(ad_filters, company_id, data, data_length);
+
+			g_variant_unref(value);
+			if (match) {
+				return true;
+			}
+		}
+	}
+
+	if (service_data != NULL) {
+		const gchar *key;
+
+		g_variant_iter_init(&iter, service_data);
+		while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+			gsize data_length = 0;
+			const guint8 *data = g_variant_get_fixed_array(value, &data_length, sizeof(guint8));
+			uint8_t uuid128[16];
+			uuid_t uuid;
+			bool match = false;
+
+			if (gattlib_string_to_uuid(key, strlen(key), &uuid) == 0) {
+				gattlib_uuid_to_uuid128(&uuid, uuid128);
+				match = gattlib_ad_filters_match_service_data(ad_filters, uuid128, data, data_length);
+			}
+
+			g_variant_unref(value);
+			if (match) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Evaluate the advertisement data filters of the adapter against the cached properties of the
+ * 'org.bluez.Device1' proxy of the object manager, before creating a dedicated proxy for the device
+ */
+static bool device_proxy_match_ad_filters(const struct gattlib_ad_filters *ad_filters, GDBusProxy *device_proxy)
 {
+	GVariant *manufacturer_data;
+	GVariant *service_data;
+	bool match;
+
+	if (gattlib_ad_filters_is_empty(ad_filters)) {
+		return true;
+	}
+
+	manufacturer_data = g_dbus_proxy_get_cached_property(device_proxy, "ManufacturerData");
+	service_data = g_dbus_proxy_get_cached_property(device_proxy, "ServiceData");
+
+	match = device_match_ad_filters(ad_filters, manufacturer_data, service_data);
+
+	if (manufacturer_data != NULL) {
+		g_variant_unref(manufacturer_data);
+	}
+	if (service_data != NULL) {
+		g_variant_unref(service_data);
+	}
+	return match;
+}
+
+/*
+ * Hash of the advertised payload used to detect payload changes
+ */
+static uint32_t get_payload_hash_from_device(struct gattlib_scan_coalescer *coalescer, OrgBluezDevice1* device1)
+{
+	GVariant *payload[2];
+	uint32_t hash = 0;
+
+	if (!gattlib_scan_coalescer_needs_payload(coalescer)) {
+		return 0;
+	}
+
+	payload[0] = org_bluez_device1_get_manufacturer_data(device1);
+	payload[1] = org_bluez_device1_get_service_data(device1);
+
+	for (size_t i = 0; i < G_N_ELEMENTS(payload); i++) {
+		if (payload[i] != NULL) {
+			hash = gattlib_scan_payload_hash(hash, g_variant_get_data(payload[i]), g_variant_get_size(payload[i]));
+		}
+	}
+	return hash;
+}
+
+// Longest period between two passes of the device pruning
+#define DEVICE_PRUNING_MAX_PERIOD_S	60
+
+static guint device_pruning_now(void)
+{
+	return (guint)(g_get_monotonic_time() / G_USEC_PER_SEC);
+}
+
+static void device_manager_on_device1_signal(GDBusProxy *device_proxy, bool is_advertisement, struct discovered_device_arg *arg)
+{
+	struct gattlib_adapter *gattlib_adapter = arg->adapter;
+	const char* device1_path = g_dbus_proxy_get_object_path(device_proxy);
+	bool report;
+
+	GATTLIB_STATS_INC(gattlib_adapter->stats.scan_events_received);
+
+	if (is_advertisement && (gattlib_adapter->device_last_seen != NULL)) {
+		g_hash_table_insert(gattlib_adapter->device_last_seen, g_strdup(device1_path),
+				GUINT_TO_POINTER(device_pruning_now()));
+	}
+
+	// Filter on the properties already cached by the object manager: most of the devices of a crowded
+	// environment do not match and do not need their own proxy
+	report = ((arg->callback != NULL) || (arg->batch != NULL)) &&
+		device_proxy_match_ad_filters(&gattlib_adapter->scan_ad_filters, device_proxy);
+	if (!report && !(is_advertisement && (g_atomic_pointer_get(&gattlib_adapter->scan_table) != NULL))) {
+		return;
+	}
+
 	GError *error = NULL;
 	OrgBluezDevice1* device1 = org_bluez_device1_proxy_new_for_bus_sync(
 			G_BUS_TYPE_SYSTEM,
@@ -152,6 +351,7 @@ static void device_manager_on_device1_signal(const char* device1_path, struct di
 			device1_path,
 			NULL,
 			&error);
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_proxies_created);
 	if (error) {
 		fprintf(stderr, "Failed to connection to new DBus Bluez Device: %s\n",
 			error->message);
@@ -162,21 +362,28 @@ static void device_manager_on_device1_signal(const char* device1_path, struct di
 		const gchar *address = org_bluez_device1_get_address(device1);
 
 		if(address != NULL) {
-			// Check if the device is already part of the list
-			GSList *item = g_slist_find_custom(*arg->discovered_devices_ptr, address, (GCompareFunc)g_ascii_strcasecmp);
-
-			// First time this device is in the list
-			if (item == NULL) {
-				// Add the device to the list
-				*arg->discovered_devices_ptr = g_slist_append(*arg->discovered_devices_ptr, g_strdup(address));
+			if (is_advertisement) {
+				scan_table_update_from_device(gattlib_adapter, device1);
 			}
 
-			if ((item == NULL) || (arg->enabled_filters & GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE)) {
-				arg->callback(
-					arg->adapter,
-					org_bluez_device1_get_address(device1),
-					org_bluez_device1_get_name(device1),
-					arg->user_data);
+			// Report new devices and, depending on the coalescing rules, changes of known devices
+			if (report &&
+			    gattlib_scan_coalescer_should_notify(arg->coalescer, address,
+					org_bluez_device1_get_rssi(device1), get_payload_hash_from_device(arg->coalescer, device1))) {
+				GATTLIB_STATS_INC(gattlib_adapter->stats.scan_events_delivered);
+
+				if (arg->batch != NULL) {
+					gattlib_scan_batch_add(arg->batch,
+						address,
+						org_bluez_device1_get_name(device1),
+						org_bluez_device1_get_rssi(device1));
+				} else {
+					arg->callback(
+						arg->adapter,
+						org_bluez_device1_get_address(device1),
+						org_bluez_device1_get_name(device1),
+						arg->user_data);
+				}
 			}
 		} else {
 			fprintf(stderr, "Failed to get address for path: %s\n", device1_path);
@@ -197,11 +404,34 @@ static void on_dbus_object_added(GDBusObjectManager *device_manager,
 	}
 
 	// It is a 'org.bluez.Device1'
-	device_manager_on_device1_signal(object_path, user_data);
+	device_manager_on_device1_signal(G_DBUS_PROXY(interface), true, user_data);
 
 	g_object_unref(interface);
 }
 
+/*
+ * Return true if the changed properties of a 'org.bluez.Device1' are the result of
+ * a received advertisement (and not for instance of a connection state change)
+ */
+static bool is_advertisement_property_change(GVariant *changed_properties)
+{
+	GVariantIter iter;
+	const gchar *key;
+	GVariant *value;
+
+	g_variant_iter_init(&iter, changed_properties);
+	while (g_variant_iter_next(&iter, "{&sv}", &key, &value)) {
+		g_variant_unref(value);
+
+		if ((strcmp(key, "RSSI") == 0) || (strcmp(key, "ManufacturerData") == 0) ||
+		    (strcmp(key, "ServiceData") == 0) || (strcmp(key, "AdvertisingData") == 0) ||
+		    (strcmp(key, "TxPower") == 0)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static void
 on_interface_proxy_properties_changed (GDBusObjectManagerClient *device_manager,
                                        GDBusObjectProxy         *object_proxy,
@@ -216,7 +446,7 @@ on_interface_proxy_properties_changed (GDBusObjectManagerClient *device_manager,
 	}
 
 	// It is a 'org.bluez.Device1'
-	device_manager_on_device1_signal(g_dbus_proxy_get_object_path(interface_proxy), user_data);
+	device_manager_on_device1_signal(interface_proxy, is_advertisement_property_change(changed_properties), user_data);
 }
 
 int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters)
@@ -251,9 +481,11 @@ int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, i
 	GVariant *transport_type = g_variant_new_string("le");
 	g_variant_builder_add(&arg_properties_builder, "{sv}", "Transport", transport_type);
 
-	GVariant *duplicate_data = g_variant_new_boolean(true);
+	// Without 'DuplicateData', Bluez only signals the advertisements whose payload has changed
+	GVariant *duplicate_data = g_variant_new_boolean((enabled_filters & GATTLIB_DISCOVER_FILTER_NO_DUPLICATE_DATA) == 0);
 	g_variant_builder_add(&arg_properties_builder, "{sv}", "DuplicateData", duplicate_data);
 
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_calls);
 	org_bluez_adapter1_call_set_discovery_filter_sync(gattlib_adapter->adapter_proxy,
 			g_variant_builder_end(&arg_properties_builder), NULL, &error);
 
@@ -269,6 +501,7 @@ int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, i
 	}
 
 	// Now, start BLE discovery
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_calls);
 	org_bluez_adapter1_call_start_discovery_sync(gattlib_adapter->adapter_proxy, NULL, &error);
 	if (error) {
 		fprintf(stderr, "Failed to start discovery: %s\n", error->message);
@@ -286,14 +519,21 @@ int gattlib_adapter_scan_enable(void* adapter)
 			GATTLIB_DISCOVER_FILTER_USE_NONE);
 }
 
-int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
-		gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data)
+/*
+ * Start the background scan. The ownership of 'batch' is transferred to the scan.
+ */
+static int adapter_scan_start(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb, struct gattlib_scan_batch *batch, void *user_data)
 {
 	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_background_scan *background_scan;
 	GDBusObjectManager *device_manager;
-	int ret = GATTLIB_SUCCESS;
-	int added_signal_id, changed_signal_id;
-	GSList *discovered_devices = NULL;
+	int ret;
+
+	if (gattlib_adapter->background_scan != NULL) {
+		gattlib_scan_batch_free(batch);
+		return GATTLIB_BUSY;
+	}
 
 	//
 	// Get notification when objects are removed from the Bluez ObjectManager.
@@ -302,32 +542,171 @@ int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t
 	//
 	device_manager = get_device_manager_from_adapter(gattlib_adapter);
 	if (device_manager == NULL) {
-		goto CLEANUP;
+		gattlib_scan_batch_free(batch);
+		return GATTLIB_ERROR_DBUS;
+	}
+
+	background_scan = calloc(1, sizeof(struct gattlib_background_scan));
+	if (background_scan == NULL) {
+		gattlib_scan_batch_free(batch);
+		return GATTLIB_OUT_OF_MEMORY;
 	}
 
-	// Pass the user callback and the discovered device list pointer to the signal handlers
-	struct discovered_device_arg discovered_device_arg = {
-		.adapter = adapter,
-		.enabled_filters = enabled_filters,
-		.callback = discovered_device_cb,
-		.user_data = user_data,
-		.discovered_devices_ptr = &discovered_devices,
-	};
+	// Pass the user callback and the per-device coalescing state to the signal handlers
+	background_scan->arg.adapter = adapter;
+	background_scan->arg.enabled_filters = enabled_filters;
+	background_scan->arg.callback = discovered_device_cb;
+	background_scan->arg.user_data = user_data;
+	background_scan->arg.batch = batch;
+	background_scan->arg.coalescer = gattlib_scan_coalescer_new(&gattlib_adapter->scan_coalescing,
+			enabled_filters & GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE);
+	if (background_scan->arg.coalescer == NULL) {
+		gattlib_scan_batch_free(batch);
+		free(background_scan);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
 
-	added_signal_id = g_signal_connect(G_DBUS_OBJECT_MANAGER(device_manager),
+	background_scan->added_signal_id = g_signal_connect(G_DBUS_OBJECT_MANAGER(device_manager),
 	                    "object-added",
 	                    G_CALLBACK (on_dbus_object_added),
-	                    &discovered_device_arg);
+	                    &background_scan->arg);
 
 	// List for object changes to see if there are still devices around
-	changed_signal_id = g_signal_connect(G_DBUS_OBJECT_MANAGER(device_manager),
+	background_scan->changed_signal_id = g_signal_connect(G_DBUS_OBJECT_MANAGER(device_manager),
 	                    "interface-proxy-properties-changed",
 	                    G_CALLBACK(on_interface_proxy_properties_changed),
-	                    &discovered_device_arg);
+	                    &background_scan->arg);
+
+	gattlib_adapter->background_scan = background_scan;
 
 	ret = gattlib_adapter_scan_enable_with_filter(adapter, uuid_list, rssi_threshold, enabled_filters);
-	if(ret != GATTLIB_SUCCESS) {
-		goto CLEANUP;
+	if (ret != GATTLIB_SUCCESS) {
+		gattlib_adapter_scan_stop(adapter);
+		return ret;
+	}
+
+	// The discovery is paused and resumed from the main context that dispatches the DBus signals
+	gattlib_scan_scheduler_scan_started(gattlib_adapter->scan_scheduler, g_main_context_default());
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_scan_start(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb, void *user_data)
+{
+	if (adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return adapter_scan_start(adapter, uuid_list, rssi_threshold, enabled_filters, discovered_device_cb, NULL, user_data);
+}
+
+int gattlib_adapter_scan_start_batched(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_devices_batch_t discovered_devices_cb, size_t max_batch_size, uint32_t max_batch_delay_ms,
+		void *user_data)
+{
+	struct gattlib_scan_batch *batch;
+
+	if ((adapter == NULL) || (discovered_devices_cb == NULL) || (max_batch_size == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	// The batch timer is dispatched by the same main context as the DBus signals
+	batch = gattlib_scan_batch_new(adapter, g_main_context_default(), max_batch_size, max_batch_delay_ms,
+			discovered_devices_cb, user_data);
+	if (batch == NULL) {
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	return adapter_scan_start(adapter, uuid_list, rssi_threshold, enabled_filters, NULL, batch, user_data);
+}
+
+/*
+ * Release the state of the scan started by 'gattlib_adapter_scan_start()'. Must be called from the thread
+ * dispatching the main context of the DBus signals as the scan state is used by their handlers.
+ */
+static void background_scan_free(struct gattlib_adapter *gattlib_adapter)
+{
+	struct gattlib_background_scan *background_scan = gattlib_adapter->background_scan;
+
+	if (background_scan == NULL) {
+		return;
+	}
+
+	gattlib_scan_scheduler_scan_stopped(gattlib_adapter->scan_scheduler);
+	gattlib_adapter->background_scan = NULL;
+
+	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(gattlib_adapter->device_manager), background_scan->added_signal_id);
+	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(gattlib_adapter->device_manager), background_scan->changed_signal_id);
+
+	// Deliver the pending devices before releasing the scan state
+	gattlib_scan_batch_free(background_scan->arg.batch);
+	gattlib_scan_coalescer_free(background_scan->arg.coalescer);
+	free(background_scan);
+}
+
+// Release of the scan state by the thread dispatching the main context
+struct background_scan_free_call {
+	struct gattlib_adapter *gattlib_adapter;
+	bool done;
+};
+
+static GMutex m_background_scan_free_mutex;
+// Signaled when the scan state has been released
+static GCond m_background_scan_free_cond;
+
+static gboolean on_background_scan_free(gpointer user_data)
+{
+	struct background_scan_free_call *call = user_data;
+
+	background_scan_free(call->gattlib_adapter);
+
+	g_mutex_lock(&m_background_scan_free_mutex);
+	call->done = true;
+	g_cond_broadcast(&m_background_scan_free_cond);
+	g_mutex_unlock(&m_background_scan_free_mutex);
+	return FALSE;
+}
+
+int gattlib_adapter_scan_stop(void *adapter)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	GMainContext *context = g_main_context_default();
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (g_main_context_acquire(context)) {
+		// No other thread dispatches the DBus signals meanwhile (or it is this thread)
+		background_scan_free(gattlib_adapter);
+		g_main_context_release(context);
+	} else {
+		// Another thread dispatches the DBus signals. Let it release the scan state between two signals.
+		struct background_scan_free_call call = { .gattlib_adapter = gattlib_adapter, .done = false };
+
+		g_main_context_invoke(context, on_background_scan_free, &call);
+
+		g_mutex_lock(&m_background_scan_free_mutex);
+		while (!call.done) {
+			g_cond_wait(&m_background_scan_free_cond, &m_background_scan_free_mutex);
+		}
+		g_mutex_unlock(&m_background_scan_free_mutex);
+	}
+
+	// Stop BLE device discovery
+	return gattlib_adapter_scan_disable(adapter);
+}
+
+int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	int ret;
+
+	ret = gattlib_adapter_scan_start(adapter, uuid_list, rssi_threshold, enabled_filters, discovered_device_cb, user_data);
+	if (ret != GATTLIB_SUCCESS) {
+		return ret;
 	}
 
 	// Run Glib loop for 'timeout' seconds
@@ -341,19 +720,10 @@ int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t
 
 	// Note: The function only resumes when loop timeout as expired or g_main_loop_quit has been called.
 
-	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(device_manager), added_signal_id);
-	g_signal_handler_disconnect(G_DBUS_OBJECT_MANAGER(device_manager), changed_signal_id);
+	// Stop BLE device discovery and disconnect the signal handlers
+	gattlib_adapter_scan_stop(adapter);
 
-	// Stop BLE device discovery
-	gattlib_adapter_scan_disable(adapter);
-
-CLEANUP:
-	// Free discovered device list
-	if(discovered_devices != NULL) {
-		g_slist_foreach(discovered_devices, (GFunc)g_free, NULL);
-		g_slist_free(discovered_devices);
-	}
-	return ret;
+	return GATTLIB_SUCCESS;
 }
 
 int gattlib_adapter_scan(void* adapter, gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data)
@@ -369,6 +739,7 @@ int gattlib_adapter_scan_disable(void* adapter) {
 
 	GError *error = NULL;
 
+	GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_calls);
 	org_bluez_adapter1_call_stop_discovery_sync(gattlib_adapter->adapter_proxy, NULL, &error);
 	// Ignore the error
 	if(error) {
@@ -393,10 +764,279 @@ int gattlib_adapter_scan_disable(void* adapter) {
 	return GATTLIB_SUCCESS;
 }
 
+int gattlib_periodic_sync_start(void *adapter, const char *addr, uint8_t addr_type, uint8_t sid,
+		gattlib_periodic_advertisement_cb_t periodic_advertisement_cb, void *user_data, void **sync_handle)
+{
+	// Bluez does not expose the periodic advertising syncs on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_periodic_sync_stop(void *adapter, void *sync_handle)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_auto_connect_add(void *adapter, const char *dst, unsigned long options,
+		gatt_connect_cb_t connect_cb, void *user_data)
+{
+	// Bluez manages the kernel auto-connect list itself and does not expose it on DBus
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_auto_connect_remove(void *adapter, const char *dst)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_set_scan_parameters(void *adapter, const gattlib_scan_parameters_t *parameters)
+{
+	// Bluez does not expose the HCI scan parameters on DBus (they are set in its 'main.conf')
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_set_scan_coalescing(void *adapter, uint32_t min_interval_ms, uint8_t min_rssi_delta, bool notify_on_payload_change)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_adapter->scan_coalescing.min_interval_ms = min_interval_ms;
+	gattlib_adapter->scan_coalescing.min_rssi_delta = min_rssi_delta;
+	gattlib_adapter->scan_coalescing.notify_on_payload_change = notify_on_payload_change;
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_set_scan_schedule(void *adapter, const gattlib_scan_schedule_t *schedule)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return gattlib_scan_scheduler_set_schedule(gattlib_adapter->scan_scheduler, schedule);
+}
+
+int gattlib_adapter_radio_hold(void *adapter)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_scan_scheduler_hold(gattlib_adapter->scan_scheduler);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_radio_release(void *adapter)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_scan_scheduler_release(gattlib_adapter->scan_scheduler);
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_get_stats(void *adapter, gattlib_adapter_stats_t *stats)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if ((gattlib_adapter == NULL) || (stats == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	gattlib_stats_copy(stats, &gattlib_adapter->stats, sizeof(gattlib_adapter_stats_t));
+	return GATTLIB_SUCCESS;
+}
+
+static bool device_get_boolean_property(GDBusProxy *device1, const char *name)
+{
+	GVariant *value = g_dbus_proxy_get_cached_property(device1, name);
+	bool result = false;
+
+	if (value != NULL) {
+		result = g_variant_get_boolean(value);
+		g_variant_unref(value);
+	}
+	return result;
+}
+
+static bool device_belongs_to_adapter(GDBusProxy *device1, const char *adapter_path)
+{
+	GVariant *value = g_dbus_proxy_get_cached_property(device1, "Adapter");
+	bool result = false;
+
+	if (value != NULL) {
+		result = (strcmp(g_variant_get_string(value, NULL), adapter_path) == 0);
+		g_variant_unref(value);
+	}
+	return result;
+}
+
+static void on_stale_device_removed(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+
+	org_bluez_adapter1_call_remove_device_finish(ORG_BLUEZ_ADAPTER1(source_object), res, &error);
+	if (error) {
+		fprintf(stderr, "Failed to remove stale device: %s\n", error->message);
+		g_error_free(error);
+	}
+}
+
+/*
+ * Remove the stale devices from Bluez and trim the per-device caches (called from the default main context)
+ */
+static gboolean adapter_prune_devices(gpointer data)
+{
+	struct gattlib_adapter *gattlib_adapter = data;
+	const char *adapter_path = g_dbus_proxy_get_object_path(G_DBUS_PROXY(gattlib_adapter->adapter_proxy));
+	const guint max_age_s = gattlib_adapter->device_pruning_max_age_s;
+	const guint now = device_pruning_now();
+	GDBusObjectManager *device_manager;
+	GHashTable *device_last_seen;
+	struct gattlib_scan_table *scan_table;
+	GList *objects, *l;
+
+	device_manager = get_device_manager_from_adapter(gattlib_adapter);
+	if (device_manager == NULL) {
+		return TRUE;
+	}
+
+	// Only keep the devices still exported by Bluez so the table does not grow with the removed ones
+	device_last_seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	objects = g_dbus_object_manager_get_objects(device_manager);
+	for (l = objects; l != NULL; l = l->next) {
+		GDBusObject *object = l->data;
+		const char *object_path = g_dbus_object_get_object_path(object);
+		GDBusInterface *interface;
+		gpointer value;
+		guint last_seen = now;
+
+		interface = g_dbus_object_get_interface(object, "org.bluez.Device1");
+		if (interface == NULL) {
+			continue;
+		}
+
+		if (!device_belongs_to_adapter(G_DBUS_PROXY(interface), adapter_path)) {
+			g_object_unref(interface);
+			continue;
+		}
+
+		// Devices not seen by gattlib yet (eg: discovered before the pruning was enabled) start aging now
+		if (g_hash_table_lookup_extended(gattlib_adapter->device_last_seen, object_path, NULL, &value)) {
+			last_seen = GPOINTER_TO_UINT(value);
+		}
+
+		if (device_get_boolean_property(G_DBUS_PROXY(interface), "Paired") ||
+		    device_get_boolean_property(G_DBUS_PROXY(interface), "Trusted") ||
+		    device_get_boolean_property(G_DBUS_PROXY(interface), "Connected")) {
+			last_seen = now;
+		} else if (now - last_seen >= max_age_s) {
+			// Do not block the main context while Bluez removes the device
+			GATTLIB_STATS_INC(gattlib_adapter->stats.dbus_calls);
+			org_bluez_adapter1_call_remove_device(gattlib_adapter->adapter_proxy, object_path, NULL,
+					on_stale_device_removed, NULL);
+			g_object_unref(interface);
+			continue;
+		}
+
+		g_hash_table_insert(device_last_seen, g_strdup(object_path), GUINT_TO_POINTER(last_seen));
+		g_object_unref(interface);
+	}
+	g_list_free_full(objects, g_object_unref);
+
+	g_hash_table_destroy(gattlib_adapter->device_last_seen);
+	gattlib_adapter->device_last_seen = device_last_seen;
+
+	scan_table = gattlib_scan_table_get(&gattlib_adapter->scan_table);
+	gattlib_scan_table_prune(scan_table, (uint64_t)max_age_s * 1000);
+	gattlib_scan_table_unref(scan_table);
+	if (gattlib_adapter->background_scan != NULL) {
+		gattlib_scan_coalescer_prune(gattlib_adapter->background_scan->arg.coalescer, (uint64_t)max_age_s * 1000);
+	}
+
+	return TRUE;
+}
+
+static void adapter_device_pruning_stop(struct gattlib_adapter *gattlib_adapter)
+{
+	if (gattlib_adapter->device_pruning_timeout_id > 0) {
+		g_source_remove(gattlib_adapter->device_pruning_timeout_id);
+		gattlib_adapter->device_pruning_timeout_id = 0;
+	}
+	if (gattlib_adapter->device_last_seen != NULL) {
+		g_hash_table_destroy(gattlib_adapter->device_last_seen);
+		gattlib_adapter->device_last_seen = NULL;
+	}
+	gattlib_adapter->device_pruning_max_age_s = 0;
+}
+
+int gattlib_adapter_set_device_pruning(void *adapter, uint32_t max_age_s)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if (gattlib_adapter == NULL) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	if (gattlib_adapter->device_pruning_timeout_id > 0) {
+		g_source_remove(gattlib_adapter->device_pruning_timeout_id);
+		gattlib_adapter->device_pruning_timeout_id = 0;
+	}
+
+	if (max_age_s == 0) {
+		adapter_device_pruning_stop(gattlib_adapter);
+		return GATTLIB_SUCCESS;
+	}
+
+	// Keep the time the devices were last seen when only the age changes
+	if (gattlib_adapter->device_last_seen == NULL) {
+		gattlib_adapter->device_last_seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+	gattlib_adapter->device_pruning_max_age_s = max_age_s;
+	gattlib_adapter->device_pruning_timeout_id = g_timeout_add_seconds(MIN(max_age_s, DEVICE_PRUNING_MAX_PERIOD_S),
+			adapter_prune_devices, gattlib_adapter);
+
+	return GATTLIB_SUCCESS;
+}
+
+int gattlib_adapter_set_scan_ad_filters(void *adapter, const gattlib_ad_filter_t *filters, size_t filter_count)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+
+	if ((gattlib_adapter == NULL) || ((filters == NULL) && (filter_count > 0))) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	return gattlib_ad_filters_set(&gattlib_adapter->scan_ad_filters, filters, filter_count);
+}
+
+struct gattlib_scan_table **gattlib_adapter_scan_table_ptr(void *adapter)
+{
+	return &((struct gattlib_adapter *)adapter)->scan_table;
+}
+
 int gattlib_adapter_close(void* adapter)
 {
 	struct gattlib_adapter *gattlib_adapter = adapter;
 
+	if (gattlib_adapter->background_scan != NULL) {
+		gattlib_adapter_scan_stop(adapter);
+	}
+	advertisement_monitor_remove_all(gattlib_adapter);
+	adapter_device_pruning_stop(gattlib_adapter);
+	gattlib_scan_scheduler_free(gattlib_adapter->scan_scheduler);
+	gattlib_ad_filters_clear(&gattlib_adapter->scan_ad_filters);
+	gattlib_scan_table_disable(gattlib_adapter);
 	if(gattlib_adapter->device_manager != NULL)
 		g_object_unref(gattlib_adapter->device_manager);
 	g_object_unref(gattlib_adapter->adapter_proxy);
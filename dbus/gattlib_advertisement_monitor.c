@@ -0,0 +1,361 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "gattlib_internal.h"
+
+#if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 54)
+
+int gattlib_adapter_advertisement_monitor_add(void *adapter, const gattlib_advertisement_monitor_t *monitor,
+		gattlib_advertisement_monitor_cb_t device_found_cb, gattlib_advertisement_monitor_cb_t device_lost_cb,
+		void *user_data, void **monitor_handle)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+int gattlib_adapter_advertisement_monitor_remove(void *adapter, void *monitor_handle)
+{
+	return GATTLIB_NOT_SUPPORTED;
+}
+
+void advertisement_monitor_remove_all(struct gattlib_adapter *gattlib_adapter)
+{
+}
+
+#else
+
+//
+// Bluez discovers the monitors of an application through the 'org.freedesktop.DBus.ObjectManager'
+// exported at the application root path. Each monitor is an object exporting 'org.bluez.AdvertisementMonitor1'.
+// The application root is registered to Bluez with the first monitor and unregistered with the last one.
+//
+
+#define ADVERTISEMENT_MONITOR_ROOT_PATH   "/org/gattlib/monitor"
+
+struct gattlib_advertisement_monitor {
+	struct gattlib_adapter *adapter;
+
+	GDBusObjectSkeleton *object;
+	OrgBluezAdvertisementMonitor1 *monitor;
+
+	gattlib_advertisement_monitor_cb_t device_found_cb;
+	gattlib_advertisement_monitor_cb_t device_lost_cb;
+	void *user_data;
+};
+
+/*
+ * Convert a Bluez device object path (ie: '/org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF') into its MAC address
+ */
+static int get_mac_from_device_path(const char *device_path, char *mac_address, size_t mac_address_len)
+{
+	const char *device_name = strrchr(device_path, '/');
+
+	if ((device_name == NULL) || (strncmp(device_name, "/dev_", 5) != 0) || (strlen(device_name + 5) + 1 > mac_address_len)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	strcpy(mac_address, device_name + 5);
+	for (char *c = mac_address; *c != '\0'; c++) {
+		if (*c == '_') {
+			*c = ':';
+		}
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static gboolean on_handle_release(OrgBluezAdvertisementMonitor1 *monitor, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	fprintf(stderr, "Advertisement monitor '%s' released by Bluez.\n",
+		g_dbus_interface_skeleton_get_object_path(G_DBUS_INTERFACE_SKELETON(monitor)));
+	org_bluez_advertisement_monitor1_complete_release(monitor, invocation);
+	return TRUE;
+}
+
+static gboolean on_handle_activate(OrgBluezAdvertisementMonitor1 *monitor, GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	org_bluez_advertisement_monitor1_complete_activate(monitor, invocation);
+	return TRUE;
+}
+
+static gboolean on_handle_device_found(OrgBluezAdvertisementMonitor1 *monitor, GDBusMethodInvocation *invocation,
+		const gchar *device, gpointer user_data)
+{
+	struct gattlib_advertisement_monitor *advertisement_monitor = user_data;
+	char mac_address[18];
+
+	org_bluez_advertisement_monitor1_complete_device_found(monitor, invocation);
+
+	if ((advertisement_monitor->device_found_cb != NULL) &&
+	    (get_mac_from_device_path(device, mac_address, sizeof(mac_address)) == GATTLIB_SUCCESS)) {
+		advertisement_monitor->device_found_cb(advertisement_monitor->adapter, mac_address, advertisement_monitor->user_data);
+	}
+	return TRUE;
+}
+
+static gboolean on_handle_device_lost(OrgBluezAdvertisementMonitor1 *monitor, GDBusMethodInvocation *invocation,
+		const gchar *device, gpointer user_data)
+{
+	struct gattlib_advertisement_monitor *advertisement_monitor = user_data;
+	char mac_address[18];
+
+	org_bluez_advertisement_monitor1_complete_device_lost(monitor, invocation);
+
+	if ((advertisement_monitor->device_lost_cb != NULL) &&
+	    (get_mac_from_device_path(device, mac_address, sizeof(mac_address)) == GATTLIB_SUCCESS)) {
+		advertisement_monitor->device_lost_cb(advertisement_monitor->adapter, mac_address, advertisement_monitor->user_data);
+	}
+	return TRUE;
+}
+
+static OrgBluezAdvertisementMonitorManager1 *get_advertisement_monitor_manager(struct gattlib_adapter *gattlib_adapter)
+{
+	char object_path[20];
+	OrgBluezAdvertisementMonitorManager1 *manager;
+	GError *error = NULL;
+
+	snprintf(object_path, sizeof(object_path), "/org/bluez/%s", gattlib_adapter->adapter_name);
+
+	manager = org_bluez_advertisement_monitor_manager1_proxy_new_for_bus_sync(
+			G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE,
+			"org.bluez",
+			object_path,
+			NULL, &error);
+	if (manager == NULL) {
+		if (error) {
+			fprintf(stderr, "Failed to get advertisement monitor manager %s: %s\n", object_path, error->message);
+			g_error_free(error);
+		} else {
+			fprintf(stderr, "Failed to get advertisement monitor manager %s\n", object_path);
+		}
+	}
+	return manager;
+}
+
+/*
+ * Export the application root and register it to Bluez
+ */
+static int advertisement_monitor_register_application(struct gattlib_adapter *gattlib_adapter)
+{
+	OrgBluezAdvertisementMonitorManager1 *manager;
+	GDBusConnection *connection;
+	char root_path[64];
+	GError *error = NULL;
+
+	manager = get_advertisement_monitor_manager(gattlib_adapter);
+	if (manager == NULL) {
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	// The interface is only exposed when Bluez supports the advertisement monitors
+	if (org_bluez_advertisement_monitor_manager1_get_supported_monitor_types(manager) == NULL) {
+		g_object_unref(manager);
+		return GATTLIB_NOT_SUPPORTED;
+	}
+
+	connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (connection == NULL) {
+		fprintf(stderr, "Failed to get DBus system bus: %s\n", error->message);
+		g_error_free(error);
+		g_object_unref(manager);
+		return GATTLIB_ERROR_DBUS;
+	}
+
+	snprintf(root_path, sizeof(root_path), ADVERTISEMENT_MONITOR_ROOT_PATH "/%s", gattlib_adapter->adapter_name);
+
+	gattlib_adapter->advertisement_monitor_manager = g_dbus_object_manager_server_new(root_path);
+	g_dbus_object_manager_server_set_connection(gattlib_adapter->advertisement_monitor_manager, connection);
+	g_object_unref(connection);
+
+	org_bluez_advertisement_monitor_manager1_call_register_monitor_sync(manager, root_path, NULL, &error);
+	g_object_unref(manager);
+	if (error) {
+		fprintf(stderr, "Failed to register advertisement monitor application: %s\n", error->message);
+		g_error_free(error);
+
+		g_object_unref(gattlib_adapter->advertisement_monitor_manager);
+		gattlib_adapter->advertisement_monitor_manager = NULL;
+		return GATTLIB_ERROR_BLUEZ;
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+static void advertisement_monitor_unregister_application(struct gattlib_adapter *gattlib_adapter)
+{
+	OrgBluezAdvertisementMonitorManager1 *manager;
+	GError *error = NULL;
+
+	manager = get_advertisement_monitor_manager(gattlib_adapter);
+	if (manager != NULL) {
+		org_bluez_advertisement_monitor_manager1_call_unregister_monitor_sync(manager,
+				g_dbus_object_manager_get_object_path(G_DBUS_OBJECT_MANAGER(gattlib_adapter->advertisement_monitor_manager)),
+				NULL, &error);
+		// Ignore the error
+		if (error) {
+			g_error_free(error);
+		}
+		g_object_unref(manager);
+	}
+
+	g_object_unref(gattlib_adapter->advertisement_monitor_manager);
+	gattlib_adapter->advertisement_monitor_manager = NULL;
+}
+
+static GVariant *advertisement_monitor_patterns_to_variant(const gattlib_advertisement_monitor_t *monitor)
+{
+	GVariantBuilder patterns_builder;
+
+	g_variant_builder_init(&patterns_builder, G_VARIANT_TYPE("a(yyay)"));
+
+	for (size_t i = 0; i < monitor->pattern_count; i++) {
+		const gattlib_advertisement_monitor_pattern_t *pattern = &monitor->patterns[i];
+
+		g_variant_builder_add(&patterns_builder, "(yy@ay)",
+				pattern->start_position, pattern->ad_type,
+				g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, pattern->content, pattern->content_length, sizeof(uint8_t)));
+	}
+
+	return g_variant_builder_end(&patterns_builder);
+}
+
+int gattlib_adapter_advertisement_monitor_add(void *adapter, const gattlib_advertisement_monitor_t *monitor,
+		gattlib_advertisement_monitor_cb_t device_found_cb, gattlib_advertisement_monitor_cb_t device_lost_cb,
+		void *user_data, void **monitor_handle)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	struct gattlib_advertisement_monitor *advertisement_monitor;
+	char object_path[96];
+	int ret;
+
+	if ((gattlib_adapter == NULL) || (monitor == NULL) || (monitor_handle == NULL) ||
+	    (monitor->patterns == NULL) || (monitor->pattern_count == 0)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	for (size_t i = 0; i < monitor->pattern_count; i++) {
+		if ((monitor->patterns[i].content_length == 0) ||
+		    (monitor->patterns[i].content_length > GATTLIB_ADVERTISEMENT_MONITOR_PATTERN_MAX_LEN)) {
+			return GATTLIB_INVALID_PARAMETER;
+		}
+	}
+
+	if (gattlib_adapter->advertisement_monitor_manager == NULL) {
+		ret = advertisement_monitor_register_application(gattlib_adapter);
+		if (ret != GATTLIB_SUCCESS) {
+			return ret;
+		}
+	}
+
+	advertisement_monitor = calloc(1, sizeof(struct gattlib_advertisement_monitor));
+	if (advertisement_monitor == NULL) {
+		if (gattlib_adapter->advertisement_monitors == NULL) {
+			advertisement_monitor_unregister_application(gattlib_adapter);
+		}
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+
+	advertisement_monitor->adapter = gattlib_adapter;
+	advertisement_monitor->device_found_cb = device_found_cb;
+	advertisement_monitor->device_lost_cb = device_lost_cb;
+	advertisement_monitor->user_data = user_data;
+
+	advertisement_monitor->monitor = org_bluez_advertisement_monitor1_skeleton_new();
+	org_bluez_advertisement_monitor1_set_type_(advertisement_monitor->monitor, "or_patterns");
+	org_bluez_advertisement_monitor1_set_rssi_low_threshold(advertisement_monitor->monitor, monitor->rssi_low_threshold);
+	org_bluez_advertisement_monitor1_set_rssi_high_threshold(advertisement_monitor->monitor, monitor->rssi_high_threshold);
+	org_bluez_advertisement_monitor1_set_rssi_low_timeout(advertisement_monitor->monitor, monitor->rssi_low_timeout);
+	org_bluez_advertisement_monitor1_set_rssi_high_timeout(advertisement_monitor->monitor, monitor->rssi_high_timeout);
+	org_bluez_advertisement_monitor1_set_rssi_sampling_period(advertisement_monitor->monitor, monitor->rssi_sampling_period);
+	org_bluez_advertisement_monitor1_set_patterns(advertisement_monitor->monitor, advertisement_monitor_patterns_to_variant(monitor));
+
+	g_signal_connect(advertisement_monitor->monitor, "handle-release", G_CALLBACK(on_handle_release), advertisement_monitor);
+	g_signal_connect(advertisement_monitor->monitor, "handle-activate", G_CALLBACK(on_handle_activate), advertisement_monitor);
+	g_signal_connect(advertisement_monitor->monitor, "handle-device-found", G_CALLBACK(on_handle_device_found), advertisement_monitor);
+	g_signal_connect(advertisement_monitor->monitor, "handle-device-lost", G_CALLBACK(on_handle_device_lost), advertisement_monitor);
+
+	snprintf(object_path, sizeof(object_path), "%s/monitor%u",
+			g_dbus_object_manager_get_object_path(G_DBUS_OBJECT_MANAGER(gattlib_adapter->advertisement_monitor_manager)),
+			gattlib_adapter->advertisement_monitor_next_id++);
+
+	// Exporting the object emits 'InterfacesAdded' that makes Bluez activate the monitor
+	advertisement_monitor->object = g_dbus_object_skeleton_new(object_path);
+	g_dbus_object_skeleton_add_interface(advertisement_monitor->object, G_DBUS_INTERFACE_SKELETON(advertisement_monitor->monitor));
+	g_dbus_object_manager_server_export(gattlib_adapter->advertisement_monitor_manager, advertisement_monitor->object);
+
+	gattlib_adapter->advertisement_monitors = g_slist_append(gattlib_adapter->advertisement_monitors, advertisement_monitor);
+
+	*monitor_handle = advertisement_monitor;
+	return GATTLIB_SUCCESS;
+}
+
+static void advertisement_monitor_free(struct gattlib_advertisement_monitor *advertisement_monitor)
+{
+	struct gattlib_adapter *gattlib_adapter = advertisement_monitor->adapter;
+
+	// Unexporting the object emits 'InterfacesRemoved' that makes Bluez release the monitor
+	g_dbus_object_manager_server_unexport(gattlib_adapter->advertisement_monitor_manager,
+			g_dbus_object_get_object_path(G_DBUS_OBJECT(advertisement_monitor->object)));
+
+	g_signal_handlers_disconnect_by_data(advertisement_monitor->monitor, advertisement_monitor);
+	g_object_unref(advertisement_monitor->object);
+	g_object_unref(advertisement_monitor->monitor);
+	free(advertisement_monitor);
+}
+
+int gattlib_adapter_advertisement_monitor_remove(void *adapter, void *monitor_handle)
+{
+	struct gattlib_adapter *gattlib_adapter = adapter;
+	GSList *item;
+
+	if ((gattlib_adapter == NULL) || (monitor_handle == NULL)) {
+		return GATTLIB_INVALID_PARAMETER;
+	}
+
+	item = g_slist_find(gattlib_adapter->advertisement_monitors, monitor_handle);
+	if (item == NULL) {
+		return GATTLIB_NOT_FOUND;
+	}
+
+	gattlib_adapter->advertisement_monitors = g_slist_delete_link(gattlib_adapter->advertisement_monitors, item);
+	advertisement_monitor_free(monitor_handle);
+
+	if (gattlib_adapter->advertisement_monitors == NULL) {
+		advertisement_monitor_unregister_application(gattlib_adapter);
+	}
+
+	return GATTLIB_SUCCESS;
+}
+
+void advertisement_monitor_remove_all(struct gattlib_adapter *gattlib_adapter)
+{
+	if (gattlib_adapter->advertisement_monitor_manager == NULL) {
+		return;
+	}
+
+	g_slist_free_full(gattlib_adapter->advertisement_monitors, (GDestroyNotify)advertisement_monitor_free);
+	gattlib_adapter->advertisement_monitors = NULL;
+
+	advertisement_monitor_unregister_application(gattlib_adapter);
+}
+
+#endif /* #if BLUEZ_VERSION < BLUEZ_VERSIONS(5, 54) */
@@ -40,19 +40,23 @@ const uuid_t m_battery_level_uuid = CREATE_UUID16(0x2A19);
 static const uuid_t m_ccc_uuid = CREATE_UUID16(0x2902);
 
 
+// The GATT proxies do not track the property changes (their properties do not change and the notifications
+// are received through 'gattlib_properties_subscribe()') so they do not add match rules to dbus-daemon
+// 'proxies_created' is the counter of the connection or the adapter the proxies are created for.
 static bool handle_dbus_gattcharacteristic_from_path(const char* device_object_path, const uuid_t* uuid,
-		struct dbus_characteristic *dbus_characteristic, const char* object_path, GError **error)
+		struct dbus_characteristic *dbus_characteristic, const char* object_path, uint64_t *proxies_created, GError **error)
 {
 	OrgBluezGattCharacteristic1 *characteristic = NULL;
 
 	*error = NULL;
 	characteristic = org_bluez_gatt_characteristic1_proxy_new_for_bus_sync (
 			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
 			"org.bluez",
 			object_path,
 			NULL,
 			error);
+	GATTLIB_STATS_INC(*proxies_created);
 	if (characteristic) {
 		if (uuid != NULL) {
 			uuid_t characteristic_uuid;
@@ -70,11 +74,12 @@ static bool handle_dbus_gattcharacteristic_from_path(const char* device_object_p
 		*error = NULL;
 		OrgBluezGattService1* service = org_bluez_gatt_service1_proxy_new_for_bus_sync (
 			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
 			"org.bluez",
 			org_bluez_gatt_characteristic1_get_service(characteristic),
 			NULL,
 			error);
+		GATTLIB_STATS_INC(*proxies_created);
 
 		if (service) {
 			const bool found = !strcmp(device_object_path, org_bluez_gatt_service1_get_device(service));
@@ -95,21 +100,22 @@ static bool handle_dbus_gattcharacteristic_from_path(const char* device_object_p
 }
 
 static bool handle_dbus_gattdescriptor_from_path(const char* device_object_path,
-		struct dbus_characteristic *dbus_characteristic, const char* object_path, GError **error)
+		struct dbus_characteristic *dbus_characteristic, const char* object_path, uint64_t *proxies_created, GError **error)
 {
 	OrgBluezGattDescriptor1 *descriptor = NULL;
 
 	*error = NULL;
 	descriptor = org_bluez_gatt_descriptor1_proxy_new_for_bus_sync (
 			G_BUS_TYPE_SYSTEM,
-			G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+			G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
 			"org.bluez",
 			object_path,
 			NULL,
 			error);
+	GATTLIB_STATS_INC(*proxies_created);
 	if (descriptor) {
 		if(handle_dbus_gattcharacteristic_from_path(device_object_path, NULL,
-					dbus_characteristic, org_bluez_gatt_descriptor1_get_characteristic(descriptor), error)) {
+					dbus_characteristic, org_bluez_gatt_descriptor1_get_characteristic(descriptor), proxies_created, error)) {
 			dbus_characteristic->desc = descriptor;
 			dbus_characteristic->type = TYPE_DESCRIPTOR;
 			return true;
@@ -123,7 +129,7 @@ static bool handle_dbus_gattdescriptor_from_path(const char* device_object_path,
 
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 static bool handle_dbus_battery_from_uuid(gattlib_context_t* conn_context, const uuid_t* uuid,
-		struct dbus_characteristic *dbus_characteristic, const char* object_path, GError **error)
+		struct dbus_characteristic *dbus_characteristic, const char* object_path, uint64_t *proxies_created, GError **error)
 {
 	OrgBluezBattery1 *battery = NULL;
 
@@ -135,6 +141,7 @@ static bool handle_dbus_battery_from_uuid(gattlib_context_t* conn_context, const
 			object_path,
 			NULL,
 			error);
+	GATTLIB_STATS_INC(*proxies_created);
 	if (battery) {
 		dbus_characteristic->battery = battery;
 		dbus_characteristic->type = TYPE_BATTERY_LEVEL;
@@ -178,7 +185,8 @@ struct dbus_characteristic get_characteristic_from_uuid(gatt_connection_t* conne
 		if (interface) {
 			g_object_unref(interface);
 
-			found = handle_dbus_gattcharacteristic_from_path(conn_context->device_object_path, uuid, &dbus_characteristic, object_path, &error);
+			found = handle_dbus_gattcharacteristic_from_path(conn_context->device_object_path, uuid, &dbus_characteristic, object_path,
+					&connection->stats.dbus_proxies_created, &error);
 			if (found) {
 				break;
 			}
@@ -190,7 +198,8 @@ struct dbus_characteristic get_characteristic_from_uuid(gatt_connection_t* conne
 			if (interface) {
 				g_object_unref(interface);
 
-				found = handle_dbus_battery_from_uuid(conn_context, uuid, &dbus_characteristic, object_path, &error);
+				found = handle_dbus_battery_from_uuid(conn_context, uuid, &dbus_characteristic, object_path,
+						&connection->stats.dbus_proxies_created, &error);
 				if (found) {
 					break;
 				}
@@ -204,7 +213,8 @@ struct dbus_characteristic get_characteristic_from_uuid(gatt_connection_t* conne
 	return dbus_characteristic;
 }
 
-static struct dbus_characteristic get_characteristic_from_handle_nc(GDBusObjectManager *device_manager, GList *dbus_objects, const char *device_object_path, int handle) {
+static struct dbus_characteristic get_characteristic_from_handle_nc(GDBusObjectManager *device_manager, GList *dbus_objects, const char *device_object_path, int handle,
+		uint64_t *proxies_created) {
 	GError *error = NULL;
 	int char_handle;
 
@@ -236,7 +246,7 @@ static struct dbus_characteristic get_characteristic_from_handle_nc(GDBusObjectM
 				continue;
 			}
 
-			found = handle_dbus_gattcharacteristic_from_path(device_object_path, NULL, &dbus_characteristic, object_path, &error);
+			found = handle_dbus_gattcharacteristic_from_path(device_object_path, NULL, &dbus_characteristic, object_path, proxies_created, &error);
 			if (found) {
 				break;
 			}
@@ -254,7 +264,7 @@ static struct dbus_characteristic get_characteristic_from_handle_nc(GDBusObjectM
 				continue;
 			}
 
-			found = handle_dbus_gattdescriptor_from_path(device_object_path, &dbus_characteristic, object_path, &error);
+			found = handle_dbus_gattdescriptor_from_path(device_object_path, &dbus_characteristic, object_path, proxies_created, &error);
 			if (found) {
 				break;
 			}
@@ -268,16 +278,19 @@ static struct dbus_characteristic get_characteristic_from_handle(gatt_connection
 	gattlib_context_t* conn_context = connection->context;
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(conn_context->adapter);
 
-	return get_characteristic_from_handle_nc(device_manager, conn_context->dbus_objects, conn_context->device_object_path, handle);
+	return get_characteristic_from_handle_nc(device_manager, conn_context->dbus_objects, conn_context->device_object_path, handle,
+			&connection->stats.dbus_proxies_created);
 }
 
 struct dbus_characteristic get_characteristic_from_mac_and_handle(void *adapter, const char *mac_address, int handle) {
 	GDBusObjectManager *device_manager = get_device_manager_from_adapter(adapter);
-	GList *dbus_objects = g_dbus_object_manager_get_objects(device_manager);
+	GList *dbus_objects;
 	char object_path[100];
 	get_device_path_from_mac_with_adapter(((struct gattlib_adapter *)adapter)->adapter_proxy, mac_address, object_path, sizeof(object_path));
+	dbus_objects = get_device_objects(device_manager, object_path);
 
-	struct dbus_characteristic res = get_characteristic_from_handle_nc(device_manager, dbus_objects, object_path, handle);
+	struct dbus_characteristic res = get_characteristic_from_handle_nc(device_manager, dbus_objects, object_path, handle,
+			&((struct gattlib_adapter *)adapter)->stats.dbus_proxies_created);
 
 	g_list_free_full(dbus_objects, g_object_unref);
 
@@ -451,7 +464,7 @@ static int read_battery_level(struct dbus_characteristic *dbus_characteristic, v
 }
 #endif
 
-int gattlib_read_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, void** buffer, size_t* buffer_len) {
+static int read_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, void** buffer, size_t* buffer_len) {
 	if(!gattlib_is_connected_from_mac(adapter, mac_address)) {
 		return GATTLIB_NOT_CONNECTED;
 	}
@@ -468,18 +481,33 @@ int gattlib_read_by_handle_from_mac(void *adapter, const char *mac_address, uint
 	}
 #endif
 	else if (dbus_characteristic.type == TYPE_DESCRIPTOR) {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		int ret = read_gatt_descriptor(&dbus_characteristic, buffer, buffer_len);
 		g_object_unref(dbus_characteristic.desc);
 		return ret;
 	} else if (dbus_characteristic.type != TYPE_GATT) {
 		return GATTLIB_NOT_SUPPORTED;
 	} else {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		int ret = read_gatt_characteristic(&dbus_characteristic, buffer, buffer_len);
 		g_object_unref(dbus_characteristic.gatt);
 		return ret;
 	}
 }
 
+int gattlib_read_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, void** buffer, size_t* buffer_len) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_READ, NULL, mac_address, handle, NULL, 0);
+	int ret;
+
+	ret = read_by_handle_from_mac(adapter, mac_address, handle, buffer, buffer_len);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? *buffer_len : 0);
+	}
+	return ret;
+}
+
 void gattlib_read_by_handle_from_mac_async(void* adapter, const char *mac_address, uint16_t handle, void *user_data, gatt_read_cb_t cb) {
 	if(!gattlib_is_connected_from_mac(adapter, mac_address)) {
 		cb(GATTLIB_NOT_CONNECTED, user_data, NULL, 0);
@@ -500,38 +528,53 @@ void gattlib_read_by_handle_from_mac_async(void* adapter, const char *mac_addres
 	}
 #endif
 	else if (dbus_characteristic.type == TYPE_DESCRIPTOR) {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		read_gatt_descriptor_async(&dbus_characteristic, user_data, cb);
 	} else if (dbus_characteristic.type != TYPE_GATT) {
 		cb(GATTLIB_NOT_SUPPORTED, user_data, NULL, 0);
 	} else {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		read_gatt_characteristic_async(&dbus_characteristic, user_data, cb);
 	}
 }
 
 
 int gattlib_read_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, void **buffer, size_t *buffer_len) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_READ, connection, NULL, 0, uuid, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_READ].issued);
+
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
 	if (dbus_characteristic.type == TYPE_NONE) {
-		return GATTLIB_NOT_FOUND;
+		ret = GATTLIB_NOT_FOUND;
 	}
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 	else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
-		return read_battery_level(&dbus_characteristic, buffer, buffer_len);
+		ret = read_battery_level(&dbus_characteristic, buffer, buffer_len);
 	}
 #endif
 	else if (dbus_characteristic.type != TYPE_GATT) {
-		return GATTLIB_NOT_SUPPORTED;
+		ret = GATTLIB_NOT_SUPPORTED;
 	} else {
-		int ret;
-
 		assert(dbus_characteristic.type == TYPE_GATT);
 
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
 		ret = read_gatt_characteristic(&dbus_characteristic, buffer, buffer_len);
 
 		g_object_unref(dbus_characteristic.gatt);
+	}
 
-		return ret;
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_read, *buffer_len);
 	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_READ, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? *buffer_len : 0);
+	}
+	return ret;
 }
 
 static void setWriteOptions(GVariantBuilder *variant_options, uint32_t options)
@@ -690,22 +733,36 @@ static void write_desc_async(struct dbus_characteristic *dbus_characteristic, co
 
 int gattlib_write_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len)
 {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE, connection, NULL, 0, uuid, buffer_len);
 	int ret;
 
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_WRITE].issued);
+
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
 	if (dbus_characteristic.type == TYPE_NONE) {
-		return GATTLIB_NOT_FOUND;
-	} else if(dbus_characteristic.type != TYPE_GATT) {
-		return GATTLIB_NOT_SUPPORTED;
+		ret = GATTLIB_NOT_FOUND;
+	} else if (dbus_characteristic.type != TYPE_GATT) {
+		ret = GATTLIB_NOT_SUPPORTED;
+	} else {
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
+		ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+
+		g_object_unref(dbus_characteristic.gatt);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_written, buffer_len);
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_WRITE, ret);
 
-	g_object_unref(dbus_characteristic.gatt);
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
 	return ret;
 }
 
-int gattlib_write_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, const void* buffer, size_t buffer_len) {
+static int write_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, const void* buffer, size_t buffer_len) {
 	if(!gattlib_is_connected_from_mac(adapter, mac_address)) {
 		return GATTLIB_NOT_CONNECTED;
 	}
@@ -716,6 +773,7 @@ int gattlib_write_by_handle_from_mac(void *adapter, const char *mac_address, uin
 	if (dbus_characteristic.type == TYPE_NONE) {
 		return GATTLIB_NOT_FOUND;
 	} else if (dbus_characteristic.type == TYPE_DESCRIPTOR) {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		int ret = write_desc(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
 		g_object_unref(dbus_characteristic.desc);
 		return ret;
@@ -723,12 +781,26 @@ int gattlib_write_by_handle_from_mac(void *adapter, const char *mac_address, uin
 		return GATTLIB_NOT_SUPPORTED;
 	}
 	else {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		int ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
 		g_object_unref(dbus_characteristic.gatt);
 		return ret;
 	}
 }
 
+int gattlib_write_by_handle_from_mac(void *adapter, const char *mac_address, uint16_t handle, const void* buffer, size_t buffer_len) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE, NULL, mac_address, handle, NULL, buffer_len);
+	int ret;
+
+	ret = write_by_handle_from_mac(adapter, mac_address, handle, buffer, buffer_len);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
+	return ret;
+}
+
 void gattlib_write_by_handle_from_mac_async(void *adapter, const char *mac_address, uint16_t handle, const void* buffer, size_t buffer_len, void *user_data, gatt_write_cb_t cb) {
 	if(!gattlib_is_connected_from_mac(adapter, mac_address)) {
 		cb(GATTLIB_NOT_CONNECTED, user_data);
@@ -742,62 +814,106 @@ void gattlib_write_by_handle_from_mac_async(void *adapter, const char *mac_addre
 	if (dbus_characteristic.type == TYPE_NONE) {
 		cb(GATTLIB_NOT_FOUND, user_data);
 	} else if (dbus_characteristic.type == TYPE_DESCRIPTOR) {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		write_desc_async(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE, user_data, cb);
 	} else if (dbus_characteristic.type != TYPE_GATT) {
 		cb(GATTLIB_NOT_SUPPORTED, user_data);
 	} else {
+		GATTLIB_STATS_INC(((struct gattlib_adapter *)adapter)->stats.dbus_calls);
 		write_char_async(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE, user_data, cb);
 	}
 }
 
 int gattlib_write_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len)
 {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE, connection, NULL, handle, NULL, buffer_len);
 	int ret;
 
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_WRITE].issued);
+
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_handle(connection, handle);
 	if (dbus_characteristic.type == TYPE_NONE) {
-		return GATTLIB_NOT_FOUND;
+		ret = GATTLIB_NOT_FOUND;
 	} else if (dbus_characteristic.type != TYPE_GATT) {
-		return GATTLIB_NOT_SUPPORTED;
+		ret = GATTLIB_NOT_SUPPORTED;
+	} else {
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
+		ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+
+		g_object_unref(dbus_characteristic.gatt);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITH_RESPONSE);
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_written, buffer_len);
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_WRITE, ret);
 
-	g_object_unref(dbus_characteristic.gatt);
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
 	return ret;
 }
 
 int gattlib_write_without_response_char_by_uuid(gatt_connection_t* connection, uuid_t* uuid, const void* buffer, size_t buffer_len)
 {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE_WITHOUT_RESPONSE, connection, NULL, 0, uuid, buffer_len);
 	int ret;
 
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_WRITE_WITHOUT_RESPONSE].issued);
+
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
 	if (dbus_characteristic.type == TYPE_NONE) {
-		return GATTLIB_NOT_FOUND;
+		ret = GATTLIB_NOT_FOUND;
 	} else if (dbus_characteristic.type != TYPE_GATT) {
-		return GATTLIB_NOT_SUPPORTED;
+		ret = GATTLIB_NOT_SUPPORTED;
+	} else {
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
+		ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+
+		g_object_unref(dbus_characteristic.gatt);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_written, buffer_len);
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_WRITE_WITHOUT_RESPONSE, ret);
 
-	g_object_unref(dbus_characteristic.gatt);
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
 	return ret;
 }
 
 int gattlib_write_without_response_char_by_handle(gatt_connection_t* connection, uint16_t handle, const void* buffer, size_t buffer_len)
 {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_WRITE_WITHOUT_RESPONSE, connection, NULL, handle, NULL, buffer_len);
 	int ret;
 
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_WRITE_WITHOUT_RESPONSE].issued);
+
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_handle(connection, handle);
 	if (dbus_characteristic.type == TYPE_NONE) {
-		return GATTLIB_NOT_FOUND;
+		ret = GATTLIB_NOT_FOUND;
 	} else if (dbus_characteristic.type != TYPE_GATT) {
-		return GATTLIB_NOT_SUPPORTED;
+		ret = GATTLIB_NOT_SUPPORTED;
+	} else {
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
+		ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+
+		g_object_unref(dbus_characteristic.gatt);
 	}
 
-	ret = write_char(&dbus_characteristic, buffer, buffer_len, BLUEZ_GATT_WRITE_VALUE_TYPE_WRITE_WITHOUT_RESPONSE);
+	if (ret == GATTLIB_SUCCESS) {
+		GATTLIB_STATS_ADD(connection->stats.bytes_written, buffer_len);
+	}
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_WRITE_WITHOUT_RESPONSE, ret);
 
-	g_object_unref(dbus_characteristic.gatt);
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
+	}
 	return ret;
 }
 
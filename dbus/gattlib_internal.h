@@ -45,6 +45,11 @@
 	#include "org-bluez-battery1.h"
 #endif
 
+#if BLUEZ_VERSION >= BLUEZ_VERSIONS(5, 54)
+	#include "org-bluez-advertisementmonitor1.h"
+	#include "org-bluez-advertisementmonitormanager1.h"
+#endif
+
 #define GATTLIB_DEFAULT_ADAPTER "hci0"
 
 typedef struct {
@@ -52,15 +57,27 @@ typedef struct {
 
 	char* device_object_path;
 	OrgBluezDevice1* device;
+	// Changes of the properties of the device (connection state)
+	struct gattlib_properties_subscription *device_subscription;
 
 	// This attribute is only used during the connection stage. By placing the attribute here, we can pass
 	// `gatt_connection_t` to
 	GMainLoop *connection_loop;
 	// ID of the timeout to know if we managed to connect to the device
 	guint connection_timeout;
+	// Set when Bluez reports the loss of the link, cleared when the link comes back
+	bool link_lost;
 
-	// List of DBUS Object managed by 'adapter->device_manager'
+	// List of the DBUS Objects of the device managed by 'adapter->device_manager'
+	// (kept up to date by the 'object-added' and 'object-removed' signals)
 	GList *dbus_objects;
+	gulong object_added_signal_id;
+	gulong object_removed_signal_id;
+
+	// Range of the GATT objects added or removed since the services have been resolved
+	guint service_changed_timeout_id;
+	uint16_t service_changed_start;
+	uint16_t service_changed_end;
 
 	// List of 'OrgBluezGattCharacteristic1*' which has an attached notification
 	GList *notified_characteristics;
@@ -74,6 +91,35 @@ struct gattlib_adapter {
 
 	GMainLoop *scan_loop;
 	guint timeout_id;
+
+	// Scan started by 'gattlib_adapter_scan_start()' (NULL when not scanning)
+	struct gattlib_background_scan *background_scan;
+
+	// Per-device coalescing rules applied to the next scans
+	struct gattlib_scan_coalescing scan_coalescing;
+
+	// Manufacturer/service data filters evaluated before the scan callbacks
+	struct gattlib_ad_filters scan_ad_filters;
+
+	// Live device table fed by the scanner (NULL when disabled)
+	struct gattlib_scan_table *scan_table;
+
+	// Object manager exporting the advertisement monitors registered to Bluez (NULL when none)
+	GDBusObjectManagerServer *advertisement_monitor_manager;
+	GSList *advertisement_monitors;
+	unsigned int advertisement_monitor_next_id;
+
+	// Interleaving of the background scan with the connections
+	struct gattlib_scan_scheduler *scan_scheduler;
+
+	// Removal of the stale device objects (see 'gattlib_adapter_set_device_pruning()')
+	uint32_t device_pruning_max_age_s;
+	guint device_pruning_timeout_id;
+	// Object path of the devices -> last time they were seen (monotonic time in seconds)
+	GHashTable *device_last_seen;
+
+	// Counters returned by 'gattlib_adapter_get_stats()'
+	gattlib_adapter_stats_t stats;
 };
 
 struct dbus_characteristic {
@@ -102,6 +148,23 @@ GDBusObjectManager *get_device_manager_from_adapter(struct gattlib_adapter *gatt
 void get_device_path_from_mac_with_adapter(OrgBluezAdapter1* adapter, const char *mac_address, char *object_path, size_t object_path_len);
 void get_device_path_from_mac(const char *adapter_name, const char *mac_address, char *object_path, size_t object_path_len);
 int get_bluez_device_from_mac(struct gattlib_adapter *adapter, const char *mac_address, OrgBluezDevice1 **bluez_device1);
+bool is_device_object_path(const char *device_object_path, const char *object_path);
+GList *get_device_objects(GDBusObjectManager *device_manager, const char *device_object_path);
+int get_raw_advertising_data_from_device(OrgBluezDevice1 *bluez_device1, uint8_t *out, size_t *out_size, size_t max_out);
+
+void advertisement_monitor_remove_all(struct gattlib_adapter *gattlib_adapter);
+
+/*
+ * Demultiplexing of the Bluez 'PropertiesChanged' signals (see 'gattlib_properties.c')
+ */
+struct gattlib_properties_subscription;
+
+typedef void (*gattlib_properties_changed_cb_t)(const char *object_path, GVariant *changed_properties, void *user_data);
+
+struct gattlib_properties_subscription *gattlib_properties_subscribe(const char *object_path, const char *interface_name,
+		gattlib_properties_changed_cb_t callback, void *user_data);
+// Wait for the callback if it is running in another thread: it must not wait for a lock held by the caller
+void gattlib_properties_unsubscribe(struct gattlib_properties_subscription *subscription);
 
 struct dbus_characteristic get_characteristic_from_uuid(gatt_connection_t* connection, const uuid_t* uuid);
 
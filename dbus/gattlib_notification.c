@@ -29,126 +29,96 @@
 #include "gattlib_internal.h"
 
 struct gattlib_notification_handle {
+	gatt_connection_t* connection;
+	// NULL for the battery level (handled by Bluez)
 	OrgBluezGattCharacteristic1 *gatt;
-	gulong signal_id;
+	struct gattlib_properties_subscription *subscription;
 	uuid_t uuid;
+	bool indication;
 };
 
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
-gboolean on_handle_battery_level_property_change(
-		OrgBluezBattery1 *object,
-	    GVariant *arg_changed_properties,
-	    const gchar *const *arg_invalidated_properties,
-	    gpointer user_data)
+static void on_handle_battery_level_property_change(const char *object_path, GVariant *arg_changed_properties, void *user_data)
 {
-	static guint8 percentage;
-	gatt_connection_t* connection = user_data;
-
-	if (gattlib_has_valid_handler(&connection->notification)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key;
-			GVariant *value;
-
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				if (strcmp(key, "Percentage") == 0) {
-					//TODO: by declaring 'percentage' as a 'static' would mean we could have issue in case of multiple
-					//      GATT connection notifiying to Battery level
-					percentage = g_variant_get_byte(value);
+	struct gattlib_notification_handle *notification_handle = user_data;
+	gatt_connection_t* connection = notification_handle->connection;
 
+	// Retrieve 'Value' from 'arg_changed_properties'
+	if (g_variant_n_children (arg_changed_properties) > 0) {
+		GVariantIter *iter;
+		const gchar *key;
+		GVariant *value;
+
+		g_variant_get (arg_changed_properties, "a{sv}", &iter);
+		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+			if (strcmp(key, "Percentage") == 0) {
+				guint8 percentage = g_variant_get_byte(value);
+
+				GATTLIB_STATS_INC(connection->stats.notifications_received);
+				GATTLIB_STATS_ADD(connection->stats.bytes_notified, sizeof(percentage));
+
+				if (gattlib_has_valid_handler(&connection->notification)) {
 					gattlib_call_notification_handler(&connection->notification,
 							&m_battery_level_uuid,
 							(const uint8_t*)&percentage, sizeof(percentage));
-					break;
+				} else {
+					GATTLIB_STATS_INC(connection->stats.notifications_dropped);
 				}
+				break;
 			}
-			g_variant_iter_free(iter);
 		}
+		g_variant_iter_free(iter);
 	}
-	return TRUE;
 }
 #endif
 
-static gboolean on_handle_characteristic_property_change(
-	    OrgBluezGattCharacteristic1 *object,
-	    GVariant *arg_changed_properties,
-	    const gchar *const *arg_invalidated_properties,
-	    gpointer user_data)
+static void on_handle_characteristic_property_change(const char *object_path, GVariant *arg_changed_properties, void *user_data)
 {
-	gatt_connection_t* connection = user_data;
-
-	if (gattlib_has_valid_handler(&connection->notification)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key;
-			GVariant *value;
-
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				if (strcmp(key, "Value") == 0) {
-					uuid_t uuid;
-					size_t data_length;
-					const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
-
-					gattlib_string_to_uuid(
-							org_bluez_gatt_characteristic1_get_uuid(object),
-							MAX_LEN_UUID_STR + 1,
-							&uuid);
-
-					gattlib_call_notification_handler(&connection->notification,
-							&uuid, data, data_length);
-					break;
+	struct gattlib_notification_handle *notification_handle = user_data;
+	gatt_connection_t* connection = notification_handle->connection;
+	struct gattlib_handler *handler = notification_handle->indication ? &connection->indication : &connection->notification;
+
+	// Retrieve 'Value' from 'arg_changed_properties'
+	if (g_variant_n_children (arg_changed_properties) > 0) {
+		GVariantIter *iter;
+		const gchar *key;
+		GVariant *value;
+
+		g_variant_get (arg_changed_properties, "a{sv}", &iter);
+		while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
+			if (strcmp(key, "Value") == 0) {
+				size_t data_length;
+				const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
+
+				GATTLIB_STATS_INC(connection->stats.notifications_received);
+				GATTLIB_STATS_ADD(connection->stats.bytes_notified, data_length);
+
+				if (gattlib_has_valid_handler(handler)) {
+					gattlib_call_notification_handler(handler, &notification_handle->uuid, data, data_length);
+				} else {
+					GATTLIB_STATS_INC(connection->stats.notifications_dropped);
 				}
+				break;
 			}
-			g_variant_iter_free(iter);
 		}
+		g_variant_iter_free(iter);
 	}
-	return TRUE;
 }
 
-static gboolean on_handle_characteristic_indication(
-	    OrgBluezGattCharacteristic1 *object,
-	    GVariant *arg_changed_properties,
-	    const gchar *const *arg_invalidated_properties,
-	    gpointer user_data)
-{
-	gatt_connection_t* connection = user_data;
-
-	if (gattlib_has_valid_handler(&connection->indication)) {
-		// Retrieve 'Value' from 'arg_changed_properties'
-		if (g_variant_n_children (arg_changed_properties) > 0) {
-			GVariantIter *iter;
-			const gchar *key;
-			GVariant *value;
-
-			g_variant_get (arg_changed_properties, "a{sv}", &iter);
-			while (g_variant_iter_loop (iter, "{&sv}", &key, &value)) {
-				if (strcmp(key, "Value") == 0) {
-					uuid_t uuid;
-					size_t data_length;
-					const uint8_t* data = g_variant_get_fixed_array(value, &data_length, sizeof(guchar));
-
-					gattlib_string_to_uuid(
-							org_bluez_gatt_characteristic1_get_uuid(object),
-							MAX_LEN_UUID_STR + 1,
-							&uuid);
-
-					gattlib_call_notification_handler(&connection->indication,
-							&uuid, data, data_length);
-					break;
-				}
-			}
-			g_variant_iter_free(iter);
-		}
+static void notification_handle_free(struct gattlib_notification_handle *notification_handle) {
+	gattlib_properties_unsubscribe(notification_handle->subscription);
+	if (notification_handle->gatt != NULL) {
+		g_object_unref(notification_handle->gatt);
 	}
-	return TRUE;
+	free(notification_handle);
 }
 
-static int connect_signal_to_characteristic_uuid(gatt_connection_t* connection, const uuid_t* uuid, void *callback) {
+static int connect_signal_to_characteristic_uuid_nc(gatt_connection_t* connection, const uuid_t* uuid, bool indication) {
 	gattlib_context_t* conn_context = connection->context;
+	struct gattlib_notification_handle *notification_handle;
+	gattlib_properties_changed_cb_t callback;
+	const char *interface_name;
+	GDBusProxy *proxy;
 
 	struct dbus_characteristic dbus_characteristic = get_characteristic_from_uuid(connection, uuid);
 	if (dbus_characteristic.type == TYPE_NONE) {
@@ -157,39 +127,53 @@ static int connect_signal_to_characteristic_uuid(gatt_connection_t* connection,
 	}
 #if BLUEZ_VERSION > BLUEZ_VERSIONS(5, 40)
 	else if (dbus_characteristic.type == TYPE_BATTERY_LEVEL) {
-		// Register a handle for notification
-		g_signal_connect(dbus_characteristic.battery,
-			"g-properties-changed",
-			G_CALLBACK (on_handle_battery_level_property_change),
-			connection);
-
-		return GATTLIB_SUCCESS;
-	} else {
-		assert(dbus_characteristic.type == TYPE_GATT);
+		proxy = G_DBUS_PROXY(dbus_characteristic.battery);
+		interface_name = "org.bluez.Battery1";
+		callback = on_handle_battery_level_property_change;
 	}
 #endif
+	else {
+		assert(dbus_characteristic.type == TYPE_GATT);
+		proxy = G_DBUS_PROXY(dbus_characteristic.gatt);
+		interface_name = "org.bluez.GattCharacteristic1";
+		callback = on_handle_characteristic_property_change;
+	}
+
+	notification_handle = calloc(1, sizeof(struct gattlib_notification_handle));
+	if (notification_handle == NULL) {
+		g_object_unref(proxy);
+		return GATTLIB_OUT_OF_MEMORY;
+	}
+	notification_handle->connection = connection;
+	notification_handle->indication = indication;
+	memcpy(&notification_handle->uuid, uuid, sizeof(*uuid));
 
 	// Register a handle for notification
-	gulong signal_id = g_signal_connect(dbus_characteristic.gatt,
-		"g-properties-changed",
-		G_CALLBACK(callback),
-		connection);
-	if (signal_id == 0) {
+	notification_handle->subscription = gattlib_properties_subscribe(g_dbus_proxy_get_object_path(proxy), interface_name,
+			callback, notification_handle);
+	if (notification_handle->subscription == NULL) {
 		fprintf(stderr, "Failed to connect signal to DBus GATT notification\n");
+		g_object_unref(proxy);
+		free(notification_handle);
 		return GATTLIB_ERROR_DBUS;
 	}
 
-	// Add signal to the list
-	struct gattlib_notification_handle *notification_handle = malloc(sizeof(struct gattlib_notification_handle));
-	if (notification_handle == NULL) {
-		return GATTLIB_OUT_OF_MEMORY;
+	if (dbus_characteristic.type != TYPE_GATT) {
+		// Bluez notifies the battery level changes on its own
+		g_object_unref(proxy);
+	} else {
+		notification_handle->gatt = dbus_characteristic.gatt;
 	}
-	notification_handle->gatt = dbus_characteristic.gatt;
-	notification_handle->signal_id = signal_id;
-	memcpy(&notification_handle->uuid, uuid, sizeof(*uuid));
+
+	// Add signal to the list
 	conn_context->notified_characteristics = g_list_append(conn_context->notified_characteristics, notification_handle);
 
+	if (notification_handle->gatt == NULL) {
+		return GATTLIB_SUCCESS;
+	}
+
 	GError *error = NULL;
+	GATTLIB_STATS_INC(connection->stats.dbus_calls);
 	org_bluez_gatt_characteristic1_call_start_notify_sync(dbus_characteristic.gatt, NULL, &error);
 
 	if (error) {
@@ -201,9 +185,10 @@ static int connect_signal_to_characteristic_uuid(gatt_connection_t* connection,
 	}
 }
 
-static int disconnect_signal_to_characteristic_uuid(gatt_connection_t* connection, const uuid_t* uuid, void *callback) {
+static int disconnect_signal_to_characteristic_uuid_nc(gatt_connection_t* connection, const uuid_t* uuid) {
 	gattlib_context_t* conn_context = connection->context;
 	struct gattlib_notification_handle *notification_handle = NULL;
+	GError *error = NULL;
 
 	// Find notification handle
 	for (GList *l = conn_context->notified_characteristics; l != NULL; l = l->next) {
@@ -220,13 +205,13 @@ static int disconnect_signal_to_characteristic_uuid(gatt_connection_t* connectio
 		return GATTLIB_NOT_FOUND;
 	}
 
-	g_signal_handler_disconnect(notification_handle->gatt, notification_handle->signal_id);
-
-	GError *error = NULL;
-	org_bluez_gatt_characteristic1_call_stop_notify_sync(
-			notification_handle->gatt, NULL, &error);
+	if (notification_handle->gatt != NULL) {
+		GATTLIB_STATS_INC(connection->stats.dbus_calls);
+		org_bluez_gatt_characteristic1_call_stop_notify_sync(
+				notification_handle->gatt, NULL, &error);
+	}
 
-	free(notification_handle);
+	notification_handle_free(notification_handle);
 
 	if (error) {
 		fprintf(stderr, "Failed to stop DBus GATT notification: %s\n", error->message);
@@ -237,30 +222,57 @@ static int disconnect_signal_to_characteristic_uuid(gatt_connection_t* connectio
 	}
 }
 
+static int connect_signal_to_characteristic_uuid(gatt_connection_t* connection, const uuid_t* uuid, bool indication) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_NOTIFICATION_START, connection, NULL, 0, uuid, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_NOTIFICATION_START].issued);
+	ret = connect_signal_to_characteristic_uuid_nc(connection, uuid, indication);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_START, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
+static int disconnect_signal_to_characteristic_uuid(gatt_connection_t* connection, const uuid_t* uuid) {
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_NOTIFICATION_STOP, connection, NULL, 0, uuid, 0);
+	int ret;
+
+	GATTLIB_STATS_INC(connection->stats.operations[GATTLIB_STATS_OPERATION_NOTIFICATION_STOP].issued);
+	ret = disconnect_signal_to_characteristic_uuid_nc(connection, uuid);
+	gattlib_stats_operation_done(&connection->stats, GATTLIB_STATS_OPERATION_NOTIFICATION_STOP, ret);
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, 0);
+	}
+	return ret;
+}
+
 int gattlib_notification_start(gatt_connection_t* connection, const uuid_t* uuid) {
-	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
+	return connect_signal_to_characteristic_uuid(connection, uuid, false);
 }
 
 int gattlib_notification_stop(gatt_connection_t* connection, const uuid_t* uuid) {
-	return disconnect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_property_change);
+	return disconnect_signal_to_characteristic_uuid(connection, uuid);
 }
 
 int gattlib_indication_start(gatt_connection_t* connection, const uuid_t* uuid) {
-	return connect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_indication);
+	return connect_signal_to_characteristic_uuid(connection, uuid, true);
 }
 
 int gattlib_indication_stop(gatt_connection_t* connection, const uuid_t* uuid) {
-	return disconnect_signal_to_characteristic_uuid(connection, uuid, on_handle_characteristic_indication);
+	return disconnect_signal_to_characteristic_uuid(connection, uuid);
 }
 
 void disconnect_all_notifications(gattlib_context_t* conn_context) {
-	// Find notification handle
 	for (GList *l = conn_context->notified_characteristics; l != NULL; l = l->next) {
-		struct gattlib_notification_handle *notification_handle = l->data;
-
-		g_signal_handler_disconnect(notification_handle->gatt, notification_handle->signal_id);
-		free(notification_handle);
+		notification_handle_free(l->data);
 	}
 
-	g_list_free_full(conn_context->notified_characteristics, g_object_unref);
+	g_list_free(conn_context->notified_characteristics);
+	conn_context->notified_characteristics = NULL;
 }
@@ -0,0 +1,236 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal.h"
+
+//
+// Dispatch of the 'org.freedesktop.DBus.Properties.PropertiesChanged' signals of Bluez.
+//
+// Connecting to 'g-properties-changed' on a proxy per object makes dbus-daemon evaluate one match rule
+// per object for every message. Instead, a single match rule is installed for all the Bluez objects
+// and the signals are demultiplexed here by object path.
+//
+// Once 'gattlib_properties_unsubscribe()' has returned, the callback of the subscription is not running and
+// is not called anymore: the unsubscription waits for a callback being dispatched by another thread.
+//
+
+struct gattlib_properties_subscription {
+	gint ref;
+	// Protected by 'g_properties_mutex'. Cleared when the subscription is removed.
+	bool active;
+	// Thread running the callback (NULL if it is not running)
+	GThread *dispatching;
+
+	char *object_path;
+	char *interface_name;
+	gattlib_properties_changed_cb_t callback;
+	void *user_data;
+};
+
+static GMutex g_properties_mutex;
+// Signaled when a callback returns
+static GCond g_properties_cond;
+static GDBusConnection *g_properties_connection;
+static guint g_properties_signal_id;
+// Object path -> GSList of 'struct gattlib_properties_subscription'
+static GHashTable *g_properties_subscriptions;
+
+static void properties_subscription_unref(struct gattlib_properties_subscription *subscription) {
+	if (g_atomic_int_dec_and_test(&subscription->ref)) {
+		free(subscription->object_path);
+		free(subscription->interface_name);
+		free(subscription);
+	}
+}
+
+static void on_properties_changed(GDBusConnection *connection,
+		const gchar *sender_name, const gchar *object_path,
+		const gchar *interface_name, const gchar *signal_name,
+		GVariant *parameters, gpointer user_data)
+{
+	struct gattlib_properties_subscription *subscription;
+	const gchar *changed_interface_name;
+	GVariant *changed_properties;
+	GSList *subscriptions = NULL;
+
+	g_variant_get(parameters, "(&s@a{sv}@as)", &changed_interface_name, &changed_properties, NULL);
+
+	g_mutex_lock(&g_properties_mutex);
+	if (g_properties_subscriptions != NULL) {
+		for (GSList *l = g_hash_table_lookup(g_properties_subscriptions, object_path); l != NULL; l = l->next) {
+			subscription = l->data;
+			if (strcmp(subscription->interface_name, changed_interface_name) == 0) {
+				g_atomic_int_inc(&subscription->ref);
+				subscriptions = g_slist_prepend(subscriptions, subscription);
+			}
+		}
+	}
+	g_mutex_unlock(&g_properties_mutex);
+
+	// The callbacks are invoked without the lock as they might remove their subscription
+	subscriptions = g_slist_reverse(subscriptions);
+	for (GSList *l = subscriptions; l != NULL; l = l->next) {
+		bool active;
+
+		subscription = l->data;
+
+		g_mutex_lock(&g_properties_mutex);
+		active = subscription->active;
+		if (active) {
+			subscription->dispatching = g_thread_self();
+		}
+		g_mutex_unlock(&g_properties_mutex);
+
+		if (active) {
+			subscription->callback(object_path, changed_properties, subscription->user_data);
+
+			g_mutex_lock(&g_properties_mutex);
+			subscription->dispatching = NULL;
+			g_cond_broadcast(&g_properties_cond);
+			g_mutex_unlock(&g_properties_mutex);
+		}
+		properties_subscription_unref(subscription);
+	}
+	g_slist_free(subscriptions);
+
+	g_variant_unref(changed_properties);
+}
+
+/*
+ * Install the match rule shared by all the subscriptions. Must be called with the mutex held.
+ */
+static int properties_connect_locked(void) {
+	GError *error = NULL;
+
+	g_properties_connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (g_properties_connection == NULL) {
+		if (error) {
+			fprintf(stderr, "Failed to connect to the system bus: %s\n", error->message);
+			g_error_free(error);
+		}
+		return GATTLIB_ERROR_DBUS;
+	}
+
+	// The signals are dispatched by the default main context as the other events of this backend
+	g_main_context_push_thread_default(NULL);
+	g_properties_signal_id = g_dbus_connection_signal_subscribe(g_properties_connection,
+			"org.bluez",
+			"org.freedesktop.DBus.Properties",
+			"PropertiesChanged",
+			NULL,
+			// Only the Bluez interfaces
+			"org.bluez",
+			G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE,
+			on_properties_changed, NULL, NULL);
+	g_main_context_pop_thread_default(NULL);
+
+	g_properties_subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+	return GATTLIB_SUCCESS;
+}
+
+struct gattlib_properties_subscription *gattlib_properties_subscribe(const char *object_path, const char *interface_name,
+		gattlib_properties_changed_cb_t callback, void *user_data)
+{
+	struct gattlib_properties_subscription *subscription;
+	GSList *subscriptions;
+
+	subscription = calloc(1, sizeof(struct gattlib_properties_subscription));
+	if (subscription == NULL) {
+		return NULL;
+	}
+
+	subscription->ref = 1;
+	subscription->active = true;
+	subscription->object_path = strdup(object_path);
+	subscription->interface_name = strdup(interface_name);
+	subscription->callback = callback;
+	subscription->user_data = user_data;
+	if ((subscription->object_path == NULL) || (subscription->interface_name == NULL)) {
+		properties_subscription_unref(subscription);
+		return NULL;
+	}
+
+	g_mutex_lock(&g_properties_mutex);
+
+	if ((g_properties_subscriptions == NULL) && (properties_connect_locked() != GATTLIB_SUCCESS)) {
+		g_mutex_unlock(&g_properties_mutex);
+		properties_subscription_unref(subscription);
+		return NULL;
+	}
+
+	subscriptions = g_hash_table_lookup(g_properties_subscriptions, object_path);
+	if (subscriptions == NULL) {
+		g_hash_table_insert(g_properties_subscriptions, strdup(object_path), g_slist_append(NULL, subscription));
+	} else {
+		// The list head does not change when appending to a non-empty list
+		subscriptions = g_slist_append(subscriptions, subscription);
+	}
+
+	g_mutex_unlock(&g_properties_mutex);
+
+	return subscription;
+}
+
+void gattlib_properties_unsubscribe(struct gattlib_properties_subscription *subscription)
+{
+	GSList *subscriptions;
+
+	if (subscription == NULL) {
+		return;
+	}
+
+	g_mutex_lock(&g_properties_mutex);
+
+	subscription->active = false;
+	// Wait for the callback dispatched by another thread. The callback can remove its own subscription.
+	while ((subscription->dispatching != NULL) && (subscription->dispatching != g_thread_self())) {
+		g_cond_wait(&g_properties_cond, &g_properties_mutex);
+	}
+
+	subscriptions = g_hash_table_lookup(g_properties_subscriptions, subscription->object_path);
+	subscriptions = g_slist_remove(subscriptions, subscription);
+	if (subscriptions == NULL) {
+		g_hash_table_remove(g_properties_subscriptions, subscription->object_path);
+	} else {
+		g_hash_table_replace(g_properties_subscriptions, strdup(subscription->object_path), subscriptions);
+	}
+
+	// Remove the match rule with the last subscription
+	if (g_hash_table_size(g_properties_subscriptions) == 0) {
+		g_dbus_connection_signal_unsubscribe(g_properties_connection, g_properties_signal_id);
+		g_object_unref(g_properties_connection);
+		g_hash_table_destroy(g_properties_subscriptions);
+		g_properties_connection = NULL;
+		g_properties_signal_id = 0;
+		g_properties_subscriptions = NULL;
+	}
+
+	g_mutex_unlock(&g_properties_mutex);
+
+	properties_subscription_unref(subscription);
+}
@@ -86,10 +86,21 @@ int gattlib_write_char_by_uuid_stream_open(gatt_connection_t* connection, uuid_t
 
 int gattlib_write_char_stream_write(gatt_stream_t *stream, const void *buffer, size_t buffer_len)
 {
+	// The stream is not attached to its connection
+	gattlib_trace_event_t trace;
+	bool traced = GATTLIB_TRACE_BEGIN(&trace, GATTLIB_TRACE_OPERATION_STREAM_WRITE, NULL, NULL, 0, NULL, buffer_len);
+	int ret;
+
 	if( buffer_len == write((unsigned long)stream, buffer, buffer_len) ) {
-		return GATTLIB_SUCCESS;
+		ret = GATTLIB_SUCCESS;
+	} else {
+		ret = GATTLIB_ERROR_DBUS;
+	}
+
+	if (traced) {
+		gattlib_trace_end(&trace, ret, (ret == GATTLIB_SUCCESS) ? buffer_len : 0);
 	}
-	return GATTLIB_ERROR_DBUS;
+	return ret;
 }
 
 int gattlib_write_char_stream_close(gatt_stream_t *stream)
@@ -54,7 +54,7 @@ void int_handler(int dummy) {
 int main(int argc, char *argv[]) {
 	char input[256];
 	char* input_ptr;
-	int i, ret, total_length, length = 0;
+	int ret, total_length, length = 0;
 	uuid_t nus_characteristic_tx_uuid;
 	uuid_t nus_characteristic_rx_uuid;
 
@@ -83,35 +83,38 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	// Look for handle for NUS_CHARACTERISTIC_TX_UUID
-	gattlib_characteristic_t* characteristics;
-	int characteristic_count;
-	ret = gattlib_discover_char(m_connection, &characteristics, &characteristic_count);
+	// Look for the NUS characteristics in the GATT database of the device
+	const gattlib_gatt_db_t* gatt_db;
+	ret = gattlib_gatt_db_get(m_connection, &gatt_db);
 	if (ret) {
-		fprintf(stderr, "Fail to discover characteristic.\n");
+		fprintf(stderr, "Fail to discover the GATT database.\n");
 		return 1;
 	}
 
-	uint16_t tx_handle = 0, rx_handle = 0;
-	for (i = 0; i < characteristic_count; i++) {
-		if (gattlib_uuid_cmp(&characteristics[i].uuid, &nus_characteristic_tx_uuid) == 0) {
-			tx_handle = characteristics[i].value_handle;
-		} else if (gattlib_uuid_cmp(&characteristics[i].uuid, &nus_characteristic_rx_uuid) == 0) {
-			rx_handle = characteristics[i].value_handle;
-		}
-	}
-	if (tx_handle == 0) {
+	const gattlib_gatt_tree_characteristic_t* tx_characteristic = gattlib_gatt_db_find_char_by_uuid(gatt_db, &nus_characteristic_tx_uuid);
+	const gattlib_gatt_tree_characteristic_t* rx_characteristic = gattlib_gatt_db_find_char_by_uuid(gatt_db, &nus_characteristic_rx_uuid);
+	if (tx_characteristic == NULL) {
 		fprintf(stderr, "Fail to find NUS TX characteristic.\n");
 		return 1;
-	} else if (rx_handle == 0) {
+	} else if (rx_characteristic == NULL) {
 		fprintf(stderr, "Fail to find NUS RX characteristic.\n");
 		return 1;
 	}
-	free(characteristics);
+	uint16_t tx_handle = tx_characteristic->characteristic.value_handle;
+	uint16_t rx_handle = rx_characteristic->characteristic.value_handle;
+
+	const gattlib_descriptor_t* rx_cccd = gattlib_gatt_db_find_cccd(gatt_db, rx_handle);
+	if (rx_cccd == NULL) {
+		fprintf(stderr, "Fail to find NUS RX Client Characteristic Configuration.\n");
+		return 1;
+	}
 
 	// Enable Status Notification
 	uint16_t enable_notification = 0x0001;
-	gattlib_write_char_by_handle(m_connection, rx_handle + 1, &enable_notification, sizeof(enable_notification));
+	gattlib_write_char_by_handle(m_connection, rx_cccd->handle, &enable_notification, sizeof(enable_notification));
+
+	// The handles have been read from the GATT database
+	gattlib_gatt_db_release(m_connection, gatt_db);
 
 	// Register notification handler
 	gattlib_register_notification(m_connection, notification_cb, NULL);
@@ -61,6 +61,25 @@ class GattlibAdvertisementData(Structure):
                 ("data_length", c_size_t)]
 
 
+# typedef struct {
+#     uint8_t  type;
+#     uint8_t  flags;
+#     uint16_t company_id;
+#     uuid_t   service_uuid;
+#     uint8_t  data[GATTLIB_AD_FILTER_MAX_LEN];
+#     uint8_t  mask[GATTLIB_AD_FILTER_MAX_LEN];
+#     size_t   data_length;
+# } gattlib_ad_filter_t;
+class GattlibAdFilter(Structure):
+    _fields_ = [("type", c_uint8),
+                ("flags", c_uint8),
+                ("company_id", c_uint16),
+                ("service_uuid", GattlibUuid),
+                ("data", c_uint8 * 31),
+                ("mask", c_uint8 * 31),
+                ("data_length", c_size_t)]
+
+
 # int gattlib_adapter_open(const char* adapter_name, void** adapter);
 gattlib_adapter_open = gattlib.gattlib_adapter_open
 gattlib_adapter_open.argtypes = [c_char_p, POINTER(c_void_p)]
@@ -86,6 +105,10 @@ gattlib_adapter_scan_enable_with_filter.argtypes = [c_void_p, POINTER(POINTER(Ga
 gattlib_adapter_scan_eddystone = gattlib.gattlib_adapter_scan_eddystone
 gattlib_adapter_scan_eddystone.argtypes = [c_void_p, c_int16, c_uint32, gattlib_discovered_device_with_data_type, c_size_t, py_object]
 
+# int gattlib_adapter_set_scan_ad_filters(void *adapter, const gattlib_ad_filter_t *filters, size_t filter_count)
+gattlib_adapter_set_scan_ad_filters = gattlib.gattlib_adapter_set_scan_ad_filters
+gattlib_adapter_set_scan_ad_filters.argtypes = [c_void_p, POINTER(GattlibAdFilter), c_size_t]
+
 # gatt_connection_t *gattlib_connect(const char *src, const char *dst, unsigned long options);
 gattlib_connect = gattlib.gattlib_connect
 gattlib_connect.restype = c_void_p
@@ -7,6 +7,11 @@ GATTLIB_DISCOVER_FILTER_USE_UUID = (1 << 0)
 GATTLIB_DISCOVER_FILTER_USE_RSSI = (1 << 1)
 GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE = (1 << 2)
 
+GATTLIB_AD_FILTER_MANUFACTURER_DATA = 0
+GATTLIB_AD_FILTER_SERVICE_DATA = 1
+GATTLIB_AD_FILTER_FLAG_USE_MASK = (1 << 0)
+GATTLIB_AD_FILTER_MAX_LEN = 31
+
 GATTLIB_EDDYSTONE_TYPE_UID = (1 << 0)
 GATTLIB_EDDYSTONE_TYPE_URL = (1 << 1)
 GATTLIB_EDDYSTONE_TYPE_TLM = (1 << 2)
@@ -99,6 +104,52 @@ class Adapter:
                                                       timeout, user_data)
         handle_return(ret)
 
+    @staticmethod
+    def _init_ad_filter(ad_filter, data, mask):
+        if len(data) > GATTLIB_AD_FILTER_MAX_LEN or (mask is not None and len(mask) != len(data)):
+            raise ValueError("Invalid advertisement data filter")
+
+        ad_filter.data_length = len(data)
+        for i, byte in enumerate(data):
+            ad_filter.data[i] = byte
+        if mask is not None:
+            ad_filter.flags |= GATTLIB_AD_FILTER_FLAG_USE_MASK
+            for i, byte in enumerate(mask):
+                ad_filter.mask[i] = byte
+
+    def set_scan_ad_filters(self, manufacturer_data=None, service_data=None):
+        """Filter the scanned devices on their advertisement data before calling the Python callbacks.
+
+        :param manufacturer_data: list of (company_id, prefix) or (company_id, prefix, mask) tuples
+        :param service_data: list of (uuid string, prefix) or (uuid string, prefix, mask) tuples
+        """
+        if not self._is_opened:
+            raise AdapterNotOpened()
+
+        manufacturer_data = manufacturer_data or []
+        service_data = service_data or []
+        filters = (GattlibAdFilter * max(len(manufacturer_data) + len(service_data), 1))()
+        index = 0
+
+        for manufacturer_filter in manufacturer_data:
+            company_id, data, mask = (tuple(manufacturer_filter) + (None,))[:3]
+            filters[index].type = GATTLIB_AD_FILTER_MANUFACTURER_DATA
+            filters[index].company_id = company_id
+            Adapter._init_ad_filter(filters[index], data, mask)
+            index += 1
+
+        for service_filter in service_data:
+            uuid, data, mask = (tuple(service_filter) + (None,))[:3]
+            filters[index].type = GATTLIB_AD_FILTER_SERVICE_DATA
+            uuid_ascii = uuid.encode("utf-8")
+            ret = gattlib.gattlib_string_to_uuid(uuid_ascii, len(uuid_ascii), byref(filters[index].service_uuid))
+            handle_return(ret)
+            Adapter._init_ad_filter(filters[index], data, mask)
+            index += 1
+
+        ret = gattlib_adapter_set_scan_ad_filters(self._adapter, filters, index)
+        handle_return(ret)
+
     @staticmethod
     def on_discovered_ble_device_with_details(adapter, mac_addr, name, advertisement_data_buffer, advertisement_data_count,
                                               manufacturer_id, manufacturer_data_buffer, manufacturer_data_size,
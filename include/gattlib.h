@@ -117,6 +117,17 @@ extern "C" {
 		GATTLIB_CONNECTION_OPTIONS_LEGACY_BT_SEC_LOW
 //@}
 
+/**
+ * @name Options for gattlib_adapter_open_with_options()
+ *
+ * @note Options with the prefix `GATTLIB_ADAPTER_OPTIONS_LEGACY_`
+ *       are only used by the legacy (HCI) backend
+ */
+//@{
+#define GATTLIB_ADAPTER_OPTIONS_DEFAULT                     0
+#define GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT             (1 << 0) //< Scan and control connections through the kernel management interface
+//@}
+
 /**
  * @name Discover filter
  */
@@ -125,6 +136,7 @@ extern "C" {
 #define GATTLIB_DISCOVER_FILTER_USE_UUID                    (1 << 0)
 #define GATTLIB_DISCOVER_FILTER_USE_RSSI                    (1 << 1)
 #define GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE               (1 << 2)
+#define GATTLIB_DISCOVER_FILTER_NO_DUPLICATE_DATA           (1 << 3)  //< Let the controller/Bluez drop advertisements with unchanged payload
 //@}
 
 /**
@@ -199,6 +211,173 @@ typedef void (*gattlib_discovered_device_with_data_t)(void *adapter, const char*
 		uint16_t manufacturer_id, uint8_t *manufacturer_data, size_t manufacturer_data_size,
 		void *user_data);
 
+/**
+ * @name Live device table limits
+ */
+//@{
+#define GATTLIB_SCAN_TABLE_NAME_MAX_LEN                     32
+// Size of a legacy advertising payload. Only the whole AD structures that fit are kept from the longer payloads
+// of the extended advertisements.
+#define GATTLIB_SCAN_TABLE_AD_DATA_MAX_LEN                  31
+//@}
+
+/**
+ * Structure to represent a BLE device of the live device table
+ */
+typedef struct {
+	char     addr[18];                                       /**< MAC address of the BLE device */
+	char     name[GATTLIB_SCAN_TABLE_NAME_MAX_LEN];          /**< Last advertised name. Empty string if none */
+	int16_t  rssi;                                           /**< RSSI of the last advertisement */
+	int16_t  rssi_average;                                   /**< Exponentially weighted moving average of the RSSI */
+	uint32_t advertisement_count;                            /**< Number of advertisements received since first seen */
+	uint32_t advertisement_rate;                             /**< Smoothed advertisement rate in milli-Hertz */
+	uint64_t first_seen;                                     /**< Monotonic time in milliseconds of the first advertisement */
+	uint64_t last_seen;                                      /**< Monotonic time in milliseconds of the last advertisement */
+	uint8_t  ad_data[GATTLIB_SCAN_TABLE_AD_DATA_MAX_LEN];    /**< Last advertisement payload (raw AD structures that fit whole) */
+	size_t   ad_data_length;                                 /**< Length of ad_data */
+} gattlib_scan_entry_t;
+
+/**
+ * @name Scan types
+ */
+//@{
+#define GATTLIB_SCAN_TYPE_PASSIVE                           0x00  //< No scan request is sent to the advertisers
+#define GATTLIB_SCAN_TYPE_ACTIVE                            0x01  //< Scan requests are sent to get the scan responses
+//@}
+
+/**
+ * @name PHYs to scan on
+ */
+//@{
+#define GATTLIB_SCAN_PHY_1M                                 (1 << 0)
+#define GATTLIB_SCAN_PHY_CODED                              (1 << 2)  //< Long range. Requires extended scanning.
+//@}
+
+/**
+ * Structure to represent the HCI scan parameters of the adapter
+ */
+typedef struct {
+	uint8_t  scan_type;          /**< GATTLIB_SCAN_TYPE_PASSIVE or GATTLIB_SCAN_TYPE_ACTIVE */
+	uint16_t interval;           /**< Scan interval in 0.625 ms units (0x0004 to 0x4000) */
+	uint16_t window;             /**< Scan window in 0.625 ms units (0x0004 to interval) */
+	uint8_t  own_address_type;   /**< 0x00: public, 0x01: random, 0x02/0x03: resolvable private address */
+	uint8_t  filter_policy;      /**< 0x00: all advertisements, 0x01: only the devices of the accept list */
+	uint8_t  scan_phys;          /**< GATTLIB_SCAN_PHY_* flags. 0 for GATTLIB_SCAN_PHY_1M */
+} gattlib_scan_parameters_t;
+
+/**
+ * Structure to represent the policy interleaving the background scan with the connections
+ */
+typedef struct {
+	uint8_t  scan_duty_percent;    /**< Percentage of each period spent scanning while connections are in progress (0 to 100) */
+	uint32_t period_ms;            /**< Duration of a scan window and the following pause */
+	uint32_t max_connect_wait_ms;  /**< Maximum time a connection waits for the end of the current scan window */
+} gattlib_scan_schedule_t;
+
+/**
+ * Structure to represent a BLE device reported by a batched scan
+ */
+typedef struct {
+	char    addr[18];                                        /**< MAC address of the BLE device */
+	char    name[GATTLIB_SCAN_TABLE_NAME_MAX_LEN];           /**< Advertised name. Empty string if none */
+	int16_t rssi;                                            /**< RSSI of the advertisement */
+} gattlib_scan_result_t;
+
+/**
+ * @brief Handler called with a batch of discovered BLE devices
+ *
+ * @param adapter is the adapter that has found the BLE devices
+ * @param results is the array of discovered devices. It is only valid during the call.
+ * @param results_count is the number of elements of results
+ * @param user_data is the data passed to `gattlib_adapter_scan_start_batched()`
+ */
+typedef void (*gattlib_discovered_devices_batch_t)(void *adapter, const gattlib_scan_result_t *results, size_t results_count,
+		void *user_data);
+
+/**
+ * @name Advertisement data filter types and flags
+ */
+//@{
+#define GATTLIB_AD_FILTER_MANUFACTURER_DATA                 0
+#define GATTLIB_AD_FILTER_SERVICE_DATA                      1
+
+#define GATTLIB_AD_FILTER_FLAG_USE_MASK                     (1 << 0)  //< Only compare the bits set in 'mask'
+
+#define GATTLIB_AD_FILTER_MAX_LEN                           31
+//@}
+
+/**
+ * Structure to represent a filter on the manufacturer data or the service data of the advertisement
+ */
+typedef struct {
+	uint8_t  type;                               /**< GATTLIB_AD_FILTER_MANUFACTURER_DATA or GATTLIB_AD_FILTER_SERVICE_DATA */
+	uint8_t  flags;                              /**< GATTLIB_AD_FILTER_FLAG_* */
+	uint16_t company_id;                         /**< Company ID of the manufacturer data */
+	uuid_t   service_uuid;                       /**< UUID of the service data */
+	uint8_t  data[GATTLIB_AD_FILTER_MAX_LEN];    /**< Prefix the data must start with */
+	uint8_t  mask[GATTLIB_AD_FILTER_MAX_LEN];    /**< Bits of the prefix to compare with GATTLIB_AD_FILTER_FLAG_USE_MASK */
+	size_t   data_length;                        /**< Length of the prefix. 0 to only match the company ID/service UUID */
+} gattlib_ad_filter_t;
+
+/**
+ * @name Advertisement monitor limits and default values
+ */
+//@{
+#define GATTLIB_ADVERTISEMENT_MONITOR_PATTERN_MAX_LEN       31
+#define GATTLIB_ADVERTISEMENT_MONITOR_RSSI_UNSET            127  //< RSSI threshold not set
+#define GATTLIB_ADVERTISEMENT_MONITOR_TIMEOUT_UNSET         0    //< RSSI timeout not set
+#define GATTLIB_ADVERTISEMENT_MONITOR_SAMPLING_UNSET        256  //< RSSI sampling period not set
+//@}
+
+/**
+ * Structure to represent a pattern matched against the advertisement data
+ */
+typedef struct {
+	uint8_t start_position;                                     /**< Offset of the pattern in the AD data */
+	uint8_t ad_type;                                            /**< AD type the pattern applies to (eg: 0xFF for manufacturer data) */
+	uint8_t content[GATTLIB_ADVERTISEMENT_MONITOR_PATTERN_MAX_LEN]; /**< Bytes to match */
+	size_t  content_length;                                     /**< Number of bytes to match */
+} gattlib_advertisement_monitor_pattern_t;
+
+/**
+ * Structure to represent an advertisement monitor. A device is reported when its advertisement matches any of
+ * the patterns and, if set, its RSSI has been over `rssi_high_threshold` for `rssi_high_timeout` seconds.
+ * It is reported lost when its RSSI has been under `rssi_low_threshold` for `rssi_low_timeout` seconds.
+ */
+typedef struct {
+	const gattlib_advertisement_monitor_pattern_t *patterns;    /**< Array of patterns (at least one) */
+	size_t   pattern_count;                                     /**< Number of elements of patterns */
+	int16_t  rssi_low_threshold;                                /**< In dBm or GATTLIB_ADVERTISEMENT_MONITOR_RSSI_UNSET */
+	int16_t  rssi_high_threshold;                               /**< In dBm or GATTLIB_ADVERTISEMENT_MONITOR_RSSI_UNSET */
+	uint16_t rssi_low_timeout;                                  /**< In seconds or GATTLIB_ADVERTISEMENT_MONITOR_TIMEOUT_UNSET */
+	uint16_t rssi_high_timeout;                                 /**< In seconds or GATTLIB_ADVERTISEMENT_MONITOR_TIMEOUT_UNSET */
+	uint16_t rssi_sampling_period;                              /**< In 100ms unit or GATTLIB_ADVERTISEMENT_MONITOR_SAMPLING_UNSET */
+} gattlib_advertisement_monitor_t;
+
+/**
+ * @brief Handler called when a device starts or stops matching an advertisement monitor
+ *
+ * @param adapter is the adapter the monitor has been added to
+ * @param addr is the MAC address of the device
+ * @param user_data is the data passed to `gattlib_adapter_advertisement_monitor_add()`
+ */
+typedef void (*gattlib_advertisement_monitor_cb_t)(void *adapter, const char* addr, void *user_data);
+
+/**
+ * @brief Handler called on the reception of a periodic advertisement
+ *
+ * @param adapter is the adapter that has received the periodic advertisement
+ * @param addr is the MAC address of the advertiser
+ * @param sid is the advertising set identifier of the periodic advertising train
+ * @param rssi is the RSSI of the advertisement (127 if not available)
+ * @param tx_power is the transmit power of the advertisement (127 if not available)
+ * @param data is the reassembled advertising data. It is only valid during the call.
+ * @param data_length is the length of data
+ * @param user_data is the data passed to `gattlib_periodic_sync_start()`
+ */
+typedef void (*gattlib_periodic_advertisement_cb_t)(void *adapter, const char* addr, uint8_t sid, int8_t rssi, int8_t tx_power,
+		const uint8_t *data, size_t data_length, void *user_data);
+
 /**
  * @brief Handler called on asynchronous connection when connection is ready
  *
@@ -225,6 +404,104 @@ typedef void (*gatt_read_cb_t)(int status, void* user_data, const void *buffer,
  */
 typedef void (*gatt_write_cb_t)(int status, void* user_data);
 
+/**
+ * Types of the GATT operations counted by `gattlib_get_stats()`
+ */
+typedef enum {
+	GATTLIB_STATS_OPERATION_READ = 0,
+	GATTLIB_STATS_OPERATION_WRITE,
+	GATTLIB_STATS_OPERATION_WRITE_WITHOUT_RESPONSE,
+	GATTLIB_STATS_OPERATION_NOTIFICATION_START,
+	GATTLIB_STATS_OPERATION_NOTIFICATION_STOP,
+	GATTLIB_STATS_OPERATION_DISCOVERY,
+	GATTLIB_STATS_OPERATION_COUNT
+} gattlib_stats_operation_t;
+
+/**
+ * Counters of a type of GATT operation
+ *
+ * The operations in progress are `issued - completed - failed`.
+ */
+typedef struct {
+	uint64_t issued;     /**< Operations requested by the application */
+	uint64_t completed;  /**< Operations completed with success */
+	uint64_t failed;     /**< Operations completed with an error */
+} gattlib_operation_stats_t;
+
+/**
+ * Counters of a GATT connection returned by `gattlib_get_stats()`
+ */
+typedef struct {
+	gattlib_operation_stats_t operations[GATTLIB_STATS_OPERATION_COUNT]; /**< Indexed by gattlib_stats_operation_t */
+	uint64_t bytes_read;              /**< Bytes returned by the successful reads */
+	uint64_t bytes_written;           /**< Bytes of the successful writes (with and without response) */
+	uint64_t bytes_notified;          /**< Bytes of the notifications and indications received */
+	uint64_t notifications_received;  /**< Notifications and indications received */
+	uint64_t notifications_dropped;   /**< Notifications and indications received without registered handler */
+	uint64_t dbus_calls;              /**< Bluez DBus method calls made for the connection (DBus backend) */
+	uint64_t dbus_proxies_created;    /**< Bluez DBus proxies created for the connection (DBus backend) */
+	uint64_t reconnects;              /**< Times the link came back while the connection was open */
+} gattlib_connection_stats_t;
+
+/**
+ * Counters of an adapter returned by `gattlib_adapter_get_stats()`
+ */
+typedef struct {
+	uint64_t scan_events_received;    /**< Advertisements and device updates reported by the controller or Bluez */
+	uint64_t scan_events_delivered;   /**< Scan events passed to the application callbacks */
+	uint64_t dbus_calls;              /**< Bluez DBus method calls made for the adapter (DBus backend) */
+	uint64_t dbus_proxies_created;    /**< Bluez DBus proxies created for the adapter (DBus backend) */
+	uint64_t reconnects;              /**< Links re-established for the devices of the auto-connect list */
+} gattlib_adapter_stats_t;
+
+/**
+ * Public operations reported to the trace hooks
+ */
+typedef enum {
+	GATTLIB_TRACE_OPERATION_CONNECT = 0,
+	GATTLIB_TRACE_OPERATION_DISCOVER,
+	GATTLIB_TRACE_OPERATION_READ,
+	GATTLIB_TRACE_OPERATION_WRITE,
+	GATTLIB_TRACE_OPERATION_WRITE_WITHOUT_RESPONSE,
+	GATTLIB_TRACE_OPERATION_NOTIFICATION_START,
+	GATTLIB_TRACE_OPERATION_NOTIFICATION_STOP,
+	GATTLIB_TRACE_OPERATION_STREAM_WRITE
+} gattlib_trace_operation_t;
+
+/**
+ * Operation reported to the trace hooks set by `gattlib_set_trace_hooks()`
+ *
+ * The same event is passed to the begin and to the end hooks of an operation.
+ */
+typedef struct {
+	gattlib_trace_operation_t operation;  /**< Type of the operation */
+	gatt_connection_t* connection;        /**< GATT connection. NULL before a connection is established and for the streams */
+	const char* mac_address;              /**< MAC address of the device. NULL if unknown */
+	uint16_t handle;                      /**< Handle of the attribute. 0 if the attribute is given by UUID or for the whole database */
+	const uuid_t* uuid;                   /**< UUID of the attribute. NULL if the attribute is given by handle */
+	size_t length;                        /**< Bytes to write (begin), bytes written or read (end) */
+	uint64_t begin_us;                    /**< Monotonic time in microseconds of the start of the operation */
+	uint64_t end_us;                      /**< Monotonic time in microseconds of the end of the operation. 0 in the begin hook */
+	int result;                           /**< GATTLIB_SUCCESS or GATTLIB_* error code. Only valid in the end hook */
+	void* context;                        /**< Free for the begin hook to attach its own data (eg: a tracing span) */
+} gattlib_trace_event_t;
+
+/**
+ * @brief Hook called when a public operation starts
+ *
+ * @param event is the operation. The hook can set `event->context`.
+ * @param user_data is the data given to `gattlib_set_trace_hooks()`
+ */
+typedef void (*gattlib_trace_begin_cb_t)(gattlib_trace_event_t *event, void *user_data);
+
+/**
+ * @brief Hook called when a public operation ends
+ *
+ * @param event is the operation passed to the begin hook, completed with its result
+ * @param user_data is the data given to `gattlib_set_trace_hooks()`
+ */
+typedef void (*gattlib_trace_end_cb_t)(const gattlib_trace_event_t *event, void *user_data);
+
 /**
  * @brief Constant defining Eddystone common data UID in Advertisement data
  */
@@ -246,6 +523,21 @@ extern const char *gattlib_eddystone_url_scheme_prefix[];
  */
 int gattlib_adapter_open(const char* adapter_name, void** adapter);
 
+/**
+ * @brief Open Bluetooth adapter with options
+ *
+ * With GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT, the legacy backend starts discovery and sets the scan parameters
+ * through the kernel management interface instead of sending raw HCI commands. It lets the kernel arbitrate the
+ * controller with the other users of the adapter. It requires Bluez 5 and the CAP_NET_ADMIN capability.
+ *
+ * @param adapter_name    With value NULL, the default adapter will be selected.
+ * @param options         Combination of GATTLIB_ADAPTER_OPTIONS_* flags
+ * @param adapter is the context of the newly opened adapter
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_open_with_options(const char* adapter_name, uint32_t options, void** adapter);
+
 /**
  * @brief Get Bluetooth adapter address
  *
@@ -309,6 +601,66 @@ int gattlib_adapter_scan_enable_with_filter(void *adapter, uuid_t **uuid_list, i
 int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
 		gattlib_discovered_device_t discovered_device_cb, size_t timeout, void *user_data);
 
+/**
+ * @brief Start Bluetooth scanning in background on a given adapter
+ *
+ * @note Contrary to `gattlib_adapter_scan_with_filter()`, this function returns as soon as the scan is started.
+ *       The scan has no timeout and runs on the library event loop until `gattlib_adapter_scan_stop()` is called.
+ *       It can run while GATT connections are established on the same adapter.
+ *       With the DBus backend, the events are dispatched by the default GLib main context (ie: the application
+ *       main loop or `gattlib_process_events()`). With the legacy backend, they are dispatched by the gattlib thread.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param uuid_list is a NULL-terminated list of UUIDs to filter. The rule only applies to advertised UUID.
+ *        Returned devices would match any of the UUIDs of the list.
+ * @param rssi_threshold is the imposed RSSI threshold for the returned devices.
+ * @param enabled_filters defines the parameters to use for filtering. There are selected by using the macros
+ *        GATTLIB_DISCOVER_FILTER_USE_UUID and GATTLIB_DISCOVER_FILTER_USE_RSSI.
+ * @param discovered_device_cb is the function callback called for each new Bluetooth device discovered
+ * @param user_data is the data passed to the callback `discovered_device_cb()`
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_BUSY if a scan is already running or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_start(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_device_t discovered_device_cb, void *user_data);
+
+/**
+ * @brief Start Bluetooth scanning in background and deliver the discovered devices in batches
+ *
+ * @note The scan behaves as `gattlib_adapter_scan_start()` but the reported devices are accumulated in a
+ *       preallocated array. The array is delivered to `discovered_devices_cb` when it holds `max_batch_size`
+ *       devices or when its oldest device has waited for `max_batch_delay_ms`.
+ *       The pending devices are delivered when the scan is stopped with `gattlib_adapter_scan_stop()`.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param uuid_list is a NULL-terminated list of UUIDs to filter. The rule only applies to advertised UUID.
+ * @param rssi_threshold is the imposed RSSI threshold for the returned devices.
+ * @param enabled_filters defines the parameters to use for filtering (see `gattlib_adapter_scan_start()`)
+ * @param discovered_devices_cb is the function callback called for each batch of discovered devices
+ * @param max_batch_size is the maximum number of devices delivered in a batch
+ * @param max_batch_delay_ms is the maximum delay in milliseconds before delivering a device. 0 to only deliver full batches.
+ * @param user_data is the data passed to the callback `discovered_devices_cb()`
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_BUSY if a scan is already running or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_start_batched(void *adapter, uuid_t **uuid_list, int16_t rssi_threshold, uint32_t enabled_filters,
+		gattlib_discovered_devices_batch_t discovered_devices_cb, size_t max_batch_size, uint32_t max_batch_delay_ms,
+		void *user_data);
+
+/**
+ * @brief Stop Bluetooth scanning started with `gattlib_adapter_scan_start()` or `gattlib_adapter_scan_start_batched()`
+ *
+ * @note The function can be called from any thread. With the DBus backend, the scan state is released by the
+ *       thread dispatching the default GLib main context between two callbacks: when another thread dispatches
+ *       it, the function waits for that thread and must not be called while it is blocked on the caller.
+ *       No callback of the scan is called once the function has returned.
+ *
+ * @param adapter is the context of the newly opened adapter
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_scan_stop(void *adapter);
+
 /**
  * @brief Enable Eddystone Bluetooth Device scanning on a given adapter
  *
@@ -326,9 +678,150 @@ int gattlib_adapter_scan_with_filter(void *adapter, uuid_t **uuid_list, int16_t
 int gattlib_adapter_scan_eddystone(void *adapter, int16_t rssi_threshold, uint32_t eddystone_types,
 		gattlib_discovered_device_with_data_t discovered_device_cb, size_t timeout, void *user_data);
 
+/**
+ * @brief Set the HCI scan parameters of the adapter
+ *
+ * @note The parameters are applied to the scans started after this call. In passive mode, the scan responses
+ *       are not received so the devices that only advertise their name in the scan response are reported without name.
+ *       Only the legacy (HCI) backend supports this function. With the DBus backend, Bluez owns the scan parameters.
+ *       The default parameters are an active scan with a 11.25 ms interval and window.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param parameters is the scan parameters
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_SUPPORTED or GATTLIB_* error code
+ */
+int gattlib_adapter_set_scan_parameters(void *adapter, const gattlib_scan_parameters_t *parameters);
+
+/**
+ * @brief Configure the coalescing of the advertisements reported by the adapter scanner
+ *
+ * @note The first advertisement of a device is always reported. When the scan is started with
+ *       `GATTLIB_DISCOVER_FILTER_NOTIFY_CHANGE`, the following advertisements of the device are only reported
+ *       once `min_interval_ms` has elapsed since the last report and, if `min_rssi_delta` is not 0 or
+ *       `notify_on_payload_change` is set, when the RSSI has changed by at least `min_rssi_delta` dB or the
+ *       advertisement payload has changed.
+ *       The configuration is applied to the scans started after this call.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param min_interval_ms is the minimum interval in milliseconds between two reports of the same device
+ * @param min_rssi_delta is the minimum RSSI variation in dB to report a device again. 0 to ignore the RSSI.
+ * @param notify_on_payload_change reports a device again if its advertisement payload has changed
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_set_scan_coalescing(void *adapter, uint32_t min_interval_ms, uint8_t min_rssi_delta, bool notify_on_payload_change);
+
+/**
+ * @brief Interleave the background scan of the adapter with the connections
+ *
+ * Without connection in progress, the background scan runs continuously. While connections are in progress
+ * (`gattlib_connect()` with this adapter or between `gattlib_adapter_radio_hold()` and `gattlib_adapter_radio_release()`),
+ * the scan only runs `scan_duty_percent` of every `period_ms` and the connections use the radio for the rest
+ * of the period. A new connection waits for the end of the current scan window, but no longer than `max_connect_wait_ms`.
+ *
+ * @note The schedule applies to the scans started by `gattlib_adapter_scan_start()` and `gattlib_adapter_scan_start_batched()`.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param schedule is the policy. NULL to let the scan and the connections compete for the radio.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_set_scan_schedule(void *adapter, const gattlib_scan_schedule_t *schedule);
+
+/**
+ * @brief Reserve the radio of the adapter for an active transfer
+ *
+ * With a scan schedule, the function waits for the scan to be paused as for a new connection.
+ * The background scan is duty cycled until `gattlib_adapter_radio_release()` is called.
+ *
+ * @param adapter is the context of the newly opened adapter
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_radio_hold(void *adapter);
+
+/**
+ * @brief Release the radio reserved by `gattlib_adapter_radio_hold()`
+ *
+ * @param adapter is the context of the newly opened adapter
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_radio_release(void *adapter);
+
+/**
+ * @brief Periodically remove the devices not seen for a while
+ *
+ * Bluez keeps a device object for every advertiser seen while scanning. On long-running scanners, this function
+ * removes from Bluez the devices that are neither paired, trusted nor connected and have not advertised for
+ * `max_age_s` seconds. The per-device state kept by gattlib for the scan (coalescing, scan table) is trimmed
+ * with the same age.
+ *
+ * @note The pruning runs from the default GLib main context (ie: the application must run a main loop or
+ *       call `gattlib_process_events()`). A pruned device is reported again as a new device when it comes back.
+ *       Only the DBus backend supports this function.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param max_age_s is the time in seconds after which a device not seen is removed. 0 disables the pruning.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_set_device_pruning(void *adapter, uint32_t max_age_s);
+
+/**
+ * @brief Set the advertisement data filters of the adapter scanner
+ *
+ * @note The filters are evaluated by the library before calling the scan callbacks. A device is reported if any of
+ *       the filters matches its manufacturer data or service data. They can be replaced while the adapter is
+ *       scanning: the new filters apply to the next advertisements.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param filters is the array of filters. The array is copied.
+ * @param filter_count is the number of elements of filters. 0 removes the filters.
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_set_scan_ad_filters(void *adapter, const gattlib_ad_filter_t *filters, size_t filter_count);
+
+/**
+ * @brief Synchronize with the periodic advertising train of a device
+ *
+ * @note The periodic advertisements are delivered on the gattlib thread once the sync is established.
+ *       The adapter must be scanning (eg: `gattlib_adapter_scan_start()`) for the sync to be established.
+ *       Several syncs can be started. They are established together with the Periodic Advertiser List of the
+ *       controller when available, otherwise one after the other. A sync not established within 10 seconds
+ *       is tried again after a growing delay, as is a lost sync.
+ *       Only the legacy (HCI) backend supports this function.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param addr is the MAC address of the advertiser
+ * @param addr_type is the address type of the advertiser (BDADDR_LE_PUBLIC or BDADDR_LE_RANDOM)
+ * @param sid is the advertising set identifier (0 to 15) of the periodic advertising train
+ * @param periodic_advertisement_cb is the function callback called for each periodic advertisement
+ * @param user_data is the data passed to the callback `periodic_advertisement_cb()`
+ * @param sync_handle is the handle to pass to `gattlib_periodic_sync_stop()`
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_SUPPORTED or GATTLIB_* error code
+ */
+int gattlib_periodic_sync_start(void *adapter, const char *addr, uint8_t addr_type, uint8_t sid,
+		gattlib_periodic_advertisement_cb_t periodic_advertisement_cb, void *user_data, void **sync_handle);
+
+/**
+ * @brief Stop a periodic advertising sync started with `gattlib_periodic_sync_start()`
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param sync_handle is the handle returned by `gattlib_periodic_sync_start()`
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_periodic_sync_stop(void *adapter, void *sync_handle);
+
 /**
  * @brief Disable Bluetooth scanning on a given adapter
  *
+ * @note It can be called from another thread or from the scan callback to end a blocking scan before its timeout.
+ *
  * @param adapter is the context of the newly opened adapter
  *
  * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
@@ -344,6 +837,75 @@ int gattlib_adapter_scan_disable(void* adapter);
  */
 int gattlib_adapter_close(void* adapter);
 
+/**
+ * @brief Enable the live device table of the adapter
+ *
+ * @note Once enabled, the table is fed by the adapter scanner (`gattlib_adapter_scan*()` functions) with
+ *       every advertisement received. A NULL `discovered_device_cb` can be passed to the scan functions
+ *       when the application only reads the table with `gattlib_scan_snapshot()`.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param max_devices is the maximum number of devices tracked. The least recently seen device is evicted when full.
+ * @param rssi_smoothing defines the weight of the RSSI moving average (alpha = 1/2^rssi_smoothing)
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_scan_table_enable(void *adapter, size_t max_devices, unsigned int rssi_smoothing);
+
+/**
+ * @brief Disable and free the live device table of the adapter
+ *
+ * It can be called from any thread, even while the adapter is scanning or a snapshot is being copied.
+ * The table is freed once they have released it.
+ *
+ * @param adapter is the context of the newly opened adapter
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_scan_table_disable(void *adapter);
+
+/**
+ * @brief Copy the content of the live device table
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param entries is the array that receives the devices
+ * @param max_entries is the number of elements of the array
+ * @param entries_count is the number of devices copied into the array
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if the table has not been enabled or GATTLIB_* error code
+ */
+int gattlib_scan_snapshot(void *adapter, gattlib_scan_entry_t *entries, size_t max_entries, size_t *entries_count);
+
+/**
+ * @brief Add an advertisement monitor to the adapter
+ *
+ * @note The advertisements are filtered by Bluez or by the controller when it supports offloading. The host is only
+ *       woken up for the matching devices. It requires Bluez v5.54 or later (with the experimental interfaces enabled
+ *       on some versions). The callbacks are dispatched by the default GLib main context.
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param monitor describes the patterns and the RSSI conditions of the monitor
+ * @param device_found_cb is called when a device starts matching the monitor
+ * @param device_lost_cb is called when a device stops matching the monitor. Can be NULL.
+ * @param user_data is the data passed to the callbacks
+ * @param monitor_handle is the handle of the new monitor to pass to `gattlib_adapter_advertisement_monitor_remove()`
+ *
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_SUPPORTED if Bluez does not support monitors or GATTLIB_* error code
+ */
+int gattlib_adapter_advertisement_monitor_add(void *adapter, const gattlib_advertisement_monitor_t *monitor,
+		gattlib_advertisement_monitor_cb_t device_found_cb, gattlib_advertisement_monitor_cb_t device_lost_cb,
+		void *user_data, void **monitor_handle);
+
+/**
+ * @brief Remove an advertisement monitor from the adapter
+ *
+ * @param adapter is the context of the newly opened adapter
+ * @param monitor_handle is the handle returned by `gattlib_adapter_advertisement_monitor_add()`
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_advertisement_monitor_remove(void *adapter, void *monitor_handle);
+
 /* TBD */
 void gattlib_register_default_agent(void);
 
@@ -371,6 +933,23 @@ gatt_connection_t *gattlib_connect_async(void *adapter, const char *dst,
 		unsigned long options,
 		gatt_connect_cb_t connect_cb, void* user_data);
 
+/**
+ * @brief Function to connect to an in-process GATT peer
+ *
+ * The peer is a GATT server populated from a device description file with the format of the
+ * fake Bluez service (see `dbus/fake-bluez/fake-bluez.conf`). It lets the applications, tests and
+ * benchmarks exercise the ATT protocol without Bluetooth hardware.
+ *
+ * @note This function is only supported by the legacy backend with Bluez v5. The DBus backend
+ *       can use the fake Bluez service instead.
+ *
+ * @param description_file	Path of the device description file
+ * @param dst			Address of the device in the description file (NULL for the first device)
+ *
+ * @return The GATT connection on success or NULL on error
+ */
+gatt_connection_t *gattlib_connect_loopback(const char *description_file, const char *dst);
+
 /**
  * @brief Function to disconnect the GATT connection
  *
@@ -391,6 +970,42 @@ int gattlib_disconnect(gatt_connection_t* connection);
  */
 void gattlib_register_on_disconnect(gatt_connection_t *connection, gattlib_disconnection_handler_t handler, void* user_data);
 
+/**
+ * @brief Add a device to the auto-connect list of the adapter
+ *
+ * The device is added to the controller accept list. The controller connects it as soon as it advertises,
+ * without any connection attempt from the host. 'connect_cb' is then called with the new GATT connection
+ * (or with NULL if the GATT connection could not be established). It is called again each time the link
+ * comes back after a disconnection until the device is removed from the list.
+ *
+ * @note The connections are owned by the user and must be released with gattlib_disconnect().
+ *       Do not connect the devices of the list with gattlib_connect().
+ * @note The legacy backend requires an adapter opened with GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT.
+ *
+ * @param adapter     is the context of the opened adapter
+ * @param dst         Remote Bluetooth address
+ * @param options     Options used for the GATT connection. Exactly one of GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_PUBLIC
+ *                    and GATTLIB_CONNECTION_OPTIONS_LEGACY_BDADDR_LE_RANDOM must be set.
+ * @param connect_cb  is the callback to call each time the device is connected
+ * @param user_data   is the user specific data to pass to the callback
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_auto_connect_add(void *adapter, const char *dst, unsigned long options,
+		gatt_connect_cb_t connect_cb, void *user_data);
+
+/**
+ * @brief Remove a device from the auto-connect list of the adapter
+ *
+ * @note The current connection of the device is not closed.
+ *
+ * @param adapter     is the context of the opened adapter
+ * @param dst         Remote Bluetooth address
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_auto_connect_remove(void *adapter, const char *dst);
+
 /**
  * Structure to represent GATT Primary Service
  */
@@ -419,6 +1034,33 @@ typedef struct {
 	uuid_t   uuid;          /**< UUID of the GATT Descriptor */
 } gattlib_descriptor_t;
 
+/**
+ * Structure to represent a GATT Characteristic with its descriptors in a GATT tree
+ */
+typedef struct {
+	gattlib_characteristic_t characteristic;   /**< GATT characteristic */
+	gattlib_descriptor_t*    descriptors;      /**< Descriptors of the characteristic sorted by handle */
+	size_t                   descriptors_count;/**< Number of elements of descriptors */
+} gattlib_gatt_tree_characteristic_t;
+
+/**
+ * Structure to represent a GATT Service with its characteristics in a GATT tree
+ */
+typedef struct {
+	gattlib_primary_service_t            service;               /**< Handle range and UUID of the GATT Service */
+	bool                                 primary;               /**< False for a secondary service */
+	gattlib_gatt_tree_characteristic_t*  characteristics;       /**< Characteristics of the service sorted by handle */
+	size_t                               characteristics_count; /**< Number of elements of characteristics */
+} gattlib_gatt_tree_service_t;
+
+/**
+ * Structure to represent the complete GATT database of a device
+ */
+typedef struct {
+	gattlib_gatt_tree_service_t* services;       /**< GATT Services sorted by handle */
+	size_t                       services_count; /**< Number of elements of services */
+} gattlib_gatt_tree_t;
+
 /**
  * @brief Function to discover GATT Services
  *
@@ -487,6 +1129,177 @@ int gattlib_discover_desc_range(gatt_connection_t* connection, int start, int en
 int gattlib_discover_desc(gatt_connection_t* connection, gattlib_descriptor_t** descriptors, int* descriptors_count);
 int gattlib_discover_desc_from_mac(void* adapter, const char *mac_address, gattlib_descriptor_t** descriptors, int* descriptors_count);
 
+/**
+ * @brief Function to discover the complete GATT database of the device
+ *
+ * @note The tree (services, characteristics and descriptors) is returned in a single allocation.
+ *       It is the responsibility of the caller to free it with `free()`.
+ *
+ * @param connection Active GATT connection
+ * @param tree is the GATT tree allocated by the function
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_discover_all(gatt_connection_t* connection, gattlib_gatt_tree_t** tree);
+
+/**
+ * GATT database of a connection (see `gattlib_gatt_db_get()`)
+ */
+typedef struct gattlib_gatt_db gattlib_gatt_db_t;
+
+/**
+ * Type of an attribute of the GATT database
+ */
+typedef enum {
+	GATTLIB_GATT_DB_ATTRIBUTE_SERVICE,        /**< Service declaration */
+	GATTLIB_GATT_DB_ATTRIBUTE_CHARACTERISTIC, /**< Characteristic declaration */
+	GATTLIB_GATT_DB_ATTRIBUTE_DESCRIPTOR,     /**< Characteristic descriptor */
+} gattlib_gatt_db_attribute_type_t;
+
+/**
+ * Attribute of the GATT database
+ */
+typedef struct {
+	gattlib_gatt_db_attribute_type_t          type;           /**< Type of the attribute */
+	uint16_t                                  handle;         /**< Handle of the attribute */
+	const gattlib_gatt_tree_service_t*        service;        /**< Service containing the attribute */
+	const gattlib_gatt_tree_characteristic_t* characteristic; /**< Characteristic of the attribute. NULL for a service */
+	const gattlib_descriptor_t*               descriptor;     /**< Descriptor. Only set for a descriptor */
+} gattlib_gatt_db_attribute_t;
+
+/**
+ * @brief Callback called for each attribute by `gattlib_gatt_db_foreach_in_range()`
+ *
+ * @param attribute is the attribute of the GATT database
+ * @param user_data is the data passed to `gattlib_gatt_db_foreach_in_range()`
+ *
+ * @return true to continue the iteration, false to stop it
+ */
+typedef bool (*gattlib_gatt_db_foreach_cb_t)(const gattlib_gatt_db_attribute_t* attribute, void* user_data);
+
+/**
+ * @brief Function to get the GATT database of the connection
+ *
+ * @note The database is discovered with `gattlib_discover_all()` on the first call and kept until
+ *       the disconnection. It is owned by the connection and must not be freed by the caller.
+ *       The ranges changed by the device since the previous call are rediscovered.
+ *
+ * @note The returned database is a snapshot that is never modified. When the device changes its database,
+ *       a new snapshot replaces it for the next calls. The snapshot and the services, characteristics and
+ *       descriptors found in it stay valid (but describe the previous database) until it is released with
+ *       `gattlib_gatt_db_release()`. A replaced snapshot is freed once all the snapshots returned for it have
+ *       been released. The snapshots not released are freed by `gattlib_disconnect()`.
+ *       The function can be called from any thread.
+ *
+ * @param connection Active GATT connection
+ * @param db is the GATT database of the connection
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_gatt_db_get(gatt_connection_t* connection, const gattlib_gatt_db_t** db);
+
+/**
+ * @brief Function to release a GATT database returned by `gattlib_gatt_db_get()`
+ *
+ * @note Each database returned by `gattlib_gatt_db_get()` should be released once, before `gattlib_disconnect()`.
+ *       The database and the attributes found in it must not be used after.
+ *
+ * @param connection Active GATT connection the database has been returned for
+ * @param db is the GATT database to release
+ */
+void gattlib_gatt_db_release(gatt_connection_t* connection, const gattlib_gatt_db_t* db);
+
+/**
+ * @brief Handler called when the device reports a change of its GATT database
+ *
+ * @note The GATT database of the connection has already been updated: the legacy backend rediscovers the range
+ *       before calling the handler, otherwise the attributes of the range are removed and rediscovered by the next
+ *       call to `gattlib_gatt_db_get()`. The characteristics, descriptors
+ *       and services previously returned by the `gattlib_gatt_db_*` functions stay valid until their database is
+ *       released but their handles might not be the ones of the device anymore: get them again from `gattlib_gatt_db_get()`.
+ *
+ * @param connection Connection of the device
+ * @param start_handle First handle of the changed range
+ * @param end_handle Last handle of the changed range
+ * @param user_data Data defined when calling `gattlib_register_on_service_changed()`
+ */
+typedef void (*gattlib_service_changed_handler_t)(gatt_connection_t* connection, uint16_t start_handle, uint16_t end_handle, void* user_data);
+
+/**
+ * @brief Function to register a handler called when the GATT database of the device changes
+ *
+ * @note The legacy backend is notified by the 'Service Changed' indications of the device.
+ *       The DBus backend is notified by the GATT objects added and removed by Bluez.
+ *
+ * @param connection Active GATT connection
+ * @param handler is the handler to call. NULL to unregister it.
+ * @param user_data is passed to the handler
+ */
+void gattlib_register_on_service_changed(gatt_connection_t* connection, gattlib_service_changed_handler_t handler, void* user_data);
+
+/**
+ * @brief Function to get the GATT tree the database is built from
+ *
+ * @param db GATT database
+ *
+ * @return The GATT tree of the database
+ */
+const gattlib_gatt_tree_t* gattlib_gatt_db_get_tree(const gattlib_gatt_db_t* db);
+
+/**
+ * @brief Function to find a GATT characteristic by UUID
+ *
+ * @param db GATT database
+ * @param uuid UUID of the GATT characteristic
+ *
+ * @return The characteristic with the lowest handle matching the UUID or NULL if not found
+ */
+const gattlib_gatt_tree_characteristic_t* gattlib_gatt_db_find_char_by_uuid(const gattlib_gatt_db_t* db, const uuid_t* uuid);
+
+/**
+ * @brief Function to find a GATT characteristic by its declaration or value handle
+ *
+ * @param db GATT database
+ * @param handle Handle of the declaration or of the value of the GATT characteristic
+ *
+ * @return The characteristic or NULL if not found
+ */
+const gattlib_gatt_tree_characteristic_t* gattlib_gatt_db_find_char_by_handle(const gattlib_gatt_db_t* db, uint16_t handle);
+
+/**
+ * @brief Function to find the Client Characteristic Configuration Descriptor of a GATT characteristic
+ *
+ * @param db GATT database
+ * @param value_handle Handle of the value of the GATT characteristic
+ *
+ * @return The descriptor or NULL if the characteristic does not support notifications and indications
+ */
+const gattlib_descriptor_t* gattlib_gatt_db_find_cccd(const gattlib_gatt_db_t* db, uint16_t value_handle);
+
+/**
+ * @brief Function to find the GATT service containing a handle
+ *
+ * @param db GATT database
+ * @param handle Handle of any attribute of the service
+ *
+ * @return The service or NULL if not found
+ */
+const gattlib_gatt_tree_service_t* gattlib_gatt_db_find_service_by_handle(const gattlib_gatt_db_t* db, uint16_t handle);
+
+/**
+ * @brief Function to iterate over the attributes of a range of handles
+ *
+ * @note The attributes are iterated in handle order. The values of the characteristics are not part of the iteration.
+ *
+ * @param db GATT database
+ * @param start is the first handle of the range
+ * @param end is the last handle of the range
+ * @param callback is called for each attribute of the range
+ * @param user_data is passed to the callback
+ */
+void gattlib_gatt_db_foreach_in_range(const gattlib_gatt_db_t* db, uint16_t start, uint16_t end,
+		gattlib_gatt_db_foreach_cb_t callback, void* user_data);
+
 /**
  * @brief Function to read GATT characteristic
  *
@@ -720,17 +1533,18 @@ bool gattlib_is_connected_from_mac(void *adapter, const char *mac_address);
  */
 bool gattlib_is_services_resolved_from_mac(void *adapter, const char *mac_address);
 
-#if 0 // Disable until https://github.com/labapart/gattlib/issues/75 is resolved
 /**
  * @brief Function to retrieve RSSI from a GATT connection
  *
+ * @note: The value is the last one reported by Bluez. Bluez only reports it while it receives
+ * advertisements from the device.
+ *
  * @param connection Active GATT connection
  * @param rssi is the Received Signal Strength Indicator of the remote device
  *
- * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ * @return GATTLIB_SUCCESS on success, GATTLIB_NOT_FOUND if no RSSI is known or GATTLIB_* error code
  */
 int gattlib_get_rssi(gatt_connection_t *connection, int16_t *rssi);
-#endif
 
 /**
  * @brief Function to retrieve RSSI from a MAC Address
@@ -807,6 +1621,81 @@ int gattlib_get_advertisement_data_from_mac(void *adapter, const char *mac_addre
 		gattlib_advertisement_data_t **advertisement_data, size_t *advertisement_data_count,
 		uint16_t *manufacturer_id, uint8_t **manufacturer_data, size_t *manufacturer_data_size);
 
+/**
+ * @brief Function to retrieve the counters of a GATT connection
+ *
+ * The counters are incremented with atomic operations since the connection has been established.
+ * Each counter of the snapshot is consistent but the snapshot is not taken atomically as a whole.
+ *
+ * @note The operations by MAC address (`gattlib_*_from_mac()`) are not counted as they have no connection.
+ *
+ * @param connection Active GATT connection
+ * @param stats is the snapshot of the counters
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_get_stats(gatt_connection_t *connection, gattlib_connection_stats_t *stats);
+
+/**
+ * @brief Function to retrieve the counters of an adapter
+ *
+ * The counters are incremented with atomic operations since the adapter has been opened.
+ *
+ * @param adapter is the context of the opened adapter
+ * @param stats is the snapshot of the counters
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_adapter_get_stats(void *adapter, gattlib_adapter_stats_t *stats);
+
+/**
+ * @brief Set the hooks called around the public operations
+ *
+ * The hooks are called by the thread calling the operation: connect, discover, read, write, notification
+ * and indication start/stop, and stream write. Without hooks, the tracing costs a single test per operation.
+ *
+ * @note The hooks are process-wide. Set them before starting the operations to trace.
+ * @note The operations completed asynchronously (`*_async()` callbacks) are not traced.
+ *
+ * @param begin_cb is called at the start of each operation. NULL for none.
+ * @param end_cb is called at the end of each operation. NULL for none.
+ * @param user_data is the data passed to the hooks
+ */
+void gattlib_set_trace_hooks(gattlib_trace_begin_cb_t begin_cb, gattlib_trace_end_cb_t end_cb, void *user_data);
+
+/**
+ * @brief Start capturing the ATT PDUs of the connections and the HCI events of the scanner
+ *
+ * The packets are recorded without locking into an in-memory ring of `packet_count` packets. The ring is
+ * flushed to a btsnoop file (format of `btmon -w`, readable with `btmon -r` or Wireshark) periodically from a
+ * dedicated thread or on demand with gattlib_capture_flush(). When the ring is full, the oldest packets are
+ * overwritten and reported as dropped in the file.
+ *
+ * @note This function is only supported by the legacy backend with Bluez v5. The scans done through the kernel
+ *       management interface (`GATTLIB_ADAPTER_OPTIONS_LEGACY_USE_MGMT`) are not captured.
+ *
+ * @param path			Path of the btsnoop file (truncated)
+ * @param packet_count		Capacity of the ring (rounded up to a power of 2)
+ * @param flush_period_ms	Period of the flushes. 0 to only flush with gattlib_capture_flush() (flight recorder).
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_capture_start(const char *path, size_t packet_count, unsigned int flush_period_ms);
+
+/**
+ * @brief Write the packets of the capture ring not written yet to the btsnoop file
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_capture_flush(void);
+
+/**
+ * @brief Stop the capture, flush the ring and close the btsnoop file
+ *
+ * @return GATTLIB_SUCCESS on success or GATTLIB_* error code
+ */
+int gattlib_capture_stop(void);
+
 /**
  * @brief Function to process pending glib events
  */
@@ -0,0 +1,158 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// Test of the evaluation of the advertisement data filters against raw AD structures (see 'common/gattlib_ad_filter.c').
+//
+// The AD structures come from the radio: the walk must stop on malformed structures without reading past the data.
+// Each advertisement is copied into a buffer of its exact size so the memory checkers catch any overread.
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gattlib_internal_defs.h"
+
+#define TEST_SERVICE_UUID128_STR    "12345678-9abc-def0-1234-56789abcdef0"
+
+#define TEST_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: Check '%s' has failed.\n", __FILE__, __LINE__, #condition); \
+			ret = 1; \
+			goto CLEAR; \
+		} \
+	} while (0)
+
+static bool match_raw(const struct gattlib_ad_filters *ad_filters, const uint8_t *ad_data, size_t ad_data_length) {
+	uint8_t *copy = malloc(ad_data_length);
+	bool match;
+
+	if (ad_data_length > 0) {
+		memcpy(copy, ad_data, ad_data_length);
+	}
+	match = gattlib_ad_filters_match_raw(ad_filters, copy, ad_data_length);
+
+	free(copy);
+	return match;
+}
+
+#define MATCH_RAW(ad_filters, ad_data) match_raw(ad_filters, ad_data, sizeof(ad_data))
+
+int main(int argc, char *argv[]) {
+	struct gattlib_ad_filters ad_filters = { 0 };
+	gattlib_ad_filter_t filters[4];
+	uuid_t uuid128;
+	int ret = 0;
+
+	// Flags, then manufacturer data of the company 0xFFFF starting with 7e 57
+	static const uint8_t manufacturer_ad[] = { 0x02, 0x01, 0x06, 0x05, 0xFF, 0xFF, 0xFF, 0x7E, 0x57 };
+	static const uint8_t other_manufacturer_ad[] = { 0x05, 0xFF, 0xFF, 0xFF, 0x00, 0x00 };
+	// Manufacturer data shorter than the prefix of the filter
+	static const uint8_t short_manufacturer_ad[] = { 0x04, 0xFF, 0xFF, 0xFF, 0x7E };
+	// Manufacturer data without its company ID
+	static const uint8_t no_company_ad[] = { 0x02, 0xFF, 0xFF };
+	// Service data of the 16-bit UUID 0x180d, 32-bit UUID 0x1234180d and 128-bit UUID TEST_SERVICE_UUID128_STR
+	static const uint8_t service16_ad[] = { 0x04, 0x16, 0x0D, 0x18, 0x01 };
+	static const uint8_t service32_ad[] = { 0x06, 0x20, 0x0D, 0x18, 0x34, 0x12, 0x02 };
+	static const uint8_t service128_ad[] = { 0x12, 0x21,
+		0xF0, 0xDE, 0xBC, 0x9A, 0x78, 0x56, 0x34, 0x12, 0xF0, 0xDE, 0xBC, 0x9A, 0x78, 0x56, 0x34, 0x12, 0x03 };
+	// Service data whose UUID is truncated
+	static const uint8_t truncated_uuid_ad[] = { 0x02, 0x16, 0x0D };
+	// A zero length structure ends the walk: the manufacturer data following it is not evaluated
+	static const uint8_t zero_length_ad[] = { 0x00, 0x05, 0xFF, 0xFF, 0xFF, 0x7E, 0x57 };
+	// The length of the structure goes past the end of the data
+	static const uint8_t overflow_ad[] = { 0x10, 0xFF, 0xFF, 0xFF, 0x7E, 0x57 };
+	// Only the length of a structure
+	static const uint8_t length_only_ad[] = { 0x05 };
+
+	// Without filter, every advertisement matches
+	TEST_CHECK(MATCH_RAW(&ad_filters, other_manufacturer_ad));
+	TEST_CHECK(match_raw(&ad_filters, NULL, 0));
+
+	memset(filters, 0, sizeof(filters));
+	filters[0].type = GATTLIB_AD_FILTER_MANUFACTURER_DATA;
+	filters[0].company_id = 0xFFFF;
+	filters[0].data[0] = 0x7E;
+	filters[0].data[1] = 0x57;
+	filters[0].data_length = 2;
+
+	filters[1].type = GATTLIB_AD_FILTER_SERVICE_DATA;
+	filters[1].service_uuid = CREATE_UUID16(0x180D);
+	filters[1].data[0] = 0x01;
+	filters[1].data_length = 1;
+
+	filters[2].type = GATTLIB_AD_FILTER_SERVICE_DATA;
+	filters[2].service_uuid.type = SDP_UUID32;
+	filters[2].service_uuid.value.uuid32 = 0x1234180D;
+	filters[2].flags = GATTLIB_AD_FILTER_FLAG_USE_MASK;
+	filters[2].data[0] = 0x0F;
+	filters[2].mask[0] = 0x02;
+	filters[2].data_length = 1;
+
+	TEST_CHECK(gattlib_string_to_uuid(TEST_SERVICE_UUID128_STR, strlen(TEST_SERVICE_UUID128_STR), &uuid128) == 0);
+	filters[3].type = GATTLIB_AD_FILTER_SERVICE_DATA;
+	filters[3].service_uuid = uuid128;
+	filters[3].data[0] = 0x03;
+	filters[3].data_length = 1;
+
+	TEST_CHECK(gattlib_ad_filters_set(&ad_filters, filters, G_N_ELEMENTS(filters)) == GATTLIB_SUCCESS);
+
+	// Well formed advertisements
+	TEST_CHECK(MATCH_RAW(&ad_filters, manufacturer_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, other_manufacturer_ad));
+	TEST_CHECK(MATCH_RAW(&ad_filters, service16_ad));
+	TEST_CHECK(MATCH_RAW(&ad_filters, service32_ad));
+	TEST_CHECK(MATCH_RAW(&ad_filters, service128_ad));
+
+	// Malformed advertisements
+	TEST_CHECK(!MATCH_RAW(&ad_filters, short_manufacturer_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, no_company_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, truncated_uuid_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, zero_length_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, overflow_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, length_only_ad));
+	TEST_CHECK(!match_raw(&ad_filters, NULL, 0));
+
+	// Invalid filters are rejected and the current ones are kept
+	filters[0].data_length = GATTLIB_AD_FILTER_MAX_LEN + 1;
+	TEST_CHECK(gattlib_ad_filters_set(&ad_filters, filters, 1) == GATTLIB_INVALID_PARAMETER);
+	TEST_CHECK(MATCH_RAW(&ad_filters, service16_ad));
+
+	// The filters can be replaced
+	filters[0].data_length = 0;
+	TEST_CHECK(gattlib_ad_filters_set(&ad_filters, filters, 1) == GATTLIB_SUCCESS);
+	TEST_CHECK(MATCH_RAW(&ad_filters, other_manufacturer_ad));
+	TEST_CHECK(!MATCH_RAW(&ad_filters, service16_ad));
+
+	gattlib_ad_filters_clear(&ad_filters);
+	TEST_CHECK(MATCH_RAW(&ad_filters, service16_ad));
+
+CLEAR:
+	gattlib_ad_filters_clear(&ad_filters);
+
+	printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+	return ret;
+}
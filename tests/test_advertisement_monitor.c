@@ -0,0 +1,121 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// Test of the advertisement monitors against the fake Bluez service (see 'dbus/fake-bluez/run-with-fake-bluez.sh').
+//
+// The monitor matches the manufacturer data of the device '00:00:00:00:7E:01' of 'gattlib-tests.conf' that is
+// expected to be found and then lost once its advertising duration has elapsed. The other device must not be reported.
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gattlib.h"
+
+#define TEST_DEVICE_ADDRESS  "00:00:00:00:7E:01"
+#define TEST_TIMEOUT_S       5
+
+static GMainLoop *m_main_loop;
+static int m_found_count;
+static int m_lost_count;
+static int m_unexpected_count;
+
+static void on_device_found(void *adapter, const char* addr, void *user_data) {
+	printf("Device found: %s\n", addr);
+	if (strcmp(addr, TEST_DEVICE_ADDRESS) == 0) {
+		m_found_count++;
+	} else {
+		m_unexpected_count++;
+	}
+}
+
+static void on_device_lost(void *adapter, const char* addr, void *user_data) {
+	printf("Device lost: %s\n", addr);
+	if (strcmp(addr, TEST_DEVICE_ADDRESS) == 0) {
+		m_lost_count++;
+		g_main_loop_quit(m_main_loop);
+	} else {
+		m_unexpected_count++;
+	}
+}
+
+static gboolean on_timeout(gpointer user_data) {
+	g_main_loop_quit(m_main_loop);
+	return FALSE;
+}
+
+int main(int argc, char *argv[]) {
+	// Manufacturer data of the test device: company ID 0xFFFF (little-endian) followed by '7e 57'
+	const gattlib_advertisement_monitor_pattern_t pattern = {
+		.start_position = 0,
+		.ad_type = 0xFF,
+		.content = { 0xFF, 0xFF, 0x7E, 0x57 },
+		.content_length = 4,
+	};
+	const gattlib_advertisement_monitor_t monitor = {
+		.patterns = &pattern,
+		.pattern_count = 1,
+		.rssi_low_threshold = GATTLIB_ADVERTISEMENT_MONITOR_RSSI_UNSET,
+		.rssi_high_threshold = GATTLIB_ADVERTISEMENT_MONITOR_RSSI_UNSET,
+		.rssi_low_timeout = GATTLIB_ADVERTISEMENT_MONITOR_TIMEOUT_UNSET,
+		.rssi_high_timeout = GATTLIB_ADVERTISEMENT_MONITOR_TIMEOUT_UNSET,
+		.rssi_sampling_period = GATTLIB_ADVERTISEMENT_MONITOR_SAMPLING_UNSET,
+	};
+	void *adapter, *monitor_handle;
+	int ret;
+
+	ret = gattlib_adapter_open(NULL, &adapter);
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "Failed to open adapter.\n");
+		return 1;
+	}
+
+	ret = gattlib_adapter_advertisement_monitor_add(adapter, &monitor, on_device_found, on_device_lost, NULL, &monitor_handle);
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "Failed to add the advertisement monitor (%d).\n", ret);
+		gattlib_adapter_close(adapter);
+		return 1;
+	}
+
+	// The monitor is served by the main loop
+	m_main_loop = g_main_loop_new(NULL, FALSE);
+	g_timeout_add_seconds(TEST_TIMEOUT_S, on_timeout, NULL);
+	g_main_loop_run(m_main_loop);
+	g_main_loop_unref(m_main_loop);
+
+	ret = gattlib_adapter_advertisement_monitor_remove(adapter, monitor_handle);
+	if (ret != GATTLIB_SUCCESS) {
+		fprintf(stderr, "Failed to remove the advertisement monitor (%d).\n", ret);
+	}
+	gattlib_adapter_close(adapter);
+
+	if ((ret != GATTLIB_SUCCESS) || (m_found_count != 1) || (m_lost_count != 1) || (m_unexpected_count != 0)) {
+		fprintf(stderr, "FAIL: found:%d lost:%d unexpected:%d\n", m_found_count, m_lost_count, m_unexpected_count);
+		return 1;
+	}
+
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,252 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// Test of the kernel management interface of the legacy backend (see 'bluez/gattlib_mgmt.c').
+//
+// The kernel is emulated by a thread serving the other end of a socket pair: it completes every command,
+// reports a device once the discovery is started and records the parameters of the commands.
+//
+
+#include "gattlib_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bluetooth/bluetooth.h>
+
+#include "lib/mgmt.h"
+
+#define TEST_INDEX        0
+#define TEST_RSSI         -42
+#define TEST_TIMEOUT_US   (2 * G_USEC_PER_SEC)
+
+static const bdaddr_t m_device_bdaddr = {{ 0x01, 0x7E, 0x00, 0x00, 0x00, 0x00 }};
+// Complete local name 'gattlib'
+static const uint8_t m_device_eir[] = { 0x08, 0x09, 'g', 'a', 't', 't', 'l', 'i', 'b' };
+
+struct fake_kernel {
+	int fd;
+	GThread *thread;
+
+	GMutex mutex;
+	GCond cond;
+	// Opcodes of the received commands
+	GArray *opcodes;
+	struct mgmt_cp_add_device add_device;
+
+	// Device reported to the discovery callback
+	bool device_found;
+	bdaddr_t device_found_bdaddr;
+	uint8_t device_found_type;
+	int8_t device_found_rssi;
+	bool device_found_eir_match;
+};
+
+static void fake_kernel_send(struct fake_kernel *kernel, uint16_t event, const void *param, uint16_t length) {
+	uint8_t buffer[MGMT_HDR_SIZE + 64];
+	struct mgmt_hdr *hdr = (struct mgmt_hdr *)buffer;
+
+	hdr->opcode = htobs(event);
+	hdr->index = htobs(TEST_INDEX);
+	hdr->len = htobs(length);
+	memcpy(buffer + MGMT_HDR_SIZE, param, length);
+
+	if (write(kernel->fd, buffer, MGMT_HDR_SIZE + length) < 0) {
+		fprintf(stderr, "Fake kernel failed to send event 0x%04x.\n", event);
+	}
+}
+
+static void fake_kernel_report_device(struct fake_kernel *kernel) {
+	uint8_t buffer[sizeof(struct mgmt_ev_device_found) + sizeof(m_device_eir)];
+	struct mgmt_ev_device_found *ev = (struct mgmt_ev_device_found *)buffer;
+
+	memset(buffer, 0, sizeof(buffer));
+	bacpy(&ev->addr.bdaddr, &m_device_bdaddr);
+	ev->addr.type = BDADDR_LE_RANDOM;
+	ev->rssi = TEST_RSSI;
+	ev->eir_len = htobs(sizeof(m_device_eir));
+	memcpy(ev->eir, m_device_eir, sizeof(m_device_eir));
+
+	fake_kernel_send(kernel, MGMT_EV_DEVICE_FOUND, buffer, sizeof(buffer));
+}
+
+static gpointer fake_kernel_thread(gpointer user_data) {
+	struct fake_kernel *kernel = user_data;
+	uint8_t buffer[512];
+	ssize_t length;
+
+	// The socket is shut down at the end of the test
+	while ((length = read(kernel->fd, buffer, sizeof(buffer))) >= MGMT_HDR_SIZE) {
+		const struct mgmt_hdr *hdr = (const struct mgmt_hdr *)buffer;
+		uint16_t opcode = btohs(hdr->opcode);
+		uint8_t reply[sizeof(struct mgmt_ev_cmd_complete) + sizeof(struct mgmt_rp_add_device)];
+		struct mgmt_ev_cmd_complete *cc = (struct mgmt_ev_cmd_complete *)reply;
+		uint16_t reply_length = sizeof(struct mgmt_ev_cmd_complete);
+
+		g_mutex_lock(&kernel->mutex);
+		g_array_append_val(kernel->opcodes, opcode);
+		if ((opcode == MGMT_OP_ADD_DEVICE) && (length >= MGMT_HDR_SIZE + sizeof(struct mgmt_cp_add_device))) {
+			memcpy(&kernel->add_device, buffer + MGMT_HDR_SIZE, sizeof(struct mgmt_cp_add_device));
+		}
+		g_cond_broadcast(&kernel->cond);
+		g_mutex_unlock(&kernel->mutex);
+
+		memset(reply, 0, sizeof(reply));
+		cc->opcode = htobs(opcode);
+		cc->status = MGMT_STATUS_SUCCESS;
+		if (opcode == MGMT_OP_START_DISCOVERY) {
+			// Return parameter: address types of the discovery
+			cc->data[0] = buffer[MGMT_HDR_SIZE];
+			reply_length += 1;
+		} else if (opcode == MGMT_OP_ADD_DEVICE) {
+			memcpy(cc->data, buffer + MGMT_HDR_SIZE, sizeof(struct mgmt_rp_add_device));
+			reply_length += sizeof(struct mgmt_rp_add_device);
+		}
+		fake_kernel_send(kernel, MGMT_EV_CMD_COMPLETE, reply, reply_length);
+
+		if (opcode == MGMT_OP_START_DISCOVERY) {
+			fake_kernel_report_device(kernel);
+		}
+	}
+
+	return NULL;
+}
+
+static bool fake_kernel_has_received(struct fake_kernel *kernel, uint16_t opcode) {
+	bool received = false;
+
+	g_mutex_lock(&kernel->mutex);
+	for (guint i = 0; i < kernel->opcodes->len; i++) {
+		if (g_array_index(kernel->opcodes, uint16_t, i) == opcode) {
+			received = true;
+		}
+	}
+	g_mutex_unlock(&kernel->mutex);
+	return received;
+}
+
+/*
+ * Called from the gattlib thread
+ */
+static void on_device_found(const bdaddr_t *bdaddr, uint8_t bdaddr_type, int8_t rssi,
+		const uint8_t *eir, size_t eir_length, void *user_data)
+{
+	struct fake_kernel *kernel = user_data;
+
+	g_mutex_lock(&kernel->mutex);
+	kernel->device_found = true;
+	bacpy(&kernel->device_found_bdaddr, bdaddr);
+	kernel->device_found_type = bdaddr_type;
+	kernel->device_found_rssi = rssi;
+	kernel->device_found_eir_match = (eir_length == sizeof(m_device_eir)) && (memcmp(eir, m_device_eir, eir_length) == 0);
+	g_cond_broadcast(&kernel->cond);
+	g_mutex_unlock(&kernel->mutex);
+}
+
+static bool wait_device_found(struct fake_kernel *kernel) {
+	gint64 end_time = g_get_monotonic_time() + TEST_TIMEOUT_US;
+	bool device_found;
+
+	g_mutex_lock(&kernel->mutex);
+	while (!kernel->device_found) {
+		if (!g_cond_wait_until(&kernel->cond, &kernel->mutex, end_time)) {
+			break;
+		}
+	}
+	device_found = kernel->device_found;
+	g_mutex_unlock(&kernel->mutex);
+	return device_found;
+}
+
+#define TEST_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: Check '%s' has failed.\n", __FILE__, __LINE__, #condition); \
+			ret = 1; \
+			goto CLOSE; \
+		} \
+	} while (0)
+
+int main(int argc, char *argv[]) {
+	struct fake_kernel kernel;
+	struct gattlib_mgmt *gattlib_mgmt;
+	int fds[2];
+	int ret = 0;
+
+	// The kernel management channel preserves the message boundaries
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	memset(&kernel, 0, sizeof(kernel));
+	kernel.fd = fds[1];
+	kernel.opcodes = g_array_new(FALSE, FALSE, sizeof(uint16_t));
+	g_mutex_init(&kernel.mutex);
+	g_cond_init(&kernel.cond);
+	kernel.thread = g_thread_new("fake-kernel", fake_kernel_thread, &kernel);
+
+	gattlib_mgmt = gattlib_mgmt_new(fds[0], TEST_INDEX);
+	if (gattlib_mgmt == NULL) {
+		fprintf(stderr, "Failed to create the management interface.\n");
+		ret = 1;
+		goto CLOSE;
+	}
+
+	// Start Discovery and Device Found
+	TEST_CHECK(gattlib_mgmt_start_discovery(gattlib_mgmt, on_device_found, &kernel) == GATTLIB_SUCCESS);
+	TEST_CHECK(fake_kernel_has_received(&kernel, MGMT_OP_START_DISCOVERY));
+	TEST_CHECK(wait_device_found(&kernel));
+	TEST_CHECK(bacmp(&kernel.device_found_bdaddr, &m_device_bdaddr) == 0);
+	TEST_CHECK(kernel.device_found_type == BDADDR_LE_RANDOM);
+	TEST_CHECK(kernel.device_found_rssi == TEST_RSSI);
+	TEST_CHECK(kernel.device_found_eir_match);
+
+	TEST_CHECK(gattlib_mgmt_stop_discovery(gattlib_mgmt) == GATTLIB_SUCCESS);
+	TEST_CHECK(fake_kernel_has_received(&kernel, MGMT_OP_STOP_DISCOVERY));
+
+	// Add Device
+	TEST_CHECK(gattlib_mgmt_add_device(gattlib_mgmt, &m_device_bdaddr, BDADDR_LE_RANDOM, MGMT_ADD_DEVICE_AUTO_CONNECT) == GATTLIB_SUCCESS);
+	TEST_CHECK(fake_kernel_has_received(&kernel, MGMT_OP_ADD_DEVICE));
+	TEST_CHECK(bacmp(&kernel.add_device.addr.bdaddr, &m_device_bdaddr) == 0);
+	TEST_CHECK(kernel.add_device.addr.type == BDADDR_LE_RANDOM);
+	TEST_CHECK(kernel.add_device.action == MGMT_ADD_DEVICE_AUTO_CONNECT);
+
+CLOSE:
+	gattlib_mgmt_close(gattlib_mgmt);
+
+	shutdown(fds[1], SHUT_RDWR);
+	g_thread_join(kernel.thread);
+	close(fds[0]);
+	close(fds[1]);
+
+	g_array_free(kernel.opcodes, TRUE);
+	g_cond_clear(&kernel.cond);
+	g_mutex_clear(&kernel.mutex);
+
+	printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+	return ret;
+}
@@ -0,0 +1,150 @@
+/*
+ *
+ *  GattLib - GATT Library
+ *
+ *  Copyright (C) 2016-2020 Olivier Martin <olivier@labapart.org>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+//
+// Smoke test of the GATT operations against the device described by 'gattlib-tests.conf'.
+//
+// The device is served by the fake Bluez service with the DBus backend (see 'dbus/fake-bluez/run-with-fake-bluez.sh')
+// or by the loopback ATT peer with the legacy backend (option '-l <description_file>').
+//
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gattlib.h"
+
+#define TEST_DEVICE_ADDRESS         "00:00:00:00:7E:01"
+#define TEST_NOTIFICATION_COUNT     10
+#define TEST_NOTIFICATION_TIMEOUT_S 5
+
+static const uuid_t m_notify_uuid = CREATE_UUID16(0x2A37);
+static const uuid_t m_read_write_uuid = CREATE_UUID16(0x2A38);
+
+static GMainLoop *m_main_loop;
+static gint m_notification_count;
+
+#define TEST_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: Check '%s' has failed.\n", __FILE__, __LINE__, #condition); \
+			goto DISCONNECT; \
+		} \
+	} while (0)
+
+static void on_notification(const uuid_t* uuid, const uint8_t* data, size_t data_length, void* user_data) {
+	if ((gattlib_uuid_cmp(uuid, &m_notify_uuid) == GATTLIB_SUCCESS) &&
+	    (g_atomic_int_add(&m_notification_count, 1) + 1 == TEST_NOTIFICATION_COUNT)) {
+		g_main_loop_quit(m_main_loop);
+	}
+}
+
+static gboolean on_notification_timeout(gpointer user_data) {
+	g_main_loop_quit(m_main_loop);
+	return FALSE;
+}
+
+static bool tree_has_characteristic(const gattlib_gatt_tree_t *tree, const uuid_t *uuid) {
+	for (size_t i = 0; i < tree->services_count; i++) {
+		const gattlib_gatt_tree_service_t *service = &tree->services[i];
+
+		for (size_t j = 0; j < service->characteristics_count; j++) {
+			if (gattlib_uuid_cmp(&service->characteristics[j].characteristic.uuid, uuid) == GATTLIB_SUCCESS) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+int main(int argc, char *argv[]) {
+	const char *description_file = NULL;
+	gatt_connection_t* connection;
+	gattlib_gatt_tree_t* tree = NULL;
+	const uint8_t written_value[] = { 0x5A, 0xA5 };
+	void *buffer = NULL;
+	size_t buffer_len;
+	int opt, ret = 1;
+
+	while ((opt = getopt(argc, argv, "l:")) != -1) {
+		switch (opt) {
+		case 'l':
+			description_file = optarg;
+			break;
+		default:
+			printf("%s [-l <description_file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (description_file != NULL) {
+		connection = gattlib_connect_loopback(description_file, TEST_DEVICE_ADDRESS);
+	} else {
+		connection = gattlib_connect(NULL, TEST_DEVICE_ADDRESS, GATTLIB_CONNECTION_OPTIONS_LEGACY_DEFAULT);
+	}
+	if (connection == NULL) {
+		fprintf(stderr, "Fail to connect to the test device.\n");
+		return 1;
+	}
+
+	// Discovery
+	TEST_CHECK(gattlib_discover_all(connection, &tree) == GATTLIB_SUCCESS);
+	TEST_CHECK(tree->services_count == 1);
+	TEST_CHECK(tree_has_characteristic(tree, &m_notify_uuid));
+	TEST_CHECK(tree_has_characteristic(tree, &m_read_write_uuid));
+
+	// Read, write and read back
+	TEST_CHECK(gattlib_read_char_by_uuid(connection, (uuid_t*)&m_read_write_uuid, &buffer, &buffer_len) == GATTLIB_SUCCESS);
+	TEST_CHECK((buffer_len == 1) && (((uint8_t*)buffer)[0] == 0x01));
+	free(buffer);
+	buffer = NULL;
+
+	TEST_CHECK(gattlib_write_char_by_uuid(connection, (uuid_t*)&m_read_write_uuid, written_value, sizeof(written_value)) == GATTLIB_SUCCESS);
+	TEST_CHECK(gattlib_read_char_by_uuid(connection, (uuid_t*)&m_read_write_uuid, &buffer, &buffer_len) == GATTLIB_SUCCESS);
+	TEST_CHECK((buffer_len == sizeof(written_value)) && (memcmp(buffer, written_value, sizeof(written_value)) == 0));
+
+	// Notifications
+	m_main_loop = g_main_loop_new(NULL, FALSE);
+	gattlib_register_notification(connection, on_notification, NULL);
+	TEST_CHECK(gattlib_notification_start(connection, &m_notify_uuid) == GATTLIB_SUCCESS);
+
+	g_timeout_add_seconds(TEST_NOTIFICATION_TIMEOUT_S, on_notification_timeout, NULL);
+	g_main_loop_run(m_main_loop);
+
+	TEST_CHECK(gattlib_notification_stop(connection, &m_notify_uuid) == GATTLIB_SUCCESS);
+	TEST_CHECK(g_atomic_int_get(&m_notification_count) >= TEST_NOTIFICATION_COUNT);
+
+	ret = 0;
+
+DISCONNECT:
+	if (m_main_loop != NULL) {
+		g_main_loop_unref(m_main_loop);
+	}
+	free(buffer);
+	free(tree);
+	gattlib_disconnect(connection);
+	printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+	return ret;
+}